@@ -35,12 +35,24 @@
 #ifdef HAVE_NETINET_TCP_H
 # include <netinet/tcp.h>
 #endif
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#ifdef HAVE_TIME_H
+# include <time.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
 #ifdef HAVE_SYS_TYPES_H
 # include <sys/types.h>
 #endif
 #ifdef HAVE_SYS_SOCKET_H
 # include <sys/socket.h>
 #endif
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
 
 
 
@@ -82,6 +94,9 @@ int flom_client_connect(flom_config_t *config,
     
     FLOM_TRACE(("flom_client_connect\n"));
     TRY {
+        /* protocol level of the messages sent to the daemon */
+        flom_conn_set_level(conn, flom_config_get_binary_protocol(config) ?
+                            FLOM_MSG_LEVEL_BINARY : FLOM_MSG_LEVEL);
         /* choose and instantiate connection type */
         if (NULL != flom_config_get_socket_name(config)) {
             if (FLOM_RC_OK != (ret_cod = flom_client_connect_local(
@@ -93,8 +108,12 @@ int flom_client_connect(flom_config_t *config,
                 THROW(CLIENT_CONNECT_TCP_ERROR);
         } else if (NULL != flom_config_get_multicast_address(config)) {
             sa_family_t family;
-            ret_cod = flom_client_discover_udp(
-                config, conn, start_daemon, &family);
+            /* the daemon discovered by a previous command is tried
+               before sending the multicast datagrams */
+            if (FLOM_RC_OK != (ret_cod = flom_client_discover_cache_connect(
+                                   config, conn)))
+                ret_cod = flom_client_discover_udp(
+                    config, conn, start_daemon, &family);
             switch (ret_cod) {
                 case FLOM_RC_OK:
                     break;
@@ -143,6 +162,13 @@ int flom_client_connect(flom_config_t *config,
             NULL != flom_config_get_tls_ca_certificate(config)) {
             /* initialize TLS/SSL support */
             flom_conn_init_tls(conn, TRUE);
+            /* the session of a previous client can be resumed */
+            flom_tls_set_session_file(
+                flom_conn_get_tls(conn),
+                flom_config_get_tls_session_file(config));
+            flom_tls_set_kernel_offload(
+                flom_conn_get_tls(conn),
+                flom_config_get_tls_kernel_offload(config));
 
             /* create a TLS/SSL context */
             if (FLOM_RC_OK != (ret_cod = flom_tls_context(
@@ -421,8 +447,8 @@ int flom_client_discover_udp(flom_config_t *config,
                      , SENDTO_ERROR
                      , CONNECTION_REFUSED
                      , RECVFROM_ERROR
-                     , G_MARKUP_PARSE_CONTEXT_NEW_ERROR
                      , MSG_DESERIALIZE_ERROR
+                     , INVALID_REPLY
                      , SET_SIN6_SCOPE_ID_ERROR
                      , CLIENT_CONNECT_TCP_ERROR
                      , INVALID_AI_FAMILY2
@@ -450,7 +476,6 @@ int flom_client_discover_udp(flom_config_t *config,
         ssize_t received;
         struct sockaddr_storage from;
         socklen_t addrlen = sizeof(from);
-        GMarkupParseContext *tmp_parser;
         
         flom_msg_init(&msg);
         
@@ -658,17 +683,14 @@ int flom_client_discover_udp(flom_config_t *config,
         flom_msg_free(&msg);
         flom_msg_init(&msg);
 
-        /* instantiate a new parser */
-        if (NULL == (tmp_parser = g_markup_parse_context_new(
-                         &flom_msg_parser, 0, (gpointer)&msg, NULL)))
-            THROW(G_MARKUP_PARSE_CONTEXT_NEW_ERROR);
-        flom_conn_set_parser(conn, tmp_parser);
-        
         /* deserialize the reply message */
         if (FLOM_RC_OK != (ret_cod = flom_msg_deserialize(
                                in_buffer, received, &msg,
                                flom_conn_get_parser(conn))))
             THROW(MSG_DESERIALIZE_ERROR);
+        if (FLOM_MSG_STATE_READY != msg.state ||
+            NULL == msg.body.discover_16.network.address)
+            THROW(INVALID_REPLY);
 
         flom_msg_trace(&msg);        
 
@@ -728,6 +750,10 @@ int flom_client_discover_udp(flom_config_t *config,
                                    conn, sa, addrlen)))
                 THROW(CLIENT_DISCOVER_UDP_CONNECT_ERROR);
         }
+        /* the next command can skip the discovery phase: a cache that
+           can't be written is not an error */
+        if (NULL != flom_config_get_discovery_cache_file(config))
+            flom_client_discover_cache_save(config, conn);
         THROW(NONE);
     } CATCH {
         switch (excp) {
@@ -754,10 +780,11 @@ int flom_client_discover_udp(flom_config_t *config,
             case RECVFROM_ERROR:
                 ret_cod = FLOM_RC_RECVFROM_ERROR;
                 break;
-            case G_MARKUP_PARSE_CONTEXT_NEW_ERROR:
-                ret_cod = FLOM_RC_G_MARKUP_PARSE_CONTEXT_NEW_ERROR;
-                break;
             case MSG_DESERIALIZE_ERROR:
+                break;
+            case INVALID_REPLY:
+                ret_cod = FLOM_RC_MSG_DESERIALIZE_ERROR;
+                break;
             case SET_SIN6_SCOPE_ID_ERROR:
             case CLIENT_CONNECT_TCP_ERROR:
                 break;
@@ -846,6 +873,273 @@ int flom_client_discover_udp_connect(flom_conn_t *conn,
 }
 
 
+
+int flom_client_discover_cache_connect(flom_config_t *config,
+                                       flom_conn_t *conn)
+{
+    enum Exception { INACTIVE_FEATURE
+                     , G_KEY_FILE_NEW_ERROR
+                     , G_KEY_FILE_LOAD_FROM_FILE_ERROR
+                     , INVALID_PROPERTY_VALUE
+                     , MULTICAST_MISMATCH
+                     , CACHE_EXPIRED
+                     , GETADDRINFO_ERROR
+                     , CLIENT_DISCOVER_UDP_CONNECT_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+
+    GKeyFile *gkf = NULL;
+    GError *error = NULL;
+    gchar *multicast_address = NULL;
+    gchar *address = NULL;
+    gchar *port = NULL;
+    struct addrinfo *result = NULL;
+    
+    FLOM_TRACE(("flom_client_discover_cache_connect\n"));
+    TRY {
+        const gchar *cache_file =
+            flom_config_get_discovery_cache_file(config);
+        gint multicast_port;
+        guint64 expiration;
+        struct addrinfo hints;
+        int errcode;
+        
+        if (NULL == cache_file)
+            THROW(INACTIVE_FEATURE);
+        if (NULL == (gkf = g_key_file_new()))
+            THROW(G_KEY_FILE_NEW_ERROR);
+        if (!g_key_file_load_from_file(gkf, cache_file, G_KEY_FILE_NONE,
+                                       &error)) {
+            FLOM_TRACE(("flom_client_discover_cache_connect/"
+                        "g_key_file_load_from_file('%s'): code=%d, "
+                        "message='%s'\n", cache_file, error->code,
+                        error->message));
+            g_error_free(error);
+            error = NULL;
+            THROW(G_KEY_FILE_LOAD_FROM_FILE_ERROR);
+        }
+        multicast_address = g_key_file_get_string(
+            gkf, FLOM_CLIENT_DISCOVER_CACHE_GROUP,
+            FLOM_CLIENT_DISCOVER_CACHE_KEY_MULTICAST_ADDRESS, NULL);
+        multicast_port = g_key_file_get_integer(
+            gkf, FLOM_CLIENT_DISCOVER_CACHE_GROUP,
+            FLOM_CLIENT_DISCOVER_CACHE_KEY_MULTICAST_PORT, NULL);
+        address = g_key_file_get_string(
+            gkf, FLOM_CLIENT_DISCOVER_CACHE_GROUP,
+            FLOM_CLIENT_DISCOVER_CACHE_KEY_ADDRESS, NULL);
+        port = g_key_file_get_string(
+            gkf, FLOM_CLIENT_DISCOVER_CACHE_GROUP,
+            FLOM_CLIENT_DISCOVER_CACHE_KEY_PORT, NULL);
+        expiration = g_key_file_get_uint64(
+            gkf, FLOM_CLIENT_DISCOVER_CACHE_GROUP,
+            FLOM_CLIENT_DISCOVER_CACHE_KEY_EXPIRATION, NULL);
+        if (NULL == multicast_address || NULL == address || NULL == port)
+            THROW(INVALID_PROPERTY_VALUE);
+        /* the address has been discovered by a command that was using
+           a different multicast group: it can't be used */
+        if (0 != g_strcmp0(multicast_address,
+                           flom_config_get_multicast_address(config)) ||
+            multicast_port != flom_config_get_multicast_port(config))
+            THROW(MULTICAST_MISMATCH);
+        if ((guint64)time(NULL) >= expiration)
+            THROW(CACHE_EXPIRED);
+        FLOM_TRACE(("flom_client_discover_cache_connect: using cached "
+                    "address '%s' and port '%s'\n", address, port));
+        /* the cache contains numeric values only: no name resolution */
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_flags = AI_NUMERICHOST|AI_NUMERICSERV;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_protocol = IPPROTO_TCP;
+        if (0 != (errcode = getaddrinfo(address, port, &hints, &result))) {
+            FLOM_TRACE(("flom_client_discover_cache_connect/getaddrinfo(): "
+                        "errcode=%d '%s'\n", errcode, gai_strerror(errcode)));
+            THROW(GETADDRINFO_ERROR);
+        }
+        if (FLOM_RC_OK != (ret_cod = flom_client_discover_udp_connect(
+                               conn, result->ai_addr, result->ai_addrlen))) {
+            /* the daemon is not there anymore */
+            unlink(cache_file);
+            THROW(CLIENT_DISCOVER_UDP_CONNECT_ERROR);
+        }
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case INACTIVE_FEATURE:
+                ret_cod = FLOM_RC_INACTIVE_FEATURE;
+                break;
+            case G_KEY_FILE_NEW_ERROR:
+                ret_cod = FLOM_RC_G_KEY_FILE_NEW_ERROR;
+                break;
+            case G_KEY_FILE_LOAD_FROM_FILE_ERROR:
+                ret_cod = FLOM_RC_G_KEY_FILE_LOAD_FROM_FILE_ERROR;
+                break;
+            case INVALID_PROPERTY_VALUE:
+            case MULTICAST_MISMATCH:
+                ret_cod = FLOM_RC_INVALID_PROPERTY_VALUE;
+                break;
+            case CACHE_EXPIRED:
+                ret_cod = FLOM_RC_OUT_OF_RANGE;
+                break;
+            case GETADDRINFO_ERROR:
+                ret_cod = FLOM_RC_GETADDRINFO_ERROR;
+                break;
+            case CLIENT_DISCOVER_UDP_CONNECT_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    if (NULL != result)
+        freeaddrinfo(result);
+    g_free(port);
+    g_free(address);
+    g_free(multicast_address);
+    if (NULL != gkf)
+        g_key_file_free(gkf);
+    FLOM_TRACE(("flom_client_discover_cache_connect/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_client_discover_cache_save(flom_config_t *config,
+                                    const flom_conn_t *conn)
+{
+    enum Exception { GETNAMEINFO_ERROR
+                     , G_KEY_FILE_NEW_ERROR
+                     , G_KEY_FILE_TO_DATA_ERROR
+                     , G_STRDUP_PRINTF_ERROR
+                     , MKSTEMP_ERROR
+                     , FCHMOD_ERROR
+                     , WRITE_ERROR
+                     , RENAME_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+
+    GKeyFile *gkf = NULL;
+    gchar *data = NULL;
+    gchar *tmp_file = NULL;
+    int fd = FLOM_NULL_FD;
+    
+    FLOM_TRACE(("flom_client_discover_cache_save\n"));
+    TRY {
+        const gchar *cache_file =
+            flom_config_get_discovery_cache_file(config);
+        const flom_tcp_t *tcp = flom_conn_get_tcp((flom_conn_t *)conn);
+        char address[NI_MAXHOST];
+        char port[NI_MAXSERV];
+        gsize length;
+        int errcode;
+        
+        if (0 != (errcode = getnameinfo(
+                      (const struct sockaddr *)&tcp->sa_storage,
+                      flom_tcp_get_addrlen(tcp),
+                      address, sizeof(address), port, sizeof(port),
+                      NI_NUMERICHOST|NI_NUMERICSERV))) {
+            FLOM_TRACE(("flom_client_discover_cache_save/getnameinfo(): "
+                        "errcode=%d '%s'\n", errcode, gai_strerror(errcode)));
+            THROW(GETNAMEINFO_ERROR);
+        }
+        if (NULL == (gkf = g_key_file_new()))
+            THROW(G_KEY_FILE_NEW_ERROR);
+        g_key_file_set_string(
+            gkf, FLOM_CLIENT_DISCOVER_CACHE_GROUP,
+            FLOM_CLIENT_DISCOVER_CACHE_KEY_MULTICAST_ADDRESS,
+            flom_config_get_multicast_address(config));
+        g_key_file_set_integer(
+            gkf, FLOM_CLIENT_DISCOVER_CACHE_GROUP,
+            FLOM_CLIENT_DISCOVER_CACHE_KEY_MULTICAST_PORT,
+            flom_config_get_multicast_port(config));
+        g_key_file_set_string(
+            gkf, FLOM_CLIENT_DISCOVER_CACHE_GROUP,
+            FLOM_CLIENT_DISCOVER_CACHE_KEY_ADDRESS, address);
+        g_key_file_set_string(
+            gkf, FLOM_CLIENT_DISCOVER_CACHE_GROUP,
+            FLOM_CLIENT_DISCOVER_CACHE_KEY_PORT, port);
+        g_key_file_set_uint64(
+            gkf, FLOM_CLIENT_DISCOVER_CACHE_GROUP,
+            FLOM_CLIENT_DISCOVER_CACHE_KEY_EXPIRATION,
+            (guint64)time(NULL) +
+            flom_config_get_discovery_cache_lifespan(config));
+        if (NULL == (data = g_key_file_to_data(gkf, &length, NULL)))
+            THROW(G_KEY_FILE_TO_DATA_ERROR);
+        /* the commands that are reading the file must never see a partial
+           content; the temporary file is created with an unpredictable
+           name and it can not be a file (or a symbolic link) prepared by
+           another user */
+        if (NULL == (tmp_file = g_strdup_printf("%s.XXXXXX", cache_file)))
+            THROW(G_STRDUP_PRINTF_ERROR);
+        if (-1 == (fd = mkstemp(tmp_file)))
+            THROW(MKSTEMP_ERROR);
+        if (-1 == fchmod(fd, S_IRUSR|S_IWUSR))
+            THROW(FCHMOD_ERROR);
+        if ((ssize_t)length != write(fd, data, length))
+            THROW(WRITE_ERROR);
+        close(fd);
+        fd = FLOM_NULL_FD;
+        if (-1 == rename(tmp_file, cache_file))
+            THROW(RENAME_ERROR);
+        FLOM_TRACE(("flom_client_discover_cache_save: address '%s' and "
+                    "port '%s' saved in file '%s'\n", address, port,
+                    cache_file));
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case GETNAMEINFO_ERROR:
+                ret_cod = FLOM_RC_GETNAMEINFO_ERROR;
+                break;
+            case G_KEY_FILE_NEW_ERROR:
+                ret_cod = FLOM_RC_G_KEY_FILE_NEW_ERROR;
+                break;
+            case G_KEY_FILE_TO_DATA_ERROR:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+                break;
+            case G_STRDUP_PRINTF_ERROR:
+                ret_cod = FLOM_RC_G_STRDUP_ERROR;
+                break;
+            case MKSTEMP_ERROR:
+                ret_cod = FLOM_RC_MKSTEMP_ERROR;
+                break;
+            case FCHMOD_ERROR:
+                ret_cod = FLOM_RC_FCHMOD_ERROR;
+                break;
+            case WRITE_ERROR:
+                ret_cod = FLOM_RC_WRITE_ERROR;
+                break;
+            case RENAME_ERROR:
+                ret_cod = FLOM_RC_RENAME_ERROR;
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    if (FLOM_NULL_FD != fd)
+        close(fd);
+    if (NULL != tmp_file) {
+        /* the temporary file exists only if mkstemp succeeded */
+        if (MKSTEMP_ERROR < excp && NONE > excp)
+            unlink(tmp_file);
+        g_free(tmp_file);
+    }
+    g_free(data);
+    if (NULL != gkf)
+        g_key_file_free(gkf);
+    FLOM_TRACE(("flom_client_discover_cache_save/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
 int flom_client_lock(flom_config_t *config, flom_conn_t *conn,
                      int timeout, char **element)
 {
@@ -857,7 +1151,6 @@ int flom_client_lock(flom_config_t *config, flom_conn_t *conn,
                      , NETWORK_TIMEOUT1
                      , MSG_RETRIEVE_ERROR
                      , CONNECTION_CLOSED_BY_SERVER
-                     , G_MARKUP_PARSE_CONTEXT_NEW_ERROR
                      , MSG_DESERIALIZE_ERROR1
                      , PROTOCOL_LEVEL_MISMATCH
                      , MSG_DESERIALIZE_ERROR2
@@ -883,13 +1176,12 @@ int flom_client_lock(flom_config_t *config, flom_conn_t *conn,
         char buffer[FLOM_NETWORK_BUFFER_SIZE];
         size_t to_send;
         size_t to_read;
-        GMarkupParseContext *tmp_parser;
         gchar *peerid = NULL;
 
         /* initialize message */
         flom_msg_init(&msg);
         /* prepare a request (lock) message */
-        msg.header.level = FLOM_MSG_LEVEL;
+        msg.header.level = flom_conn_get_level(conn);
         msg.header.pvs.verb = FLOM_MSG_VERB_LOCK;
         msg.header.pvs.step = FLOM_MSG_STEP_INCR;
 
@@ -948,12 +1240,6 @@ int flom_client_lock(flom_config_t *config, flom_conn_t *conn,
             THROW(CONNECTION_CLOSED_BY_SERVER);
         }
         
-        /* instantiate a new parser */
-        if (NULL == (tmp_parser = g_markup_parse_context_new(
-                         &flom_msg_parser, 0, (gpointer)&msg, NULL)))
-            THROW(G_MARKUP_PARSE_CONTEXT_NEW_ERROR);
-        flom_conn_set_parser(conn, tmp_parser);
-        
         /* deserialize the reply message */
         if (FLOM_RC_OK != (ret_cod = flom_msg_deserialize(
                                buffer, to_read, &msg,
@@ -963,7 +1249,7 @@ int flom_client_lock(flom_config_t *config, flom_conn_t *conn,
         /* check the parser completed without errors */
         if (FLOM_MSG_STATE_READY != msg.state) {
             /* check message level */
-            if (FLOM_MSG_LEVEL != msg.header.level) {
+            if (flom_conn_get_level(conn) != msg.header.level) {
                 THROW(PROTOCOL_LEVEL_MISMATCH);
             } else {
                 THROW(MSG_DESERIALIZE_ERROR2);
@@ -1082,9 +1368,6 @@ int flom_client_lock(flom_config_t *config, flom_conn_t *conn,
             case CONNECTION_CLOSED_BY_SERVER:
                 ret_cod = FLOM_RC_CONNECTION_CLOSED_BY_SERVER;
                 break;
-            case G_MARKUP_PARSE_CONTEXT_NEW_ERROR:
-                ret_cod = FLOM_RC_G_MARKUP_PARSE_CONTEXT_NEW_ERROR;
-                break;
             case MSG_DESERIALIZE_ERROR1:
                 ret_cod = FLOM_RC_MSG_DESERIALIZE_ERROR;
                 break;
@@ -1128,8 +1411,6 @@ int flom_client_lock(flom_config_t *config, flom_conn_t *conn,
     /* release peer_name if necessary */
     if (NULL != peer_name)
         g_free(peer_name);
-    /* release markup parser */
-    flom_conn_free_parser(conn);
     flom_msg_free(&msg);        
     
     FLOM_TRACE(("flom_client_lock/excp=%d/"
@@ -1139,6 +1420,536 @@ int flom_client_lock(flom_config_t *config, flom_conn_t *conn,
 
 
 
+int flom_client_lock_many(flom_config_t *config, flom_conn_t *conn,
+                          int timeout, const char *resource_names[],
+                          const flom_lock_mode_t lock_modes[],
+                          int resource_number)
+{
+    enum Exception { OUT_OF_RANGE
+                     , NULL_OBJECT1
+                     , G_TRY_MALLOC_ERROR
+                     , G_STRDUP_ERROR
+                     , MSG_SERIALIZE_ERROR
+                     , MSG_SEND_ERROR
+                     , MSG_FREE_ERROR
+                     , NETWORK_TIMEOUT1
+                     , MSG_RETRIEVE_ERROR
+                     , CONNECTION_CLOSED_BY_SERVER
+                     , MSG_DESERIALIZE_ERROR1
+                     , PROTOCOL_LEVEL_MISMATCH
+                     , MSG_DESERIALIZE_ERROR2
+                     , PROTOCOL_ERROR1
+                     , NO_TLS_CONNECTION
+                     , NULL_OBJECT2
+                     , TLS_CERT_CHECK_ERROR
+                     , NETWORK_TIMEOUT2
+                     , CONNECT_WAIT_LOCK_ERROR
+                     , PROTOCOL_ERROR2
+                     , LOCK_ERROR2
+                     , LOCK_ERROR1
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    struct flom_msg_s msg;
+    gchar *peer_name = NULL;
+    
+    FLOM_TRACE(("flom_client_lock_many: resource_number=%d\n",
+                resource_number));
+    TRY {
+        char buffer[FLOM_MSG_MAX_SIZE];
+        size_t to_send;
+        size_t to_read;
+        gchar *peerid = NULL;
+        int i;
+
+        /* initialize message */
+        flom_msg_init(&msg);
+        if (0 >= resource_number ||
+            FLOM_MSG_MLOCK_MAX_RESOURCES < resource_number)
+            THROW(OUT_OF_RANGE);
+        /* prepare a request (multiple lock) message: the list of resources
+           can be encoded only as XML */
+        msg.header.level = FLOM_MSG_LEVEL;
+        msg.header.pvs.verb = FLOM_MSG_VERB_MLOCK;
+        msg.header.pvs.step = FLOM_MSG_STEP_INCR;
+
+        /* session */
+        if (NULL == (msg.body.mlock_8.session.peerid =
+                     flom_tls_get_unique_id()))
+            THROW(NULL_OBJECT1);
+        /* resources */
+        if (NULL == (msg.body.mlock_8.resources = g_try_malloc0(
+                         resource_number *
+                         sizeof(struct flom_msg_body_lock_8_resource_s))))
+            THROW(G_TRY_MALLOC_ERROR);
+        for (i=0; i<resource_number; ++i) {
+            struct flom_msg_body_lock_8_resource_s *resource =
+                msg.body.mlock_8.resources + i;
+            /* the name must be released by flom_msg_free */
+            msg.body.mlock_8.resource_number++;
+            if (NULL == (resource->name = g_strdup(resource_names[i])))
+                THROW(G_STRDUP_ERROR);
+            resource->mode = NULL == lock_modes ?
+                flom_config_get_lock_mode(config) : lock_modes[i];
+            resource->wait = 0 != flom_config_get_resource_timeout(config);
+            resource->quantity = flom_config_get_resource_quantity(config);
+            resource->create = flom_config_get_resource_create(config);
+            resource->lifespan =
+                flom_config_get_resource_idle_lifespan(config);
+        } /* for (i=0; i<resource_number; ++i) */
+
+        /* serialize the request message */
+        if (FLOM_RC_OK != (ret_cod = flom_msg_serialize(
+                               &msg, buffer, sizeof(buffer), &to_send)))
+            THROW(MSG_SERIALIZE_ERROR);
+
+        /* send the request message */
+        if (FLOM_RC_OK != (ret_cod = flom_conn_send(conn, buffer, to_send)))
+            THROW(MSG_SEND_ERROR);
+        flom_conn_set_last_step(conn, msg.header.pvs.step);
+
+        flom_msg_trace(&msg);
+        if (FLOM_RC_OK != (ret_cod = flom_msg_free(&msg)))
+            THROW(MSG_FREE_ERROR);
+        flom_msg_init(&msg);
+
+        /* retrieve the reply message */
+        ret_cod = flom_conn_recv(conn, buffer, sizeof(buffer), &to_read,
+                                 timeout, NULL, NULL);
+        switch (ret_cod) {
+            case FLOM_RC_OK:
+                break;
+            case FLOM_RC_NETWORK_TIMEOUT:
+                THROW(NETWORK_TIMEOUT1);
+                break;
+            default:
+                THROW(MSG_RETRIEVE_ERROR);
+        } /* switch (ret_cod) */
+
+        /* an empty response is the result of connection closing on the
+           server side */
+        if (0 == to_read) {
+            FLOM_TRACE(("flom_client_lock_many: flom daemon has closed the "
+                        "connection, maybe a wrong request was sent...\n"));
+            THROW(CONNECTION_CLOSED_BY_SERVER);
+        }
+        
+        /* deserialize the reply message */
+        if (FLOM_RC_OK != (ret_cod = flom_msg_deserialize(
+                               buffer, to_read, &msg,
+                               flom_conn_get_parser(conn))))
+            THROW(MSG_DESERIALIZE_ERROR1);
+        flom_conn_set_last_step(conn, msg.header.pvs.step);
+        /* check the parser completed without errors */
+        if (FLOM_MSG_STATE_READY != msg.state) {
+            /* check message level */
+            if (FLOM_MSG_LEVEL != msg.header.level) {
+                THROW(PROTOCOL_LEVEL_MISMATCH);
+            } else {
+                THROW(MSG_DESERIALIZE_ERROR2);
+            }
+        } /* if (FLOM_MSG_STATE_READY != msg->state) */
+        
+        flom_msg_trace(&msg);
+
+        /* check multiple lock answer */
+        if (FLOM_MSG_VERB_MLOCK != msg.header.pvs.verb ||
+            2*FLOM_MSG_STEP_INCR != msg.header.pvs.step)
+            THROW(PROTOCOL_ERROR1);
+        /* retrieve peer id */
+        if (NULL != (peerid = flom_msg_get_peerid(&msg))) {
+            FLOM_TRACE(("flom_client_lock_many: remote peer is presenting "
+                        "itself with id='%s'\n", peerid));
+            syslog(LOG_INFO, FLOM_SYSLOG_FLM016I, peerid,
+                   msg.header.pvs.verb, msg.header.pvs.step);
+        }
+        
+        /* check peer id if requested */
+        if (flom_config_get_tls_check_peer_id(config)) {
+            flom_tls_t *tls = NULL;
+            /* check it's a TLS connection; if not, maybe an internal
+               error */
+            if (NULL == (tls = flom_conn_get_tls(conn)))
+                THROW(NO_TLS_CONNECTION);
+            if (NULL == (peer_name = flom_tcp_retrieve_peer_name(
+                             flom_conn_get_tcp(conn))))
+                THROW(NULL_OBJECT2);
+            if (FLOM_RC_OK != (ret_cod = flom_tls_cert_check(
+                                   tls, peerid, peer_name))) {
+                THROW(TLS_CERT_CHECK_ERROR);
+            }
+        } /* if (flom_config_get_tls_check_peer_id(config)) */
+
+        switch (msg.body.lock_16.answer.rc) {
+            case FLOM_RC_OK:
+                break;
+            case FLOM_RC_LOCK_ENQUEUED:
+                FLOM_TRACE(("flom_client_lock_many: some resources can not "
+                            "be acquired now, waiting...\n"));
+                ret_cod = flom_client_wait_lock(conn, &msg, timeout);
+                switch (ret_cod) {
+                    case FLOM_RC_OK:
+                        break;
+                    case FLOM_RC_NETWORK_TIMEOUT:
+                        THROW(NETWORK_TIMEOUT2);
+                        break;
+                    default:
+                        THROW(CONNECT_WAIT_LOCK_ERROR);
+                } /* switch (ret_cod) */
+                /* the last answer carries the outcome of the whole
+                   request */
+                if (3*FLOM_MSG_STEP_INCR != flom_conn_get_last_step(conn))
+                    THROW(PROTOCOL_ERROR2);
+                if (FLOM_RC_OK != msg.body.lock_24.answer.rc) {
+                    ret_cod = msg.body.lock_24.answer.rc;
+                    THROW(LOCK_ERROR2);
+                }
+                break;
+            default:
+                /* the daemon released all the resources */
+                ret_cod = msg.body.lock_16.answer.rc;
+                THROW(LOCK_ERROR1);
+                break;
+        } /* switch (msg.body.lock_16.answer.rc) */
+
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case OUT_OF_RANGE:
+                ret_cod = FLOM_RC_OUT_OF_RANGE;
+                break;
+            case NULL_OBJECT1:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
+            case G_TRY_MALLOC_ERROR:
+                ret_cod = FLOM_RC_G_TRY_MALLOC_ERROR;
+                break;
+            case G_STRDUP_ERROR:
+                ret_cod = FLOM_RC_G_STRDUP_ERROR;
+                break;
+            case MSG_SERIALIZE_ERROR:
+            case MSG_SEND_ERROR:
+            case MSG_FREE_ERROR:
+            case NETWORK_TIMEOUT1:
+            case MSG_RETRIEVE_ERROR:
+                break;
+            case CONNECTION_CLOSED_BY_SERVER:
+                ret_cod = FLOM_RC_CONNECTION_CLOSED_BY_SERVER;
+                break;
+            case MSG_DESERIALIZE_ERROR1:
+                ret_cod = FLOM_RC_MSG_DESERIALIZE_ERROR;
+                break;
+            case PROTOCOL_LEVEL_MISMATCH:
+                ret_cod = FLOM_RC_PROTOCOL_LEVEL_MISMATCH;
+                break;
+            case MSG_DESERIALIZE_ERROR2:
+                ret_cod = FLOM_RC_MSG_DESERIALIZE_ERROR;
+                break;
+            case PROTOCOL_ERROR1:
+                ret_cod = FLOM_RC_PROTOCOL_ERROR;
+                break;
+            case NO_TLS_CONNECTION:
+                ret_cod = FLOM_RC_NO_TLS_CONNECTION;
+                break;
+            case NULL_OBJECT2:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
+            case TLS_CERT_CHECK_ERROR:
+            case NETWORK_TIMEOUT2:
+            case CONNECT_WAIT_LOCK_ERROR:
+                break;
+            case PROTOCOL_ERROR2:
+                ret_cod = FLOM_RC_PROTOCOL_ERROR;
+                break;
+            case LOCK_ERROR2:
+            case LOCK_ERROR1:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    /* release peer_name if necessary */
+    if (NULL != peer_name)
+        g_free(peer_name);
+    flom_msg_free(&msg);        
+    
+    FLOM_TRACE(("flom_client_lock_many/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_client_pipeline_request(flom_config_t *config, flom_conn_t *conn,
+                                 int rid, int verb,
+                                 const char *resource_name, int rollback)
+{
+    enum Exception { OUT_OF_RANGE
+                     , NULL_OBJECT1
+                     , G_STRDUP_ERROR
+                     , INVALID_VERB
+                     , MSG_SERIALIZE_ERROR
+                     , MSG_SEND_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    struct flom_msg_s msg;
+    
+    FLOM_TRACE(("flom_client_pipeline_request: rid=%d, verb=%d\n",
+                rid, verb));
+    TRY {
+        char buffer[FLOM_NETWORK_BUFFER_SIZE];
+        size_t to_send;
+
+        /* initialize message */
+        flom_msg_init(&msg);
+        if (0 >= rid)
+            THROW(OUT_OF_RANGE);
+        msg.header.level = flom_conn_get_level(conn);
+        msg.header.pvs.verb = verb;
+        msg.header.pvs.step = FLOM_MSG_STEP_INCR;
+        msg.header.rid = rid;
+        switch (verb) {
+            case FLOM_MSG_VERB_LOCK:
+                if (NULL == (msg.body.lock_8.session.peerid =
+                             flom_tls_get_unique_id()))
+                    THROW(NULL_OBJECT1);
+                if (NULL == (msg.body.lock_8.resource.name =
+                             g_strdup(resource_name)))
+                    THROW(G_STRDUP_ERROR);
+                msg.body.lock_8.resource.mode =
+                    flom_config_get_lock_mode(config);
+                msg.body.lock_8.resource.wait =
+                    0 != flom_config_get_resource_timeout(config);
+                msg.body.lock_8.resource.quantity =
+                    flom_config_get_resource_quantity(config);
+                msg.body.lock_8.resource.create =
+                    flom_config_get_resource_create(config);
+                msg.body.lock_8.resource.lifespan =
+                    flom_config_get_resource_idle_lifespan(config);
+                break;
+            case FLOM_MSG_VERB_UNLOCK:
+                /* the daemon knows the resource of the request */
+                msg.body.unlock_8.resource.rollback = rollback;
+                break;
+            case FLOM_MSG_VERB_PING:
+                break;
+            default:
+                THROW(INVALID_VERB);
+        } /* switch (verb) */
+        msg.state = FLOM_MSG_STATE_READY;
+
+        /* serialize the request message */
+        if (FLOM_RC_OK != (ret_cod = flom_msg_serialize(
+                               &msg, buffer, sizeof(buffer), &to_send)))
+            THROW(MSG_SERIALIZE_ERROR);
+
+        /* send the request message: the answer is not awaited */
+        if (FLOM_RC_OK != (ret_cod = flom_conn_send(conn, buffer, to_send)))
+            THROW(MSG_SEND_ERROR);
+        flom_conn_set_last_step(conn, msg.header.pvs.step);
+        flom_msg_trace(&msg);
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case OUT_OF_RANGE:
+                ret_cod = FLOM_RC_OUT_OF_RANGE;
+                break;
+            case NULL_OBJECT1:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
+            case G_STRDUP_ERROR:
+                ret_cod = FLOM_RC_G_STRDUP_ERROR;
+                break;
+            case INVALID_VERB:
+                ret_cod = FLOM_RC_INVALID_OPTION;
+                break;
+            case MSG_SERIALIZE_ERROR:
+            case MSG_SEND_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    flom_msg_free(&msg);
+    FLOM_TRACE(("flom_client_pipeline_request/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_client_pipeline_answer(flom_config_t *config, flom_conn_t *conn,
+                                int timeout, int *rid, int *verb, int *rc,
+                                char **element)
+{
+    enum Exception { NETWORK_TIMEOUT
+                     , MSG_RETRIEVE_ERROR
+                     , CONNECTION_CLOSED_BY_SERVER
+                     , MSG_DESERIALIZE_ERROR1
+                     , PROTOCOL_LEVEL_MISMATCH
+                     , MSG_DESERIALIZE_ERROR2
+                     , PROTOCOL_ERROR1
+                     , NO_TLS_CONNECTION
+                     , NULL_OBJECT
+                     , TLS_CERT_CHECK_ERROR
+                     , PROTOCOL_ERROR2
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    struct flom_msg_s msg;
+    gchar *peer_name = NULL;
+    
+    FLOM_TRACE(("flom_client_pipeline_answer\n"));
+    TRY {
+        char buffer[FLOM_NETWORK_BUFFER_SIZE];
+        size_t to_read;
+        gchar *peerid = NULL;
+        struct flom_msg_body_answer_s *answer = NULL;
+
+        flom_msg_init(&msg);
+        *rid = 0;
+        *rc = FLOM_RC_OK;
+        *element = NULL;
+        /* retrieve the answer message */
+        ret_cod = flom_conn_recv(conn, buffer, sizeof(buffer), &to_read,
+                                 timeout, NULL, NULL);
+        switch (ret_cod) {
+            case FLOM_RC_OK:
+                break;
+            case FLOM_RC_NETWORK_TIMEOUT:
+                THROW(NETWORK_TIMEOUT);
+                break;
+            default:
+                THROW(MSG_RETRIEVE_ERROR);
+        } /* switch (ret_cod) */
+        /* an empty response is the result of connection closing on the
+           server side */
+        if (0 == to_read) {
+            FLOM_TRACE(("flom_client_pipeline_answer: flom daemon has "
+                        "closed the connection, maybe a wrong request was "
+                        "sent...\n"));
+            THROW(CONNECTION_CLOSED_BY_SERVER);
+        }
+        /* deserialize the answer message */
+        if (FLOM_RC_OK != (ret_cod = flom_msg_deserialize(
+                               buffer, to_read, &msg,
+                               flom_conn_get_parser(conn))))
+            THROW(MSG_DESERIALIZE_ERROR1);
+        flom_conn_set_last_step(conn, msg.header.pvs.step);
+        /* check the parser completed without errors */
+        if (FLOM_MSG_STATE_READY != msg.state) {
+            /* check message level */
+            if (flom_conn_get_level(conn) != msg.header.level) {
+                THROW(PROTOCOL_LEVEL_MISMATCH);
+            } else {
+                THROW(MSG_DESERIALIZE_ERROR2);
+            }
+        } /* if (FLOM_MSG_STATE_READY != msg->state) */
+        flom_msg_trace(&msg);
+        
+        /* only the answers of the pipelined requests are expected */
+        if (0 >= msg.header.rid || !flom_msg_check_protocol(&msg, FALSE))
+            THROW(PROTOCOL_ERROR1);
+        *rid = msg.header.rid;
+        *verb = msg.header.pvs.verb;
+        /* retrieve peer id */
+        if (NULL != (peerid = flom_msg_get_peerid(&msg))) {
+            FLOM_TRACE(("flom_client_pipeline_answer: remote peer is "
+                        "presenting itself with id='%s'\n", peerid));
+            syslog(LOG_INFO, FLOM_SYSLOG_FLM016I, peerid,
+                   msg.header.pvs.verb, msg.header.pvs.step);
+            /* check peer id if requested */
+            if (flom_config_get_tls_check_peer_id(config)) {
+                flom_tls_t *tls = NULL;
+                /* check it's a TLS connection; if not, maybe an internal
+                   error */
+                if (NULL == (tls = flom_conn_get_tls(conn)))
+                    THROW(NO_TLS_CONNECTION);
+                if (NULL == (peer_name = flom_tcp_retrieve_peer_name(
+                                 flom_conn_get_tcp(conn))))
+                    THROW(NULL_OBJECT);
+                if (FLOM_RC_OK != (ret_cod = flom_tls_cert_check(
+                                       tls, peerid, peer_name)))
+                    THROW(TLS_CERT_CHECK_ERROR);
+            } /* if (flom_config_get_tls_check_peer_id(config)) */
+        }
+        switch (msg.header.pvs.verb) {
+            case FLOM_MSG_VERB_LOCK:
+            case FLOM_MSG_VERB_MLOCK:
+                if (2*FLOM_MSG_STEP_INCR == msg.header.pvs.step)
+                    answer = &msg.body.lock_16.answer;
+                else if (3*FLOM_MSG_STEP_INCR == msg.header.pvs.step)
+                    answer = &msg.body.lock_24.answer;
+                else
+                    THROW(PROTOCOL_ERROR2);
+                *rc = answer->rc;
+                /* the element is passed to the caller */
+                *element = answer->element;
+                answer->element = NULL;
+                break;
+            case FLOM_MSG_VERB_PING:
+                break;
+            default:
+                THROW(PROTOCOL_ERROR2);
+        } /* switch (msg.header.pvs.verb) */
+        FLOM_TRACE(("flom_client_pipeline_answer: rid=%d, verb=%d, rc=%d, "
+                    "element='%s'\n", *rid, *verb, *rc, STRORNULL(*element)));
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case NETWORK_TIMEOUT:
+            case MSG_RETRIEVE_ERROR:
+                break;
+            case CONNECTION_CLOSED_BY_SERVER:
+                ret_cod = FLOM_RC_CONNECTION_CLOSED_BY_SERVER;
+                break;
+            case MSG_DESERIALIZE_ERROR1:
+                ret_cod = FLOM_RC_MSG_DESERIALIZE_ERROR;
+                break;
+            case PROTOCOL_LEVEL_MISMATCH:
+                ret_cod = FLOM_RC_PROTOCOL_LEVEL_MISMATCH;
+                break;
+            case MSG_DESERIALIZE_ERROR2:
+                ret_cod = FLOM_RC_MSG_DESERIALIZE_ERROR;
+                break;
+            case PROTOCOL_ERROR1:
+                ret_cod = FLOM_RC_PROTOCOL_ERROR;
+                break;
+            case NO_TLS_CONNECTION:
+                ret_cod = FLOM_RC_NO_TLS_CONNECTION;
+                break;
+            case NULL_OBJECT:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
+            case TLS_CERT_CHECK_ERROR:
+                break;
+            case PROTOCOL_ERROR2:
+                ret_cod = FLOM_RC_PROTOCOL_ERROR;
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    /* release peer_name if necessary */
+    if (NULL != peer_name)
+        g_free(peer_name);
+    flom_msg_free(&msg);        
+    FLOM_TRACE(("flom_client_pipeline_answer/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
 int flom_client_wait_lock(flom_conn_t *conn,
                           struct flom_msg_s *msg, int timeout)
 {
@@ -1184,7 +1995,8 @@ int flom_client_wait_lock(flom_conn_t *conn,
 
             /* is arriving an intermediate message (resource does not exist
                condition)? */
-            if (FLOM_MSG_VERB_LOCK == msg->header.pvs.verb) {
+            if (FLOM_MSG_VERB_LOCK == msg->header.pvs.verb ||
+                FLOM_MSG_VERB_MLOCK == msg->header.pvs.verb) {
                 switch (msg->header.pvs.step) {
                     case 2*FLOM_MSG_STEP_INCR:
                         mba = msg->body.lock_16.answer;
@@ -1205,7 +2017,8 @@ int flom_client_wait_lock(flom_conn_t *conn,
                         THROW(PROTOCOL_ERROR);
                         break;
                 } /* switch (msg->header.pvs.step) */
-            } /* if (FLOM_MSG_VERB_LOCK == msg->header.pvs.verb) */
+            } else
+                THROW(PROTOCOL_ERROR);
             
             if (FLOM_RC_LOCK_ENQUEUED == mba.rc) {
                 FLOM_TRACE(("flom_client_wait_lock: the resource is "
@@ -1260,7 +2073,7 @@ int flom_client_unlock(flom_config_t *config, flom_conn_t *conn,
         size_t to_send;
 
         /* prepare a request (lock) message */
-        msg.header.level = FLOM_MSG_LEVEL;
+        msg.header.level = flom_conn_get_level(conn);
         msg.header.pvs.verb = FLOM_MSG_VERB_UNLOCK;
         msg.header.pvs.step = FLOM_MSG_STEP_INCR;
 
@@ -1404,7 +2217,7 @@ int flom_client_shutdown(flom_config_t *config, int immediate)
 
         /* prepare a shutdown message */
         /* header values */
-        msg.header.level = FLOM_MSG_LEVEL;
+        msg.header.level = flom_conn_get_level(conn);
         msg.header.pvs.verb = FLOM_MSG_VERB_MNGMNT;
         msg.header.pvs.step = FLOM_MSG_STEP_INCR;
         /* body values */
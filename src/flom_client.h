@@ -42,6 +42,33 @@
 
 
 
+/**
+ * Group of the keys inside the discovery cache file
+ */
+#define FLOM_CLIENT_DISCOVER_CACHE_GROUP                 "Discovery"
+/**
+ * Multicast address used to discover the daemon
+ */
+#define FLOM_CLIENT_DISCOVER_CACHE_KEY_MULTICAST_ADDRESS "MulticastAddress"
+/**
+ * Multicast port used to discover the daemon
+ */
+#define FLOM_CLIENT_DISCOVER_CACHE_KEY_MULTICAST_PORT    "MulticastPort"
+/**
+ * Numeric address of the discovered daemon
+ */
+#define FLOM_CLIENT_DISCOVER_CACHE_KEY_ADDRESS           "Address"
+/**
+ * Numeric port of the discovered daemon
+ */
+#define FLOM_CLIENT_DISCOVER_CACHE_KEY_PORT              "Port"
+/**
+ * Time (seconds since the Epoch) the cached address expires
+ */
+#define FLOM_CLIENT_DISCOVER_CACHE_KEY_EXPIRATION        "Expiration"
+
+
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -112,6 +139,32 @@ extern "C" {
     int flom_client_discover_udp_connect(flom_conn_t *conn,
                                          const struct sockaddr *so,
                                          socklen_t addrlen);
+
+
+
+    /**
+     * Connect to the daemon whose address has been cached by a previous
+     * multicast UDP discovery; the cache file is removed if the daemon
+     * can't be reached
+     * @param config IN configuration object, NULL for global config
+     * @param conn IN/OUT connection object
+     * @return a reason code: @ref FLOM_RC_OK if the cached address has been
+     *         used, a different value if the discovery must be performed
+     */
+    int flom_client_discover_cache_connect(flom_config_t *config,
+                                           flom_conn_t *conn);
+
+
+
+    /**
+     * Save the address of the daemon discovered using multicast UDP in the
+     * cache file
+     * @param config IN configuration object, NULL for global config
+     * @param conn IN connection object
+     * @return a reason code
+     */
+    int flom_client_discover_cache_save(flom_config_t *config,
+                                        const flom_conn_t *conn);
     
     
 
@@ -141,6 +194,70 @@ extern "C" {
 
 
 
+    /**
+     * Send a multiple lock command to the daemon: all the resources are
+     * locked or none of them
+     * @param config IN configuration object (wait, quantity, create and
+     *        idle lifespan are used for all the resources)
+     * @param conn IN connection object
+     * @param timeout IN maximum wait time for lock acquisition
+     * @param resource_names IN names of the resources to lock
+     * @param lock_modes IN lock modes of the resources; NULL means the lock
+     *        mode of the configuration for all the resources
+     * @param resource_number IN number of resources, at most
+     *        @ref FLOM_MSG_MLOCK_MAX_RESOURCES
+     * @return a reason code
+     */
+    int flom_client_lock_many(flom_config_t *config, flom_conn_t *conn,
+                              int timeout, const char *resource_names[],
+                              const flom_lock_mode_t lock_modes[],
+                              int resource_number);
+
+
+
+    /**
+     * Send a pipelined request to the daemon without waiting for its
+     * answer: the answers are retrieved with
+     * @ref flom_client_pipeline_answer and they can arrive out of order
+     * @param config IN configuration object (lock mode, wait, quantity,
+     *        create and idle lifespan are used by the lock requests)
+     * @param conn IN connection object
+     * @param rid IN request id, it must be positive and it can not be
+     *        reused until the resource has been unlocked
+     * @param verb IN @ref FLOM_MSG_VERB_LOCK, @ref FLOM_MSG_VERB_UNLOCK
+     *        (it releases the resource locked with the same request id) or
+     *        @ref FLOM_MSG_VERB_PING
+     * @param resource_name IN resource to lock (lock requests only)
+     * @param rollback IN rollback resource value (unlock requests only)
+     * @return a reason code
+     */
+    int flom_client_pipeline_request(flom_config_t *config, flom_conn_t *conn,
+                                     int rid, int verb,
+                                     const char *resource_name, int rollback);
+
+
+
+    /**
+     * Retrieve the next answer to a pipelined request
+     * @param config IN configuration object
+     * @param conn IN connection object
+     * @param timeout IN maximum wait time for the answer
+     * @param rid OUT request id of the answer
+     * @param verb OUT verb of the answered request
+     * @param rc OUT return code of the request: @ref FLOM_RC_LOCK_ENQUEUED
+     *        means the lock request is waiting for the resource and another
+     *        answer will follow
+     * @param element OUT locked element (resource sets and similar), it
+     *        must be released with g_free; NULL if the answer does not
+     *        carry an element
+     * @return a reason code
+     */
+    int flom_client_pipeline_answer(flom_config_t *config, flom_conn_t *conn,
+                                    int timeout, int *rid, int *verb, int *rc,
+                                    char **element);
+
+
+
     /**
      * Wait while the desired resource is busy, then go on
      * @param conn IN connection object
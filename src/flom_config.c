@@ -113,6 +113,8 @@ const gchar *FLOM_CONFIG_KEY_UNICAST_PORT = _CONFIG_KEY_UNICAST_PORT;
 const gchar *FLOM_CONFIG_KEY_MULTICAST_ADDRESS = _CONFIG_KEY_MULTICAST_ADDRESS;
 const gchar *FLOM_CONFIG_KEY_MULTICAST_PORT = _CONFIG_KEY_MULTICAST_PORT;
 const gchar *FLOM_CONFIG_KEY_MOUNT_POINT_VFS = _CONFIG_KEY_MOUNT_POINT_VFS;
+const gchar *FLOM_CONFIG_KEY_LOCKER_THREADS = _CONFIG_KEY_LOCKER_THREADS;
+const gchar *FLOM_CONFIG_KEY_ACCEPTOR_THREADS = _CONFIG_KEY_ACCEPTOR_THREADS;
 const gchar *FLOM_CONFIG_GROUP_MONITOR = _CONFIG_GROUP_MONITOR;
 const gchar *FLOM_CONFIG_KEY_IGNORED_SIGNALS = _CONFIG_KEY_IGNORED_SIGNALS;
 const gchar *FLOM_CONFIG_GROUP_NETWORK = _CONFIG_GROUP_NETWORK;
@@ -120,14 +122,19 @@ const gchar *FLOM_CONFIG_KEY_NETWORK_INTERFACE = _CONFIG_KEY_NETWORK_INTERFACE;
 const gchar *FLOM_CONFIG_KEY_DISCOVERY_ATTEMPTS = _CONFIG_KEY_DISCOVERY_ATTEMPTS;
 const gchar *FLOM_CONFIG_KEY_DISCOVERY_TIMEOUT = _CONFIG_KEY_DISCOVERY_TIMEOUT;
 const gchar *FLOM_CONFIG_KEY_DISCOVERY_TTL = _CONFIG_KEY_DISCOVERY_TTL;
+const gchar *FLOM_CONFIG_KEY_DISCOVERY_CACHE_FILE = _CONFIG_KEY_DISCOVERY_CACHE_FILE;
+const gchar *FLOM_CONFIG_KEY_DISCOVERY_CACHE_LIFESPAN = _CONFIG_KEY_DISCOVERY_CACHE_LIFESPAN;
 const gchar *FLOM_CONFIG_KEY_TCP_KEEPALIVE_TIME = _CONFIG_KEY_TCP_KEEPALIVE_TIME;
 const gchar *FLOM_CONFIG_KEY_TCP_KEEPALIVE_INTVL = _CONFIG_KEY_TCP_KEEPALIVE_INTVL;
 const gchar *FLOM_CONFIG_KEY_TCP_KEEPALIVE_PROBES = _CONFIG_KEY_TCP_KEEPALIVE_PROBES;
+const gchar *FLOM_CONFIG_KEY_BINARY_PROTOCOL = _CONFIG_KEY_BINARY_PROTOCOL;
 const gchar *FLOM_CONFIG_GROUP_TLS = _CONFIG_GROUP_TLS;
 const gchar *FLOM_CONFIG_KEY_TLS_CERTIFICATE = _CONFIG_KEY_TLS_CERTIFICATE;
 const gchar *FLOM_CONFIG_KEY_TLS_PRIVATE_KEY = _CONFIG_KEY_TLS_PRIVATE_KEY;
 const gchar *FLOM_CONFIG_KEY_TLS_CA_CERTIFICATE = _CONFIG_KEY_TLS_CA_CERTIFICATE;
 const gchar *FLOM_CONFIG_KEY_TLS_CHECK_PEER_ID = _CONFIG_KEY_TLS_CHECK_PEER_ID;
+const gchar *FLOM_CONFIG_KEY_TLS_SESSION_FILE = _CONFIG_KEY_TLS_SESSION_FILE;
+const gchar *FLOM_CONFIG_KEY_TLS_KERNEL_OFFLOAD = _CONFIG_KEY_TLS_KERNEL_OFFLOAD;
 
 
 
@@ -219,18 +226,25 @@ void flom_config_reset(flom_config_t *config)
     config->multicast_address = NULL;
     config->multicast_port = _DEFAULT_DAEMON_PORT;
     config->mount_point_vfs = NULL;
+    config->locker_threads = _DEFAULT_LOCKER_THREADS;
+    config->acceptor_threads = _DEFAULT_ACCEPTOR_THREADS;
     config->network_interface = NULL;
     config->sin6_scope_id = 0;
     config->discovery_attempts = _DEFAULT_DISCOVERY_ATTEMPTS;
     config->discovery_timeout = _DEFAULT_DISCOVERY_TIMEOUT;
     config->discovery_ttl = _DEFAULT_DISCOVERY_TTL;
+    config->discovery_cache_file = NULL;
+    config->discovery_cache_lifespan = _DEFAULT_DISCOVERY_CACHE_LIFESPAN;
     config->tcp_keepalive_time = _DEFAULT_TCP_KEEPALIVE_TIME;
     config->tcp_keepalive_intvl = _DEFAULT_TCP_KEEPALIVE_INTVL;
     config->tcp_keepalive_probes = _DEFAULT_TCP_KEEPALIVE_PROBES;
+    config->binary_protocol = FALSE;
     config->tls_certificate = NULL;
     config->tls_private_key = NULL;
     config->tls_ca_certificate = NULL;
     config->tls_check_peer_id = FALSE;
+    config->tls_session_file = NULL;
+    config->tls_kernel_offload = FALSE;
     sigemptyset(&config->ignored_signals);
 }
 
@@ -402,6 +416,12 @@ void flom_config_print(flom_config_t *config)
             NULL == flom_config_get_mount_point_vfs(config) ?
             FLOM_EMPTY_STRING : 
             flom_config_get_mount_point_vfs(config));
+    g_print("[%s]/%s=%d\n", FLOM_CONFIG_GROUP_DAEMON,
+            FLOM_CONFIG_KEY_LOCKER_THREADS,
+            flom_config_get_locker_threads(config));
+    g_print("[%s]/%s=%d\n", FLOM_CONFIG_GROUP_DAEMON,
+            FLOM_CONFIG_KEY_ACCEPTOR_THREADS,
+            flom_config_get_acceptor_threads(config));
     ignored_signals = flom_config_get_ignored_signals_str(config);
     g_print("[%s]/%s='%s'\n", FLOM_CONFIG_GROUP_MONITOR,
             FLOM_CONFIG_KEY_IGNORED_SIGNALS, ignored_signals);
@@ -420,6 +440,14 @@ void flom_config_print(flom_config_t *config)
     g_print("[%s]/%s=%d\n", FLOM_CONFIG_GROUP_NETWORK,
             FLOM_CONFIG_KEY_DISCOVERY_TTL,
             flom_config_get_discovery_ttl(config));
+    g_print("[%s]/%s='%s'\n", FLOM_CONFIG_GROUP_NETWORK,
+            FLOM_CONFIG_KEY_DISCOVERY_CACHE_FILE,
+            NULL == flom_config_get_discovery_cache_file(config) ?
+            FLOM_EMPTY_STRING :
+            flom_config_get_discovery_cache_file(config));
+    g_print("[%s]/%s=%d\n", FLOM_CONFIG_GROUP_NETWORK,
+            FLOM_CONFIG_KEY_DISCOVERY_CACHE_LIFESPAN,
+            flom_config_get_discovery_cache_lifespan(config));
     g_print("[%s]/%s=%d\n", FLOM_CONFIG_GROUP_NETWORK,
             FLOM_CONFIG_KEY_TCP_KEEPALIVE_TIME,
             flom_config_get_tcp_keepalive_time(config));
@@ -429,6 +457,9 @@ void flom_config_print(flom_config_t *config)
     g_print("[%s]/%s=%d\n", FLOM_CONFIG_GROUP_NETWORK,
             FLOM_CONFIG_KEY_TCP_KEEPALIVE_PROBES,
             flom_config_get_tcp_keepalive_probes(config));
+    g_print("[%s]/%s=%d\n", FLOM_CONFIG_GROUP_NETWORK,
+            FLOM_CONFIG_KEY_BINARY_PROTOCOL,
+            flom_config_get_binary_protocol(config));
     g_print("[%s]/%s='%s'\n", FLOM_CONFIG_GROUP_TLS,
             FLOM_CONFIG_KEY_TLS_CERTIFICATE,
             NULL == flom_config_get_tls_certificate(config) ?
@@ -447,6 +478,14 @@ void flom_config_print(flom_config_t *config)
     g_print("[%s]/%s=%d\n", FLOM_CONFIG_GROUP_TLS,
             FLOM_CONFIG_KEY_TLS_CHECK_PEER_ID,
             flom_config_get_tls_check_peer_id(config));
+    g_print("[%s]/%s='%s'\n", FLOM_CONFIG_GROUP_TLS,
+            FLOM_CONFIG_KEY_TLS_SESSION_FILE,
+            NULL == flom_config_get_tls_session_file(config) ?
+            FLOM_EMPTY_STRING :
+            flom_config_get_tls_session_file(config));
+    g_print("[%s]/%s=%d\n", FLOM_CONFIG_GROUP_TLS,
+            FLOM_CONFIG_KEY_TLS_KERNEL_OFFLOAD,
+            flom_config_get_tls_kernel_offload(config));
 }
 
 
@@ -472,12 +511,16 @@ void flom_config_free(flom_config_t *config)
     config->mount_point_vfs = NULL;
     g_free(config->network_interface);
     config->network_interface = NULL;
+    g_free(config->discovery_cache_file);
+    config->discovery_cache_file = NULL;
     g_free(config->tls_certificate);
     config->tls_certificate = NULL;
     g_free(config->tls_private_key);
     config->tls_private_key = NULL;
     g_free(config->tls_ca_certificate);
     config->tls_ca_certificate = NULL;
+    g_free(config->tls_session_file);
+    config->tls_session_file = NULL;
 }
 
 
@@ -585,17 +628,22 @@ int flom_config_init_load(flom_config_t *config,
         CONFIG_SET_DAEMON_UNICAST_PORT_ERROR,
         CONFIG_SET_DAEMON_MULTICAST_PORT_ERROR,
         CONFIG_SET_MOUNT_POINT_VFS_ERROR,
+        CONFIG_SET_DAEMON_LOCKER_THREADS_ERROR,
+        CONFIG_SET_DAEMON_ACCEPTOR_THREADS_ERROR,
         CONFIG_SET_DAEMON_DISCOVERY_ATTEMPTS_ERROR,
         CONFIG_SET_DAEMON_DISCOVERY_TIMEOUT_ERROR,
         CONFIG_SET_DAEMON_DISCOVERY_TTL_ERROR,
+        CONFIG_SET_DAEMON_DISCOVERY_CACHE_LIFESPAN_ERROR,
         CONFIG_SET_MONITOR_IGNORED_SIGNALS_ERROR,
         CONFIG_SET_NETWORK_TCP_KEEPALIVE_TIME_ERROR,
         CONFIG_SET_NETWORK_TCP_KEEPALIVE_INTVL_ERROR,
         CONFIG_SET_NETWORK_TCP_KEEPALIVE_PROBES_ERROR,
+        CONFIG_SET_NETWORK_BINARY_PROTOCOL_ERROR,
         CONFIG_SET_TLS_CERTIFICATE_ERROR,
         CONFIG_SET_TLS_PRIVATE_KEY_ERROR,
         CONFIG_SET_TLS_CA_CERTIFICATE_ERROR,
         CONFIG_SET_TLS_CHECK_PEER_ID_ERROR,
+        CONFIG_SET_TLS_KERNEL_OFFLOAD_ERROR,
         NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     int print_file_name = FALSE;
@@ -1045,6 +1093,56 @@ int flom_config_init_load(flom_config_t *config,
                 value = NULL;
             }
         }
+        /* pick-up number of locker threads from configuration */
+        ivalue = g_key_file_get_integer(gkf, FLOM_CONFIG_GROUP_DAEMON,
+                                        FLOM_CONFIG_KEY_LOCKER_THREADS,
+                                        &error);
+        if (NULL != error) {
+            int throw_error = FALSE;
+            FLOM_TRACE(("flom_config_init_load/g_key_file_get_string"
+                        "(...,%s,%s,...): code=%d, message='%s'\n",
+                        FLOM_CONFIG_GROUP_DAEMON,
+                        FLOM_CONFIG_KEY_LOCKER_THREADS,
+                        error->code,
+                        error->message));
+            if (G_KEY_FILE_ERROR_KEY_NOT_FOUND != error->code) {
+                print_file_name = throw_error = TRUE;
+                g_print("%s\n", error->message);
+            }
+            g_error_free(error);
+            error = NULL;
+            if (throw_error) THROW(CONFIG_SET_DAEMON_LOCKER_THREADS_ERROR);
+        } else {
+            FLOM_TRACE(("flom_config_init_load: %s[%s]='%d'\n",
+                        FLOM_CONFIG_GROUP_DAEMON,
+                        FLOM_CONFIG_KEY_LOCKER_THREADS, ivalue));
+            flom_config_set_locker_threads(config, ivalue);
+        }
+        /* pick-up number of acceptor threads from configuration */
+        ivalue = g_key_file_get_integer(gkf, FLOM_CONFIG_GROUP_DAEMON,
+                                        FLOM_CONFIG_KEY_ACCEPTOR_THREADS,
+                                        &error);
+        if (NULL != error) {
+            int throw_error = FALSE;
+            FLOM_TRACE(("flom_config_init_load/g_key_file_get_string"
+                        "(...,%s,%s,...): code=%d, message='%s'\n",
+                        FLOM_CONFIG_GROUP_DAEMON,
+                        FLOM_CONFIG_KEY_ACCEPTOR_THREADS,
+                        error->code,
+                        error->message));
+            if (G_KEY_FILE_ERROR_KEY_NOT_FOUND != error->code) {
+                print_file_name = throw_error = TRUE;
+                g_print("%s\n", error->message);
+            }
+            g_error_free(error);
+            error = NULL;
+            if (throw_error) THROW(CONFIG_SET_DAEMON_ACCEPTOR_THREADS_ERROR);
+        } else {
+            FLOM_TRACE(("flom_config_init_load: %s[%s]='%d'\n",
+                        FLOM_CONFIG_GROUP_DAEMON,
+                        FLOM_CONFIG_KEY_ACCEPTOR_THREADS, ivalue));
+            flom_config_set_acceptor_threads(config, ivalue);
+        }
         /* pick-up the signals that must be ignored by the monitor */
         if (NULL == (list = g_key_file_get_string_list(
                          gkf, FLOM_CONFIG_GROUP_MONITOR,
@@ -1157,6 +1255,52 @@ int flom_config_init_load(flom_config_t *config,
                         FLOM_CONFIG_KEY_DISCOVERY_TTL, ivalue));
             flom_config_set_discovery_ttl(config, ivalue);
         }
+        /* pick-up discovery cache file from configuration */
+        if (NULL == (value = g_key_file_get_string(
+                         gkf, FLOM_CONFIG_GROUP_NETWORK,
+                         FLOM_CONFIG_KEY_DISCOVERY_CACHE_FILE, &error))) {
+            FLOM_TRACE(("flom_config_init_load/g_key_file_get_string"
+                        "(...,%s,%s,...): code=%d, message='%s'\n",
+                        FLOM_CONFIG_GROUP_NETWORK,
+                        FLOM_CONFIG_KEY_DISCOVERY_CACHE_FILE,
+                        error->code,
+                        error->message));
+            g_error_free(error);
+            error = NULL;
+        } else {
+            FLOM_TRACE(("flom_config_init_load: %s[%s]='%s'\n",
+                        FLOM_CONFIG_GROUP_NETWORK,
+                        FLOM_CONFIG_KEY_DISCOVERY_CACHE_FILE, value));
+            flom_config_set_discovery_cache_file(config, value);
+            g_free(value);
+            value = NULL;
+        }
+        /* pick-up discovery cache lifespan from configuration */
+        ivalue = g_key_file_get_integer(gkf, FLOM_CONFIG_GROUP_NETWORK,
+                                        FLOM_CONFIG_KEY_DISCOVERY_CACHE_LIFESPAN,
+                                        &error);
+        if (NULL != error) {
+            int throw_error = FALSE;
+            FLOM_TRACE(("flom_config_init_load/g_key_file_get_string"
+                        "(...,%s,%s,...): code=%d, message='%s'\n",
+                        FLOM_CONFIG_GROUP_NETWORK,
+                        FLOM_CONFIG_KEY_DISCOVERY_CACHE_LIFESPAN,
+                        error->code,
+                        error->message));
+            if (G_KEY_FILE_ERROR_KEY_NOT_FOUND != error->code) {
+                print_file_name = throw_error = TRUE;
+                g_print("%s\n", error->message);
+            }
+            g_error_free(error);
+            error = NULL;
+            if (throw_error)
+                THROW(CONFIG_SET_DAEMON_DISCOVERY_CACHE_LIFESPAN_ERROR);
+        } else {
+            FLOM_TRACE(("flom_config_init_load: %s[%s]='%d'\n",
+                        FLOM_CONFIG_GROUP_NETWORK,
+                        FLOM_CONFIG_KEY_DISCOVERY_CACHE_LIFESPAN, ivalue));
+            flom_config_set_discovery_cache_lifespan(config, ivalue);
+        }
         /* pick-up tcp_keepalive_time from configuration */
         ivalue = g_key_file_get_integer(gkf, FLOM_CONFIG_GROUP_NETWORK,
                                         FLOM_CONFIG_KEY_TCP_KEEPALIVE_TIME,
@@ -1235,6 +1379,35 @@ int flom_config_init_load(flom_config_t *config,
                         FLOM_CONFIG_KEY_TCP_KEEPALIVE_PROBES, ivalue));
             flom_config_set_tcp_keepalive_probes(config, ivalue);
         }
+        /* pick-up binary protocol from configuration */
+        if (NULL == (value = g_key_file_get_string(
+                         gkf, FLOM_CONFIG_GROUP_NETWORK,
+                         FLOM_CONFIG_KEY_BINARY_PROTOCOL, &error))) {
+            FLOM_TRACE(("flom_config_init_load/g_key_file_get_string"
+                        "(...,%s,%s,...): code=%d, message='%s'\n",
+                        FLOM_CONFIG_GROUP_NETWORK,
+                        FLOM_CONFIG_KEY_BINARY_PROTOCOL,
+                        error->code,
+                        error->message));
+            g_error_free(error);
+            error = NULL;
+        } else {
+            int throw_error = FALSE;
+            flom_bool_value_t fbv;
+            FLOM_TRACE(("flom_config_init_load: %s[%s]='%s'\n",
+                        FLOM_CONFIG_GROUP_NETWORK,
+                        FLOM_CONFIG_KEY_BINARY_PROTOCOL, value));
+            if (FLOM_BOOL_INVALID == (
+                    fbv = flom_bool_value_retrieve(value))) {
+                print_file_name = TRUE;
+                throw_error = TRUE;
+            } else {
+                flom_config_set_binary_protocol(config, fbv);
+            }
+            g_free(value);
+            value = NULL;
+            if (throw_error) THROW(CONFIG_SET_NETWORK_BINARY_PROTOCOL_ERROR);
+        }
         /* pick-up TLS peer certificate */
         if (NULL == (value = g_key_file_get_string(
                          gkf, FLOM_CONFIG_GROUP_TLS,
@@ -1330,6 +1503,55 @@ int flom_config_init_load(flom_config_t *config,
             value = NULL;
             if (throw_error) THROW(CONFIG_SET_TLS_CHECK_PEER_ID_ERROR);
         }
+        /* pick-up TLS session file from configuration */
+        if (NULL == (value = g_key_file_get_string(
+                         gkf, FLOM_CONFIG_GROUP_TLS,
+                         FLOM_CONFIG_KEY_TLS_SESSION_FILE, &error))) {
+            FLOM_TRACE(("flom_config_init_load/g_key_file_get_string"
+                        "(...,%s,%s,...): code=%d, message='%s'\n",
+                        FLOM_CONFIG_GROUP_TLS,
+                        FLOM_CONFIG_KEY_TLS_SESSION_FILE,
+                        error->code,
+                        error->message));
+            g_error_free(error);
+            error = NULL;
+        } else {
+            FLOM_TRACE(("flom_config_init_load: %s[%s]='%s'\n",
+                        FLOM_CONFIG_GROUP_TLS,
+                        FLOM_CONFIG_KEY_TLS_SESSION_FILE, value));
+            flom_config_set_tls_session_file(config, value);
+            g_free(value);
+            value = NULL;
+        }
+        /* pick-up TLS kernel offload from configuration */
+        if (NULL == (value = g_key_file_get_string(
+                         gkf, FLOM_CONFIG_GROUP_TLS,
+                         FLOM_CONFIG_KEY_TLS_KERNEL_OFFLOAD, &error))) {
+            FLOM_TRACE(("flom_config_init_load/g_key_file_get_string"
+                        "(...,%s,%s,...): code=%d, message='%s'\n",
+                        FLOM_CONFIG_GROUP_TLS,
+                        FLOM_CONFIG_KEY_TLS_KERNEL_OFFLOAD,
+                        error->code,
+                        error->message));
+            g_error_free(error);
+            error = NULL;
+        } else {
+            int throw_error = FALSE;
+            flom_bool_value_t fbv;
+            FLOM_TRACE(("flom_config_init_load: %s[%s]='%s'\n",
+                        FLOM_CONFIG_GROUP_TLS,
+                        FLOM_CONFIG_KEY_TLS_KERNEL_OFFLOAD, value));
+            if (FLOM_BOOL_INVALID == (
+                    fbv = flom_bool_value_retrieve(value))) {
+                print_file_name = TRUE;
+                throw_error = TRUE;
+            } else {
+                flom_config_set_tls_kernel_offload(config, fbv);
+            }
+            g_free(value);
+            value = NULL;
+            if (throw_error) THROW(CONFIG_SET_TLS_KERNEL_OFFLOAD_ERROR);
+        }
         
         THROW(NONE);
     } CATCH {
@@ -1353,13 +1575,17 @@ int flom_config_init_load(flom_config_t *config,
             case CONFIG_SET_DAEMON_LIFESPAN_ERROR:
             case CONFIG_SET_DAEMON_UNICAST_PORT_ERROR:
             case CONFIG_SET_MOUNT_POINT_VFS_ERROR:
+            case CONFIG_SET_DAEMON_LOCKER_THREADS_ERROR:
+            case CONFIG_SET_DAEMON_ACCEPTOR_THREADS_ERROR:
             case CONFIG_SET_DAEMON_DISCOVERY_ATTEMPTS_ERROR:
             case CONFIG_SET_DAEMON_DISCOVERY_TIMEOUT_ERROR:
             case CONFIG_SET_DAEMON_DISCOVERY_TTL_ERROR:
+            case CONFIG_SET_DAEMON_DISCOVERY_CACHE_LIFESPAN_ERROR:
             case CONFIG_SET_MONITOR_IGNORED_SIGNALS_ERROR:
             case CONFIG_SET_NETWORK_TCP_KEEPALIVE_TIME_ERROR:
             case CONFIG_SET_NETWORK_TCP_KEEPALIVE_INTVL_ERROR:
             case CONFIG_SET_NETWORK_TCP_KEEPALIVE_PROBES_ERROR:
+            case CONFIG_SET_NETWORK_BINARY_PROTOCOL_ERROR:
                 ret_cod = FLOM_RC_INVALID_OPTION;
                 break;
             case CONFIG_SET_TLS_CERTIFICATE_ERROR:
@@ -1367,6 +1593,7 @@ int flom_config_init_load(flom_config_t *config,
             case CONFIG_SET_TLS_CA_CERTIFICATE_ERROR:
                 break;
             case CONFIG_SET_TLS_CHECK_PEER_ID_ERROR:
+            case CONFIG_SET_TLS_KERNEL_OFFLOAD_ERROR:
                 ret_cod = FLOM_RC_INVALID_OPTION;
                 break;
             case NONE:
@@ -1415,6 +1642,9 @@ int flom_config_clone(flom_config_t *config)
         config->multicast_address = g_strdup(global_config.multicast_address);
         config->mount_point_vfs = g_strdup(global_config.mount_point_vfs);
         config->network_interface = g_strdup(global_config.network_interface);
+        config->discovery_cache_file =
+            g_strdup(global_config.discovery_cache_file);
+        config->tls_session_file = g_strdup(global_config.tls_session_file);
         
         THROW(NONE);
     } CATCH {
@@ -1676,6 +1906,28 @@ int flom_config_set_mount_point_vfs(flom_config_t *config,
 
 
 
+void flom_config_set_locker_threads(flom_config_t *config, gint value)
+{
+    if (0 > value) value = 0;
+    if (NULL == config)
+        global_config.locker_threads = value;
+    else
+        config->locker_threads = value;
+}
+
+
+
+void flom_config_set_acceptor_threads(flom_config_t *config, gint value)
+{
+    if (1 > value) value = 1;
+    if (NULL == config)
+        global_config.acceptor_threads = value;
+    else
+        config->acceptor_threads = value;
+}
+
+
+
 void flom_config_set_ignored_signals(flom_config_t *config, gchar **list)
 {
     int i, j;
@@ -1969,6 +2221,31 @@ void flom_config_set_discovery_timeout(flom_config_t *config, gint timeout)
 
 
 
+void flom_config_set_discovery_cache_file(flom_config_t *config,
+                                          const gchar *value)
+{
+    FLOM_TRACE(("flom_config_set_discovery_cache_file(%s)\n", value));
+    /* default config object */
+    if (NULL == config)
+        config = &global_config;
+    g_free(config->discovery_cache_file);
+    config->discovery_cache_file = g_strdup(value);
+}
+
+
+
+void flom_config_set_discovery_cache_lifespan(flom_config_t *config,
+                                              gint lifespan)
+{
+    if (0 > lifespan) lifespan = -lifespan;
+    if (NULL == config)
+        global_config.discovery_cache_lifespan = lifespan;
+    else
+        config->discovery_cache_lifespan = lifespan;
+}
+
+
+
 void flom_config_set_discovery_ttl(flom_config_t *config, gint ttl)
 {
     if (0 > ttl) ttl = -ttl;
@@ -2051,6 +2328,19 @@ int flom_config_set_tls_private_key(flom_config_t *config,
 
 
 
+void flom_config_set_tls_session_file(flom_config_t *config,
+                                      const gchar *value)
+{
+    FLOM_TRACE(("flom_config_set_tls_session_file(%s)\n", value));
+    /* default config object */
+    if (NULL == config)
+        config = &global_config;
+    g_free(config->tls_session_file);
+    config->tls_session_file = g_strdup(value);
+}
+
+
+
 int flom_config_set_tls_ca_certificate(flom_config_t *config,
                                        const gchar *value)
 {
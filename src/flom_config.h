@@ -206,6 +206,14 @@ extern const gchar *FLOM_CONFIG_KEY_MULTICAST_PORT;
  * Label associated to "MountPointVFS" key inside config files
  */
 extern const gchar *FLOM_CONFIG_KEY_MOUNT_POINT_VFS;
+/**
+ * Label associated to "LockerThreads" key inside config files
+ */
+extern const gchar *FLOM_CONFIG_KEY_LOCKER_THREADS;
+/**
+ * Label associated to "AcceptorThreads" key inside config files
+ */
+extern const gchar *FLOM_CONFIG_KEY_ACCEPTOR_THREADS;
 /**
  * Label associated to "Monitor" group inside config files
  */
@@ -234,6 +242,14 @@ extern const gchar *FLOM_CONFIG_KEY_DISCOVERY_TIMEOUT;
  * Label associated to "DiscoveryTTL" key inside config files
  */
 extern const gchar *FLOM_CONFIG_KEY_DISCOVERY_TTL;
+/**
+ * Label associated to "DiscoveryCacheFile" key inside config files
+ */
+extern const gchar *FLOM_CONFIG_KEY_DISCOVERY_CACHE_FILE;
+/**
+ * Label associated to "DiscoveryCacheLifespan" key inside config files
+ */
+extern const gchar *FLOM_CONFIG_KEY_DISCOVERY_CACHE_LIFESPAN;
 /**
  * Label associated to "TcpKeepaliveTime" key inside config files
  */
@@ -246,6 +262,10 @@ extern const gchar *FLOM_CONFIG_KEY_TCP_KEEPALIVE_INTVL;
  * Label associated to "TcpKeepaliveProbes" key inside config files
  */
 extern const gchar *FLOM_CONFIG_KEY_TCP_KEEPALIVE_PROBES;
+/**
+ * Label associated to "BinaryProtocol" key inside config files
+ */
+extern const gchar *FLOM_CONFIG_KEY_BINARY_PROTOCOL;
 /**
  * Label associated to TLS group inside config files
  */
@@ -266,6 +286,14 @@ extern const gchar *FLOM_CONFIG_KEY_TLS_CA_CERTIFICATE;
  * Label associated to "TlsCheckPeerId" key inside config files
  */
 extern const gchar *FLOM_CONFIG_KEY_TLS_CHECK_PEER_ID;
+/**
+ * Label associated to "TlsSessionFile" key inside config files
+ */
+extern const gchar *FLOM_CONFIG_KEY_TLS_SESSION_FILE;
+/**
+ * Label associated to "TlsKernelOffload" key inside config files
+ */
+extern const gchar *FLOM_CONFIG_KEY_TLS_KERNEL_OFFLOAD;
 /**
  * Array with the name of all the signals
  */
@@ -382,6 +410,16 @@ typedef struct flom_config_s {
      * Mount point for the VFS used by the daemon to communicate
      */
     gchar             *mount_point_vfs;
+    /**
+     * Number of locker threads started by the daemon: 0 means one thread
+     * for every online processor
+     */
+    gint               locker_threads;
+    /**
+     * Number of acceptor threads started by a TCP/IP daemon: every thread
+     * listens on its own SO_REUSEPORT socket
+     */
+    gint               acceptor_threads;
     /**
      * Network interface that must be used to reach IPv6 link local addresses
      */
@@ -402,6 +440,14 @@ typedef struct flom_config_s {
      * Discovery TTL: hop limit for outgoing multicast datagrams
      */
     gint               discovery_ttl;
+    /**
+     * Name of the file used to cache the address of the discovered daemon
+     */
+    gchar             *discovery_cache_file;
+    /**
+     * Lifespan of the cached daemon address (seconds)
+     */
+    gint               discovery_cache_lifespan;
     /**
      * per socket value of parameter tcp_keepalive_time
      */
@@ -414,6 +460,11 @@ typedef struct flom_config_s {
      * per socket value of parameter tcp_keepalive_probes
      */
     gint               tcp_keepalive_probes;
+    /**
+     * use the binary protocol level instead of XML for the messages sent
+     * to the daemon
+     */
+    gint               binary_protocol;
     /**
      * name of the file that contains the X.509 certificate assigned to this
      * peer
@@ -433,6 +484,14 @@ typedef struct flom_config_s {
      * unique identifier
      */
     gint               tls_check_peer_id;
+    /**
+     * name of the file used by the client to persist the TLS session
+     */
+    gchar             *tls_session_file;
+    /**
+     * let the kernel process the TLS records after the handshake (kTLS)
+     */
+    gint               tls_kernel_offload;
     /**
      * set of signals that must be ignored while waiting the monitored
      * process (it applies to command line FLoM utility)
@@ -946,6 +1005,53 @@ extern "C" {
     }
 
 
+
+    /**
+     * Set the number of locker threads that must be started by the daemon
+     * @param config IN/OUT configuration object, NULL for global config
+     * @param value IN new value, 0 means one thread for every online
+     *        processor
+     */
+    void flom_config_set_locker_threads(flom_config_t *config, gint value);
+
+
+
+    /**
+     * Get the number of locker threads that must be started by the daemon
+     * @param config IN/OUT configuration object, NULL for global config
+     * @return current value, 0 means one thread for every online processor
+     */
+    static inline gint flom_config_get_locker_threads(
+        flom_config_t *config) {
+        return NULL == config ?
+            global_config.locker_threads : config->locker_threads;
+    }
+
+
+
+    /**
+     * Set the number of acceptor threads that must be started by a TCP/IP
+     * daemon
+     * @param config IN/OUT configuration object, NULL for global config
+     * @param value IN new value, values less than 1 are changed to 1
+     */
+    void flom_config_set_acceptor_threads(flom_config_t *config, gint value);
+
+
+
+    /**
+     * Get the number of acceptor threads that must be started by a TCP/IP
+     * daemon
+     * @param config IN/OUT configuration object, NULL for global config
+     * @return current value
+     */
+    static inline gint flom_config_get_acceptor_threads(
+        flom_config_t *config) {
+        return NULL == config ?
+            global_config.acceptor_threads : config->acceptor_threads;
+    }
+
+
     
     /**
      * Set the signals that must be ignored by the monitor.
@@ -1106,6 +1212,54 @@ extern "C" {
     }
 
 
+
+    /**
+     * Set the file used to cache the address of the discovered daemon
+     * @param config IN/OUT configuration object, NULL for global config
+     * @param value IN new value
+     */
+    void flom_config_set_discovery_cache_file(flom_config_t *config,
+                                              const gchar *value);
+
+
+
+    /**
+     * Get the file used to cache the address of the discovered daemon
+     * @param config IN/OUT configuration object, NULL for global config
+     * @return current value
+     */
+    static inline const gchar *flom_config_get_discovery_cache_file(
+        flom_config_t *config) {
+        return NULL == config ?
+            global_config.discovery_cache_file :
+            config->discovery_cache_file;
+    }
+
+
+
+    /**
+     * Set the lifespan of the cached daemon address
+     * @param config IN/OUT configuration object, NULL for global config
+     * @param lifespan IN new value (seconds)
+     */
+    void flom_config_set_discovery_cache_lifespan(flom_config_t *config,
+                                                  gint lifespan);
+
+
+
+    /**
+     * Get the lifespan of the cached daemon address
+     * @param config IN/OUT configuration object, NULL for global config
+     * @return current value (seconds)
+     */
+    static inline gint flom_config_get_discovery_cache_lifespan(
+        flom_config_t *config) {
+        return NULL == config ?
+            global_config.discovery_cache_lifespan :
+            config->discovery_cache_lifespan;
+    }
+
+
     
     /**
      * Set tcp_keepalive_time parameter value for socket SO_KEEPALIVE feature
@@ -1247,6 +1401,34 @@ extern "C" {
     
 
     
+    /**
+     * Set binary_protocol parameter value
+     * @param config IN/OUT configuration object, NULL for global config
+     * @param value IN new (boolean) value
+     */
+    static inline void flom_config_set_binary_protocol(
+        flom_config_t *config, gint value) {
+        if (NULL == config)
+            global_config.binary_protocol = value;
+        else
+            config->binary_protocol = value;
+    }
+
+
+
+    /**
+     * Get binary_protocol parameter value
+     * @param config IN/OUT configuration object, NULL for global config
+     * @return current value
+     */
+    static inline gint flom_config_get_binary_protocol(
+        flom_config_t *config) {
+        return NULL == config ?
+            global_config.binary_protocol : config->binary_protocol;
+    }
+
+
+
     /**
      * Set tls_check_peer_id parameter value
      * @param config IN/OUT configuration object, NULL for global config
@@ -1275,6 +1457,57 @@ extern "C" {
 
 
 
+    /**
+     * Set tls_session_file in config object
+     * @param config IN/OUT configuration object, NULL for global config
+     * @param value IN set the new value for tls_session_file property
+     */
+    void flom_config_set_tls_session_file(flom_config_t *config,
+                                          const gchar *value);
+
+
+
+    /**
+     * Get tls_session_file value
+     * @param config IN/OUT configuration object, NULL for global config
+     * @return current value
+     */
+    static inline const gchar *flom_config_get_tls_session_file(
+        flom_config_t *config) {
+        return NULL == config ?
+            global_config.tls_session_file : config->tls_session_file;
+    }
+
+
+
+    /**
+     * Set tls_kernel_offload parameter value
+     * @param config IN/OUT configuration object, NULL for global config
+     * @param value IN new (boolean) value
+     */
+    static inline void flom_config_set_tls_kernel_offload(
+        flom_config_t *config, gint value) {
+        if (NULL == config)
+            global_config.tls_kernel_offload = value;
+        else
+            config->tls_kernel_offload = value;
+    }
+
+
+
+    /**
+     * Get tls_kernel_offload parameter value
+     * @param config IN/OUT configuration object, NULL for global config
+     * @return current value
+     */
+    static inline gint flom_config_get_tls_kernel_offload(
+        flom_config_t *config) {
+        return NULL == config ?
+            global_config.tls_kernel_offload : config->tls_kernel_offload;
+    }
+
+
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -26,6 +26,9 @@
 #ifdef HAVE_NETINET_TCP_H
 # include <netinet/tcp.h>
 #endif
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
 #ifdef HAVE_SYS_SOCKET_H
 # include <sys/socket.h>
 #endif
@@ -59,6 +62,8 @@ flom_conn_t *flom_conn_new(flom_config_t *config)
         if (NULL != (tmp->msg = g_try_malloc(sizeof(struct flom_msg_s)))) {
             /* initialize the message */
             flom_msg_init(tmp->msg);
+            /* XML until the peer chooses a different protocol level */
+            tmp->level = FLOM_MSG_LEVEL;
         } else {
             /* remove connection object because msg struct was not allocated */
             g_free(tmp);
@@ -86,6 +91,10 @@ void flom_conn_delete(flom_conn_t *obj)
         /* clean TLS object */
         flom_tls_delete(obj->tls);
         obj->tls = NULL;
+        g_free(obj->incubator_key);
+        obj->incubator_key = NULL;
+        flom_conn_free_rbuf(obj);
+        flom_conn_free_wbuf(obj);
         /* remove object itself */
         g_free(obj);
     }
@@ -100,13 +109,11 @@ int flom_conn_init(flom_conn_t *obj, flom_uid_t uid, int domain, int sockfd,
 {
     enum Exception { NULL_OBJECT
                      , INVALID_DOMAIN
-                     , G_MARKUP_PARSE_CONTEXT_NEW_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     
     FLOM_TRACE(("flom_conn_init\n"));
     TRY {
-        GMarkupParseContext *tmp_parser = NULL;
         if (NULL == obj)
             THROW(NULL_OBJECT);
 
@@ -139,11 +146,7 @@ int flom_conn_init(flom_conn_t *obj, flom_uid_t uid, int domain, int sockfd,
         flom_conn_set_wait(obj, FALSE);
         
         /* initialize the associated parser */
-        if (NULL == (tmp_parser = g_markup_parse_context_new (
-                         &flom_msg_parser, 0,
-                         (gpointer)(obj->msg), NULL)))
-            THROW(G_MARKUP_PARSE_CONTEXT_NEW_ERROR);
-        flom_conn_set_parser(obj, tmp_parser);
+        flom_msg_parser_reset(&obj->parser);
         
         THROW(NONE);
     } CATCH {
@@ -154,9 +157,6 @@ int flom_conn_init(flom_conn_t *obj, flom_uid_t uid, int domain, int sockfd,
             case INVALID_DOMAIN:
                 ret_cod = FLOM_RC_OBJ_CORRUPTED;
                 break;
-            case G_MARKUP_PARSE_CONTEXT_NEW_ERROR:
-                ret_cod = FLOM_RC_G_MARKUP_PARSE_CONTEXT_NEW_ERROR;
-                break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
                 break;
@@ -171,14 +171,21 @@ int flom_conn_init(flom_conn_t *obj, flom_uid_t uid, int domain, int sockfd,
 
 
 
-void flom_conn_free_parser(flom_conn_t *obj)
+void flom_conn_free_wbuf(flom_conn_t *obj)
 {
     if (NULL != obj) {
-        if (NULL != obj->parser) {
-            g_markup_parse_context_free(obj->parser);
-            obj->parser = NULL;
-        } /* if (NULL != obj->parser) */
-    } /* if (NULL != obj) */
+        if (obj->wbuf_pending && NULL != obj->batch)
+            g_ptr_array_remove_fast(obj->batch->pending, obj);
+        obj->wbuf_pending = FALSE;
+        /* a closed connection must not be closed again by the batch
+           owner */
+        if (NULL != obj->batch && NULL != obj->batch->failed)
+            while (g_ptr_array_remove_fast(obj->batch->failed, obj))
+                ;
+        g_free(obj->wbuf);
+        obj->wbuf = NULL;
+        obj->wbuf_len = 0;
+    }
 }
 
 
@@ -188,17 +195,264 @@ int flom_conn_send(flom_conn_t *obj, const void *buf, size_t len)
     int ret_cod = FLOM_RC_OK;
     FLOM_TRACE(("flom_conn_send\n"));
 
+    if (NULL != obj->batch)
+        ret_cod = flom_conn_queue(obj, buf, len);
+    else
+        ret_cod = flom_conn_write(obj, buf, len);
+    FLOM_TRACE(("flom_conn_send/"
+                "ret_cod=%d/errno=%d\n", ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_conn_write(flom_conn_t *obj, const void *buf, size_t len)
+{
+    int ret_cod = FLOM_RC_OK;
+    FLOM_TRACE(("flom_conn_write\n"));
+
     if (NULL != obj->tls)
         ret_cod = flom_tls_send(obj->tls, buf, len);
     else
         ret_cod = flom_tcp_send(&obj->tcp, buf, len);
-    FLOM_TRACE(("flom_conn_send/"
+    FLOM_TRACE(("flom_conn_write/"
                 "ret_cod=%d/errno=%d\n", ret_cod, errno));
     return ret_cod;
 }
 
 
 
+int flom_conn_queue(flom_conn_t *obj, const void *buf, size_t len)
+{
+    enum Exception { CONN_FLUSH_ERROR
+                     , CONN_WRITE_ERROR
+                     , G_TRY_MALLOC_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_conn_queue: len=" SIZE_T_FORMAT ", wbuf_len="
+                SIZE_T_FORMAT "\n", len, obj->wbuf_len));
+    TRY {
+        /* the message does not fit the free space: the queued messages
+           are sent first */
+        if (0 < obj->wbuf_len && FLOM_CONN_WBUF_SIZE - obj->wbuf_len < len)
+            if (FLOM_RC_OK != (ret_cod = flom_conn_flush(obj)))
+                THROW(CONN_FLUSH_ERROR);
+        obj->batch->messages++;
+        if (FLOM_CONN_WBUF_SIZE < len) {
+            /* it can't be buffered at all */
+            obj->batch->writes++;
+            if (FLOM_RC_OK != (ret_cod = flom_conn_write(obj, buf, len))) {
+                g_ptr_array_add(obj->batch->failed, obj);
+                THROW(CONN_WRITE_ERROR);
+            }
+            THROW(NONE);
+        }
+        if (NULL == obj->wbuf &&
+            NULL == (obj->wbuf = g_try_malloc(FLOM_CONN_WBUF_SIZE)))
+            THROW(G_TRY_MALLOC_ERROR);
+        memcpy(obj->wbuf + obj->wbuf_len, buf, len);
+        obj->wbuf_len += len;
+        /* the batch will flush the connection at the end of the loop
+           iteration */
+        if (!obj->wbuf_pending) {
+            g_ptr_array_add(obj->batch->pending, obj);
+            obj->wbuf_pending = TRUE;
+        }
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case CONN_FLUSH_ERROR:
+            case CONN_WRITE_ERROR:
+                break;
+            case G_TRY_MALLOC_ERROR:
+                ret_cod = FLOM_RC_G_TRY_MALLOC_ERROR;
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_conn_queue/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_conn_flush(flom_conn_t *obj)
+{
+    int ret_cod = FLOM_RC_OK;
+    FLOM_TRACE(("flom_conn_flush: wbuf_len=" SIZE_T_FORMAT "\n",
+                obj->wbuf_len));
+
+    if (0 < obj->wbuf_len) {
+        if (NULL != obj->batch)
+            obj->batch->writes++;
+        ret_cod = flom_conn_write(obj, obj->wbuf, obj->wbuf_len);
+        /* the messages that can not be sent are lost: the connection
+           must be closed by the thread owning the batch */
+        obj->wbuf_len = 0;
+        if (FLOM_RC_OK != ret_cod && NULL != obj->batch)
+            g_ptr_array_add(obj->batch->failed, obj);
+    }
+    FLOM_TRACE(("flom_conn_flush/"
+                "ret_cod=%d/errno=%d\n", ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+void flom_conn_batch_init(flom_conn_batch_t *batch)
+{
+    batch->pending = g_ptr_array_new();
+    batch->failed = g_ptr_array_new();
+    batch->messages = batch->writes = 0;
+}
+
+
+
+void flom_conn_batch_free(flom_conn_batch_t *batch)
+{
+    guint i;
+    
+    if (NULL == batch->pending)
+        return;
+    /* the messages of the connections still attached are discarded */
+    for (i=0; i<batch->pending->len; ++i) {
+        flom_conn_t *conn = g_ptr_array_index(batch->pending, i);
+        conn->wbuf_pending = FALSE;
+        conn->wbuf_len = 0;
+    }
+    g_ptr_array_free(batch->pending, TRUE);
+    batch->pending = NULL;
+    g_ptr_array_free(batch->failed, TRUE);
+    batch->failed = NULL;
+}
+
+
+
+void flom_conn_batch_flush(flom_conn_batch_t *batch)
+{
+    guint i;
+    
+    FLOM_TRACE(("flom_conn_batch_flush: pending=%u\n", batch->pending->len));
+    for (i=0; i<batch->pending->len; ++i) {
+        int ret_cod;
+        flom_conn_t *conn = g_ptr_array_index(batch->pending, i);
+        conn->wbuf_pending = FALSE;
+        if (FLOM_RC_OK != (ret_cod = flom_conn_flush(conn))) {
+            FLOM_TRACE(("flom_conn_batch_flush: error %d while sending "
+                        "messages to connection %p, it must be "
+                        "closed\n", ret_cod, conn));
+        }
+    } /* for (i=0; i<batch->pending->len; ++i) */
+    g_ptr_array_set_size(batch->pending, 0);
+    FLOM_TRACE(("flom_conn_batch_flush: messages=" UINT64_T_FORMAT
+                ", writes=" UINT64_T_FORMAT "\n",
+                batch->messages, batch->writes));
+}
+
+
+
+int flom_conn_send_answer(flom_conn_t *obj, int verb, int step, int rc)
+{
+    enum Exception { CONN_SEND_ERROR
+                     , CONN_SEND_TAGGED_ANSWER_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_conn_send_answer: verb=%d, step=%d, rc=%d\n",
+                verb, step, rc));
+    TRY {
+        const flom_msg_cached_answer_t *cached =
+            flom_msg_get_cached_answer(
+                flom_conn_get_level(obj), verb, step, rc);
+        
+        if (NULL != cached) {
+            if (FLOM_RC_OK != (ret_cod = flom_conn_send(
+                                   obj, cached->buffer, cached->len)))
+                THROW(CONN_SEND_ERROR);
+            THROW(NONE);
+        }
+        /* the answer is not cached, it must be built */
+        if (FLOM_RC_OK != (ret_cod = flom_conn_send_tagged_answer(
+                               obj, verb, step, rc, 0, NULL)))
+            THROW(CONN_SEND_TAGGED_ANSWER_ERROR);
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case CONN_SEND_ERROR:
+            case CONN_SEND_TAGGED_ANSWER_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_conn_send_answer/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_conn_send_tagged_answer(flom_conn_t *obj, int verb, int step,
+                                 int rc, int rid, const gchar *element)
+{
+    enum Exception { MSG_BUILD_ANSWER_ERROR
+                     , MSG_SERIALIZE_ERROR
+                     , CONN_SEND_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    struct flom_msg_s msg;
+    
+    FLOM_TRACE(("flom_conn_send_tagged_answer: verb=%d, step=%d, rc=%d, "
+                "rid=%d\n", verb, step, rc, rid));
+    flom_msg_init(&msg);
+    TRY {
+        char buffer[FLOM_MSG_BUFFER_SIZE];
+        size_t to_send;
+        
+        if (FLOM_RC_OK != (ret_cod = flom_msg_build_answer(
+                               &msg, verb, step, rc, element)))
+            THROW(MSG_BUILD_ANSWER_ERROR);
+        msg.header.level = flom_conn_get_level(obj);
+        msg.header.rid = rid;
+        if (FLOM_RC_OK != (ret_cod = flom_msg_serialize(
+                               &msg, buffer, sizeof(buffer), &to_send)))
+            THROW(MSG_SERIALIZE_ERROR);
+        if (FLOM_RC_OK != (ret_cod = flom_conn_send(obj, buffer, to_send)))
+            THROW(CONN_SEND_ERROR);
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case MSG_BUILD_ANSWER_ERROR:
+            case MSG_SERIALIZE_ERROR:
+            case CONN_SEND_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    flom_msg_free(&msg);
+    FLOM_TRACE(("flom_conn_send_tagged_answer/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
 int flom_conn_recv(flom_conn_t *obj, void *buf, size_t len, size_t *received,
                    int timeout, struct sockaddr *src_addr, socklen_t *addrlen)
 {
@@ -210,7 +464,10 @@ int flom_conn_recv(flom_conn_t *obj, void *buf, size_t len, size_t *received,
     
     FLOM_TRACE(("flom_conn_recv\n"));
     TRY {
-        if (timeout > 0) {
+        int stream = SOCK_STREAM == flom_tcp_get_socket_type(&obj->tcp);
+        /* a message already inside the receive buffer does not need to
+           wait for the socket */
+        if (timeout > 0 && !(stream && 0 < flom_conn_get_pending_msgs(obj))) {
             struct pollfd fds[1];
             int rc;
             /* use poll to check the filedescriptor for a limited amount of
@@ -234,8 +491,8 @@ int flom_conn_recv(flom_conn_t *obj, void *buf, size_t len, size_t *received,
         } /* if (timeout > 0) */
 
         
-        if (NULL != obj->tls)
-            ret_cod = flom_tls_recv_msg(obj->tls, buf, len, received);
+        if (stream)
+            ret_cod = flom_conn_recv_msg(obj, buf, len, received);
         else
             ret_cod = flom_tcp_recv(&obj->tcp, buf, len, received,
                                     src_addr, addrlen);
@@ -265,6 +522,151 @@ int flom_conn_recv(flom_conn_t *obj, void *buf, size_t len, size_t *received,
 
 
 
+int flom_conn_recv_msg(flom_conn_t *obj, char *buf, size_t len,
+                       size_t *received)
+{
+    enum Exception { G_TRY_MALLOC_ERROR
+                     , BUFFER_OVERFLOW1
+                     , TLS_RECV_CHUNK_ERROR
+                     , TCP_RECV_CHUNK_ERROR
+                     , BUFFER_OVERFLOW2
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_conn_recv_msg\n"));
+    TRY {
+        size_t msg_len;
+        
+        if (NULL == obj->rbuf) {
+            if (NULL == (obj->rbuf = g_try_malloc(FLOM_CONN_RBUF_SIZE)))
+                THROW(G_TRY_MALLOC_ERROR);
+            obj->rbuf_pos = obj->rbuf_len = 0;
+        }
+        /* read until the buffer contains a complete message */
+        while (0 == (msg_len = flom_conn_frame_msg(
+                         obj->rbuf + obj->rbuf_pos,
+                         obj->rbuf_len - obj->rbuf_pos))) {
+            size_t read_bytes = 0;
+            /* move the partial message at the beginning of the buffer */
+            if (0 < obj->rbuf_pos) {
+                obj->rbuf_len -= obj->rbuf_pos;
+                memmove(obj->rbuf, obj->rbuf + obj->rbuf_pos, obj->rbuf_len);
+                obj->rbuf_pos = 0;
+            }
+            if (FLOM_CONN_RBUF_SIZE == obj->rbuf_len)
+                THROW(BUFFER_OVERFLOW1);
+            if (NULL != obj->tls) {
+                if (FLOM_RC_OK != (ret_cod = flom_tls_recv_chunk(
+                                       obj->tls, obj->rbuf + obj->rbuf_len,
+                                       FLOM_CONN_RBUF_SIZE - obj->rbuf_len,
+                                       &read_bytes)))
+                    THROW(TLS_RECV_CHUNK_ERROR);
+            } else {
+                if (FLOM_RC_OK != (ret_cod = flom_tcp_recv_chunk(
+                                       &obj->tcp, obj->rbuf + obj->rbuf_len,
+                                       FLOM_CONN_RBUF_SIZE - obj->rbuf_len,
+                                       &read_bytes)))
+                    THROW(TCP_RECV_CHUNK_ERROR);
+            }
+            obj->rbuf_len += read_bytes;
+        } /* while (0 == (msg_len = ... */
+        /* room for the string terminator is necessary */
+        if (msg_len >= len)
+            THROW(BUFFER_OVERFLOW2);
+        memcpy(buf, obj->rbuf + obj->rbuf_pos, msg_len);
+        buf[msg_len] = '\0';
+        *received = msg_len;
+        obj->rbuf_pos += msg_len;
+        if (obj->rbuf_pos == obj->rbuf_len)
+            obj->rbuf_pos = obj->rbuf_len = 0;
+        FLOM_TRACE(("flom_conn_recv_msg: message of " SIZE_T_FORMAT
+                    " bytes, " SIZE_T_FORMAT " bytes still buffered\n",
+                    msg_len, obj->rbuf_len - obj->rbuf_pos));
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case G_TRY_MALLOC_ERROR:
+                ret_cod = FLOM_RC_G_TRY_MALLOC_ERROR;
+                break;
+            case BUFFER_OVERFLOW1:
+                ret_cod = FLOM_RC_BUFFER_OVERFLOW;
+                break;
+            case TLS_RECV_CHUNK_ERROR:
+            case TCP_RECV_CHUNK_ERROR:
+                break;
+            case BUFFER_OVERFLOW2:
+                ret_cod = FLOM_RC_BUFFER_OVERFLOW;
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_conn_recv_msg/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+size_t flom_conn_frame_msg(const char *buffer, size_t buffer_len)
+{
+    size_t closing_tag_len = strlen(FLOM_MSG_CLOSING_TAG);
+    const char *last = buffer + buffer_len;
+    const char *cursor = buffer;
+    
+    if (flom_msg_is_binary(buffer, buffer_len)) {
+        size_t frame_len;
+        if (FLOM_MSG_BINARY_HEADER_SIZE > buffer_len)
+            return 0;
+        frame_len = flom_msg_binary_frame_len(buffer);
+        return frame_len <= buffer_len ? frame_len : 0;
+    }
+    /* look for the last char of the closing tag, then check the tag */
+    while (NULL != (cursor = memchr(
+                        cursor, FLOM_MSG_CLOSING_TAG[closing_tag_len-1],
+                        last - cursor))) {
+        cursor++;
+        if (cursor - buffer >= closing_tag_len &&
+            0 == memcmp(cursor - closing_tag_len, FLOM_MSG_CLOSING_TAG,
+                        closing_tag_len))
+            return cursor - buffer;
+    }
+    return 0;
+}
+
+
+
+guint flom_conn_get_pending_msgs(const flom_conn_t *obj)
+{
+    guint n = 0;
+    size_t pos, msg_len;
+
+    if (NULL == obj->rbuf)
+        return 0;
+    for (pos = obj->rbuf_pos; 0 < (msg_len = flom_conn_frame_msg(
+                                        obj->rbuf + pos, obj->rbuf_len - pos));
+         pos += msg_len)
+        n++;
+    return n;
+}
+
+
+
+void flom_conn_free_rbuf(flom_conn_t *obj)
+{
+    if (NULL != obj) {
+        g_free(obj->rbuf);
+        obj->rbuf = NULL;
+        obj->rbuf_pos = obj->rbuf_len = 0;
+    }
+}
+
+
+
 int flom_conn_terminate(flom_conn_t *obj)
 {
     enum Exception { TCP_CLOSE
@@ -284,6 +686,9 @@ int flom_conn_terminate(flom_conn_t *obj)
                 if (FLOM_RC_OK != (ret_cod = flom_tcp_close(&obj->tcp)))
                     THROW(TCP_CLOSE);
             }
+            /* buffered bytes are useless without the socket */
+            flom_conn_free_rbuf(obj);
+            flom_conn_free_wbuf(obj);
         } else {
             FLOM_TRACE(("flom_conn_terminate: connection %p already "
                         "in state %d, skipping...\n", obj,
@@ -316,12 +721,12 @@ void flom_conn_trace(const flom_conn_t *conn)
     FLOM_TRACE(("flom_conn_trace: "
                 "uid= " FLOM_UID_T_FORMAT ", fd=%d, type=%d, state=%d, "
                 "wait=%d, msg=%p, parser=%p, "
-                "addr_len=%d\n",
+                "addr_len=%d, conns_pos=%u\n",
                 flom_conn_get_uid(conn),
                 flom_tcp_get_sockfd(&conn->tcp),
                 flom_tcp_get_socket_type(&conn->tcp),
-                conn->state, conn->wait, conn->msg, conn->parser,
-                flom_tcp_get_addrlen(&conn->tcp)));
+                conn->state, conn->wait, conn->msg, &conn->parser,
+                flom_tcp_get_addrlen(&conn->tcp), conn->conns_pos));
 }
 
 
@@ -65,6 +65,31 @@
 
 
 
+/* defined in flom_locker.h */
+struct flom_locker_s;
+/* defined in flom_mlock.h */
+struct flom_mlock_s;
+
+
+
+/**
+ * Size of the receive buffer of a stream connection: it must contain the
+ * longest message, the remaining space is used to pick-up the pipelined
+ * messages with the same system call
+ */
+#define FLOM_CONN_RBUF_SIZE    (4*FLOM_NETWORK_BUFFER_SIZE)
+
+
+
+/**
+ * Size of the write buffer of a batched connection: the messages queued
+ * during a loop iteration are sent with a single write; a message that
+ * does not fit the free space flushes the buffer first
+ */
+#define FLOM_CONN_WBUF_SIZE    (4*FLOM_NETWORK_BUFFER_SIZE)
+
+
+
 /**
  * Possible state of a connection
  */
@@ -87,6 +112,35 @@ typedef enum flom_conn_state_e {
 
 
 
+/**
+ * Output messages of the connections served by the same thread: the
+ * messages sent during a loop iteration are appended to the write buffers
+ * of their connections and they are flushed by
+ * @ref flom_conn_batch_flush at the end of the iteration, with a single
+ * write (and a single TLS record) for every connection
+ */
+typedef struct flom_conn_batch_s {
+    /**
+     * Connections with a non empty write buffer
+     */
+    GPtrArray            *pending;
+    /**
+     * Connections whose queued messages could not be sent: they must be
+     * closed by the thread owning the batch
+     */
+    GPtrArray            *failed;
+    /**
+     * Number of messages queued by the connections of the batch
+     */
+    guint64               messages;
+    /**
+     * Number of writes used to send the queued messages
+     */
+    guint64               writes;
+} flom_conn_batch_t;
+
+
+
 /**
  * Class of objects used to store connection data
  */
@@ -105,6 +159,12 @@ typedef struct {
      * property
      */
     int                   wait;
+    /**
+     * Key of the incubator queue hosting the connection (see
+     * @ref flom_conns_incubate); it's NULL if the connection is not
+     * waiting for resource creation
+     */
+    gchar                *incubator_key;
     /**
      * Step of the last sent/received  message
      */
@@ -122,9 +182,76 @@ typedef struct {
      */
     struct flom_msg_s    *msg;
     /**
-     * GMarkup Parser context (allocated by g_markup_parse_context_new)
+     * XML parser used to deserialize the messages received from the
+     * connection
+     */
+    flom_msg_parser_t     parser;
+    /**
+     * Position of the connection inside the connections object
+     * (@ref flom_conns_t) that's managing it; it's used to map a ready
+     * file descriptor returned by epoll to the connection id
+     */
+    guint                 conns_pos;
+    /**
+     * Poll events the connection is waiting for in addition to POLLIN
+     * (i.e. POLLOUT while a non blocking TLS handshake is waiting to write)
      */
-    GMarkupParseContext  *parser;
+    short                 events;
+    /**
+     * Protocol level used to send messages to the peer:
+     * @ref FLOM_MSG_LEVEL or @ref FLOM_MSG_LEVEL_BINARY
+     */
+    int                   level;
+    /**
+     * Receive buffer of a stream connection (allocated at first receive
+     * with @ref FLOM_CONN_RBUF_SIZE bytes); it contains the bytes read from
+     * the socket and not yet returned by @ref flom_conn_recv
+     */
+    char                 *rbuf;
+    /**
+     * Offset of the first byte of @ref rbuf not yet returned
+     */
+    size_t                rbuf_pos;
+    /**
+     * Number of valid bytes inside @ref rbuf
+     */
+    size_t                rbuf_len;
+    /**
+     * Batch used to send the messages of the connection; NULL if the
+     * messages are sent immediately
+     */
+    flom_conn_batch_t    *batch;
+    /**
+     * Write buffer of a batched connection (allocated at first send with
+     * @ref FLOM_CONN_WBUF_SIZE bytes)
+     */
+    char                 *wbuf;
+    /**
+     * Number of bytes queued inside @ref wbuf
+     */
+    size_t                wbuf_len;
+    /**
+     * Boolean value: the connection is inside the pending array of its
+     * batch
+     */
+    int                   wbuf_pending;
+    /**
+     * Locker serving the connection: it's set by the locker thread when
+     * the connection is attached to one of the lockers it's hosting
+     */
+    struct flom_locker_s *locker;
+    /**
+     * Multiple lock request the connection belongs to: it's the client
+     * connection that sent the request or the connection used to acquire
+     * one of its resources; NULL for all the other connections
+     */
+    struct flom_mlock_s  *mlock;
+    /**
+     * Requests of a pipelined client connection (@ref flom_mlock_s objects
+     * indexed by request id); NULL if the client does not use pipelined
+     * requests
+     */
+    GHashTable           *pipeline;
 } flom_conn_t;
 
 
@@ -240,6 +367,18 @@ extern "C" {
 
 
     
+    /**
+     * Getter method for incubator_key property
+     * @param obj IN connection object
+     * @return incubator_key
+     */
+    static inline const gchar *flom_conn_get_incubator_key(
+        const flom_conn_t *obj) {
+        return obj->incubator_key;
+    }
+
+
+    
     /**
      * Getter method for last_step property
      * @param obj IN connection object
@@ -262,6 +401,158 @@ extern "C" {
 
 
     
+    /**
+     * Getter method for conns_pos property
+     * @param obj IN connection object
+     * @return conns_pos
+     */
+    static inline guint flom_conn_get_conns_pos(const flom_conn_t *obj) {
+        return obj->conns_pos;
+    }
+    
+    
+    
+    /**
+     * Setter method for conns_pos property
+     * @param obj IN/OUT connection object
+     * @param value IN new value for conns_pos
+     */
+    static inline void flom_conn_set_conns_pos(flom_conn_t *obj,
+                                               guint value) {
+        obj->conns_pos = value;
+    }
+
+
+    
+    /**
+     * Getter method for events property
+     * @param obj IN connection object
+     * @return events
+     */
+    static inline short flom_conn_get_events(const flom_conn_t *obj) {
+        return obj->events;
+    }
+    
+    
+    
+    /**
+     * Setter method for events property; use @ref flom_conns_epoll_mod to
+     * propagate the new value to the epoll set
+     * @param obj IN/OUT connection object
+     * @param value IN new value for events
+     */
+    static inline void flom_conn_set_events(flom_conn_t *obj, short value) {
+        obj->events = value;
+    }
+
+
+    
+    /**
+     * Getter method for level property
+     * @param obj IN connection object
+     * @return level
+     */
+    static inline int flom_conn_get_level(const flom_conn_t *obj) {
+        return obj->level;
+    }
+    
+    
+    
+    /**
+     * Setter method for level property
+     * @param obj IN/OUT connection object
+     * @param value IN new value for level
+     */
+    static inline void flom_conn_set_level(flom_conn_t *obj, int value) {
+        obj->level = value;
+    }
+
+
+    
+    /**
+     * Getter method for locker property
+     * @param obj IN connection object
+     * @return locker
+     */
+    static inline struct flom_locker_s *flom_conn_get_locker(
+        const flom_conn_t *obj) {
+        return obj->locker;
+    }
+    
+    
+    
+    /**
+     * Setter method for locker property
+     * @param obj IN/OUT connection object
+     * @param value IN new value for locker
+     */
+    static inline void flom_conn_set_locker(flom_conn_t *obj,
+                                            struct flom_locker_s *value) {
+        obj->locker = value;
+    }
+
+
+    
+    /**
+     * Setter method for batch property: the messages sent by the
+     * connection will be queued inside the batch
+     * @param obj IN/OUT connection object
+     * @param value IN batch object or NULL
+     */
+    static inline void flom_conn_set_batch(flom_conn_t *obj,
+                                           flom_conn_batch_t *value) {
+        obj->batch = value;
+    }
+
+
+    
+    /**
+     * Getter method for mlock property
+     * @param obj IN connection object
+     * @return mlock
+     */
+    static inline struct flom_mlock_s *flom_conn_get_mlock(
+        const flom_conn_t *obj) {
+        return obj->mlock;
+    }
+    
+    
+    
+    /**
+     * Setter method for mlock property
+     * @param obj IN/OUT connection object
+     * @param value IN new value for mlock
+     */
+    static inline void flom_conn_set_mlock(flom_conn_t *obj,
+                                           struct flom_mlock_s *value) {
+        obj->mlock = value;
+    }
+
+
+    
+    /**
+     * Getter method for pipeline property
+     * @param obj IN connection object
+     * @return pipeline
+     */
+    static inline GHashTable *flom_conn_get_pipeline(const flom_conn_t *obj) {
+        return obj->pipeline;
+    }
+    
+    
+    
+    /**
+     * Setter method for pipeline property
+     * @param obj IN/OUT connection object
+     * @param value IN new value for pipeline
+     */
+    static inline void flom_conn_set_pipeline(flom_conn_t *obj,
+                                              GHashTable *value) {
+        obj->pipeline = value;
+    }
+
+
+    
     /**
      * Getter method for tcp property
      * @param obj IN connection object
@@ -310,34 +601,11 @@ extern "C" {
     /**
      * Getter method for parser property
      * @param obj IN connection object
-     * @return msg
-     */
-    static inline GMarkupParseContext *flom_conn_get_parser(flom_conn_t *obj) {
-        return obj->parser;
-    }
-    
-    
-    
-    /**
-     * Setter method for parser property
-     * @param obj IN connection object
-     * @param ref IN reference to the new parser
-     * @return msg
+     * @return a reference to the XML parser of the connection
      */
-    static inline void flom_conn_set_parser(
-        flom_conn_t *obj, GMarkupParseContext *ref) {
-        if (NULL != obj->parser)
-            g_markup_parse_context_free(obj->parser);
-        obj->parser = ref;
+    static inline flom_msg_parser_t *flom_conn_get_parser(flom_conn_t *obj) {
+        return &obj->parser;
     }
-    
-    
-
-    /**
-     * Release the parser object used by the connection
-     * @param obj IN/OUT connection object
-     */
-    void flom_conn_free_parser(flom_conn_t *obj);
 
 
 
@@ -349,7 +617,7 @@ extern "C" {
      * @param received OUT number of read bytes
      * @param timeout IN maximum wait time to receive the answer
      *        (milliseconds); use @ref FLOM_NETWORK_WAIT_TIMEOUT for indefinite
-     *        wait
+     *        wait, 0 to read a non blocking socket without waiting
      * @param src_addr OUT transparently passed to recvfrom if type is
      *                 SOCK_DGRAM (see recvfrom man page); it applies only to
      *                 UDP/IP
@@ -363,9 +631,71 @@ extern "C" {
                        struct sockaddr *src_addr, socklen_t *addrlen);
 
 
+
+    /**
+     * Return the next message of a stream connection: the socket is read
+     * in large chunks and the message is framed inside the receive buffer;
+     * the bytes that follow the message (pipelined messages) are kept for
+     * the next call
+     * @param obj IN/OUT connection object
+     * @param buf OUT buffer for the message (it will be null terminated)
+     * @param len IN size of buf
+     * @param received OUT message length
+     * @return a reason code; @ref FLOM_RC_WOULD_BLOCK if the socket is non
+     *         blocking and the buffer does not contain a complete message:
+     *         the partial message is kept for the next call
+     */
+    int flom_conn_recv_msg(flom_conn_t *obj, char *buf, size_t len,
+                           size_t *received);
+
+
+
+    /**
+     * Compute the length of the first message contained in a buffer;
+     * binary messages are framed by their header, XML messages by the
+     * closing tag
+     * @param buffer IN received bytes
+     * @param buffer_len IN number of received bytes
+     * @return the length of the first message or 0 if the buffer does not
+     *         contain a complete message
+     */
+    size_t flom_conn_frame_msg(const char *buffer, size_t buffer_len);
+
+
+
+    /**
+     * Number of complete messages already inside the receive buffer of a
+     * connection: they must be processed without waiting for the socket
+     * because poll/epoll would not report them
+     * @param obj IN connection object
+     * @return the number of buffered messages
+     */
+    guint flom_conn_get_pending_msgs(const flom_conn_t *obj);
+
+
+
+    /**
+     * Release the receive buffer of the connection; the bytes not yet
+     * returned are discarded
+     * @param obj IN/OUT connection object
+     */
+    void flom_conn_free_rbuf(flom_conn_t *obj);
+
+
     
     /**
-     * Send a buffer using raw TCP/IP or TLS over TCP/IP
+     * Release the write buffer of the connection; the queued messages
+     * are discarded and the connection is removed from its batch
+     * @param obj IN/OUT connection object
+     */
+    void flom_conn_free_wbuf(flom_conn_t *obj);
+
+
+
+    /**
+     * Send a buffer using raw TCP/IP or TLS over TCP/IP; if the connection
+     * is attached to a batch, the buffer is queued (see
+     * @ref flom_conn_queue)
      * @param obj IN/OUT connection object
      * @param buf IN buffer to send
      * @param len IN buffer lenght
@@ -375,6 +705,99 @@ extern "C" {
 
 
 
+    /**
+     * Send a buffer immediately, even if the connection is attached to a
+     * batch
+     * @param obj IN/OUT connection object
+     * @param buf IN buffer to send
+     * @param len IN buffer lenght
+     * @return a reason code
+     */
+    int flom_conn_write(flom_conn_t *obj, const void *buf, size_t len);
+
+
+
+    /**
+     * Append a buffer to the write buffer of a batched connection: it will
+     * be sent by @ref flom_conn_batch_flush
+     * @param obj IN/OUT connection object
+     * @param buf IN buffer to queue
+     * @param len IN buffer lenght
+     * @return a reason code
+     */
+    int flom_conn_queue(flom_conn_t *obj, const void *buf, size_t len);
+
+
+
+    /**
+     * Send the content of the write buffer of a connection with a single
+     * write; if the write fails, the connection is appended to the failed
+     * connections of its batch
+     * @param obj IN/OUT connection object
+     * @return a reason code
+     */
+    int flom_conn_flush(flom_conn_t *obj);
+
+
+
+    /**
+     * Initialize a batch object
+     * @param batch OUT batch object
+     */
+    void flom_conn_batch_init(flom_conn_batch_t *batch);
+
+
+
+    /**
+     * Release the resources of a batch object: the connections must be
+     * already detached or deleted
+     * @param batch IN/OUT batch object
+     */
+    void flom_conn_batch_free(flom_conn_batch_t *batch);
+
+
+
+    /**
+     * Flush the write buffers of all the connections of a batch; a
+     * connection that raises a send error is appended to the failed
+     * connections of the batch and it must be closed by the caller
+     * @param batch IN/OUT batch object
+     */
+    void flom_conn_batch_flush(flom_conn_batch_t *batch);
+
+
+
+    /**
+     * Send a lock answer without element using the protocol level of the
+     * connection: common answers are taken from the cache of
+     * pre-serialized answers (see @ref flom_msg_get_cached_answer), the
+     * others are built and serialized on the fly
+     * @param obj IN/OUT connection object
+     * @param verb IN answer verb
+     * @param step IN answer step
+     * @param rc IN answer rc
+     * @return a reason code
+     */
+    int flom_conn_send_answer(flom_conn_t *obj, int verb, int step, int rc);
+
+
+
+    /**
+     * Send a lock answer tagged with the id of a pipelined request; the
+     * answer is always built and serialized on the fly
+     * @param obj IN/OUT connection object
+     * @param verb IN answer verb
+     * @param step IN answer step
+     * @param rc IN answer rc
+     * @param rid IN request id (0 for an untagged answer)
+     * @param element IN locked element (NULL means "no element")
+     * @return a reason code
+     */
+    int flom_conn_send_tagged_answer(flom_conn_t *obj, int verb, int step,
+                                     int rc, int rid, const gchar *element);
+
+
+
     /**
      * Close a raw TCP/IP or TLS over TCP/IP connection
      * @param obj IN/OUT connection object
@@ -26,12 +26,18 @@
 #ifdef HAVE_NETINET_TCP_H
 # include <netinet/tcp.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 #ifdef HAVE_SYS_SOCKET_H
 # include <sys/socket.h>
 #endif
 #ifdef HAVE_SYS_TYPES_H
 # include <sys/types.h>
 #endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
 
 
 
@@ -50,6 +56,17 @@
 
 
 
+/**
+ * Last unique identifier generated by @ref flom_conns_get_new_uid
+ */
+static flom_uid_t flom_conns_last_uid = 0;
+/**
+ * Mutex used to serialize the generation of unique identifiers
+ */
+static GMutex flom_conns_uid_mutex;
+
+
+
 int flom_conns_check_n(flom_conns_t *conns)
 {
     /* this is a dirty hack because this struct is opaque and this operation
@@ -68,23 +85,152 @@ int flom_conns_check_n(flom_conns_t *conns)
 
 
 
+flom_uid_t flom_conns_get_new_uid(flom_conns_t *conns)
+{
+    flom_uid_t uid;
+    
+    g_mutex_lock(&flom_conns_uid_mutex);
+    uid = ++flom_conns_last_uid;
+    g_mutex_unlock(&flom_conns_uid_mutex);
+    conns->last_uid = uid;
+    return uid;
+}
+
+
+
+void flom_conns_epoll_disable(flom_conns_t *conns)
+{
+#ifdef FLOM_CONNS_EPOLL
+    if (FLOM_NULL_FD != conns->epoll_fd) {
+        FLOM_TRACE(("flom_conns_epoll_disable: closing epoll fd=%d, "
+                    "poll function will be used from now on\n",
+                    conns->epoll_fd));
+        close(conns->epoll_fd);
+        conns->epoll_fd = FLOM_NULL_FD;
+    }
+#endif
+}
+
+
+
+void flom_conns_epoll_add(flom_conns_t *conns, flom_conn_t *conn)
+{
+#ifdef FLOM_CONNS_EPOLL
+    struct epoll_event ev;
+    int fd = flom_tcp_get_sockfd(flom_conn_get_tcp(conn));
+    
+    if (FLOM_NULL_FD == conns->epoll_fd)
+        return;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    if (flom_conn_get_events(conn) & POLLOUT)
+        ev.events |= EPOLLOUT;
+    ev.data.ptr = conn;
+    if (0 != epoll_ctl(conns->epoll_fd, EPOLL_CTL_ADD, fd, &ev)) {
+        FLOM_TRACE(("flom_conns_epoll_add/epoll_ctl(EPOLL_CTL_ADD, %d): "
+                    "errno=%d '%s'\n", fd, errno, strerror(errno)));
+        flom_conns_epoll_disable(conns);
+    }
+#endif
+}
+
+
+
+void flom_conns_epoll_mod(flom_conns_t *conns, flom_conn_t *conn)
+{
+#ifdef FLOM_CONNS_EPOLL
+    struct epoll_event ev;
+    int fd = flom_tcp_get_sockfd(flom_conn_get_tcp(conn));
+    
+    if (FLOM_NULL_FD == conns->epoll_fd || FLOM_NULL_FD == fd)
+        return;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    if (flom_conn_get_events(conn) & POLLOUT)
+        ev.events |= EPOLLOUT;
+    ev.data.ptr = conn;
+    if (0 != epoll_ctl(conns->epoll_fd, EPOLL_CTL_MOD, fd, &ev)) {
+        FLOM_TRACE(("flom_conns_epoll_mod/epoll_ctl(EPOLL_CTL_MOD, %d): "
+                    "errno=%d '%s'\n", fd, errno, strerror(errno)));
+        flom_conns_epoll_disable(conns);
+    }
+#endif
+}
+
+
+
+void flom_conns_epoll_del(flom_conns_t *conns, flom_conn_t *conn)
+{
+#ifdef FLOM_CONNS_EPOLL
+    struct epoll_event ev;
+    int fd = flom_tcp_get_sockfd(flom_conn_get_tcp(conn));
+    
+    if (FLOM_NULL_FD == conns->epoll_fd || FLOM_NULL_FD == fd)
+        return;
+    /* kernels before 2.6.9 require a non NULL event */
+    memset(&ev, 0, sizeof(ev));
+    if (0 != epoll_ctl(conns->epoll_fd, EPOLL_CTL_DEL, fd, &ev)) {
+        FLOM_TRACE(("flom_conns_epoll_del/epoll_ctl(EPOLL_CTL_DEL, %d): "
+                    "errno=%d '%s'\n", fd, errno, strerror(errno)));
+    }
+#endif
+}
+
+
+
+flom_conn_t *flom_conns_remove_index(flom_conns_t *conns, guint id)
+{
+    flom_conn_t *c = (flom_conn_t *)g_ptr_array_remove_index_fast(
+        conns->array, id);
+    /* the last element has been moved in place of the removed one */
+    if (NULL != c && id < conns->array->len)
+        flom_conn_set_conns_pos(
+            (flom_conn_t *)g_ptr_array_index(conns->array, id), id);
+    return c;
+}
+
+
+
 void flom_conns_init(flom_conns_t *conns, int domain)
 {
     FLOM_TRACE(("flom_conns_init\n"));
     conns->poll_array = NULL;
+    conns->ready_array = NULL;
+    conns->ready_used = conns->ready_size = 0;
+#ifdef FLOM_CONNS_EPOLL
+    conns->epoll_array = NULL;
+    if (FLOM_NULL_FD == (conns->epoll_fd = epoll_create1(EPOLL_CLOEXEC))) {
+        FLOM_TRACE(("flom_conns_init/epoll_create1: errno=%d '%s', "
+                    "falling back to poll function\n",
+                    errno, strerror(errno)));
+    }
+    FLOM_TRACE(("flom_conns_init: epoll_fd=%d\n", conns->epoll_fd));
+#endif
     conns->domain = domain;
     conns->array = g_ptr_array_new();
     conns->last_uid = 0;
+    conns->incubator = g_hash_table_new_full(
+        g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_queue_free);
+    conns->incubated = 0;
     FLOM_TRACE(("flom_conns_init: allocated array:%p\n", conns->array));
 }
 
 
 
+void flom_conns_add_conn(flom_conns_t *conns, flom_conn_t *conn)
+{
+    flom_conn_set_conns_pos(conn, conns->array->len);
+    g_ptr_array_add(conns->array, conn);
+    flom_conns_epoll_add(conns, conn);
+}
+
+
+
 void flom_conns_import(flom_conns_t *conns, int fd, flom_conn_t *conn)
 {
     FLOM_TRACE(("flom_conns_import\n"));
     flom_conn_trace(conn);
-    g_ptr_array_add(conns->array, conn);
+    flom_conns_add_conn(conns, conn);
 }
     
 
@@ -130,7 +276,8 @@ int flom_conns_set_events(flom_conns_t *conns, short events)
             flom_conn_t *c =
                 (flom_conn_t *)g_ptr_array_index(conns->array, i);
             if (FLOM_NULL_FD != flom_tcp_get_sockfd(flom_conn_get_tcp(c)))
-                conns->poll_array[i].events = events;
+                conns->poll_array[i].events =
+                    events | flom_conn_get_events(c);
             else {
                 FLOM_TRACE(("flom_conns_set_events: i=%u, "
                             "conns->poll_array[i].fd=%d\n", i,
@@ -159,6 +306,136 @@ int flom_conns_set_events(flom_conns_t *conns, short events)
 
 
 
+int flom_conns_ready_reserve(flom_conns_t *conns)
+{
+    guint size = conns->array->len;
+    struct flom_conns_event_s *tmp;
+    
+    if (size <= conns->ready_size)
+        return TRUE;
+    /* avoid too many reallocations when the number of connections is
+       growing */
+    if (size < FLOM_CONNS_DEFAULT_ALLOCATION)
+        size = FLOM_CONNS_DEFAULT_ALLOCATION;
+    else
+        size += size * FLOM_CONNS_PERCENT_ALLOCATION / 100;
+    if (NULL == (tmp = (struct flom_conns_event_s *)realloc(
+                     conns->ready_array,
+                     (size_t)(size*sizeof(struct flom_conns_event_s)))))
+        return FALSE;
+    conns->ready_array = tmp;
+#ifdef FLOM_CONNS_EPOLL
+    {
+        struct epoll_event *tmp2;
+        if (NULL == (tmp2 = (struct epoll_event *)realloc(
+                         conns->epoll_array,
+                         (size_t)(size*sizeof(struct epoll_event)))))
+            return FALSE;
+        conns->epoll_array = tmp2;
+    }
+#endif
+    FLOM_TRACE(("flom_conns_ready_reserve: ready_size=%u->%u\n",
+                conns->ready_size, size));
+    conns->ready_size = size;
+    return TRUE;
+}
+
+
+
+int flom_conns_poll(flom_conns_t *conns, int timeout, int *ready_fd)
+{
+    enum Exception { MALLOC_ERROR
+                     , EPOLL_WAIT_ERROR
+                     , CONNS_GET_FDS_ERROR
+                     , CONNS_SET_EVENTS_ERROR
+                     , POLL_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_conns_poll\n"));
+    TRY {
+        guint i;
+        
+        conns->ready_used = 0;
+        *ready_fd = 0;
+        if (!flom_conns_ready_reserve(conns))
+            THROW(MALLOC_ERROR);
+#ifdef FLOM_CONNS_EPOLL
+        if (FLOM_NULL_FD != conns->epoll_fd) {
+            int n;
+            FLOM_TRACE(("flom_conns_poll: calling epoll_wait(%d, ..., %u, "
+                        "%d)\n", conns->epoll_fd, conns->array->len,
+                        timeout));
+            if (0 > (n = epoll_wait(conns->epoll_fd, conns->epoll_array,
+                                    (int)conns->ready_size, timeout)))
+                THROW(EPOLL_WAIT_ERROR);
+            for (i=0; i<(guint)n; ++i) {
+                flom_conn_t *c = (flom_conn_t *)conns->epoll_array[i].data.ptr;
+                uint32_t events = conns->epoll_array[i].events;
+                short revents = 0;
+                if (events & EPOLLIN)
+                    revents |= POLLIN;
+                if (events & EPOLLOUT)
+                    revents |= POLLOUT;
+                if (events & EPOLLERR)
+                    revents |= POLLERR;
+                if (events & EPOLLHUP)
+                    revents |= POLLHUP;
+                conns->ready_array[i].id = flom_conn_get_conns_pos(c);
+                conns->ready_array[i].revents = revents;
+            } /* for (i=0; i<n; ++i) */
+            conns->ready_used = *ready_fd = n;
+            THROW(NONE);
+        } /* if (FLOM_NULL_FD != conns->epoll_fd) */
+#endif
+        /* poll fallback: the array must be rebuilt at every call */
+        if (NULL == flom_conns_get_fds(conns))
+            THROW(CONNS_GET_FDS_ERROR);
+        if (FLOM_RC_OK != (ret_cod = flom_conns_set_events(conns, POLLIN)))
+            THROW(CONNS_SET_EVENTS_ERROR);
+        if (0 > (*ready_fd = poll(conns->poll_array, conns->array->len,
+                                  timeout)))
+            THROW(POLL_ERROR);
+        for (i=0; i<conns->array->len && conns->ready_used<*ready_fd; ++i) {
+            if (0 != conns->poll_array[i].revents) {
+                conns->ready_array[conns->ready_used].id = i;
+                conns->ready_array[conns->ready_used].revents =
+                    conns->poll_array[i].revents;
+                conns->ready_used++;
+            }
+        } /* for (i=0; ... */
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case MALLOC_ERROR:
+                ret_cod = FLOM_RC_MALLOC_ERROR;
+                break;
+            case EPOLL_WAIT_ERROR:
+                ret_cod = FLOM_RC_EPOLL_WAIT_ERROR;
+                break;
+            case CONNS_GET_FDS_ERROR:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
+            case CONNS_SET_EVENTS_ERROR:
+                break;
+            case POLL_ERROR:
+                ret_cod = FLOM_RC_POLL_ERROR;
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_conns_poll/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
 int flom_conns_close_fd(flom_conns_t *conns, guint id)
 {
     enum Exception { OUT_OF_RANGE
@@ -176,6 +453,9 @@ int flom_conns_close_fd(flom_conns_t *conns, guint id)
         if (NULL == (c = (flom_conn_t *)
                      g_ptr_array_index(conns->array, id)))
             THROW(NULL_OBJECT);
+        /* the file descriptor must be unregistered before close */
+        if (FLOM_CONN_STATE_REMOVE != flom_conn_get_state(c))
+            flom_conns_epoll_del(conns, c);
         if (FLOM_RC_OK != (ret_cod = flom_conn_terminate(c)))
             THROW(CONN_TERMINATE_ERROR);
         
@@ -221,9 +501,13 @@ int flom_conns_trns_fd(flom_conns_t *conns, guint id)
         /* update connection state */
         c = (flom_conn_t *)g_ptr_array_index(conns->array, id);
         flom_conn_set_state(c, FLOM_CONN_STATE_LOCKER);
+        /* a transferred connection is not waiting anymore */
+        flom_conns_unincubate(conns, c);
+        /* the file descriptor will be monitored by another thread */
+        flom_conns_epoll_del(conns, c);
         /* detach the connection from this connections object (it
            will be attached by a locker connections object */
-        if (NULL == g_ptr_array_remove_index_fast(conns->array, id)) {
+        if (NULL == flom_conns_remove_index(conns, id)) {
             THROW(G_PTR_ARRAY_REMOVE_INDEX_FAST_ERROR);
         }
         
@@ -250,6 +534,81 @@ int flom_conns_trns_fd(flom_conns_t *conns, guint id)
 
 
 
+void flom_conns_incubate(flom_conns_t *conns, flom_conn_t *conn,
+                         const gchar *key)
+{
+    GQueue *queue;
+
+    /* a connection can wait only one resource */
+    flom_conns_unincubate(conns, conn);
+    if (NULL == (queue = g_hash_table_lookup(conns->incubator, key))) {
+        queue = g_queue_new();
+        g_hash_table_insert(conns->incubator, g_strdup(key), queue);
+    }
+    g_queue_push_tail(queue, conn);
+    conn->incubator_key = g_strdup(key);
+    flom_conn_set_wait(conn, TRUE);
+    conns->incubated++;
+    FLOM_TRACE(("flom_conns_incubate: conn=%p, key='%s', waiting for the "
+                "same resource=%u, incubated=%u\n", conn, key,
+                g_queue_get_length(queue), conns->incubated));
+}
+
+
+
+void flom_conns_unincubate(flom_conns_t *conns, flom_conn_t *conn)
+{
+    GQueue *queue;
+
+    if (NULL == conn->incubator_key)
+        return;
+    if (NULL != (queue = g_hash_table_lookup(
+                     conns->incubator, conn->incubator_key)) &&
+        g_queue_remove(queue, conn)) {
+        conns->incubated--;
+        if (g_queue_is_empty(queue))
+            g_hash_table_remove(conns->incubator, conn->incubator_key);
+    }
+    FLOM_TRACE(("flom_conns_unincubate: conn=%p, key='%s', "
+                "incubated=%u\n", conn, conn->incubator_key,
+                conns->incubated));
+    g_free(conn->incubator_key);
+    conn->incubator_key = NULL;
+    flom_conn_set_wait(conn, FALSE);
+}
+
+
+
+GQueue *flom_conns_incubator_take(flom_conns_t *conns, const gchar *key)
+{
+    gpointer orig_key = NULL;
+    gpointer value = NULL;
+    GQueue *queue;
+    GList *l;
+
+    if (!g_hash_table_lookup_extended(conns->incubator, key,
+                                      &orig_key, &value))
+        return NULL;
+    /* the queue is detached from the incubator and it's passed to the
+       caller */
+    g_hash_table_steal(conns->incubator, key);
+    g_free(orig_key);
+    queue = (GQueue *)value;
+    for (l=queue->head; NULL != l; l=l->next) {
+        flom_conn_t *conn = (flom_conn_t *)l->data;
+        g_free(conn->incubator_key);
+        conn->incubator_key = NULL;
+        flom_conn_set_wait(conn, FALSE);
+    }
+    conns->incubated -= g_queue_get_length(queue);
+    FLOM_TRACE(("flom_conns_incubator_take: key='%s', taken=%u, "
+                "incubated=%u\n", key, g_queue_get_length(queue),
+                conns->incubated));
+    return queue;
+}
+
+
+
 int flom_conns_clean(flom_conns_t *conns)
 {
     enum Exception { G_PTR_ARRAY_REMOVE_INDEX_FAST_ERROR
@@ -273,10 +632,10 @@ int flom_conns_clean(flom_conns_t *conns)
                 /* connections with this state are no more valid and must be
                    removed and destroyed */
                 /* removing message object */
-                /* removing parser object */
-                flom_conn_free_parser(c);
+                /* removing from incubator */
+                flom_conns_unincubate(conns, c);
                 /* removing from array */
-                if (NULL == g_ptr_array_remove_index_fast(conns->array, i)) {
+                if (NULL == flom_conns_remove_index(conns, i)) {
                     THROW(G_PTR_ARRAY_REMOVE_INDEX_FAST_ERROR);
                 }
                 /* release connection */
@@ -318,6 +677,20 @@ void flom_conns_free(flom_conns_t *conns)
         free(conns->poll_array);
         conns->poll_array = NULL;
     }
+    if (NULL != conns->ready_array) {
+        FLOM_TRACE(("flom_conns_free: releasing ready_array:%p\n",
+                    conns->ready_array));
+        free(conns->ready_array);
+        conns->ready_array = NULL;
+    }
+    conns->ready_used = conns->ready_size = 0;
+#ifdef FLOM_CONNS_EPOLL
+    if (NULL != conns->epoll_array) {
+        free(conns->epoll_array);
+        conns->epoll_array = NULL;
+    }
+    flom_conns_epoll_disable(conns);
+#endif
     assert(flom_conns_check_n(conns));
     if (NULL != conns->array) {
         FLOM_TRACE(("flom_conns_free: releasing array:%p\n",
@@ -325,6 +698,11 @@ void flom_conns_free(flom_conns_t *conns)
         g_ptr_array_free(conns->array, TRUE);
         conns->array = NULL;
     }
+    if (NULL != conns->incubator) {
+        g_hash_table_destroy(conns->incubator);
+        conns->incubator = NULL;
+        conns->incubated = 0;
+    }
     FLOM_TRACE(("flom_conns_free: completed\n"));
 }
 
@@ -334,7 +712,10 @@ void flom_conns_trace(const flom_conns_t *conns)
 {
     FLOM_TRACE(("flom_conns_trace: object=%p\n", conns));
     FLOM_TRACE(("flom_conns_trace: domain=%d, len=%u, array=%p, "
-                "poll_array=%p\n",
+                "poll_array=%p, ready_used=%u, ready_size=%u\n",
                 conns->domain, conns->array->len, conns->array,
-                conns->poll_array));
+                conns->poll_array, conns->ready_used, conns->ready_size));
+#ifdef FLOM_CONNS_EPOLL
+    FLOM_TRACE(("flom_conns_trace: epoll_fd=%d\n", conns->epoll_fd));
+#endif
 }
@@ -34,6 +34,9 @@
 #ifdef HAVE_POLL_H
 # include <poll.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 #ifdef HAVE_SYS_SOCKET_H
 # include <sys/socket.h>
 #endif
@@ -76,6 +79,33 @@
 
 
 
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE1)
+/**
+ * epoll backend is available: it's used instead of poll unless it was
+ * disabled at configure time (--disable-epoll)
+ */
+# define FLOM_CONNS_EPOLL
+#endif
+
+
+
+/**
+ * A ready connection as returned by @ref flom_conns_poll
+ */
+struct flom_conns_event_s {
+    /**
+     * Identificator (position in array) of the ready connection
+     */
+    guint          id;
+    /**
+     * Returned events, expressed with poll flags (POLLIN, POLLERR, POLLHUP,
+     * POLLNVAL) even when epoll is in use
+     */
+    short          revents;
+};
+
+
+
 /**
  * A structured object used to register connections
  */
@@ -85,6 +115,31 @@ struct flom_conns_s {
      * function)
      */
     struct pollfd *poll_array;
+    /**
+     * Array of the connections returned ready by the last call of
+     * @ref flom_conns_poll
+     */
+    struct flom_conns_event_s *ready_array;
+    /**
+     * Number of valid elements inside ready_array
+     */
+    guint          ready_used;
+    /**
+     * Number of allocated elements for ready_array (and epoll_array)
+     */
+    guint          ready_size;
+#ifdef FLOM_CONNS_EPOLL
+    /**
+     * epoll file descriptor: every connection is registered only once,
+     * when it's added to the object; @ref FLOM_NULL_FD means the object
+     * fell back to poll function
+     */
+    int            epoll_fd;
+    /**
+     * Array used for epoll_wait function
+     */
+    struct epoll_event *epoll_array;
+#endif
     /**
      * Connection domain as specified when calling socket function
      */
@@ -99,6 +154,16 @@ struct flom_conns_s {
      * any type of objects, for example the lockers
      */
     flom_uid_t       last_uid;
+    /**
+     * Incubator of the connections waiting for resource creation: the key
+     * is the normalized resource name (see @ref flom_rsrc_get_key), the
+     * value is a GQueue of @ref flom_conn_t
+     */
+    GHashTable      *incubator;
+    /**
+     * Number of connections inside the incubator
+     */
+    guint            incubated;
 };
     
 
@@ -133,15 +198,64 @@ extern "C" {
 
 
 
+    /**
+     * Stop using epoll for a connections object: the object falls back to poll
+     * function that does not require any registration
+     * @param conns IN/OUT connections object
+     */
+    void flom_conns_epoll_disable(flom_conns_t *conns);
+
+
+
+    /**
+     * Register the file descriptor of a connection in the epoll set (if epoll
+     * is in use)
+     * @param conns IN/OUT connections object
+     * @param conn IN connection to register
+     */
+    void flom_conns_epoll_add(flom_conns_t *conns, flom_conn_t *conn);
+
+
+
+    /**
+     * Update the events registered in the epoll set for a connection (if
+     * epoll is in use) after they have been changed with
+     * @ref flom_conn_set_events
+     * @param conns IN/OUT connections object
+     * @param conn IN connection to update
+     */
+    void flom_conns_epoll_mod(flom_conns_t *conns, flom_conn_t *conn);
+
+
+
+    /**
+     * Unregister the file descriptor of a connection from the epoll set (if
+     * epoll is in use); it must be called before the file descriptor is closed
+     * or passed to another thread
+     * @param conns IN/OUT connections object
+     * @param conn IN connection to unregister
+     */
+    void flom_conns_epoll_del(flom_conns_t *conns, flom_conn_t *conn);
+
+
+
+    /**
+     * Remove a connection from the array keeping up to date the position of
+     * the connection moved in its place
+     * @param conns IN/OUT connections object
+     * @param id IN position of the connection to remove
+     * @return the removed connection or NULL
+     */
+    flom_conn_t *flom_conns_remove_index(flom_conns_t *conns, guint id);
+
+
+
     /**
      * Add a new connection to the pool
      * @param conns IN/OUT connection pool object
      * @param conn IN connection object to add
      */
-    static inline void flom_conns_add_conn(
-        flom_conns_t *conns, flom_conn_t *conn) {
-        g_ptr_array_add(conns->array, conn);
-    }
+    void flom_conns_add_conn(flom_conns_t *conns, flom_conn_t *conn);
 
 
     
@@ -207,13 +321,13 @@ extern "C" {
 
 
     /**
-     * Generate a new unique id
+     * Generate a new unique id; the ids are unique inside the process
+     * because the daemon can use many connections objects (one for every
+     * acceptor thread) and the ids are used by the VFS too
      * @param conns IN/OUT connections object
      * @return last generated unique id
      */
-    static inline flom_uid_t flom_conns_get_new_uid(flom_conns_t *conns) {
-        return ++(conns->last_uid);
-    }
+    flom_uid_t flom_conns_get_new_uid(flom_conns_t *conns);
 
     
     
@@ -298,12 +412,12 @@ extern "C" {
 
 
     /**
-     * Return the GMarkupParseContext associated to a connection
+     * Return the XML parser associated to a connection
      * @param conns IN connections object
      * @param id IN identificator (position in array) of the connection
-     * @return the associated GMarkupParseContext or NULL if any error happens
+     * @return the associated XML parser or NULL if any error happens
      */
-    static inline GMarkupParseContext *flom_conns_get_parser(
+    static inline flom_msg_parser_t *flom_conns_get_parser(
         flom_conns_t *conns, guint id) {
         if (id < conns->array->len)
             return flom_conn_get_parser(
@@ -315,7 +429,72 @@ extern "C" {
 
 
     /**
-     * Set events field for every connection in the object
+     * Reserve enough room in ready_array (and epoll_array) for all the
+     * connections managed by the object; memory is reallocated only when the
+     * number of connections grows beyond the previous size
+     * @param conns IN/OUT connections object
+     * @return a boolean value: TRUE OK, FALSE memory allocation error
+     */
+    int flom_conns_ready_reserve(flom_conns_t *conns);
+
+
+
+    /**
+     * Wait for incoming events (POLLIN) on all the connections of the object
+     * and prepare the list of the ready ones; it uses epoll if available,
+     * poll otherwise. The ids of the ready connections remain valid until
+     * the next call of @ref flom_conns_clean or @ref flom_conns_trns_fd
+     * @param conns IN/OUT connections object
+     * @param timeout IN timeout in milliseconds (-1 = infinite)
+     * @param ready_fd OUT number of ready connections (0 if timeout
+     *        expired)
+     * @return a reason code
+     */
+    int flom_conns_poll(flom_conns_t *conns, int timeout, int *ready_fd);
+
+
+    
+    /**
+     * Number of ready connections returned by last @ref flom_conns_poll
+     * @param conns IN connections object
+     * @return the number of ready connections
+     */
+    static inline guint flom_conns_get_ready(const flom_conns_t *conns) {
+        return conns->ready_used;
+    }
+
+
+
+    /**
+     * Return the id of a ready connection
+     * @param conns IN connections object
+     * @param i IN position inside the list of ready connections
+     * @return the identificator (position in array) of the connection
+     */
+    static inline guint flom_conns_get_ready_id(
+        const flom_conns_t *conns, guint i) {
+        return conns->ready_array[i].id;
+    }
+
+
+
+    /**
+     * Return the events occurred on a ready connection
+     * @param conns IN connections object
+     * @param i IN position inside the list of ready connections
+     * @return the events (POLLIN, POLLERR, POLLHUP, POLLNVAL)
+     */
+    static inline short flom_conns_get_ready_revents(
+        const flom_conns_t *conns, guint i) {
+        return conns->ready_array[i].revents;
+    }
+
+
+    
+    /**
+     * Set events field for every connection in the object; the events
+     * requested by a single connection (see @ref flom_conn_get_events) are
+     * added to the passed ones
      * NOTE: it must be called after @ref flom_conns_get_fds because it
      *       resize the poll array if necessary
      * @param conns IN/OUT connections object
@@ -347,6 +526,52 @@ extern "C" {
      */
     int flom_conns_trns_fd(flom_conns_t *conns, guint id);
 
+
+
+    /**
+     * Put a connection inside the incubator: the connection waits the
+     * creation of the resource associated to key
+     * @param conns IN/OUT connections object
+     * @param conn IN/OUT connection waiting for resource creation
+     * @param key IN normalized resource name (see @ref flom_rsrc_get_key)
+     */
+    void flom_conns_incubate(flom_conns_t *conns, flom_conn_t *conn,
+                             const gchar *key);
+
+
+
+    /**
+     * Remove a connection from the incubator; nothing is done if the
+     * connection is not waiting for resource creation
+     * @param conns IN/OUT connections object
+     * @param conn IN/OUT connection
+     */
+    void flom_conns_unincubate(flom_conns_t *conns, flom_conn_t *conn);
+
+
+
+    /**
+     * Remove from the incubator all the connections waiting for the
+     * creation of a resource
+     * @param conns IN/OUT connections object
+     * @param key IN normalized resource name (see @ref flom_rsrc_get_key)
+     * @return a queue of @ref flom_conn_t that must be released by the
+     *         caller with g_queue_free or NULL if no connection is waiting
+     *         for the resource
+     */
+    GQueue *flom_conns_incubator_take(flom_conns_t *conns, const gchar *key);
+
+
+
+    /**
+     * Number of connections inside the incubator
+     * @param conns IN connections object
+     * @return the number of connections waiting for resource creation
+     */
+    static inline guint flom_conns_get_incubated(const flom_conns_t *conns) {
+        return conns->incubated;
+    }
+
     
 
     /**
@@ -20,6 +20,10 @@
 
 
 
+#ifdef HAVE_ACCEPT4
+/* accept4 is not POSIX standard and needs GNU extensions... */
+# define _GNU_SOURCE
+#endif
 #include <stdio.h>
 #ifdef HAVE_ARPA_INET_H
 # include <arpa/inet.h>
@@ -71,8 +75,10 @@
 #include "flom_daemon_mngmnt.h"
 #include "flom_errors.h"
 #include "flom_locker.h"
+#include "flom_mlock.h"
 #include "flom_msg.h"
 #include "flom_tcp.h"
+#include "flom_timer.h"
 #include "flom_vfs.h"
 #include "flom_syslog.h"
 
@@ -388,6 +394,7 @@ int flom_listen_local(flom_config_t *config, flom_conns_t *conns)
                      , LISTEN_ERROR
                      , NEW_OBJ
                      , CONN_INIT_ERROR
+                     , TCP_SET_NONBLOCKING_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
 
@@ -454,6 +461,10 @@ int flom_listen_local(flom_config_t *config, flom_conns_t *conns)
                                fd, SOCK_STREAM, sizeof(servaddr),
                                (struct sockaddr *)&servaddr, TRUE)))
             THROW(CONN_INIT_ERROR);
+        /* the backlog is drained until accept returns EAGAIN */
+        if (FLOM_RC_OK != (ret_cod = flom_tcp_set_nonblocking(
+                               flom_conn_get_tcp(conn), TRUE)))
+            THROW(TCP_SET_NONBLOCKING_ERROR);
         /* add connection */
         flom_conns_add_conn(conns, conn);
         conn = NULL; /* avoid connection delete from this function */
@@ -488,6 +499,7 @@ int flom_listen_local(flom_config_t *config, flom_conns_t *conns)
                 ret_cod = FLOM_RC_NEW_OBJ;
                 break;
             case CONN_INIT_ERROR:
+            case TCP_SET_NONBLOCKING_ERROR:
                 break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
@@ -531,6 +543,7 @@ int flom_listen_tcp_configured(flom_config_t *config, flom_conns_t *conns)
     enum Exception { LISTEN_ERROR
                      , NEW_OBJ
                      , CONN_INIT_ERROR
+                     , TCP_SET_NONBLOCKING_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     
@@ -558,6 +571,10 @@ int flom_listen_tcp_configured(flom_config_t *config, flom_conns_t *conns)
                                SOCK_STREAM, flom_tcp_get_addrlen(&tcp),
                                flom_tcp_get_sa(&tcp), TRUE)))
             THROW(CONN_INIT_ERROR);
+        /* the backlog is drained until accept returns EAGAIN */
+        if (FLOM_RC_OK != (ret_cod = flom_tcp_set_nonblocking(
+                               flom_conn_get_tcp(conn), TRUE)))
+            THROW(TCP_SET_NONBLOCKING_ERROR);
         /* add connection */
         flom_conns_add_conn(conns, conn);
         conn = NULL; /* avoid connection delete from this function */
@@ -571,6 +588,7 @@ int flom_listen_tcp_configured(flom_config_t *config, flom_conns_t *conns)
                 ret_cod = FLOM_RC_NEW_OBJ;
                 break;
             case CONN_INIT_ERROR:
+            case TCP_SET_NONBLOCKING_ERROR:
                 break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
@@ -600,6 +618,7 @@ int flom_listen_tcp_automatic(flom_config_t *config, flom_conns_t *conns)
                      , INVALID_AI_FAMILY2
                      , NEW_OBJ
                      , CONN_INIT_ERROR
+                     , TCP_SET_NONBLOCKING_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     int fd = FLOM_NULL_FD;
@@ -621,6 +640,14 @@ int flom_listen_tcp_automatic(flom_config_t *config, flom_conns_t *conns)
         if (-1 == setsockopt(fd, SOL_SOCKET, SO_REUSEADDR,
                              (void *)&sock_opt, sizeof(sock_opt)))
             THROW(SETSOCKOPT_ERROR);
+#ifdef SO_REUSEPORT
+        /* the sockets of the other acceptor threads will be bound to the
+           same ephemeral port */
+        if (1 < flom_config_get_acceptor_threads(config) &&
+            -1 == setsockopt(fd, SOL_SOCKET, SO_REUSEPORT,
+                             (void *)&sock_opt, sizeof(sock_opt)))
+            THROW(SETSOCKOPT_ERROR);
+#endif /* SO_REUSEPORT */
         /* binding local address, ephemeral port */
         switch (family) {
             case AF_INET:
@@ -696,6 +723,10 @@ int flom_listen_tcp_automatic(flom_config_t *config, flom_conns_t *conns)
                                fd, SOCK_STREAM, addrlen,
                                (struct sockaddr *)&addr, TRUE)))
             THROW(CONN_INIT_ERROR);
+        /* the backlog is drained until accept returns EAGAIN */
+        if (FLOM_RC_OK != (ret_cod = flom_tcp_set_nonblocking(
+                               flom_conn_get_tcp(conn), TRUE)))
+            THROW(TCP_SET_NONBLOCKING_ERROR);
         /* add connection */
         flom_conns_add_conn(conns, conn);
         conn = NULL; /* avoid connection delete from this function */
@@ -729,6 +760,7 @@ int flom_listen_tcp_automatic(flom_config_t *config, flom_conns_t *conns)
                 ret_cod = FLOM_RC_NEW_OBJ;
                 break;
             case CONN_INIT_ERROR:
+            case TCP_SET_NONBLOCKING_ERROR:
                 break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
@@ -987,6 +1019,7 @@ int flom_listen_clean(flom_config_t *config, flom_conns_t *conns)
     FLOM_TRACE(("flom_listen_clean\n"));
     TRY {
         int domain = flom_conns_get_domain(conns);
+        flom_mlock_free_all(conns);
         flom_conns_free(conns);
         if (AF_LOCAL == domain &&
             -1 == unlink(flom_config_get_socket_name(config))) {
@@ -1011,19 +1044,16 @@ int flom_listen_clean(flom_config_t *config, flom_conns_t *conns)
 
 int flom_accept_loop(flom_config_t *config, flom_conns_t *conns)
 {
-    enum Exception { VFS_RAM_TREE_INIT_ERROR
+    enum Exception { LOCKER_ARRAY_START_WORKERS_ERROR
+                     , VFS_RAM_TREE_INIT_ERROR
                      , G_THREAD_NEW_ERROR
+                     , ACCEPT_LOOP_START_ACCEPTORS_ERROR
                      , CONNS_CLEAN_ERROR
-                     , CONNS_GET_FDS_ERROR
-                     , CONNS_SET_EVENTS_ERROR
-                     , POLL_ERROR
+                     , CONNS_POLL_ERROR
+                     , ACCEPT_LOOP_INCUBATOR_CHECK_ERROR
                      , ACCEPT_LOOP_CHKLOCKERS_ERROR1
                      , NEGATIVE_NUMBER_OF_LOCKERS_ERROR1
-                     , CONNS_CLOSE_ERROR1
-                     , CONNS_CLOSE_ERROR2
-                     , ACCEPT_LOOP_POLLIN_ERROR
-                     , NETWORK_ERROR
-                     , INTERNAL_ERROR
+                     , ACCEPT_LOOP_SCAN_ERROR
                      , ACCEPT_LOOP_CHKLOCKERS_ERROR2
                      , NEGATIVE_NUMBER_OF_LOCKERS_ERROR2
                      , NONE } excp;
@@ -1031,13 +1061,31 @@ int flom_accept_loop(flom_config_t *config, flom_conns_t *conns)
     flom_locker_array_t lockers;
     int activate_vfs = flom_config_get_mount_point_vfs(config) != NULL;
     GThread *vfs_thread = NULL;
+    flom_acceptor_t *acceptors = NULL;
+    guint acceptor_number = 0;
+    flom_tls_stats_t tls_stats;
     
     FLOM_TRACE(("flom_accept_loop\n"));
     TRY {
         int loop = TRUE;
         int chklockers_again = FALSE;
+        guint locker_threads = flom_config_get_locker_threads(config);
+        guint acceptor_threads = flom_config_get_acceptor_threads(config);
+        gint generation = 0;
+        guint64 idle_start;
     
         flom_locker_array_init(&lockers);
+        /* start the pool of threads that will host the lockers */
+        if (0 == locker_threads) {
+            long online_processors = sysconf(_SC_NPROCESSORS_ONLN);
+            locker_threads = 0 < online_processors ?
+                (guint)online_processors : 1;
+        }
+        FLOM_TRACE(("flom_accept_loop: starting %u locker threads...\n",
+                    locker_threads));
+        if (FLOM_RC_OK != (ret_cod = flom_locker_array_start_workers(
+                               &lockers, locker_threads)))
+            THROW(LOCKER_ARRAY_START_WORKERS_ERROR);
 
         /* initialize the RAM representation of the VFS */
         ret_cod = flom_vfs_ram_tree_init(activate_vfs);
@@ -1054,13 +1102,33 @@ int flom_accept_loop(flom_config_t *config, flom_conns_t *conns)
                                  config))))
                 THROW(G_THREAD_NEW_ERROR);
         }
+
+        /* additional acceptor threads can be used only by TCP/IP daemons:
+           every thread needs its own socket bound to the same address */
+#ifdef SO_REUSEPORT
+        if (AF_LOCAL == flom_conns_get_domain(conns))
+            acceptor_threads = 1;
+#else
+        acceptor_threads = 1;
+#endif /* SO_REUSEPORT */
+        if (1 < acceptor_threads) {
+            FLOM_TRACE(("flom_accept_loop: starting %u additional acceptor "
+                        "threads...\n", acceptor_threads - 1));
+            if (FLOM_RC_OK != (ret_cod = flom_accept_loop_start_acceptors(
+                                   config, flom_conns_get_domain(conns),
+                                   &lockers, acceptor_threads - 1,
+                                   &acceptors)))
+                THROW(ACCEPT_LOOP_START_ACCEPTORS_ERROR);
+            acceptor_number = acceptor_threads - 1;
+            syslog(LOG_INFO, FLOM_SYSLOG_FLM027I, acceptor_threads);
+        }
         
+        idle_start = flom_timer_get_ticks();
         while (loop) {
             int ready_fd;
-            guint i, n;
-            struct pollfd *fds;
             guint number_of_lockers;
             int poll_timeout = flom_config_get_lifespan(config);
+            int wait_timeout;
 
             /* the completion needs three polling cycles, so timeout must
                be a third of estimated lifespan */
@@ -1068,36 +1136,54 @@ int flom_accept_loop(flom_config_t *config, flom_conns_t *conns)
                 poll_timeout = 0;
             else if (3 < poll_timeout)
                 poll_timeout /= 3;
+            /* the state of the additional acceptor threads must be
+               periodically checked */
+            wait_timeout = poll_timeout;
+            if (0 < acceptor_number &&
+                (0 > wait_timeout || FLOM_ACCEPTOR_POLL_TIMEOUT < wait_timeout))
+                wait_timeout = FLOM_ACCEPTOR_POLL_TIMEOUT;
             
             if (FLOM_RC_OK != (ret_cod = flom_conns_clean(conns)))
                 THROW(CONNS_CLEAN_ERROR);
-            if (NULL == (fds = flom_conns_get_fds(conns)))
-                THROW(CONNS_GET_FDS_ERROR);
-            if (FLOM_RC_OK != (ret_cod = flom_conns_set_events(conns, POLLIN)))
-                THROW(CONNS_SET_EVENTS_ERROR);
             FLOM_TRACE(("flom_accept_loop: entering poll...\n"));
-            ready_fd = poll(fds, flom_conns_get_used(conns), poll_timeout);
+            if (FLOM_RC_OK != (ret_cod = flom_conns_poll(
+                                   conns, wait_timeout, &ready_fd)))
+                THROW(CONNS_POLL_ERROR);
             FLOM_TRACE(("flom_accept_loop: ready_fd=%d\n", ready_fd));
-            /* error on poll function */
-            if (0 > ready_fd) {
-                THROW(POLL_ERROR);
-            }
+            /* a locker created by another acceptor thread could serve
+               some connections waiting inside the incubator */
+            if (0 < acceptor_number &&
+                FLOM_RC_OK != (ret_cod = flom_accept_loop_incubator_check(
+                                   conns, &lockers, &generation)))
+                THROW(ACCEPT_LOOP_INCUBATOR_CHECK_ERROR);
             /* poll exited due to time out */
             if (0 == ready_fd) {
                 chklockers_again = FALSE;
+                flom_locker_array_lock(&lockers);
                 number_of_lockers = flom_locker_array_count(&lockers);
+                flom_locker_array_unlock(&lockers);
                 FLOM_TRACE(("flom_accept_loop: idle time exceeded %d "
                             "milliseconds, number of lockers=%u\n",
-                            poll_timeout, number_of_lockers));
+                            wait_timeout, number_of_lockers));
                 if (0 == number_of_lockers && 0 < poll_timeout) {
-                    if (1 == flom_conns_get_used(conns) ||
-                        (2 == flom_conns_get_used(conns) &&
-                         SOCK_DGRAM == flom_conns_get_type(conns, 1))) {
-                        FLOM_TRACE(("flom_accept_loop: only listener "
-                                    "connection is active, exiting...\n"));
-                        loop = FALSE;
-                    }
+                    if ((1 == flom_conns_get_used(conns) ||
+                         (2 == flom_conns_get_used(conns) &&
+                          SOCK_DGRAM == flom_conns_get_type(conns, 1))) &&
+                        0 == flom_accept_loop_acceptors_active(
+                            acceptors, acceptor_number)) {
+                        /* the whole idle time must be elapsed */
+                        if (wait_timeout == poll_timeout ||
+                            flom_timer_get_ticks() - idle_start >=
+                            (guint64)poll_timeout) {
+                            FLOM_TRACE(("flom_accept_loop: only listener "
+                                        "connection is active, "
+                                        "exiting...\n"));
+                            loop = FALSE;
+                        }
+                    } else
+                        idle_start = flom_timer_get_ticks();
                 } else if (0 < number_of_lockers) {
+                    idle_start = flom_timer_get_ticks();
                     if (FLOM_RC_OK != (ret_cod =
                                        flom_accept_loop_chklockers(
                                            &lockers, &chklockers_again)))
@@ -1107,52 +1193,15 @@ int flom_accept_loop(flom_config_t *config, flom_conns_t *conns)
                 }
                 continue;
             }
-            /* scanning file descriptors */
-            n = flom_conns_get_used(conns);
-            for (i=0; i<n; ++i) {
-                FLOM_TRACE(("flom_accept_loop: i=%u, fd=%d, POLLIN=%d, "
-                            "POLLERR=%d, POLLHUP=%d, POLLNVAL=%d\n", i,
-                            fds[i].fd,
-                            fds[i].revents & POLLIN,
-                            fds[i].revents & POLLERR,
-                            fds[i].revents & POLLHUP,
-                            fds[i].revents & POLLNVAL));
-                if ((fds[i].revents & POLLHUP) && (0 != i)) {
-                    FLOM_TRACE(("flom_accept_loop: client %u disconnected "
-                                "before categorization!\n", i));
-                    if (FLOM_RC_OK != (ret_cod = flom_conns_close_fd(
-                                           conns, i)))
-                        THROW(CONNS_CLOSE_ERROR1);
-                    /* this file descriptor is no more valid, continue to
-                       next one */
-                    continue;
-                }
-                if (fds[i].revents & POLLIN) {
-                    int conn_moved = FALSE;
-                    ret_cod = flom_accept_loop_pollin(
-                        config, conns, i, &lockers, &conn_moved);
-                    if (FLOM_RC_CONNECTION_CLOSED == ret_cod) {
-                        FLOM_TRACE(("flom_accept_loop: peer closed the "
-                                    "connection, terminating it...\n"));
-                        if (FLOM_RC_OK != (ret_cod = flom_conns_close_fd(
-                                               conns, i)))
-                            THROW(CONNS_CLOSE_ERROR2);
-                        /* this file descriptor is no more valid, continue to
-                           next one */
-                        continue;
-                    } else if (FLOM_RC_OK != ret_cod)
-                        THROW(ACCEPT_LOOP_POLLIN_ERROR);
-                    if (conn_moved)
-                        /* connection is no more available for main thread,
-                           a new main loop must be started */
-                        break;
-                }
-                if (fds[i].revents &
-                    (POLLERR | POLLHUP | POLLNVAL))
-                    THROW(NETWORK_ERROR);
-            } /* for (i... */
+            idle_start = flom_timer_get_ticks();
+            /* scanning ready file descriptors */
+            if (FLOM_RC_OK != (ret_cod = flom_accept_loop_scan(
+                                   config, conns, &lockers)))
+                THROW(ACCEPT_LOOP_SCAN_ERROR);
             /* check if any locker is ready for termination... */
+            flom_locker_array_lock(&lockers);
             number_of_lockers = flom_locker_array_count(&lockers);
+            flom_locker_array_unlock(&lockers);
             FLOM_TRACE(("flom_accept_loop: number of lockers=%u\n",
                         number_of_lockers));
             if (0 < number_of_lockers) {
@@ -1167,35 +1216,23 @@ int flom_accept_loop(flom_config_t *config, flom_conns_t *conns)
         THROW(NONE);
     } CATCH {
         switch (excp) {
+            case LOCKER_ARRAY_START_WORKERS_ERROR:
             case VFS_RAM_TREE_INIT_ERROR:
                 break;
             case G_THREAD_NEW_ERROR:
                 ret_cod = FLOM_RC_G_THREAD_NEW_ERROR;
                 break;
+            case ACCEPT_LOOP_START_ACCEPTORS_ERROR:
             case CONNS_CLEAN_ERROR:
-                break;
-            case CONNS_GET_FDS_ERROR:
-                ret_cod = FLOM_RC_NULL_OBJECT;
-                break;
-            case CONNS_SET_EVENTS_ERROR:
-                break;
-            case POLL_ERROR:
-                ret_cod = FLOM_RC_POLL_ERROR;
+            case CONNS_POLL_ERROR:
+            case ACCEPT_LOOP_INCUBATOR_CHECK_ERROR:
                 break;
             case ACCEPT_LOOP_CHKLOCKERS_ERROR1:
                 break;
             case NEGATIVE_NUMBER_OF_LOCKERS_ERROR1:
                 ret_cod = FLOM_RC_OBJ_CORRUPTED;
                 break;
-            case CONNS_CLOSE_ERROR1:
-            case CONNS_CLOSE_ERROR2:
-            case ACCEPT_LOOP_POLLIN_ERROR:
-                break;
-            case NETWORK_ERROR:
-                ret_cod = FLOM_RC_NETWORK_EVENT_ERROR;
-                break;
-            case INTERNAL_ERROR:
-                ret_cod = FLOM_RC_INTERNAL_ERROR;
+            case ACCEPT_LOOP_SCAN_ERROR:
                 break;
             case ACCEPT_LOOP_CHKLOCKERS_ERROR2:
                 break;
@@ -1210,6 +1247,11 @@ int flom_accept_loop(flom_config_t *config, flom_conns_t *conns)
         } /* switch (excp) */
     } /* TRY-CATCH */
 
+    /* the acceptor threads use the lockers and the VFS: they must be
+       stopped before */
+    if (NULL != acceptors)
+        flom_accept_loop_stop_acceptors(acceptors, acceptor_number);
+    
     /* terminate the thread started for VFS even if an error happened */
 
     if (excp > G_THREAD_NEW_ERROR && activate_vfs) {
@@ -1249,7 +1291,22 @@ int flom_accept_loop(flom_config_t *config, flom_conns_t *conns)
     }
     
     flom_vfs_ram_tree_cleanup(NULL, FALSE);
+    syslog(LOG_INFO, FLOM_SYSLOG_FLM026I,
+           flom_locker_array_get_cache_hits(&lockers),
+           flom_locker_array_get_cache_misses(&lockers));
+    /* output statistics are collected when the worker threads stop */
+    flom_locker_array_stop_workers(&lockers);
+    syslog(LOG_INFO, FLOM_SYSLOG_FLM029I,
+           flom_locker_array_get_batch_messages(&lockers),
+           flom_locker_array_get_batch_writes(&lockers));
     flom_locker_array_free(&lockers);
+    flom_tls_get_stats(&tls_stats);
+    syslog(LOG_INFO, FLOM_SYSLOG_FLM030I,
+           tls_stats.full, tls_stats.full_usec,
+           tls_stats.resumed, tls_stats.resumed_usec);
+    syslog(LOG_INFO, FLOM_SYSLOG_FLM031I,
+           tls_stats.ktls_send, tls_stats.ktls_recv);
+    flom_tls_server_context_free();
     FLOM_TRACE(("flom_accept_loop/excp=%d/"
                 "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
     return ret_cod;
@@ -1257,22 +1314,362 @@ int flom_accept_loop(flom_config_t *config, flom_conns_t *conns)
 
 
 
+int flom_accept_loop_start_acceptors(flom_config_t *config, int domain,
+                                     flom_locker_array_t *lockers,
+                                     guint number,
+                                     flom_acceptor_t **acceptors)
+{
+    enum Exception { LISTEN_TCP_CONFIGURED_ERROR
+                     , G_THREAD_NEW_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    flom_acceptor_t *array = NULL;
+    
+    FLOM_TRACE(("flom_accept_loop_start_acceptors\n"));
+    TRY {
+        guint i;
+        char thread_name[32];
+
+        array = g_new0(flom_acceptor_t, number);
+        /* all the sockets must be bound before any thread can accept a
+           connection */
+        for (i=0; i<number; ++i) {
+            flom_acceptor_t *acceptor = array + i;
+            acceptor->id = i + 1;
+            acceptor->config = config;
+            acceptor->lockers = lockers;
+            acceptor->active = acceptor->stop = FALSE;
+            flom_conns_init(&acceptor->conns, domain);
+            /* the main thread has already bound the socket: the address
+               and the port (even if it was ephemeral) are available in
+               the configuration */
+            if (FLOM_RC_OK != (ret_cod = flom_listen_tcp_configured(
+                                   config, &acceptor->conns)))
+                THROW(LISTEN_TCP_CONFIGURED_ERROR);
+        } /* for (i=0; i<number; ++i) */
+        for (i=0; i<number; ++i) {
+            snprintf(thread_name, sizeof(thread_name), "Acceptor %u",
+                     array[i].id);
+            if (NULL == (array[i].thread = g_thread_new(
+                             thread_name, flom_accept_loop_acceptor,
+                             (gpointer)(array + i))))
+                THROW(G_THREAD_NEW_ERROR);
+            FLOM_TRACE(("flom_accept_loop_start_acceptors: created "
+                        "acceptor %u (thread=%p, listener fd=%d)\n",
+                        array[i].id, array[i].thread,
+                        flom_conns_get_fd(&array[i].conns, 0)));
+        } /* for (i=0; i<number; ++i) */
+        *acceptors = array;
+        array = NULL;
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case LISTEN_TCP_CONFIGURED_ERROR:
+                break;
+            case G_THREAD_NEW_ERROR:
+                ret_cod = FLOM_RC_G_THREAD_NEW_ERROR;
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    /* stop the threads already started and release the sockets */
+    if (NULL != array)
+        flom_accept_loop_stop_acceptors(array, number);
+    FLOM_TRACE(("flom_accept_loop_start_acceptors/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+void flom_accept_loop_stop_acceptors(flom_acceptor_t *acceptors,
+                                     guint number)
+{
+    guint i;
+    
+    FLOM_TRACE(("flom_accept_loop_stop_acceptors: number=%u\n", number));
+    for (i=0; i<number; ++i)
+        g_atomic_int_set(&acceptors[i].stop, TRUE);
+    for (i=0; i<number; ++i) {
+        if (NULL != acceptors[i].thread) {
+            FLOM_TRACE(("flom_accept_loop_stop_acceptors: waiting "
+                        "termination of acceptor %u (thread=%p)\n",
+                        acceptors[i].id, acceptors[i].thread));
+            /* the thread releases its connections before exiting */
+            g_thread_join(acceptors[i].thread);
+            acceptors[i].thread = NULL;
+        } else if (NULL != acceptors[i].conns.array)
+            flom_conns_free(&acceptors[i].conns);
+    } /* for (i=0; i<number; ++i) */
+    g_free(acceptors);
+}
+
+
+
+guint flom_accept_loop_acceptors_active(flom_acceptor_t *acceptors,
+                                        guint number)
+{
+    guint i, active = 0;
+    
+    for (i=0; i<number; ++i)
+        active += g_atomic_int_get(&acceptors[i].active);
+    return active;
+}
+
+
+
+gpointer flom_accept_loop_acceptor(gpointer data)
+{
+    enum Exception { CONNS_CLEAN_ERROR
+                     , CONNS_POLL_ERROR
+                     , ACCEPT_LOOP_INCUBATOR_CHECK_ERROR
+                     , ACCEPT_LOOP_SCAN_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    flom_acceptor_t *acceptor = (flom_acceptor_t *)data;
+    
+    FLOM_TRACE(("flom_accept_loop_acceptor: new thread in progress (first "
+                "message)\n"));
+    TRY {
+        gint generation = 0;
+        
+        while (!g_atomic_int_get(&acceptor->stop)) {
+            int ready_fd;
+            
+            if (FLOM_RC_OK != (ret_cod = flom_conns_clean(&acceptor->conns)))
+                THROW(CONNS_CLEAN_ERROR);
+            /* the first connection is the listener */
+            g_atomic_int_set(&acceptor->active,
+                             flom_conns_get_used(&acceptor->conns) - 1);
+            if (FLOM_RC_OK != (ret_cod = flom_conns_poll(
+                                   &acceptor->conns,
+                                   FLOM_ACCEPTOR_POLL_TIMEOUT, &ready_fd)))
+                THROW(CONNS_POLL_ERROR);
+            /* a locker created by another acceptor thread could serve
+               some connections waiting inside the incubator */
+            if (FLOM_RC_OK != (ret_cod = flom_accept_loop_incubator_check(
+                                   &acceptor->conns, acceptor->lockers,
+                                   &generation)))
+                THROW(ACCEPT_LOOP_INCUBATOR_CHECK_ERROR);
+            if (0 == ready_fd)
+                continue;
+            FLOM_TRACE(("flom_accept_loop_acceptor: acceptor=%u, "
+                        "ready_fd=%d\n", acceptor->id, ready_fd));
+            if (FLOM_RC_OK != (ret_cod = flom_accept_loop_scan(
+                                   acceptor->config, &acceptor->conns,
+                                   acceptor->lockers)))
+                THROW(ACCEPT_LOOP_SCAN_ERROR);
+        } /* while (!g_atomic_int_get(&acceptor->stop)) */
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case CONNS_CLEAN_ERROR:
+            case CONNS_POLL_ERROR:
+            case ACCEPT_LOOP_INCUBATOR_CHECK_ERROR:
+            case ACCEPT_LOOP_SCAN_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    if (NONE != excp)
+        syslog(LOG_ERR, FLOM_SYSLOG_FLM028E, acceptor->id, ret_cod,
+               flom_strerror(ret_cod));
+    /* closing the listener socket, the kernel stops to dispatch new
+       connections to this thread */
+    flom_mlock_free_all(&acceptor->conns);
+    flom_conns_free(&acceptor->conns);
+    g_atomic_int_set(&acceptor->active, 0);
+    FLOM_TRACE(("flom_accept_loop_acceptor/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    FLOM_TRACE(("flom_accept_loop_acceptor: this thread completed service "
+                "(last message)\n"));
+    return data;
+}
+
+
+
+int flom_accept_loop_scan(flom_config_t *config, flom_conns_t *conns,
+                          flom_locker_array_t *lockers)
+{
+    enum Exception { CONNS_CLOSE_ERROR1
+                     , CONNS_CLOSE_ERROR3
+                     , CONNS_CLOSE_ERROR2
+                     , ACCEPT_LOOP_POLLIN_ERROR
+                     , NETWORK_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_accept_loop_scan\n"));
+    TRY {
+        guint i, j, n;
+        
+        n = flom_conns_get_ready(conns);
+        for (j=0; j<n; ++j) {
+            short revents = flom_conns_get_ready_revents(conns, j);
+            i = flom_conns_get_ready_id(conns, j);
+            FLOM_TRACE(("flom_accept_loop_scan: i=%u, fd=%d, POLLIN=%d, "
+                        "POLLOUT=%d, POLLERR=%d, POLLHUP=%d, POLLNVAL=%d\n",
+                        i, flom_conns_get_fd(conns, i),
+                        revents & POLLIN, revents & POLLOUT,
+                        revents & POLLERR,
+                        revents & POLLHUP,
+                        revents & POLLNVAL));
+            if (0 != i && FLOM_CONN_STATE_REMOVE == flom_conn_get_state(
+                    flom_conns_get_conn(conns, i))) {
+                /* closed by a previous event of this loop (the members of a
+                   multiple lock request) */
+                continue;
+            }
+            if ((revents & POLLHUP) && (0 != i)) {
+                FLOM_TRACE(("flom_accept_loop_scan: client %u disconnected "
+                            "before categorization!\n", i));
+                if (FLOM_RC_OK != (ret_cod = flom_accept_loop_close_fd(
+                                       conns, i)))
+                    THROW(CONNS_CLOSE_ERROR1);
+                /* this file descriptor is no more valid, continue to
+                   next one */
+                continue;
+            }
+            if (0 != i && (revents & (POLLIN | POLLOUT | POLLERR))) {
+                flom_conn_t *c = flom_conns_get_conn(conns, i);
+                flom_tls_t *tls = NULL == c ? NULL : flom_conn_get_tls(c);
+                if (NULL != tls && 0 != flom_tls_get_handshake_events(tls)) {
+                    /* TLS handshake in progress: it's resumed without
+                       blocking the other clients */
+                    ret_cod = flom_accept_loop_handshake(c);
+                    if (FLOM_RC_OK == ret_cod ||
+                        FLOM_RC_TLS_HANDSHAKE_IN_PROGRESS == ret_cod) {
+                        flom_conns_epoll_mod(conns, c);
+                    } else {
+                        FLOM_TRACE(("flom_accept_loop_scan: TLS handshake "
+                                    "of client %u returned %d, closing "
+                                    "the TCP connection...\n", i, ret_cod));
+                        if (FLOM_RC_OK != (
+                                ret_cod = flom_accept_loop_close_fd(
+                                    conns, i)))
+                            THROW(CONNS_CLOSE_ERROR3);
+                    }
+                    /* the first message will be notified by the next
+                       poll */
+                    continue;
+                }
+            }
+            if (revents & POLLIN) {
+                int conn_moved = FALSE;
+                ret_cod = flom_accept_loop_pollin(
+                    config, conns, i, lockers, &conn_moved);
+                if (FLOM_RC_CONNECTION_CLOSED == ret_cod) {
+                    FLOM_TRACE(("flom_accept_loop_scan: peer closed the "
+                                "connection, terminating it...\n"));
+                    if (FLOM_RC_OK != (ret_cod = flom_accept_loop_close_fd(
+                                           conns, i)))
+                        THROW(CONNS_CLOSE_ERROR2);
+                    /* this file descriptor is no more valid, continue to
+                       next one */
+                    continue;
+                } else if (FLOM_RC_OK != ret_cod)
+                    THROW(ACCEPT_LOOP_POLLIN_ERROR);
+                if (conn_moved)
+                    /* connection is no more available for this thread,
+                       a new loop must be started */
+                    break;
+            }
+            if (revents & (POLLERR | POLLHUP | POLLNVAL))
+                THROW(NETWORK_ERROR);
+        } /* for (j=0; j<n; ++j) */
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case CONNS_CLOSE_ERROR1:
+            case CONNS_CLOSE_ERROR3:
+            case CONNS_CLOSE_ERROR2:
+            case ACCEPT_LOOP_POLLIN_ERROR:
+                break;
+            case NETWORK_ERROR:
+                ret_cod = FLOM_RC_NETWORK_EVENT_ERROR;
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_accept_loop_scan/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_accept_loop_close_fd(flom_conns_t *conns, guint id)
+{
+    enum Exception { CONNS_GET_CD_ERROR
+                     , MLOCK_CLOSE_CONN_ERROR
+                     , CONNS_CLOSE_FD_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_accept_loop_close_fd: id=%u\n", id));
+    TRY {
+        flom_conn_t *c;
+        
+        if (NULL == (c = flom_conns_get_conn(conns, id)))
+            THROW(CONNS_GET_CD_ERROR);
+        /* the other connections of a multiple lock request must be
+           managed before this one disappears */
+        if (FLOM_RC_OK != (ret_cod = flom_mlock_close_conn(conns, c)))
+            THROW(MLOCK_CLOSE_CONN_ERROR);
+        if (FLOM_RC_OK != (ret_cod = flom_conns_close_fd(conns, id)))
+            THROW(CONNS_CLOSE_FD_ERROR);
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case CONNS_GET_CD_ERROR:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
+            case MLOCK_CLOSE_CONN_ERROR:
+            case CONNS_CLOSE_FD_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_accept_loop_close_fd/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
 int flom_accept_loop_pollin(flom_config_t *config,
                             flom_conns_t *conns, guint id,
                             flom_locker_array_t *lockers,
                             int *moved)
 {
     enum Exception { CONNS_GET_CD_ERROR
-                     , ACCEPT_ERROR
-                     , SETSOCKOPT_ERROR
-                     , CONN_SET_KEEPALIVE_ERROR
-                     , NEW_OBJ
-                     , CONN_INIT_ERROR
-                     , CONN_TERMINATE_ERROR
+                     , ACCEPT_LOOP_ACCEPT_ERROR
+                     , MLOCK_MEMBER_POLLIN_ERROR
+                     , MLOCK_PIPELINE_POLLIN_ERROR1
                      , MSG_RETRIEVE_ERROR
                      , EMPTY_MESSAGE
                      , CONNS_GET_MSG_ERROR
-                     , CONNS_GET_GMPC_ERROR
+                     , CONNS_GET_PARSER_ERROR
                      , MSG_DESERIALIZE_ERROR
                      , CONNS_CLOSE_ERROR1
                      , PROTOCOL_ERROR
@@ -1283,11 +1680,14 @@ int flom_accept_loop_pollin(flom_config_t *config,
                      , GETNAMEINFO_ERROR
                      , ACCEPT_DISCOVER_REPLY_ERROR
                      , DAEMON_MANAGEMENT_ERROR
+                     , MLOCK_CLIENT_MSG_ERROR
+                     , MLOCK_PIPELINE_MSG_ERROR
+                     , MLOCK_PIPELINE_POLLIN_ERROR2
+                     , MLOCK_START_ERROR
                      , ACCEPT_LOOP_TRANSFER_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
 
-    flom_conn_t *conn = NULL;
     gchar *peer_name = NULL;
     
     FLOM_TRACE(("flom_accept_loop_pollin\n"));
@@ -1300,59 +1700,33 @@ int flom_accept_loop_pollin(flom_config_t *config,
         FLOM_TRACE(("flom_accept_loop_pollin: id=%u, fd=%d\n",
                     id, flom_tcp_get_sockfd(flom_conn_get_tcp(c))));
         if (0 == id) {
-            /* it's a new connection */
-            int conn_fd;
-            struct sockaddr_storage cliaddr;
-            socklen_t clilen = sizeof(cliaddr);
-            if (-1 == (conn_fd = accept(flom_tcp_get_sockfd(
-                                            flom_conn_get_tcp(c)),
-                                        (struct sockaddr *)&cliaddr,
-                                        &clilen)))
-                THROW(ACCEPT_ERROR);
-            FLOM_TRACE(("flom_accept_loop_pollin: new client connected "
-                        "with fd=%d\n", conn_fd));
-            
-            if (AF_INET == flom_conns_get_domain(conns)) {
-                int sock_opt = 1;
-                /* set TCP_NODELAY for socket */
-                if (0 != setsockopt(conn_fd, IPPROTO_TCP, TCP_NODELAY,
-                                    (void *)(&sock_opt), sizeof(sock_opt)))
-                    THROW(SETSOCKOPT_ERROR);
-                /* set SO_KEEPALIVE for socket */
-                if (FLOM_RC_OK != (ret_cod = flom_conn_set_keepalive(
-                                       config, conn_fd)))
-                    THROW(CONN_SET_KEEPALIVE_ERROR);
-            }
-            /* create a new connection object */
-            if (NULL == (conn = flom_conn_new(NULL)))
-                THROW(NEW_OBJ);
-            FLOM_TRACE(("flom_accept_loop_pollin: allocated a new connection "
-                        "(%p)\n", conn));
-            /* initialize the connection */
-            if (FLOM_RC_OK != (ret_cod = flom_conn_init(
-                                   conn, flom_conns_get_new_uid(conns),
-                                   flom_conns_get_domain(conns),
-                                   conn_fd, SOCK_STREAM, clilen,
-                                   (struct sockaddr *)&cliaddr, TRUE)))
-                THROW(CONN_INIT_ERROR);
-            /* switch the connection to TLS if required by the configuration */
-            if (FLOM_RC_OK != (ret_cod = flom_accept_loop_pollin_tls(
-                                   config, conn))) {
-                FLOM_TRACE(("flom_accept_loop_pollin: TLS negotiation "
-                            "returned %d, closing the TCP connection...\n",
-                            ret_cod));
-                if (FLOM_RC_OK != (ret_cod = flom_conn_terminate(conn)))
-                    THROW(CONN_TERMINATE_ERROR);
-            }
-            
-            /* add connection */
-            flom_conns_add_conn(conns, conn);
-            conn = NULL; /* avoid connection delete from this function */
+            /* new connections: the backlog is drained in batches */
+            guint n;
+            int accepted = TRUE;
+            for (n=0; n<FLOM_ACCEPT_BATCH_SIZE && accepted; ++n)
+                if (FLOM_RC_OK != (ret_cod = flom_accept_loop_accept(
+                                       config, conns, c, &accepted)))
+                    THROW(ACCEPT_LOOP_ACCEPT_ERROR);
+            FLOM_TRACE(("flom_accept_loop_pollin: accepted %u "
+                        "connection(s) in this batch\n",
+                        accepted ? n : n - 1));
+        } else if (flom_mlock_is_member(c)) {
+            /* answers of a locker to a resource of a multiple lock
+               request */
+            if (FLOM_RC_OK != (ret_cod = flom_mlock_member_pollin(
+                                   conns, id, lockers)))
+                THROW(MLOCK_MEMBER_POLLIN_ERROR);
+        } else if (flom_mlock_is_pipelined(c)) {
+            /* requests of a pipelined client */
+            if (FLOM_RC_OK != (ret_cod = flom_mlock_pipeline_pollin(
+                                   conns, id, lockers)))
+                THROW(MLOCK_PIPELINE_POLLIN_ERROR1);
         } else {
-            char buffer[FLOM_MSG_BUFFER_SIZE];
+            /* a multiple lock request is bigger than the other messages */
+            char buffer[FLOM_MSG_MAX_SIZE];
             size_t read_bytes;
             struct flom_msg_s *msg;
-            GMarkupParseContext *gmpc;
+            flom_msg_parser_t *parser;
             struct sockaddr_storage src_addr;
             socklen_t addrlen = sizeof(src_addr);
             memset(&src_addr, 0, addrlen);
@@ -1378,17 +1752,18 @@ int flom_accept_loop_pollin(flom_config_t *config,
             if (NULL == (msg = flom_conns_get_msg(conns, id)))
                 THROW(CONNS_GET_MSG_ERROR);
 
-            if (NULL == (gmpc = flom_conns_get_parser(conns, id)))
-                THROW(CONNS_GET_GMPC_ERROR);
+            if (NULL == (parser = flom_conns_get_parser(conns, id)))
+                THROW(CONNS_GET_PARSER_ERROR);
             
             if (FLOM_RC_OK != (ret_cod = flom_msg_deserialize(
-                                   buffer, read_bytes, msg, gmpc)))
+                                   buffer, read_bytes, msg, parser)))
                 THROW(MSG_DESERIALIZE_ERROR);
             flom_conn_set_last_step(c, msg->header.pvs.step);
             flom_msg_trace(msg);
             /* if the message is not valid the client must be terminated */
             if (FLOM_MSG_STATE_INVALID == msg->state) {
-                if (FLOM_MSG_LEVEL != msg->header.level) {
+                if (FLOM_MSG_LEVEL != msg->header.level &&
+                    FLOM_MSG_LEVEL_BINARY != msg->header.level) {
                     FLOM_TRACE(("flom_accept_loop_pollin: this flom daemon "
                                 "is using communication level %d, client is "
                                 "using communication level %d\n",
@@ -1398,7 +1773,7 @@ int flom_accept_loop_pollin(flom_config_t *config,
                 }
                 FLOM_TRACE(("flom_accept_loop_pollin: message from client %u "
                             "is invalid, disconneting...\n", id));
-                if (FLOM_RC_OK != (ret_cod = flom_conns_close_fd(
+                if (FLOM_RC_OK != (ret_cod = flom_accept_loop_close_fd(
                                        conns, id)))
                     THROW(CONNS_CLOSE_ERROR1);
             }
@@ -1406,6 +1781,8 @@ int flom_accept_loop_pollin(flom_config_t *config,
                to a slave thread (a locker) */
             if (FLOM_MSG_STATE_READY == msg->state) {
                 gchar *peerid = NULL;
+                /* the answers use the protocol level of the client */
+                flom_conn_set_level(c, msg->header.level);
                 /* check the message is protocol correct */
                 if (!flom_msg_check_protocol(msg, TRUE))
                     THROW(PROTOCOL_ERROR);
@@ -1429,8 +1806,9 @@ int flom_accept_loop_pollin(flom_config_t *config,
                         THROW(NULL_OBJECT);
                     if (FLOM_RC_OK != (ret_cod = flom_tls_cert_check(
                                            tls, peerid, peer_name))) {
-                        if (FLOM_RC_OK != (ret_cod = flom_conns_close_fd(
-                                               conns, id)))
+                        if (FLOM_RC_OK != (
+                                ret_cod = flom_accept_loop_close_fd(
+                                    conns, id)))
                             THROW(CONNS_CLOSE_ERROR2);
                         THROW(TLS_CERT_CHECK_ERROR);
                     }
@@ -1458,6 +1836,29 @@ int flom_accept_loop_pollin(flom_config_t *config,
                     if (FLOM_RC_OK != (ret_cod = flom_daemon_mngmnt(
                                            config, conns, id)))
                         THROW(DAEMON_MANAGEMENT_ERROR);
+                } else if (NULL != flom_conn_get_mlock(c)) {
+                    /* the client is the owner of a multiple lock request:
+                       it's not passed to a locker */
+                    if (FLOM_RC_OK != (ret_cod = flom_mlock_client_msg(
+                                           conns, id)))
+                        THROW(MLOCK_CLIENT_MSG_ERROR);
+                } else if (0 != msg->header.rid) {
+                    /* the first tagged request: the client is kept by this
+                       thread and its requests are served out of order */
+                    if (FLOM_RC_OK != (ret_cod = flom_mlock_pipeline_msg(
+                                           conns, id, lockers)))
+                        THROW(MLOCK_PIPELINE_MSG_ERROR);
+                    /* the next requests can be already buffered */
+                    if (0 < flom_conn_get_pending_msgs(c) &&
+                        FLOM_RC_OK != (ret_cod = flom_mlock_pipeline_pollin(
+                                           conns, id, lockers)))
+                        THROW(MLOCK_PIPELINE_POLLIN_ERROR2);
+                } else if (FLOM_MSG_VERB_MLOCK == msg->header.pvs.verb) {
+                    /* the resources are acquired by this thread on behalf
+                       of the client */
+                    if (FLOM_RC_OK != (ret_cod = flom_mlock_start(
+                                           conns, id, lockers)))
+                        THROW(MLOCK_START_ERROR);
                 } else {
                     if (FLOM_RC_OK != (ret_cod = flom_accept_loop_transfer(
                                            conns, id, lockers)))
@@ -1473,19 +1874,9 @@ int flom_accept_loop_pollin(flom_config_t *config,
             case CONNS_GET_CD_ERROR:
                 ret_cod = FLOM_RC_NULL_OBJECT;
                 break;
-            case ACCEPT_ERROR:
-                ret_cod = FLOM_RC_ACCEPT_ERROR;
-                break;
-            case SETSOCKOPT_ERROR:
-                ret_cod = FLOM_RC_SETSOCKOPT_ERROR;
-                break;
-            case CONN_SET_KEEPALIVE_ERROR:
-                break;
-            case NEW_OBJ:
-                ret_cod = FLOM_RC_NEW_OBJ;
-                break;
-            case CONN_INIT_ERROR:
-            case CONN_TERMINATE_ERROR:
+            case ACCEPT_LOOP_ACCEPT_ERROR:
+            case MLOCK_MEMBER_POLLIN_ERROR:
+            case MLOCK_PIPELINE_POLLIN_ERROR1:
                 break;
             case MSG_RETRIEVE_ERROR:
             case EMPTY_MESSAGE:
@@ -1494,7 +1885,7 @@ int flom_accept_loop_pollin(flom_config_t *config,
             case MSG_DESERIALIZE_ERROR:
                 break;
             case CONNS_GET_MSG_ERROR:
-            case CONNS_GET_GMPC_ERROR:
+            case CONNS_GET_PARSER_ERROR:
                 ret_cod = FLOM_RC_NULL_OBJECT;
                 break;
             case CONNS_CLOSE_ERROR1:
@@ -1519,6 +1910,10 @@ int flom_accept_loop_pollin(flom_config_t *config,
             case ACCEPT_DISCOVER_REPLY_ERROR:
             case ACCEPT_LOOP_TRANSFER_ERROR:
             case DAEMON_MANAGEMENT_ERROR:
+            case MLOCK_CLIENT_MSG_ERROR:
+            case MLOCK_PIPELINE_MSG_ERROR:
+            case MLOCK_PIPELINE_POLLIN_ERROR2:
+            case MLOCK_START_ERROR:
                 break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
@@ -1530,10 +1925,163 @@ int flom_accept_loop_pollin(flom_config_t *config,
     /* release peer address if necessary */
     if (NULL != peer_name)
         g_free(peer_name);
+    FLOM_TRACE(("flom_accept_loop_pollin/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_accept_loop_accept(flom_config_t *config,
+                            flom_conns_t *conns,
+                            flom_conn_t *listener,
+                            int *accepted)
+{
+    enum Exception { NO_PENDING_CONNECTION
+                     , ACCEPT_ERROR
+#ifndef HAVE_ACCEPT4
+                     , FCNTL_ERROR1
+                     , FCNTL_ERROR2
+                     , FCNTL_ERROR3
+#endif
+                     , SETSOCKOPT_ERROR
+                     , CONN_SET_KEEPALIVE_ERROR
+                     , NEW_OBJ
+                     , CONN_INIT_ERROR
+                     , CONN_TERMINATE_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+
+    int conn_fd = FLOM_NULL_FD;
+    flom_conn_t *conn = NULL;
+    
+    FLOM_TRACE(("flom_accept_loop_accept\n"));
+    TRY {
+        struct sockaddr_storage cliaddr;
+        socklen_t clilen = sizeof(cliaddr);
+
+        *accepted = FALSE;
+#ifdef HAVE_ACCEPT4
+        /* the descriptor must not leak into the commands executed by
+           the daemon */
+        conn_fd = accept4(flom_tcp_get_sockfd(flom_conn_get_tcp(listener)),
+                          (struct sockaddr *)&cliaddr, &clilen,
+                          SOCK_CLOEXEC);
+#else
+        conn_fd = accept(flom_tcp_get_sockfd(flom_conn_get_tcp(listener)),
+                         (struct sockaddr *)&cliaddr, &clilen);
+#endif
+        if (-1 == conn_fd) {
+            /* the backlog is empty or the pending connection vanished:
+               next POLLIN will restart the batch */
+            if (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno ||
+                ECONNABORTED == errno)
+                THROW(NO_PENDING_CONNECTION);
+            THROW(ACCEPT_ERROR);
+        }
+        *accepted = TRUE;
+        FLOM_TRACE(("flom_accept_loop_accept: new client connected "
+                    "with fd=%d\n", conn_fd));
+        
+#ifndef HAVE_ACCEPT4
+        {
+            int flags;
+            /* same descriptor returned by accept4: close on exec and
+               blocking, even if the platform inherits the flags of the
+               listener */
+            if (-1 == fcntl(conn_fd, F_SETFD, FD_CLOEXEC))
+                THROW(FCNTL_ERROR1);
+            if (-1 == (flags = fcntl(conn_fd, F_GETFL)))
+                THROW(FCNTL_ERROR2);
+            if (flags & O_NONBLOCK &&
+                -1 == fcntl(conn_fd, F_SETFL, flags & ~O_NONBLOCK))
+                THROW(FCNTL_ERROR3);
+        }
+#endif
+        if (AF_INET == flom_conns_get_domain(conns)) {
+            int sock_opt = 1;
+            /* set TCP_NODELAY for socket */
+            if (0 != setsockopt(conn_fd, IPPROTO_TCP, TCP_NODELAY,
+                                (void *)(&sock_opt), sizeof(sock_opt)))
+                THROW(SETSOCKOPT_ERROR);
+            /* set SO_KEEPALIVE for socket */
+            if (FLOM_RC_OK != (ret_cod = flom_conn_set_keepalive(
+                                   config, conn_fd)))
+                THROW(CONN_SET_KEEPALIVE_ERROR);
+        }
+        /* create a new connection object */
+        if (NULL == (conn = flom_conn_new(NULL)))
+            THROW(NEW_OBJ);
+        FLOM_TRACE(("flom_accept_loop_accept: allocated a new connection "
+                    "(%p)\n", conn));
+        /* initialize the connection */
+        if (FLOM_RC_OK != (ret_cod = flom_conn_init(
+                               conn, flom_conns_get_new_uid(conns),
+                               flom_conns_get_domain(conns),
+                               conn_fd, SOCK_STREAM, clilen,
+                               (struct sockaddr *)&cliaddr, TRUE)))
+            THROW(CONN_INIT_ERROR);
+        conn_fd = FLOM_NULL_FD; /* the socket is owned by the connection */
+        /* switch the connection to TLS if required by the configuration */
+        ret_cod = flom_accept_loop_pollin_tls(config, conn);
+        if (FLOM_RC_TLS_HANDSHAKE_IN_PROGRESS == ret_cod) {
+            FLOM_TRACE(("flom_accept_loop_accept: TLS handshake "
+                        "will be completed when the socket is ready\n"));
+        } else if (FLOM_RC_OK != ret_cod) {
+            FLOM_TRACE(("flom_accept_loop_accept: TLS negotiation "
+                        "returned %d, closing the TCP connection...\n",
+                        ret_cod));
+            if (FLOM_RC_OK != (ret_cod = flom_conn_terminate(conn)))
+                THROW(CONN_TERMINATE_ERROR);
+        }
+        
+        /* add connection */
+        flom_conns_add_conn(conns, conn);
+        conn = NULL; /* avoid connection delete from this function */
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case NO_PENDING_CONNECTION:
+                FLOM_TRACE(("flom_accept_loop_accept: errno=%d ('%s'), "
+                            "no pending connection\n", errno,
+                            strerror(errno)));
+                ret_cod = FLOM_RC_OK;
+                break;
+            case ACCEPT_ERROR:
+                ret_cod = FLOM_RC_ACCEPT_ERROR;
+                break;
+#ifndef HAVE_ACCEPT4
+            case FCNTL_ERROR1:
+            case FCNTL_ERROR2:
+            case FCNTL_ERROR3:
+                ret_cod = FLOM_RC_FCNTL_ERROR;
+                break;
+#endif
+            case SETSOCKOPT_ERROR:
+                ret_cod = FLOM_RC_SETSOCKOPT_ERROR;
+                break;
+            case CONN_SET_KEEPALIVE_ERROR:
+                break;
+            case NEW_OBJ:
+                ret_cod = FLOM_RC_NEW_OBJ;
+                break;
+            case CONN_INIT_ERROR:
+            case CONN_TERMINATE_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
     /* release conn if necessary */
     if (NULL != conn)
         flom_conn_delete(conn);
-    FLOM_TRACE(("flom_accept_loop_pollin/excp=%d/"
+    if (FLOM_NULL_FD != conn_fd)
+        close(conn_fd);
+    FLOM_TRACE(("flom_accept_loop_accept/excp=%d/"
                 "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
     return ret_cod;
 }
@@ -1544,8 +2092,9 @@ int flom_accept_loop_pollin_tls(flom_config_t *config,
                                 flom_conn_t *conn)
 {
     enum Exception { TLS_NOT_REQUIRED
-                     , TLS_CREATE_CONTEXT_ERROR
-                     , TLS_SET_CERT_ERROR
+                     , TLS_SERVER_CONTEXT_ERROR
+                     , TCP_SET_NONBLOCKING_ERROR
+                     , HANDSHAKE_IN_PROGRESS
                      , TLS_ACCEPT_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
@@ -1564,24 +2113,30 @@ int flom_accept_loop_pollin_tls(flom_config_t *config,
         
         /* initialize TLS/SSL support */
         flom_conn_init_tls(conn, FALSE);
+        flom_tls_set_kernel_offload(
+            flom_conn_get_tls(conn),
+            flom_config_get_tls_kernel_offload(config));
         
-        /* create a TLS/SSL context */
-        if (FLOM_RC_OK != (ret_cod = flom_tls_context(
-                               flom_conn_get_tls(conn))))
-            THROW(TLS_CREATE_CONTEXT_ERROR);
-
-        /* set certificates */
-        if (FLOM_RC_OK != (ret_cod = flom_tls_set_cert(
+        /* use the TLS/SSL context shared by all the connections: it
+           keeps the sessions that can be resumed by the clients */
+        if (FLOM_RC_OK != (ret_cod = flom_tls_server_context(
                                flom_conn_get_tls(conn),
                                flom_config_get_tls_certificate(config),
                                flom_config_get_tls_private_key(config),
                                flom_config_get_tls_ca_certificate(config))))
-            THROW(TLS_SET_CERT_ERROR);
+            THROW(TLS_SERVER_CONTEXT_ERROR);
 
+        /* the handshake must not block the thread that's accepting the
+           connections of the other clients */
+        if (FLOM_RC_OK != (ret_cod = flom_tcp_set_nonblocking(
+                               flom_conn_get_tcp(conn), TRUE)))
+            THROW(TCP_SET_NONBLOCKING_ERROR);
+        
         /* switch the server connection to TLS */
-        if (FLOM_RC_OK != (ret_cod = flom_tls_accept(
-                               flom_conn_get_tls(conn),
-                               flom_tcp_get_sockfd(flom_conn_get_tcp(conn)))))
+        ret_cod = flom_accept_loop_handshake(conn);
+        if (FLOM_RC_TLS_HANDSHAKE_IN_PROGRESS == ret_cod)
+            THROW(HANDSHAKE_IN_PROGRESS);
+        if (FLOM_RC_OK != ret_cod)
             THROW(TLS_ACCEPT_ERROR);
 
         THROW(NONE);
@@ -1590,8 +2145,12 @@ int flom_accept_loop_pollin_tls(flom_config_t *config,
             case TLS_NOT_REQUIRED:
                 ret_cod = FLOM_RC_OK;
                 break;
-            case TLS_CREATE_CONTEXT_ERROR:
-            case TLS_SET_CERT_ERROR:
+            case TLS_SERVER_CONTEXT_ERROR:
+            case TCP_SET_NONBLOCKING_ERROR:
+                break;
+            case HANDSHAKE_IN_PROGRESS:
+                ret_cod = FLOM_RC_TLS_HANDSHAKE_IN_PROGRESS;
+                break;
             case TLS_ACCEPT_ERROR:
                 break;
             case NONE:
@@ -1608,6 +2167,62 @@ int flom_accept_loop_pollin_tls(flom_config_t *config,
 
 
 
+int flom_accept_loop_handshake(flom_conn_t *conn)
+{
+    enum Exception { NULL_OBJECT
+                     , HANDSHAKE_IN_PROGRESS
+                     , TLS_ACCEPT_ERROR
+                     , TCP_SET_NONBLOCKING_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_accept_loop_handshake: conn=%p\n", conn));
+    TRY {
+        flom_tls_t *tls;
+        
+        if (NULL == (tls = flom_conn_get_tls(conn)))
+            THROW(NULL_OBJECT);
+        ret_cod = flom_tls_accept(
+            tls, flom_tcp_get_sockfd(flom_conn_get_tcp(conn)));
+        if (FLOM_RC_TLS_HANDSHAKE_IN_PROGRESS == ret_cod) {
+            /* wait the direction requested by the handshake */
+            flom_conn_set_events(conn, flom_tls_get_handshake_events(tls));
+            THROW(HANDSHAKE_IN_PROGRESS);
+        } else if (FLOM_RC_OK != ret_cod)
+            THROW(TLS_ACCEPT_ERROR);
+        /* the handshake is completed: from now on the connection is a
+           standard (blocking) one */
+        flom_conn_set_events(conn, 0);
+        if (FLOM_RC_OK != (ret_cod = flom_tcp_set_nonblocking(
+                               flom_conn_get_tcp(conn), FALSE)))
+            THROW(TCP_SET_NONBLOCKING_ERROR);
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case NULL_OBJECT:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
+            case HANDSHAKE_IN_PROGRESS:
+                ret_cod = FLOM_RC_TLS_HANDSHAKE_IN_PROGRESS;
+                break;
+            case TLS_ACCEPT_ERROR:
+            case TCP_SET_NONBLOCKING_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_accept_loop_handshake/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
 int flom_accept_loop_transfer(flom_conns_t *conns, guint id,
                               flom_locker_array_t *lockers)
 {
@@ -1624,18 +2239,17 @@ int flom_accept_loop_transfer(flom_conns_t *conns, guint id,
                      , PUT_INTO_INCUBATOR
                      , RESOURCE_INIT_ERROR
                      , ACCEPT_LOOP_START_LOCKER_ERROR
-                     , ACCEPT_LOOP_TRANSFER_CONN_ERROR1
-                     , CONNS_GET_CD_ERROR2
-                     , ACCEPT_LOOP_TRANSFER_CONN_ERROR2
+                     , ACCEPT_LOOP_TRANSFER_CONN_ERROR
+                     , ACCEPT_LOOP_INCUBATOR_TRANSFER_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     gchar *peer_name = NULL;
+    gchar *key = NULL;
+    int locked = FALSE;
 
     FLOM_TRACE(("flom_accept_loop_transfer\n"));
     TRY {
-        guint i, n;
         int found = FALSE;
-        GThread *locker_thread = NULL;
         struct flom_msg_s *msg = NULL;
         flom_rsrc_type_t flrt;
         flom_conn_t *conn = NULL;
@@ -1682,30 +2296,21 @@ int flom_accept_loop_transfer(flom_conns_t *conns, guint id,
         }
                                               
         /* is there a locker already active? */
-        n = flom_locker_array_count(lockers);
-        for (i=0; i<n; ++i) {
-            if (NULL == (locker = flom_locker_array_get(lockers, i)))
-                THROW(NULL_OBJECT2);
-            if (FLOM_NULL_FD == locker->write_pipe ||
-                FLOM_NULL_FD == locker->read_pipe) {
-                FLOM_TRACE(("flom_accept_loop_transfer: locker # %u is "
-                            "terminating (write_pipe=%d, read_pipe=%d), "
-                            "skipping...\n", i, locker->write_pipe,
-                            locker->read_pipe));
-                continue;
-            }
-            FLOM_TRACE(("flom_accept_loop_transfer: locker # %u is managing "
-                        "resource '%s'\n", i,
-                        flom_resource_get_name(&locker->resource)));
-            if (!locker->resource.compare_name(
-                    &locker->resource, msg->body.lock_8.resource.name)) {
-                FLOM_TRACE(("flom_accept_loop_transfer: found locker %u for "
-                            "resource '%s'\n", i,
-                            msg->body.lock_8.resource.name));
-                found = TRUE;
-                break;
-            }
-        } /* for (i=0; i<lockers->n; ++i) */
+        if (NULL == (key = flom_rsrc_get_key(
+                         flrt, msg->body.lock_8.resource.name)))
+            THROW(NULL_OBJECT2);
+        /* the registry is shared by all the acceptor threads: lookup,
+           creation and feeding of the locker must be atomic */
+        flom_locker_array_lock(lockers);
+        locked = TRUE;
+        if (NULL != (locker = flom_locker_array_lookup(lockers, key))) {
+            FLOM_TRACE(("flom_accept_loop_transfer: found locker "
+                        FLOM_UID_T_FORMAT " managing resource '%s' for "
+                        "resource '%s' (key='%s')\n", locker->uid,
+                        flom_resource_get_name(&locker->resource),
+                        msg->body.lock_8.resource.name, key));
+            found = TRUE;
+        }
         if (!found) {
             /* resources with "create=0" (NO) attribute, can not start a
                new locker, but must be kept */
@@ -1738,7 +2343,7 @@ int flom_accept_loop_transfer(flom_conns_t *conns, guint id,
                     if (FLOM_RC_OK != (ret_cod = flom_accept_loop_reply(
                                            conn, FLOM_RC_LOCK_WAIT_RESOURCE)))
                         THROW(ACCEPT_LOOP_REPLY_ERROR3);
-                    flom_conn_set_wait(conn, TRUE);
+                    flom_conns_incubate(conns, conn, key);
                     /* create the observability dir and files in VFS */
                     peer_name = flom_tcp_retrieve_peer_name(&conn->tcp);
                     if (FLOM_RC_OK != (
@@ -1759,7 +2364,7 @@ int flom_accept_loop_transfer(flom_conns_t *conns, guint id,
                 uint64_t uid = flom_conns_get_new_uid(conns);
                 /* start a new locker */
                 ret_cod = flom_accept_loop_start_locker(
-                    lockers, msg, flrt, uid, &locker, &locker_thread);
+                    lockers, msg, flrt, uid, &locker);
                 if (FLOM_RC_RESOURCE_INIT_ERROR == ret_cod) {
                     FLOM_TRACE(("flom_accept_loop_transfer: client requested "
                                 "an invalid resource, starting connection "
@@ -1779,58 +2384,19 @@ int flom_accept_loop_transfer(flom_conns_t *conns, guint id,
                 } else
                     locker_is_new = TRUE;
             } /* if (!msg->body.lock_8.resource.create) */
-        } else
-            locker_thread = locker->thread;
+        }
 
         if (FLOM_RC_OK != (ret_cod = flom_accept_loop_transfer_conn(
                                conns, id, locker, conn)))
-            THROW(ACCEPT_LOOP_TRANSFER_CONN_ERROR1);
+            THROW(ACCEPT_LOOP_TRANSFER_CONN_ERROR);
 
         /* if the a new locker has been created, check the resources
            inside the incubator: it might be some resource can be assigned
            to the new locker */
-        if (locker_is_new) {
-            /* scanning incubator to retrieve clients waiting for this
-               resource */
-            i=1;
-            while (i < flom_conns_get_used(conns)) {
-                flom_conn_t *loop_conn = NULL;
-                if (NULL == (loop_conn = flom_conns_get_conn(conns, i)))
-                    THROW(CONNS_GET_CD_ERROR2);
-                /* check if the connection is really waiting resource
-                   creation, else skip it */
-                if (!flom_conn_get_wait(loop_conn)) {
-                    i++;
-                    continue;
-                }
-                if (!locker->resource.compare_name(
-                        &locker->resource,
-                        flom_conn_get_msg(loop_conn)->
-                        body.lock_8.resource.name)) {
-                    FLOM_TRACE(("flom_accept_loop_transfer: connection %u "
-                                "(fd=%d) is waiting for resource '%s' and "
-                                "can be transferred to this locker\n",
-                                i, flom_tcp_get_sockfd(
-                                    flom_conn_get_tcp(loop_conn)),
-                                flom_conn_get_msg(loop_conn)->
-                                body.lock_8.resource.name));
-                    if (FLOM_RC_OK != (ret_cod =
-                                       flom_accept_loop_transfer_conn(
-                                           conns, i, locker, loop_conn)))
-                        THROW(ACCEPT_LOOP_TRANSFER_CONN_ERROR2);
-                    /* remove the connection from the incubator in the VFS
-                       ram tree */
-                    if (FLOM_RC_OK != (
-                            ret_cod = flom_vfs_ram_tree_del_conn(
-                                loop_conn->uid, TRUE))) {
-                        FLOM_TRACE(("flom_accept_loop_transfer: unable to "
-                                    "delete the info from VFS for this "
-                                    "holder connection\n"));
-                    }                  
-                } else
-                    i++;
-            } /* while (i < flom_conns_get_used(conns))) */
-        } /* if (locker_is_new) */
+        if (locker_is_new &&
+            FLOM_RC_OK != (ret_cod = flom_accept_loop_incubator_transfer(
+                               conns, key, locker)))
+            THROW(ACCEPT_LOOP_INCUBATOR_TRANSFER_ERROR);
         
         THROW(NONE);
     } CATCH {
@@ -1867,12 +2433,8 @@ int flom_accept_loop_transfer(flom_conns_t *conns, guint id,
                 break;
             case ACCEPT_LOOP_START_LOCKER_ERROR:
                 break;
-            case ACCEPT_LOOP_TRANSFER_CONN_ERROR1:
-                break;
-            case CONNS_GET_CD_ERROR2:
-                ret_cod = FLOM_RC_OBJ_CORRUPTED;
-                break;
-            case ACCEPT_LOOP_TRANSFER_CONN_ERROR2:
+            case ACCEPT_LOOP_TRANSFER_CONN_ERROR:
+            case ACCEPT_LOOP_INCUBATOR_TRANSFER_ERROR:
                 break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
@@ -1881,9 +2443,13 @@ int flom_accept_loop_transfer(flom_conns_t *conns, guint id,
                 ret_cod = FLOM_RC_INTERNAL_ERROR;
         } /* switch (excp) */
     } /* TRY-CATCH */
+    if (locked)
+        flom_locker_array_unlock(lockers);
     /* free allocated memory */
     if (NULL != peer_name)
         g_free(peer_name);
+    if (NULL != key)
+        g_free(key);
     FLOM_TRACE(("flom_accept_loop_transfer/excp=%d/"
                 "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
     return ret_cod;
@@ -1895,48 +2461,63 @@ int flom_accept_loop_transfer_conn(flom_conns_t *conns, guint id,
                                    struct flom_locker_s *locker,
                                    flom_conn_t *conn)
 {
-    enum Exception { WRITE_ERROR1
-                     , CONNS_TRNS_FD
-                     , WRITE_ERROR2
+    enum Exception { CONNS_TRNS_FD
+                     , RING_FULL
+                     , LOCKER_WORKER_PUSH_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     
     FLOM_TRACE(("flom_accept_loop_transfer_conn\n"));
     TRY {
         struct flom_locker_token_s flt;
-        GThread *locker_thread = locker->thread;
+        struct flom_locker_worker_s *worker = locker->worker;
         
         /* prepare the token for locker thread */
+        flt.command = FLOM_LOCKER_CMD_NEW_CONN;
+        flt.locker = locker;
         flt.domain = flom_conns_get_domain(conns);
         flt.client_fd = flom_conns_get_fd(conns, id);
-        flt.sequence = ++locker->write_sequence;
+        flt.sequence = locker->write_sequence + 1;
         FLOM_TRACE(("flom_accept_loop_transfer_conn: transferring "
                     "connection %u "
-                    "(domain=%d, client_fd=%d, sequence=%d) to thread %p "
-                    "using pipe %d\n", id, flt.domain, flt.client_fd,
-                    flt.sequence, locker_thread, locker->write_pipe));
-        /* send token */
-        if (sizeof(flt) != write(
-                locker->write_pipe, &flt, sizeof(flt)))
-            THROW(WRITE_ERROR1);
-        /* set the connection as transferred to another thread */
+                    "(domain=%d, client_fd=%d, sequence=%d) to locker %p "
+                    "hosted by worker %u (thread=%p)\n",
+                    id, flt.domain, flt.client_fd, flt.sequence, locker,
+                    worker->id, worker->thread));
+        /* set the connection as transferred to another thread: it must
+           be done before the worker thread can see it */
         if (FLOM_RC_OK != (ret_cod = flom_conns_trns_fd(conns, id)))
             THROW(CONNS_TRNS_FD);
-        /* send connection data (pointer is used because this object will
-           be managed by child thread */
-        if (sizeof(conn) != write(locker->write_pipe, &conn, sizeof(conn)))
-            THROW(WRITE_ERROR2);
+        /* send token and connection data (pointer is used because this
+           object will be managed by child thread) */
+        ret_cod = flom_locker_worker_push(worker, &flt, conn);
+        if (FLOM_RC_RING_FULL == ret_cod) {
+            THROW(RING_FULL);
+        } else if (FLOM_RC_OK != ret_cod)
+            THROW(LOCKER_WORKER_PUSH_ERROR);
+        locker->write_sequence = flt.sequence;
         
         THROW(NONE);
     } CATCH {
         switch (excp) {
-            case WRITE_ERROR1:
-                ret_cod = FLOM_RC_WRITE_ERROR;
-                break;
             case CONNS_TRNS_FD:
                 break;
-            case WRITE_ERROR2:
-                ret_cod = FLOM_RC_WRITE_ERROR;
+            case RING_FULL:
+                /* the worker thread is overloaded: the connection has
+                   already been detached and it's refused by this thread */
+                FLOM_TRACE(("flom_accept_loop_transfer_conn: worker %u is "
+                            "overloaded, refusing connection %u\n",
+                            locker->worker->id, id));
+                if (FLOM_RC_OK != (ret_cod = flom_accept_loop_reply(
+                                       conn, FLOM_RC_RING_FULL)))
+                    FLOM_TRACE(("flom_accept_loop_transfer_conn/"
+                                "flom_accept_loop_reply: ret_cod=%d\n",
+                                ret_cod));
+                flom_conn_terminate(conn);
+                flom_conn_delete(conn);
+                ret_cod = FLOM_RC_OK;
+                break;
+            case LOCKER_WORKER_PUSH_ERROR:
                 break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
@@ -1952,16 +2533,143 @@ int flom_accept_loop_transfer_conn(flom_conns_t *conns, guint id,
 
 
 
+int flom_accept_loop_incubator_transfer(flom_conns_t *conns,
+                                        const gchar *key,
+                                        struct flom_locker_s *locker)
+{
+    enum Exception { CONNS_GET_CD_ERROR
+                     , ACCEPT_LOOP_TRANSFER_CONN_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    GQueue *incubated = NULL;
+    
+    FLOM_TRACE(("flom_accept_loop_incubator_transfer: key='%s'\n", key));
+    TRY {
+        flom_conn_t *loop_conn;
+        guint i;
+
+        /* only the clients waiting for this resource are involved */
+        if (NULL == (incubated = flom_conns_incubator_take(conns, key)))
+            THROW(NONE);
+        while (NULL != (loop_conn = g_queue_pop_head(incubated))) {
+            i = flom_conn_get_conns_pos(loop_conn);
+            if (loop_conn != flom_conns_get_conn(conns, i))
+                THROW(CONNS_GET_CD_ERROR);
+            /* the client could have been disconnected */
+            if (FLOM_CONN_STATE_REMOVE == flom_conn_get_state(loop_conn))
+                continue;
+            FLOM_TRACE(("flom_accept_loop_incubator_transfer: connection %u "
+                        "(fd=%d) is waiting for resource '%s' and "
+                        "can be transferred to this locker\n",
+                        i, flom_tcp_get_sockfd(
+                            flom_conn_get_tcp(loop_conn)),
+                        flom_conn_get_msg(loop_conn)->
+                        body.lock_8.resource.name));
+            if (FLOM_RC_OK != (ret_cod = flom_accept_loop_transfer_conn(
+                                   conns, i, locker, loop_conn)))
+                THROW(ACCEPT_LOOP_TRANSFER_CONN_ERROR);
+            /* remove the connection from the incubator in the VFS
+               ram tree */
+            if (FLOM_RC_OK != (
+                    ret_cod = flom_vfs_ram_tree_del_conn(
+                        loop_conn->uid, TRUE))) {
+                FLOM_TRACE(("flom_accept_loop_incubator_transfer: unable to "
+                            "delete the info from VFS for this "
+                            "holder connection\n"));
+            }                  
+        } /* while (NULL != (loop_conn = ... */
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case CONNS_GET_CD_ERROR:
+                ret_cod = FLOM_RC_OBJ_CORRUPTED;
+                break;
+            case ACCEPT_LOOP_TRANSFER_CONN_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    if (NULL != incubated)
+        g_queue_free(incubated);
+    FLOM_TRACE(("flom_accept_loop_incubator_transfer/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_accept_loop_incubator_check(flom_conns_t *conns,
+                                     flom_locker_array_t *lockers,
+                                     gint *generation)
+{
+    enum Exception { ACCEPT_LOOP_INCUBATOR_TRANSFER_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    GList *keys = NULL;
+    int locked = FALSE;
+    
+    TRY {
+        GList *l;
+        gint current = flom_locker_array_get_generation(lockers);
+
+        /* no new lockers, or nobody is waiting for them */
+        if (current == *generation || 0 == flom_conns_get_incubated(conns)) {
+            *generation = current;
+            THROW(NONE);
+        }
+        FLOM_TRACE(("flom_accept_loop_incubator_check: generation %d -> %d, "
+                    "incubated connections=%u\n", *generation, current,
+                    flom_conns_get_incubated(conns)));
+        *generation = current;
+        flom_locker_array_lock(lockers);
+        locked = TRUE;
+        /* the transfer removes the key from the incubator: the list
+           must be retrieved before */
+        keys = g_hash_table_get_keys(conns->incubator);
+        for (l=keys; NULL != l; l=l->next) {
+            struct flom_locker_s *locker = flom_locker_array_lookup(
+                lockers, (const gchar *)l->data);
+            if (NULL == locker)
+                continue;
+            if (FLOM_RC_OK != (ret_cod = flom_accept_loop_incubator_transfer(
+                                   conns, (const gchar *)l->data, locker)))
+                THROW(ACCEPT_LOOP_INCUBATOR_TRANSFER_ERROR);
+        } /* for (l=keys; NULL != l; l=l->next) */
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case ACCEPT_LOOP_INCUBATOR_TRANSFER_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    if (locked)
+        flom_locker_array_unlock(lockers);
+    if (NULL != keys)
+        g_list_free(keys);
+    return ret_cod;
+}
+
+
+
 int flom_accept_loop_start_locker(flom_locker_array_t *lockers,
                                   struct flom_msg_s *msg,
                                   flom_rsrc_type_t flrt,
                                   flom_uid_t uid,
-                                  struct flom_locker_s **new_locker,
-                                  GThread **new_thread)
+                                  struct flom_locker_s **new_locker)
 {
     enum Exception { RESOURCE_INIT_ERROR
-                     , PIPE_ERROR
-                     , G_THREAD_NEW_ERROR
+                     , NULL_OBJECT
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
 
@@ -1969,35 +2677,26 @@ int flom_accept_loop_start_locker(flom_locker_array_t *lockers,
 
     FLOM_TRACE(("flom_accept_loop_start_locker\n"));
     TRY {
-        locker = g_malloc0(sizeof(struct flom_locker_s));
-        int pipefd[2];
-        gchar thread_name[10+SIZEOF_FLOM_UID_T*3];
+        /* a terminated locker is reused if available */
+        locker = flom_locker_array_new_locker(lockers);
         
         FLOM_TRACE(("flom_accept_loop_start_locker: creating a new locker "
                     "for resource '%s' with uid=" UINT64_T_FORMAT "\n",
                     msg->body.lock_8.resource.name, uid));
-        flom_locker_init(locker);
         if (FLOM_RC_OK != (ret_cod = flom_resource_init(
                                &locker->resource, flrt,
                                msg->body.lock_8.resource.name)))
             THROW(RESOURCE_INIT_ERROR);
-        /* creating a communication pipe for the new thread */
-        if (0 != pipe(pipefd))
-            THROW(PIPE_ERROR);
         locker->uid = uid;
-        locker->read_pipe = pipefd[0];
-        locker->write_pipe = pipefd[1];
+        if (NULL == (locker->key = flom_rsrc_get_key(
+                         flrt, msg->body.lock_8.resource.name)))
+            THROW(NULL_OBJECT);
         locker->idle_lifespan = msg->body.lock_8.resource.lifespan;
-        snprintf(thread_name, sizeof(thread_name),
-                 "Locker " FLOM_UID_T_FORMAT, uid);
-        if (NULL == (*new_thread = g_thread_new(
-                         thread_name, flom_locker_loop, (gpointer)locker))) {
-            THROW(G_THREAD_NEW_ERROR);
-        } else {
-            locker->thread = *new_thread;
-            FLOM_TRACE(("flom_accept_loop_start_locker: created thread %p\n",
-                        *new_thread));
-        }
+        /* the resource is pinned to a worker thread by its key */
+        locker->worker = flom_locker_array_get_worker(lockers, locker->key);
+        FLOM_TRACE(("flom_accept_loop_start_locker: locker %p will be "
+                    "hosted by worker %u (thread=%p)\n", locker,
+                    locker->worker->id, locker->worker->thread));
         /* add this locker to the array of all lockers */
         flom_locker_array_add(lockers, locker);
         /* return the new locker to caller function */
@@ -2010,11 +2709,8 @@ int flom_accept_loop_start_locker(flom_locker_array_t *lockers,
             case RESOURCE_INIT_ERROR:
                 ret_cod = FLOM_RC_RESOURCE_INIT_ERROR;
                 break;
-            case PIPE_ERROR:
-                ret_cod = FLOM_RC_PIPE_ERROR;
-                break;
-            case G_THREAD_NEW_ERROR:
-                ret_cod = FLOM_RC_G_THREAD_NEW_ERROR;
+            case NULL_OBJECT:
+                ret_cod = FLOM_RC_NULL_OBJECT;
                 break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
@@ -2027,8 +2723,7 @@ int flom_accept_loop_start_locker(flom_locker_array_t *lockers,
         /* clean-up locker */
         FLOM_TRACE(("flom_accept_start_locker: clean-up due to excp=%d\n",
                     excp));
-        flom_resource_free(&locker->resource);
-        g_free(locker);
+        flom_locker_array_park(lockers, locker);
     } /* if (NULL != locker) */
     FLOM_TRACE(("flom_accept_loop_start_locker/excp=%d/"
                 "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
@@ -2040,11 +2735,13 @@ int flom_accept_loop_start_locker(flom_locker_array_t *lockers,
 int flom_accept_loop_chklockers(flom_locker_array_t *lockers, int *again)
 {
     enum Exception { NULL_LOCKER
-                     , CLOSE_ERROR
+                     , LOCKER_WORKER_PUSH_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     
     FLOM_TRACE(("flom_accept_loop_chklockers\n"));
+    /* the acceptor threads could be adding new lockers */
+    flom_locker_array_lock(lockers);
     TRY {
         guint i;
         guint number_of_lockers = flom_locker_array_count(lockers);
@@ -2054,48 +2751,62 @@ int flom_accept_loop_chklockers(flom_locker_array_t *lockers, int *again)
             struct flom_locker_s *fl = flom_locker_array_get(lockers, i);
             if (NULL == fl)
                 THROW(NULL_LOCKER);
-            if (fl->write_sequence == fl->read_sequence &&
+            if (!fl->terminating &&
+                fl->write_sequence == fl->read_sequence &&
                 fl->idle_periods > FLOM_LOCKER_MAX_IDLE_PERIODS) {
-                if (fl->write_pipe != FLOM_NULL_FD) {
-                    FLOM_TRACE(("flom_accept_loop_chklockers: starting "
-                                "termination for locker %u (thread=%p, "
-                                "uid=" UINT64_T_FORMAT
-                                ", write_pipe=%d, read_pipe=%d, "
-                                "resource_name='%s', "
-                                "write_sequence=%d, read_sequence=%d, "
-                                "idle_periods=%d\n", i, fl->thread, fl->uid,
-                                fl->write_pipe, fl->read_pipe,
-                                flom_resource_get_name(&fl->resource),
-                                fl->write_sequence,
-                                fl->read_sequence, fl->idle_periods));
-                    if (-1 == close(fl->write_pipe))
-                        THROW(CLOSE_ERROR);
-                    fl->write_pipe = FLOM_NULL_FD;
-                } else if (fl->write_pipe == FLOM_NULL_FD &&
-                           fl->read_pipe == FLOM_NULL_FD) {
-                    gpointer thread_ret_cod;
-                    FLOM_TRACE(("flom_accept_loop_chklockers: completing "
-                                "termination for locker %u (thread=%p, "
-                                "uid=" UINT64_T_FORMAT
-                                ", write_pipe=%d, read_pipe=%d, "
-                                "resource_name='%s', "
-                                "write_sequence=%d, read_sequence=%d, "
-                                "idle_periods=%d\n", i, fl->thread, fl->uid,
-                                fl->write_pipe, fl->read_pipe,
-                                flom_resource_get_name(&fl->resource),
-                                fl->write_sequence,
-                                fl->read_sequence, fl->idle_periods));
-                    /* join already terminated child thread */
-                    thread_ret_cod = g_thread_join(fl->thread);
-                    FLOM_TRACE(("flom_accept_loop_chklockers/g_thread_join"
-                                "(%p)=%p\n", fl->thread, thread_ret_cod));
-                    flom_locker_array_del(lockers, fl);
-                    /* lockers object changed, break the loop, but call me
-                       as soon as possible */
-                    *again = TRUE;
-                    break;
-                }
-            } /* if (fl->write_sequence == fl->read_sequence && ... */
+                struct flom_locker_token_s flt;
+                FLOM_TRACE(("flom_accept_loop_chklockers: starting "
+                            "termination for locker %u (worker=%u, "
+                            "uid=" UINT64_T_FORMAT ", "
+                            "resource_name='%s', "
+                            "write_sequence=%d, read_sequence=%d, "
+                            "idle_periods=%d\n", i, fl->worker->id,
+                            fl->uid, flom_resource_get_name(&fl->resource),
+                            fl->write_sequence,
+                            fl->read_sequence, fl->idle_periods));
+                /* ask the worker thread to detach the locker */
+                memset(&flt, 0, sizeof(flt));
+                flt.command = FLOM_LOCKER_CMD_TERMINATE;
+                flt.locker = fl;
+                flt.client_fd = FLOM_NULL_FD;
+                ret_cod = flom_locker_worker_push(fl->worker, &flt, NULL);
+                if (FLOM_RC_RING_FULL == ret_cod) {
+                    /* the termination is retried at next check */
+                    continue;
+                } else if (FLOM_RC_OK != ret_cod)
+                    THROW(LOCKER_WORKER_PUSH_ERROR);
+                /* new requests for the same resource must start a
+                   new locker */
+                flom_locker_array_unindex(lockers, fl);
+                fl->terminating = TRUE;
+            } else if (0 == fl->write_sequence) {
+                /* the first connection could not be queued to the worker
+                   thread: the locker has never been hosted */
+                FLOM_TRACE(("flom_accept_loop_chklockers: removing locker "
+                            "%u never hosted by worker %u\n", i,
+                            fl->worker->id));
+                flom_locker_array_del(lockers, fl);
+                *again = TRUE;
+                break;
+            } else if (fl->terminating &&
+                       g_atomic_int_get(&fl->terminated)) {
+                FLOM_TRACE(("flom_accept_loop_chklockers: completing "
+                            "termination for locker %u (worker=%u, "
+                            "uid=" UINT64_T_FORMAT ", "
+                            "resource_name='%s', "
+                            "write_sequence=%d, read_sequence=%d, "
+                            "idle_periods=%d\n", i, fl->worker->id,
+                            fl->uid, flom_resource_get_name(&fl->resource),
+                            fl->write_sequence,
+                            fl->read_sequence, fl->idle_periods));
+                /* the worker thread does not reference the locker
+                   anymore */
+                flom_locker_array_del(lockers, fl);
+                /* lockers object changed, break the loop, but call me
+                   as soon as possible */
+                *again = TRUE;
+                break;
+            }
         } /* for (i=0; i<number_of_lockers; ++i) */
         
         THROW(NONE);
@@ -2104,8 +2815,7 @@ int flom_accept_loop_chklockers(flom_locker_array_t *lockers, int *again)
             case NULL_LOCKER:
                 ret_cod = FLOM_RC_NULL_OBJECT;
                 break;
-            case CLOSE_ERROR:
-                ret_cod = FLOM_RC_CLOSE_ERROR;
+            case LOCKER_WORKER_PUSH_ERROR:
                 break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
@@ -2114,6 +2824,7 @@ int flom_accept_loop_chklockers(flom_locker_array_t *lockers, int *again)
                 ret_cod = FLOM_RC_INTERNAL_ERROR;
         } /* switch (excp) */
     } /* TRY-CATCH */
+    flom_locker_array_unlock(lockers);
     FLOM_TRACE(("flom_accept_loop_chklockers/excp=%d/"
                 "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
     return ret_cod;
@@ -2142,6 +2853,7 @@ int flom_accept_loop_reply(flom_conn_t *conn, int rc)
                                &msg, FLOM_MSG_VERB_LOCK, 2*FLOM_MSG_STEP_INCR,
                                rc, NULL)))
             THROW(MSG_BUILD_ANSWER_ERROR);
+        msg.header.level = flom_conn_get_level(conn);
         /* serialize the message to the buffer */
         if (FLOM_RC_OK != (ret_cod = flom_msg_serialize(
                                &msg, buffer, sizeof(buffer), &to_send)))
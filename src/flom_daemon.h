@@ -43,6 +43,65 @@
 
 
 
+/**
+ * Maximum time (milliseconds) spent inside poll by a thread that accepts
+ * connections when the daemon uses more than one acceptor thread: the
+ * threads must periodically check the termination flag and the lockers
+ * created by the other acceptor threads
+ */
+#define FLOM_ACCEPTOR_POLL_TIMEOUT   100
+
+
+
+/**
+ * Maximum number of connections accepted for every POLLIN event of the
+ * listener socket: the backlog is drained in batches to serve the clients
+ * already connected with a fair latency
+ */
+#define FLOM_ACCEPT_BATCH_SIZE        64
+
+
+
+/**
+ * Additional acceptor thread of a TCP/IP daemon: it owns a listener socket
+ * bound to the same address of the main thread (SO_REUSEPORT) and the
+ * connections accepted through it; the connections are transferred to
+ * the lockers of the registry shared by all the acceptor threads
+ */
+typedef struct flom_acceptor_s {
+    /**
+     * Identifier of the acceptor thread (the main thread is 0)
+     */
+    guint                      id;
+    /**
+     * Thread accepting the connections
+     */
+    GThread                   *thread;
+    /**
+     * Configuration object, NULL for global config
+     */
+    flom_config_t             *config;
+    /**
+     * Listener and client connections managed by the thread
+     */
+    flom_conns_t               conns;
+    /**
+     * Registry of the lockers shared by all the acceptor threads
+     */
+    flom_locker_array_t       *lockers;
+    /**
+     * Number of client connections still managed by the thread (it's
+     * atomically updated): the daemon can not exit while it's not zero
+     */
+    gint                       active;
+    /**
+     * Termination flag set by the main thread (it's atomically updated)
+     */
+    gint                       stop;
+} flom_acceptor_t;
+
+
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -144,6 +203,80 @@ extern "C" {
 
 
 
+    /**
+     * Create the listener sockets and start the additional acceptor
+     * threads of a TCP/IP daemon
+     * @param config IN configuration object, NULL for global config
+     * @param domain IN socket domain of the daemon
+     * @param lockers IN/OUT registry of the lockers shared by all the
+     *        acceptor threads
+     * @param number IN number of additional acceptor threads
+     * @param acceptors OUT array of the started acceptor threads (it must
+     *        be released with @ref flom_accept_loop_stop_acceptors)
+     * @return a reason code
+     */
+    int flom_accept_loop_start_acceptors(flom_config_t *config, int domain,
+                                         flom_locker_array_t *lockers,
+                                         guint number,
+                                         flom_acceptor_t **acceptors);
+
+
+
+    /**
+     * Stop the additional acceptor threads and release them
+     * @param acceptors IN/OUT array of acceptor threads
+     * @param number IN number of acceptor threads
+     */
+    void flom_accept_loop_stop_acceptors(flom_acceptor_t *acceptors,
+                                         guint number);
+
+
+
+    /**
+     * Count the client connections still managed by the additional
+     * acceptor threads
+     * @param acceptors IN array of acceptor threads
+     * @param number IN number of acceptor threads
+     * @return the number of client connections
+     */
+    guint flom_accept_loop_acceptors_active(flom_acceptor_t *acceptors,
+                                            guint number);
+
+
+
+    /**
+     * Main loop function for an additional acceptor thread
+     * @param data IN pointer to the acceptor context, it must be a pointer
+     *        to @ref flom_acceptor_t
+     */
+    gpointer flom_accept_loop_acceptor(gpointer data);
+
+
+
+    /**
+     * Manage the file descriptors returned ready by the last poll
+     * @param config IN configuration object, NULL for global config
+     * @param conns IN/OUT connections object
+     * @param lockers IN/OUT array of lockers serving the connected clients
+     * @return a reason code
+     */
+    int flom_accept_loop_scan(flom_config_t *config, flom_conns_t *conns,
+                              flom_locker_array_t *lockers);
+
+
+
+    
+    /**
+     * Close a connection managed by an acceptor thread; if the connection
+     * is part of a multiple lock request, the request is terminated first
+     * @param conns IN/OUT connections object
+     * @param id IN connection id
+     * @return a reason code
+     */
+    int flom_accept_loop_close_fd(flom_conns_t *conns, guint id);
+
+
+
     /**
      * Manager POLLIN event received from listener daemon
      * @param config IN configuration object, NULL for global config
@@ -161,6 +294,23 @@ extern "C" {
 
 
 
+    /**
+     * Accept a pending connection from the listener socket (it must be a
+     * non blocking socket) and add it to the connections object
+     * @param config IN configuration object, NULL for global config
+     * @param conns IN/OUT connections object
+     * @param listener IN listener connection
+     * @param accepted OUT boolean value: TRUE a connection was accepted,
+     *                     FALSE the backlog is empty
+     * @return a reason code
+     */
+    int flom_accept_loop_accept(flom_config_t *config,
+                                flom_conns_t *conns,
+                                flom_conn_t *listener,
+                                int *accepted);
+
+
+
     /**
      * Perform the TLS accept step for the connection (if necessary)
      * @param config IN configuration object, NULL for global config
@@ -170,6 +320,20 @@ extern "C" {
     int flom_accept_loop_pollin_tls(flom_config_t *config,
                                     flom_conn_t *conn);
 
+
+
+    /**
+     * Drive a step of the non blocking TLS handshake of a connection: it's
+     * called when the connection is accepted and every time the socket is
+     * ready for the direction requested by the handshake. When the
+     * handshake completes, the socket is switched back to blocking mode
+     * @param conn IN/OUT connection object
+     * @return a reason code, @ref FLOM_RC_TLS_HANDSHAKE_IN_PROGRESS if the
+     *         handshake must be resumed later: the events of the connection
+     *         (see @ref flom_conn_get_events) are updated accordingly
+     */
+    int flom_accept_loop_handshake(flom_conn_t *conn);
+
     
 
     /**
@@ -188,8 +352,7 @@ extern "C" {
      * details related to connection movement
      * @param conns IN/OUT connections object
      * @param id IN connection id
-     * @param locker IN/OUT locker object associated to locker thread that
-     *                      will host the connection
+     * @param locker IN/OUT locker object that will host the connection
      * @param conn IN connection that must be transferred to the locker
      * @return a reason code
      */
@@ -197,6 +360,37 @@ extern "C" {
                                        struct flom_locker_s *locker,
                                        flom_conn_t *conn);
 
+
+
+    /**
+     * Transfer to a locker all the connections waiting inside the
+     * incubator for its resource; the caller must lock the registry of
+     * the lockers
+     * @param conns IN/OUT connections object
+     * @param key IN normalized resource name (see @ref flom_rsrc_get_key)
+     * @param locker IN/OUT locker object that will host the connections
+     * @return a reason code
+     */
+    int flom_accept_loop_incubator_transfer(flom_conns_t *conns,
+                                            const gchar *key,
+                                            struct flom_locker_s *locker);
+
+
+
+    /**
+     * Check if some lockers created by other acceptor threads can serve
+     * the connections waiting inside the incubator and transfer them
+     * @param conns IN/OUT connections object
+     * @param lockers IN/OUT array of lockers serving the connected clients
+     * @param generation IN/OUT generation of the registry of the lockers
+     *        seen by the last check (see
+     *        @ref flom_locker_array_get_generation)
+     * @return a reason code
+     */
+    int flom_accept_loop_incubator_check(flom_conns_t *conns,
+                                         flom_locker_array_t *lockers,
+                                         gint *generation);
+
     
 
     /**
@@ -205,16 +399,15 @@ extern "C" {
      * @param msg IN message carrying the request
      * @param flrt IN type of resource will be assigned to the new locker
      * @param uid IN unique identifier to be assigned to the new locker
-     * @param new_locker OUT new locker allocated for the resource
-     * @param new_thread OUT new thread started for the new locker
+     * @param new_locker OUT new locker allocated for the resource and
+     *        assigned to one of the locker worker threads
      * @return a reason code
      */
     int flom_accept_loop_start_locker(flom_locker_array_t *lockers,
                                       struct flom_msg_s *msg,
                                       flom_rsrc_type_t flrt,
                                       flom_uid_t uid,
-                                      struct flom_locker_s **new_locker,
-                                      GThread **new_thread);
+                                      struct flom_locker_s **new_locker);
 
     
 
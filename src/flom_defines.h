@@ -270,6 +270,15 @@
 
 
 
+/**
+ * Maximum time (milliseconds) a send operation waits for a non blocking
+ * socket that can not accept more bytes: a peer that does not read its
+ * answers is disconnected instead of stopping the thread that serves it
+ */
+#define FLOM_NETWORK_SEND_TIMEOUT   1000
+
+
+
 #ifdef HAVE_STRCASESTR
 /**
  * If "strcasstr" is available, strings are checked case insensitive; else
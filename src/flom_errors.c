@@ -28,6 +28,12 @@ const char *flom_strerror(int ret_cod)
 {
     switch (ret_cod) {
         /* WARNINGS */
+        case FLOM_RC_WOULD_BLOCK:
+            return "WARNING: a complete message is not yet available on a "
+                "non blocking socket";
+        case FLOM_RC_TLS_HANDSHAKE_IN_PROGRESS:
+            return "WARNING: TLS handshake is in progress and it must be "
+                "resumed";
         case FLOM_RC_INACTIVE_FEATURE:
             return "WARNING: a feature is inactive and a piece of code was "
                 "skipped";
@@ -133,6 +139,15 @@ const char *flom_strerror(int ret_cod)
             return "ERROR: the server has unilaterally closed the connection";
         case FLOM_RC_OBJ_NOT_FOUND_ERROR:
             return "ERROR: object not found";
+        case FLOM_RC_XML_SYNTAX_ERROR:
+            return "ERROR: the XML message does not comply with the subset "
+                "of XML used by FLoM";
+        case FLOM_RC_DUPLICATED_RESOURCE:
+            return "ERROR: the same resource (or resource tree) is requested "
+                "more than once";
+        case FLOM_RC_RING_FULL:
+            return "ERROR: the locker worker thread is overloaded or "
+                "not running";
             /* system function error */
         case FLOM_RC_ACCEPT_ERROR:
             return "ERROR: 'accept' function returned an error condition";
@@ -225,6 +240,22 @@ const char *flom_strerror(int ret_cod)
             return "ERROR: 'wait' function returned an error condition";
         case FLOM_RC_WRITE_ERROR:
             return "ERROR: 'write' function returned an error condition";
+        case FLOM_RC_EPOLL_WAIT_ERROR:
+            return "ERROR: 'epoll_wait' function returned an error condition";
+        case FLOM_RC_EVENTFD_ERROR:
+            return "ERROR: 'eventfd' function returned an error condition";
+        case FLOM_RC_SOCKETPAIR_ERROR:
+            return "ERROR: 'socketpair' function returned an error "
+                "condition";
+        case FLOM_RC_RENAME_ERROR:
+            return "ERROR: 'rename' function returned an error "
+                "condition";
+        case FLOM_RC_MKSTEMP_ERROR:
+            return "ERROR: 'mkstemp' function returned an error "
+                "condition";
+        case FLOM_RC_FCHMOD_ERROR:
+            return "ERROR: 'fchmod' function returned an error "
+                "condition";
             /* GLIB related errors */
         case FLOM_RC_G_ARRAY_NEW_ERROR:
             return "ERROR: 'g_array_new' function returned an error condition";
@@ -249,12 +280,6 @@ const char *flom_strerror(int ret_cod)
         case FLOM_RC_G_NODE_PREPEND_DATA_ERROR:
             return "ERROR: 'g_node_prepend_data' function returned "
                 "an error condition";
-        case FLOM_RC_G_MARKUP_PARSE_CONTEXT_NEW_ERROR:
-            return "ERROR: 'g_markup_parse_context_new' function returned "
-                "an error condition";
-        case FLOM_RC_G_MARKUP_PARSE_CONTEXT_PARSE_ERROR:
-            return "ERROR: 'g_markup_parse_context_parse' function returned "
-                "an error condition";
         case FLOM_RC_G_PTR_ARRAY_REMOVE_INDEX_FAST_ERROR:
             return "ERROR: 'g_ptr_array_remove_index_fast' function returned "
                 "an error condition";
@@ -322,6 +347,9 @@ const char *flom_strerror(int ret_cod)
                 "returned an error";
         case FLOM_RC_TLS_NO_VALID_METHOD:
             return "ERROR: no valid TLS/SSL method was found";
+        case FLOM_RC_SSL_CTX_SET_SESSION_ID_CONTEXT_ERROR:
+            return "ERROR: 'OpenSSL SSL_CTX_set_session_id_context' "
+                "function returned an error";
         default:
             return "ERROR: unknown error";
     } /* switch (ret_cod) */
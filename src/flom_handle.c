@@ -179,7 +179,8 @@ int flom_handle_clean(flom_handle_t *handle)
     FLOM_TRACE(("flom_handle_clean\n"));
     TRY {
         /* is the handle locked? we must unlock it before going on... */
-        if (FLOM_HANDLE_STATE_LOCKED == handle->state) {
+        if (FLOM_HANDLE_STATE_LOCKED == handle->state ||
+            FLOM_HANDLE_STATE_PIPELINED == handle->state) {
             if (FLOM_RC_OK != (ret_cod = flom_handle_unlock(handle)))
                 THROW(FLOM_HANDLE_UNLOCK_ERROR);
         }
@@ -342,6 +343,306 @@ int flom_handle_lock(flom_handle_t *handle)
 
 
 
+int flom_handle_lock_many(flom_handle_t *handle,
+                          const char *resource_names[],
+                          const flom_lock_mode_t lock_modes[],
+                          int resource_number)
+{
+    enum Exception { NULL_OBJECT1
+                     , NULL_OBJECT2
+                     , API_INVALID_SEQUENCE
+                     , OBJ_CORRUPTED
+                     , CLIENT_CONNECT_ERROR
+                     , CLIENT_LOCK_MANY_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+
+    /* check flom library is initialized */
+    if (FLOM_RC_OK != (ret_cod = flom_init_check()))
+        return ret_cod;
+    
+    FLOM_TRACE(("flom_handle_lock_many\n"));
+    TRY {
+        flom_conn_t *conn = NULL;
+        /* check handle and resource names are not NULL */
+        if (NULL == handle)
+            THROW(NULL_OBJECT1);
+        if (NULL == resource_names)
+            THROW(NULL_OBJECT2);
+        /* cast and retrieve conn fron the proxy object */
+        conn = (flom_conn_t *)handle->conn;
+        /* check handle state */
+        if (FLOM_HANDLE_STATE_INIT != handle->state &&
+            FLOM_HANDLE_STATE_CONNECTED != handle->state &&
+            FLOM_HANDLE_STATE_DISCONNECTED != handle->state) {
+            FLOM_TRACE(("flom_handle_lock_many: handle->state=%d\n",
+                        handle->state));
+            THROW(API_INVALID_SEQUENCE);
+        }
+        /* check the connection data pointer is not NULL (we can't be sure
+           it's a valid pointer) */
+        if (NULL == handle->conn)
+            THROW(OBJ_CORRUPTED);
+        /* open a connection to a valid lock manager */
+        if (FLOM_HANDLE_STATE_CONNECTED != handle->state) {
+            if (FLOM_RC_OK != (ret_cod = flom_client_connect(
+                                   handle->config, conn, TRUE)))
+                THROW(CLIENT_CONNECT_ERROR);
+            /* state update */
+            handle->state = FLOM_HANDLE_STATE_CONNECTED;
+        } else {
+            FLOM_TRACE(("flom_handle_lock_many: handle already connected "
+                        "(%d), skipping...\n", handle->state));
+        }
+        /* lock acquisition: one request for all the resources */
+        if (FLOM_RC_OK != (ret_cod = flom_client_lock_many(
+                               handle->config, conn,
+                               flom_config_get_resource_timeout(
+                                   handle->config),
+                               resource_names, lock_modes,
+                               resource_number)))
+            THROW(CLIENT_LOCK_MANY_ERROR);
+        /* state update */
+        handle->state = FLOM_HANDLE_STATE_LOCKED;
+
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case API_INVALID_SEQUENCE:
+                ret_cod = FLOM_RC_API_INVALID_SEQUENCE;
+                break;
+            case NULL_OBJECT1:
+            case NULL_OBJECT2:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
+            case OBJ_CORRUPTED:
+                ret_cod = FLOM_RC_OBJ_CORRUPTED;
+                break;
+            case CLIENT_CONNECT_ERROR:
+            case CLIENT_LOCK_MANY_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_handle_lock_many/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+/**
+ * This is a private library function, not exposed in the interface, that's
+ * used by @ref flom_handle_pipeline_lock , @ref flom_handle_pipeline_unlock
+ * and @ref flom_handle_pipeline_ping .
+ * See above functions for more details.
+ * @param handle (Input/Output): a valid object handle
+ * @param request_id (Input): id of the request
+ * @param verb (Input): verb of the request
+ * @param resource_name (Input): name of the resource (lock requests only)
+ * @return a reason code
+ */
+int flom_handle_pipeline_request(flom_handle_t *handle, int request_id,
+                                 int verb, const char *resource_name)
+{
+    enum Exception { NULL_OBJECT
+                     , OUT_OF_RANGE
+                     , API_INVALID_SEQUENCE
+                     , OBJ_CORRUPTED
+                     , CLIENT_CONNECT_ERROR
+                     , CLIENT_PIPELINE_REQUEST_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+
+    /* check flom library is initialized */
+    if (FLOM_RC_OK != (ret_cod = flom_init_check()))
+        return ret_cod;
+    
+    FLOM_TRACE(("flom_handle_pipeline_request: request_id=%d, verb=%d\n",
+                request_id, verb));
+    TRY {
+        flom_conn_t *conn = NULL;
+        /* check handle is not NULL */
+        if (NULL == handle)
+            THROW(NULL_OBJECT);
+        /* cast and retrieve conn fron the proxy object */
+        conn = (flom_conn_t *)handle->conn;
+        /* check the request id before connecting to the daemon */
+        if (0 >= request_id)
+            THROW(OUT_OF_RANGE);
+        /* check handle state: an unlock request must follow a lock
+           request */
+        if ((FLOM_MSG_VERB_UNLOCK == verb &&
+             FLOM_HANDLE_STATE_PIPELINED != handle->state) ||
+            (FLOM_HANDLE_STATE_INIT != handle->state &&
+             FLOM_HANDLE_STATE_CONNECTED != handle->state &&
+             FLOM_HANDLE_STATE_DISCONNECTED != handle->state &&
+             FLOM_HANDLE_STATE_PIPELINED != handle->state)) {
+            FLOM_TRACE(("flom_handle_pipeline_request: handle->state=%d\n",
+                        handle->state));
+            THROW(API_INVALID_SEQUENCE);
+        }
+        /* check the connection data pointer is not NULL (we can't be sure
+           it's a valid pointer) */
+        if (NULL == handle->conn)
+            THROW(OBJ_CORRUPTED);
+        /* open a connection to a valid lock manager */
+        if (FLOM_HANDLE_STATE_CONNECTED != handle->state &&
+            FLOM_HANDLE_STATE_PIPELINED != handle->state) {
+            if (FLOM_RC_OK != (ret_cod = flom_client_connect(
+                                   handle->config, conn, TRUE)))
+                THROW(CLIENT_CONNECT_ERROR);
+            /* state update */
+            handle->state = FLOM_HANDLE_STATE_CONNECTED;
+        } else {
+            FLOM_TRACE(("flom_handle_pipeline_request: handle already "
+                        "connected (%d), skipping...\n", handle->state));
+        }
+        /* send the request, the answer will be picked up by
+           flom_handle_pipeline_wait */
+        if (FLOM_RC_OK != (ret_cod = flom_client_pipeline_request(
+                               handle->config, conn, request_id, verb,
+                               resource_name, FALSE)))
+            THROW(CLIENT_PIPELINE_REQUEST_ERROR);
+        /* state update */
+        handle->state = FLOM_HANDLE_STATE_PIPELINED;
+
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case NULL_OBJECT:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
+            case OUT_OF_RANGE:
+                ret_cod = FLOM_RC_OUT_OF_RANGE;
+                break;
+            case API_INVALID_SEQUENCE:
+                ret_cod = FLOM_RC_API_INVALID_SEQUENCE;
+                break;
+            case OBJ_CORRUPTED:
+                ret_cod = FLOM_RC_OBJ_CORRUPTED;
+                break;
+            case CLIENT_CONNECT_ERROR:
+            case CLIENT_PIPELINE_REQUEST_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_handle_pipeline_request/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_handle_pipeline_lock(flom_handle_t *handle, int request_id,
+                              const char *resource_name)
+{
+    if (NULL == resource_name)
+        return FLOM_RC_NULL_OBJECT;
+    return flom_handle_pipeline_request(handle, request_id,
+                                        FLOM_MSG_VERB_LOCK, resource_name);
+}
+
+
+
+int flom_handle_pipeline_unlock(flom_handle_t *handle, int request_id)
+{
+    return flom_handle_pipeline_request(handle, request_id,
+                                        FLOM_MSG_VERB_UNLOCK, NULL);
+}
+
+
+
+int flom_handle_pipeline_ping(flom_handle_t *handle, int request_id)
+{
+    return flom_handle_pipeline_request(handle, request_id,
+                                        FLOM_MSG_VERB_PING, NULL);
+}
+
+
+
+int flom_handle_pipeline_wait(flom_handle_t *handle, int *request_id,
+                              int *rc)
+{
+    enum Exception { NULL_OBJECT
+                     , API_INVALID_SEQUENCE
+                     , OBJ_CORRUPTED
+                     , CLIENT_PIPELINE_ANSWER_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+
+    /* check flom library is initialized */
+    if (FLOM_RC_OK != (ret_cod = flom_init_check()))
+        return ret_cod;
+    
+    FLOM_TRACE(("flom_handle_pipeline_wait\n"));
+    TRY {
+        int verb;
+        char *element = NULL;
+        
+        /* check handle and output parameters are not NULL */
+        if (NULL == handle || NULL == request_id || NULL == rc)
+            THROW(NULL_OBJECT);
+        /* check handle state */
+        if (FLOM_HANDLE_STATE_PIPELINED != handle->state) {
+            FLOM_TRACE(("flom_handle_pipeline_wait: handle->state=%d\n",
+                        handle->state));
+            THROW(API_INVALID_SEQUENCE);
+        }
+        /* check the connection data pointer is not NULL (we can't be sure
+           it's a valid pointer) */
+        if (NULL == handle->conn)
+            THROW(OBJ_CORRUPTED);
+        /* retrieve the next answer */
+        if (FLOM_RC_OK != (ret_cod = flom_client_pipeline_answer(
+                               handle->config, (flom_conn_t *)handle->conn,
+                               flom_config_get_resource_timeout(
+                                   handle->config),
+                               request_id, &verb, rc, &element)))
+            THROW(CLIENT_PIPELINE_ANSWER_ERROR);
+        /* keep the element of the last granted request */
+        if (NULL != element) {
+            g_free(handle->locked_element);
+            handle->locked_element = element;
+        }
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case NULL_OBJECT:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
+            case API_INVALID_SEQUENCE:
+                ret_cod = FLOM_RC_API_INVALID_SEQUENCE;
+                break;
+            case OBJ_CORRUPTED:
+                ret_cod = FLOM_RC_OBJ_CORRUPTED;
+                break;
+            case CLIENT_PIPELINE_ANSWER_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_handle_pipeline_wait/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
 /**
  * This is a private library function, not exposed in the interface, that's
  * used both by @ref flom_handle_unlock and by
@@ -379,7 +680,8 @@ int flom_handle_unlock_internal(flom_handle_t *handle, int rollback)
         conn = (flom_conn_t *)handle->conn;
         /* check handle state */
         if (FLOM_HANDLE_STATE_LOCKED != handle->state &&
-            FLOM_HANDLE_STATE_CONNECTED != handle->state) {
+            FLOM_HANDLE_STATE_CONNECTED != handle->state &&
+            FLOM_HANDLE_STATE_PIPELINED != handle->state) {
             FLOM_TRACE(("flom_handle_unlock_internal: handle->state=%d\n",
                         handle->state));
             THROW(API_INVALID_SEQUENCE);
@@ -411,8 +713,11 @@ int flom_handle_unlock_internal(flom_handle_t *handle, int rollback)
             /* state update */
             handle->state = FLOM_HANDLE_STATE_CONNECTED;
         } else {
+            /* the daemon releases the resources of the pipelined requests
+               when the connection is closed */
             FLOM_TRACE(("flom_handle_unlock_internal: resource already "
-                        "unlocked (%d), skipping...\n", handle->state));
+                        "unlocked or pipelined (%d), skipping...\n",
+                        handle->state));
         }
         /* gracefully disconnect from daemon */
         if (FLOM_RC_OK != (ret_cod = flom_client_disconnect(conn)))
@@ -54,7 +54,13 @@ typedef enum flom_handle_state_e {
      * The handle memory was released and the handle itself can NOT be used
      * without a call to @ref flom_handle_init method
      */
-    FLOM_HANDLE_STATE_CLEANED
+    FLOM_HANDLE_STATE_CLEANED,
+    /**
+     * The client is connected to the daemon and it has sent pipelined
+     * requests: the handle can be released only with
+     * @ref flom_handle_unlock , that releases all the resources
+     */
+    FLOM_HANDLE_STATE_PIPELINED
 } flom_handle_state_t;
 
 
@@ -148,6 +154,91 @@ extern "C" {
 
 
 
+    /**
+     * Locks a list of (logical) resources with a single request: the lock
+     * manager grants all the resources or none of them. The resources MUST
+     * be unlocked using function @ref flom_handle_unlock when the lock
+     * condition is no more necessary.<P>
+     * Note: only simple, numeric and hierarchical resources can be locked
+     * together and a resource (the root of a hierarchical resource) can
+     * not be specified more than once; the other properties (wait timeout,
+     * quantity, create and idle lifespan) are the ones of the handle
+     * @param handle (Input/Output): a valid object handle
+     * @param resource_names (Input): names of the resources to lock
+     * @param lock_modes (Input): lock modes of the resources; NULL means
+     *        the lock mode of the handle for all the resources
+     * @param resource_number (Input): number of resources (max 32)
+     * @return a reason code (see file @ref flom_errors.h)
+     */
+    int flom_handle_lock_many(flom_handle_t *handle,
+                              const char *resource_names[],
+                              const flom_lock_mode_t lock_modes[],
+                              int resource_number);
+
+
+
+    /**
+     * Sends a pipelined lock request without waiting for its answer: more
+     * requests can be sent on the same connection and the answers,
+     * retrieved with @ref flom_handle_pipeline_wait , are returned as soon
+     * as the resources are granted, not in the order of the requests.
+     * The properties of the request (lock mode, wait timeout, quantity,
+     * create and idle lifespan) are the ones of the handle.<P>
+     * Note: the resource is released by @ref flom_handle_pipeline_unlock
+     *       or, together with all the other resources, by
+     *       @ref flom_handle_unlock
+     * @param handle (Input/Output): a valid object handle
+     * @param request_id (Input): positive id of the request, it can not be
+     *        used by another request until the resource is unlocked
+     * @param resource_name (Input): name of the resource to lock
+     * @return a reason code (see file @ref flom_errors.h)
+     */
+    int flom_handle_pipeline_lock(flom_handle_t *handle, int request_id,
+                                  const char *resource_name);
+
+
+
+    /**
+     * Sends a pipelined unlock request: the resource locked (or waited)
+     * by the pipelined lock request with the same id is released; the
+     * daemon does not answer unlock requests
+     * @param handle (Input/Output): a valid object handle
+     * @param request_id (Input): id of the lock request
+     * @return a reason code (see file @ref flom_errors.h)
+     */
+    int flom_handle_pipeline_unlock(flom_handle_t *handle, int request_id);
+
+
+
+    /**
+     * Sends a pipelined ping request: the daemon answers it immediately,
+     * even if some lock requests of the same connection are waiting for
+     * their resources
+     * @param handle (Input/Output): a valid object handle
+     * @param request_id (Input): positive id of the request
+     * @return a reason code (see file @ref flom_errors.h)
+     */
+    int flom_handle_pipeline_ping(flom_handle_t *handle, int request_id);
+
+
+
+    /**
+     * Waits the next answer of the pipelined requests of an handle; the
+     * wait timeout is the resource timeout of the handle. The element
+     * locked by a request (resource sets) can be retrieved with
+     * @ref flom_handle_get_locked_element until the next answer
+     * @param handle (Input/Output): a valid object handle
+     * @param request_id (Output): id of the answered request
+     * @param rc (Output): return code of the answered request;
+     *        @ref FLOM_RC_LOCK_ENQUEUED means the request is waiting for
+     *        the resource and another answer will follow
+     * @return a reason code (see file @ref flom_errors.h)
+     */
+    int flom_handle_pipeline_wait(flom_handle_t *handle, int *request_id,
+                                  int *rc);
+
+
+
     /**
      * Unlocks the (logical) resource linked to an handle; the resource MUST
      * be previously locked using function @ref flom_handle_lock
@@ -23,6 +23,12 @@
 #ifdef HAVE_REGEX_H
 # include <regex.h>
 #endif
+#ifdef HAVE_SYSLOG_H
+# include <syslog.h>
+#endif
+#ifdef HAVE_SYS_EVENTFD_H
+# include <sys/eventfd.h>
+#endif
 #ifdef HAVE_SYS_TIME_H
 # include <sys/time.h>
 #endif
@@ -39,6 +45,7 @@
 #include "flom_errors.h"
 #include "flom_locker.h"
 #include "flom_rsrc.h"
+#include "flom_syslog.h"
 #include "flom_tcp.h"
 #include "flom_trace.h"
 #include "flom_vfs.h"
@@ -57,10 +64,7 @@ void flom_locker_destroy(struct flom_locker_s *locker)
 {
     if (NULL != locker) {
         flom_resource_free(&locker->resource);
-        if (FLOM_NULL_FD != locker->write_pipe)
-            close(locker->write_pipe);
-        if (FLOM_NULL_FD != locker->read_pipe)
-            close(locker->read_pipe);
+        g_free(locker->key);
         g_free(locker);
     }
 }
@@ -69,16 +73,228 @@ void flom_locker_destroy(struct flom_locker_s *locker)
 
 void flom_locker_array_init(flom_locker_array_t *lockers)
 {
-    lockers->locker_array = g_ptr_array_new_with_free_func(
+    /* lockers removed from the array are parked, not destroyed */
+    lockers->locker_array = g_ptr_array_new();
+    /* keys are owned by the lockers, values are owned by the array */
+    lockers->locker_index = g_hash_table_new(g_str_hash, g_str_equal);
+    lockers->worker_number = 0;
+    lockers->workers = NULL;
+    lockers->locker_cache = g_ptr_array_new_with_free_func(
         (GDestroyNotify)flom_locker_destroy);
+    lockers->cache_hits = lockers->cache_misses = 0;
+    lockers->batch_messages = lockers->batch_writes = 0;
+    g_mutex_init(&lockers->mutex);
+    lockers->generation = 0;
 }
 
 
 
 void flom_locker_array_free(flom_locker_array_t *lockers)
 {
+    /* worker threads can reference the lockers: they must be stopped
+       before lockers destruction */
+    flom_locker_array_stop_workers(lockers);
+    g_hash_table_destroy(lockers->locker_index);
+    lockers->locker_index = NULL;
+    g_ptr_array_foreach(lockers->locker_array, (GFunc)flom_locker_destroy,
+                        NULL);
     g_ptr_array_free(lockers->locker_array, TRUE);
     lockers->locker_array = NULL;
+    g_ptr_array_free(lockers->locker_cache, TRUE);
+    lockers->locker_cache = NULL;
+    g_mutex_clear(&lockers->mutex);
+}
+
+
+
+int flom_locker_array_start_workers(flom_locker_array_t *lockers,
+                                    guint worker_number)
+{
+    enum Exception { INVALID_OPTION
+                     , EVENTFD_ERROR
+                     , PIPE_ERROR
+                     , G_THREAD_NEW_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_locker_array_start_workers\n"));
+    TRY {
+        guint i;
+        
+        if (0 == worker_number || NULL != lockers->workers)
+            THROW(INVALID_OPTION);
+        lockers->workers = g_new0(struct flom_locker_worker_s,
+                                  worker_number);
+        for (i=0; i<worker_number; ++i) {
+            struct flom_locker_worker_s *worker = &lockers->workers[i];
+            gchar thread_name[16];
+            guint j;
+#ifndef FLOM_LOCKER_EVENTFD
+            int pipefd[2];
+#endif
+            
+            worker->id = i;
+            worker->lockers = lockers;
+            worker->failed = FALSE;
+            worker->wakeup_write_fd = worker->wakeup_read_fd = FLOM_NULL_FD;
+            worker->wakeup_pending = FALSE;
+            worker->locker_number = 0;
+            flom_timer_wheel_init(&worker->wheel, flom_timer_get_ticks());
+            /* every slot of the ring is free for the first lap */
+            worker->ring.head = worker->ring.tail = 0;
+            for (j=0; j<FLOM_LOCKER_RING_SIZE; ++j)
+                worker->ring.slots[j].sequence = j;
+            /* workers are counted while they are created: a partial pool
+               can be stopped by flom_locker_array_stop_workers */
+            lockers->worker_number = i+1;
+            /* creating the wake-up file descriptor(s) for the new thread */
+#ifdef FLOM_LOCKER_EVENTFD
+            if (FLOM_NULL_FD == (worker->wakeup_read_fd = eventfd(0, 0)))
+                THROW(EVENTFD_ERROR);
+            worker->wakeup_write_fd = worker->wakeup_read_fd;
+#else
+            if (0 != pipe(pipefd))
+                THROW(PIPE_ERROR);
+            worker->wakeup_read_fd = pipefd[0];
+            worker->wakeup_write_fd = pipefd[1];
+#endif
+            snprintf(thread_name, sizeof(thread_name), "Locker %u", i);
+            if (NULL == (worker->thread = g_thread_new(
+                             thread_name, flom_locker_worker_loop,
+                             (gpointer)worker)))
+                THROW(G_THREAD_NEW_ERROR);
+            FLOM_TRACE(("flom_locker_array_start_workers: created worker "
+                        "%u (thread=%p, wakeup_write_fd=%d, "
+                        "wakeup_read_fd=%d)\n",
+                        i, worker->thread, worker->wakeup_write_fd,
+                        worker->wakeup_read_fd));
+        } /* for (i=0; i<worker_number; ++i) */
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case INVALID_OPTION:
+                ret_cod = FLOM_RC_INVALID_OPTION;
+                break;
+            case EVENTFD_ERROR:
+                ret_cod = FLOM_RC_EVENTFD_ERROR;
+                break;
+            case PIPE_ERROR:
+                ret_cod = FLOM_RC_PIPE_ERROR;
+                break;
+            case G_THREAD_NEW_ERROR:
+                ret_cod = FLOM_RC_G_THREAD_NEW_ERROR;
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_locker_array_start_workers/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+void flom_locker_array_stop_workers(flom_locker_array_t *lockers)
+{
+    struct flom_locker_token_s flt;
+    guint i;
+    
+    FLOM_TRACE(("flom_locker_array_stop_workers: worker_number=%u\n",
+                lockers->worker_number));
+    if (NULL == lockers->workers)
+        return;
+    /* sending the stop command to all the workers... */
+    memset(&flt, 0, sizeof(flt));
+    flt.command = FLOM_LOCKER_CMD_STOP;
+    flt.client_fd = FLOM_NULL_FD;
+    for (i=0; i<lockers->worker_number; ++i) {
+        int ret_cod;
+        if (NULL == lockers->workers[i].thread)
+            continue;
+        /* the acceptor threads are stopped: the worker thread can be
+           waited until it releases a slot */
+        while (FLOM_RC_RING_FULL == (ret_cod = flom_locker_worker_push(
+                                         &lockers->workers[i], &flt, NULL)) &&
+               !g_atomic_int_get(&lockers->workers[i].failed))
+            g_thread_yield();
+        if (FLOM_RC_OK != ret_cod) {
+            FLOM_TRACE(("flom_locker_array_stop_workers: unable to send "
+                        "stop command to worker %u (ret_cod=%d)\n", i,
+                        ret_cod));
+        }
+    } /* for (i=0; i<lockers->worker_number; ++i) */
+    /* ... and now it waits them */
+    for (i=0; i<lockers->worker_number; ++i) {
+        struct flom_locker_worker_s *worker = &lockers->workers[i];
+        if (NULL != worker->thread) {
+            gpointer thread_ret_cod = g_thread_join(worker->thread);
+            FLOM_TRACE(("flom_locker_array_stop_workers/g_thread_join"
+                        "(%p)=%p\n", worker->thread, thread_ret_cod));
+            worker->thread = NULL;
+        }
+        lockers->batch_messages += worker->batch.messages;
+        lockers->batch_writes += worker->batch.writes;
+        /* the worker thread resets wakeup_read_fd after it has closed
+           it */
+        if (FLOM_NULL_FD != worker->wakeup_read_fd)
+            close(worker->wakeup_read_fd);
+#ifndef FLOM_LOCKER_EVENTFD
+        if (FLOM_NULL_FD != worker->wakeup_write_fd)
+            close(worker->wakeup_write_fd);
+#endif
+        worker->wakeup_write_fd = worker->wakeup_read_fd = FLOM_NULL_FD;
+    } /* for (i=0; i<lockers->worker_number; ++i) */
+    g_free(lockers->workers);
+    lockers->workers = NULL;
+    lockers->worker_number = 0;
+}
+
+
+
+struct flom_locker_s *flom_locker_array_new_locker(
+    flom_locker_array_t *lockers)
+{
+    struct flom_locker_s *locker = NULL;
+
+    if (0 < lockers->locker_cache->len) {
+        locker = g_ptr_array_remove_index_fast(
+            lockers->locker_cache, lockers->locker_cache->len - 1);
+        lockers->cache_hits++;
+    } else {
+        locker = g_malloc0(sizeof(struct flom_locker_s));
+        lockers->cache_misses++;
+    }
+    flom_locker_init(locker);
+    FLOM_TRACE(("flom_locker_array_new_locker: locker=%p, cache_hits="
+                UINT64_T_FORMAT ", cache_misses=" UINT64_T_FORMAT "\n",
+                locker, lockers->cache_hits, lockers->cache_misses));
+    return locker;
+}
+
+
+
+void flom_locker_array_park(flom_locker_array_t *lockers,
+                            struct flom_locker_s *locker)
+{
+    if (FLOM_LOCKER_CACHE_SIZE <= lockers->locker_cache->len) {
+        FLOM_TRACE(("flom_locker_array_park: cache is full, destroying "
+                    "locker %p\n", locker));
+        flom_locker_destroy(locker);
+        return;
+    }
+    /* only the struct is reused: the resource will be initialized again
+       with a different type and name */
+    flom_resource_free(&locker->resource);
+    g_free(locker->key);
+    flom_locker_init(locker);
+    g_ptr_array_add(lockers->locker_cache, locker);
+    FLOM_TRACE(("flom_locker_array_park: locker %p parked (%u parked "
+                "lockers)\n", locker, lockers->locker_cache->len));
 }
 
 
@@ -87,9 +303,12 @@ void flom_locker_array_add(flom_locker_array_t *lockers,
                            struct flom_locker_s *locker)
 {
     g_ptr_array_add(lockers->locker_array, (gpointer)locker);
+    if (NULL != locker->key)
+        g_hash_table_replace(lockers->locker_index, locker->key, locker);
     flom_vfs_ram_tree_add_locker(locker->uid, locker->resource.name,
                                  flom_rsrc_get_type_human_readable(
                                      locker->resource.type));
+    g_atomic_int_inc(&lockers->generation);
 }
 
 
@@ -98,9 +317,11 @@ void flom_locker_array_del(flom_locker_array_t *lockers,
                            struct flom_locker_s *locker)
 {
     flom_vfs_ram_tree_del_locker(locker->uid);
+    flom_locker_array_unindex(lockers, locker);
     if (g_ptr_array_remove(lockers->locker_array, locker)) {
         FLOM_TRACE(("flom_locker_array_del: removed locker %p from array\n",
                     locker));
+        flom_locker_array_park(lockers, locker);
     } else {
         FLOM_TRACE(("flom_locker_array_del: locker %p not found in array\n",
                     locker));
@@ -109,229 +330,207 @@ void flom_locker_array_del(flom_locker_array_t *lockers,
 
 
 
-gpointer flom_locker_loop(gpointer data)
+void flom_locker_array_unindex(flom_locker_array_t *lockers,
+                               struct flom_locker_s *locker)
+{
+    /* a newer locker could have been indexed with the same key */
+    if (NULL != locker->key &&
+        locker == g_hash_table_lookup(lockers->locker_index, locker->key)) {
+        g_hash_table_remove(lockers->locker_index, locker->key);
+        FLOM_TRACE(("flom_locker_array_unindex: removed locker %p "
+                    "(key='%s') from index\n", locker, locker->key));
+    }
+}
+
+
+
+gpointer flom_locker_worker_loop(gpointer data)
 {
     enum Exception { NEW_OBJ
                      , CONN_INIT_ERROR
                      , CONNS_CLEAN_ERROR
-                     , CONNS_GET_FDS_ERROR
-                     , CONNS_SET_EVENTS_ERROR
-                     , POLL_ERROR
-                     , RESOURCE_TIMEOUT_ERROR
-                     , CONNS_CLOSE_ERROR1
-                     , RESOURCE_CLEAN_ERROR1
-                     , CONNS_CLOSE_ERROR2
-                     , RESOURCE_CLEAN_ERROR2
-                     , CONNS_CLOSE_ERROR3
-                     , RESOURCE_CLEAN_ERROR3
-                     , CONNS_CLOSE_ERROR4
+                     , CONNS_POLL_ERROR
+                     , WORKER_TIMEOUT_ERROR1
+                     , WORKER_DRAIN_ERROR
+                     , WORKER_TIMEOUT_ERROR2
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     flom_conns_t conns;
     flom_conn_t *conn = NULL;
+    int wakeup_fd_added = FALSE;
+    struct flom_locker_worker_s *worker =
+        (struct flom_locker_worker_s *)data;
     
-    FLOM_TRACE(("flom_locker_loop: new thread in progress (first message)\n"));
+    FLOM_TRACE(("flom_locker_worker_loop: new thread in progress (first "
+                "message)\n"));
+    /* initialize a connections object for this worker thread */
+    flom_conns_init(&conns, AF_UNIX);
+    flom_conn_batch_init(&worker->batch);
     TRY {
         int loop = TRUE;
-        struct flom_locker_s *locker = (struct flom_locker_s *)data;
         struct sockaddr_storage sa_storage;
-        struct timeval next_deadline;
 
-        /* set next deadline to one second in the past*/
-        gettimeofday(&next_deadline, NULL);
-        next_deadline.tv_sec--;
-        
-        /* as a first action, it marks the identifier */
-        locker->thread = g_thread_self();
-        FLOM_TRACE(("flom_locker_loop: resource_name='%s', "
-                    "resource_type=%d\n",
-                    flom_resource_get_name(&locker->resource),
-                    flom_resource_get_type(&locker->resource)));
-        /* initialize a connections object for this locker thread */
-        flom_conns_init(&conns, AF_UNIX);
+        FLOM_TRACE(("flom_locker_worker_loop: worker=%u, "
+                    "wakeup_read_fd=%d\n",
+                    worker->id, worker->wakeup_read_fd));
         /* create a new connection object */
         if (NULL == (conn = flom_conn_new(NULL)))
             THROW(NEW_OBJ);
-        FLOM_TRACE(("flom_locker_loop: allocated a new connection (%p)\n",
-                    conn));
+        FLOM_TRACE(("flom_locker_worker_loop: allocated a new connection "
+                    "(%p)\n", conn));
         /* initialize the connection */
         memset(&sa_storage, 0, sizeof(sa_storage));
         if (FLOM_RC_OK != (ret_cod = flom_conn_init(
                                conn, 0,
                                flom_conns_get_domain(&conns),
-                               locker->read_pipe, SOCK_STREAM,
+                               worker->wakeup_read_fd, SOCK_STREAM,
                                sizeof(struct sockaddr_storage),
                                (struct sockaddr *)&sa_storage,
                                FALSE)))
             THROW(CONN_INIT_ERROR);
         
-        /* add the parent communication pipe to connections */
+        /* add the wake-up file descriptor to connections: it will be
+           closed by flom_conns_free */
         flom_conns_add_conn(&conns, conn);
         conn = NULL; /* avoid connection delete from this function */
+        wakeup_fd_added = TRUE;
         
         while (loop) {
             int ready_fd;
-            guint i, n;
-            struct pollfd *fds;
+            guint i, j, n;
             int timeout;
+            /* the messages produced by the previous iteration are sent
+               together, a single write for every connection */
+            flom_locker_worker_flush(worker, &conns);
             if (FLOM_RC_OK != (ret_cod = flom_conns_clean(&conns)))
                 THROW(CONNS_CLEAN_ERROR);
             if (flom_conns_get_used(&conns) == 0) {
-                FLOM_TRACE(("flom_locker_loop: no more available connections"
-                            ", leaving...\n"));
+                FLOM_TRACE(("flom_locker_worker_loop: no more available "
+                            "connections, leaving...\n"));
                 /* break the loop */
                 loop = FALSE;
                 break;
             }
-            if (NULL == (fds = flom_conns_get_fds(&conns)))
-                THROW(CONNS_GET_FDS_ERROR);
-            if (FLOM_RC_OK != (ret_cod = flom_conns_set_events(
-                                   &conns, POLLIN)))
-                THROW(CONNS_SET_EVENTS_ERROR);
-            FLOM_TRACE(("flom_locker_loop: "
-                        "next_deadline.tv_sec=%d, next_deadline.tv_usec=%d\n",
-                        next_deadline.tv_sec, next_deadline.tv_usec));
-            /* compute time-out from next deadline as asked by the resource
-               (in case the resource asked for a deadline...) */
-            if (0 <= (timeout = flom_locker_loop_get_timeout(
-                          &next_deadline))) {
-                FLOM_TRACE(("flom_locker_loop: timeout was requested by the "
-                            "resource: %d milliseconds\n", timeout));
-            } else if (locker->idle_periods > FLOM_LOCKER_MAX_IDLE_PERIODS) {
-                /* the only possible event comes from main thread, using
-                   a shorter time-out would be useless */
-                timeout = -1;
-                FLOM_TRACE(("flom_locker_loop: locker termination already "
-                            "started, using infinite poll timeout...\n"));
-            } else if (locker->idle_periods > 0) {
-                /* there's a chance this locker would start termination
-                   because there are no connected clients */
-                timeout = FLOM_LOCKER_POLL_TIMEOUT;
-                FLOM_TRACE(("flom_locker_loop: possible locker termination "
-                            "in the next few milliseconds, using a short "
-                            "poll timeout...\n"));
-            } else if (locker->idle_periods == 0 &&
-                       locker->idle_lifespan > 0) {
-                /* time-out must be fixed to resource lifespan as requested
-                   by the client */
-                timeout = locker->idle_lifespan;
-                FLOM_TRACE(("flom_locker_loop: resource timeout asked by "
-                            "caller (%d milliseconds)\n", timeout));
-            } else {
-                timeout = FLOM_LOCKER_POLL_TIMEOUT;
-                FLOM_TRACE(("flom_locker_loop: setting default timeout: "
-                            "%d milliseconds\n", timeout));
-            }
-            FLOM_TRACE(("flom_locker_loop: entering poll using %d "
+            timeout = flom_locker_worker_get_timeout(worker);
+            FLOM_TRACE(("flom_locker_worker_loop: entering poll using %d "
                         "timeout milliseconds...\n", timeout));
-            ready_fd = poll(fds, flom_conns_get_used(&conns), timeout);
-            FLOM_TRACE(("flom_locker_loop: ready_fd=%d\n", ready_fd));
-            /* error on poll function */
-            if (0 > ready_fd)
-                THROW(POLL_ERROR);
+            if (FLOM_RC_OK != (ret_cod = flom_conns_poll(
+                                   &conns, timeout, &ready_fd)))
+                THROW(CONNS_POLL_ERROR);
+            FLOM_TRACE(("flom_locker_worker_loop: ready_fd=%d\n", ready_fd));
             /* poll exited due to time out */
             if (0 == ready_fd) {
-                FLOM_TRACE(("flom_locker_loop: idle time exceeded %d "
-                            "milliseconds\n", timeout));
-                /* calling timeout resource callback */
-                if (FLOM_RC_OK != (ret_cod = locker->resource.timeout(
-                                       &locker->resource, locker->uid,
-                                       &next_deadline)))
-                    THROW(RESOURCE_TIMEOUT_ERROR);
-                if (1 == flom_conns_get_used(&conns)) {
-                    locker->idle_periods++;
-                    FLOM_TRACE(("flom_locker_loop: only control connection "
-                                "is active, idle_periods=%d, waiting exit "
-                                "command from parent thread...\n",
-                                locker->idle_periods));
-                }
+                if (FLOM_RC_OK != (ret_cod = flom_locker_worker_timeout(
+                                       worker, &conns)))
+                    THROW(WORKER_TIMEOUT_ERROR1);
                 continue;
             }
-            /* scanning file descriptors */
-            n = flom_conns_get_used(&conns);
-            for (i=0; i<n; ++i) {
+            /* scanning ready file descriptors */
+            n = flom_conns_get_ready(&conns);
+            for (j=0; j<n; ++j) {
                 int refresh_conns = FALSE;
-                FLOM_TRACE(("flom_locker_loop: i=%u, fd=%d, POLLIN=%d, "
-                            "POLLERR=%d, POLLHUP=%d, POLLNVAL=%d\n", i,
-                            fds[i].fd,
-                            fds[i].revents & POLLIN,
-                            fds[i].revents & POLLERR,
-                            fds[i].revents & POLLHUP,
-                            fds[i].revents & POLLNVAL));
-                if (fds[i].revents & POLLERR) {
-                    /* client error, termination */
-                    FLOM_TRACE(("flom_locker_loop: connection to client %u "
-                                "encountered an error, closing it...\n", i));
+                struct flom_locker_s *locker = NULL;
+                short revents = flom_conns_get_ready_revents(&conns, j);
+                i = flom_conns_get_ready_id(&conns, j);
+                FLOM_TRACE(("flom_locker_worker_loop: i=%u, fd=%d, "
+                            "POLLIN=%d, POLLERR=%d, POLLHUP=%d, "
+                            "POLLNVAL=%d\n", i,
+                            flom_conns_get_fd(&conns, i),
+                            revents & POLLIN,
+                            revents & POLLERR,
+                            revents & POLLHUP,
+                            revents & POLLNVAL));
+                if (0 == i) {
+                    int stop = FALSE;
+                    if (revents & POLLIN) {
+                        /* commands sent by parent thread */
+                        if (FLOM_RC_OK != (ret_cod =
+                                           flom_locker_worker_drain(
+                                               worker, &conns,
+                                               &refresh_conns, &stop)))
+                            THROW(WORKER_DRAIN_ERROR);
+                    } else if (revents & (POLLERR | POLLHUP)) {
+                        /* no more commands can be received */
+                        FLOM_TRACE(("flom_locker_worker_loop: wake-up file "
+                                    "descriptor is not usable anymore\n"));
+                        stop = TRUE;
+                    }
+                    if (stop) {
+                        FLOM_TRACE(("flom_locker_worker_loop: termination "
+                                    "of this worker was asked by parent "
+                                    "thread...\n"));
+                        loop = FALSE;
+                        break;
+                    }
+                    if (refresh_conns)
+                        break;
+                    continue;
+                } /* if (0 == i) */
+                /* the connection is attached to a locker, a connection
+                   without locker (or attached to a discarded locker) can
+                   only be closed */
+                locker = flom_conn_get_locker(flom_conns_get_conn(&conns, i));
+                if (NULL == locker || locker->discarded) {
+                    FLOM_TRACE(("flom_locker_worker_loop: connection %u is "
+                                "not served by any locker, closing it...\n",
+                                i));
                     if (FLOM_RC_OK != (ret_cod = flom_conns_close_fd(
                                            &conns, i)))
-                        THROW(CONNS_CLOSE_ERROR1);
-                    /* clean locks and/or queued locks */
-                    if (FLOM_RC_OK != (ret_cod =
-                                       locker->resource.clean(
-                                           &locker->resource, locker->uid,
-                                           flom_conns_get_conn(
-                                               &conns, i))))
-                        THROW(RESOURCE_CLEAN_ERROR1);
+                        FLOM_TRACE(("flom_locker_worker_loop/"
+                                    "flom_conns_close_fd: ret_cod=%d\n",
+                                    ret_cod));
+                    break;
+                }
+                if (revents & POLLERR) {
+                    /* client error, termination */
+                    FLOM_TRACE(("flom_locker_worker_loop: connection to "
+                                "client %u encountered an error, closing "
+                                "it...\n", i));
+                    if (FLOM_RC_OK != (ret_cod = flom_locker_close_conn(
+                                           locker, &conns, i)))
+                        flom_locker_worker_discard(
+                            worker, &conns, locker, ret_cod);
                     /* conns is no more consistent, break the loop and poll
                        again */
                     break;
-                } /* if (fds[i].revents & POLLERR) */
-                if (fds[i].revents & POLLIN) {
+                } /* if (revents & POLLERR) */
+                if (revents & POLLIN) {
                     if (FLOM_RC_OK != (ret_cod = flom_locker_loop_pollin(
                                            locker, &conns, i,
-                                           &refresh_conns, &next_deadline))) {
-                        FLOM_TRACE(("flom_locker_loop: connection %u "
+                                           &refresh_conns))) {
+                        FLOM_TRACE(("flom_locker_worker_loop: connection %u "
                                     "raised an exception, closing it...\n",
                                     i));
-                        if (FLOM_RC_OK != (ret_cod = flom_conns_close_fd(
-                                               &conns, i)))
-                            THROW(CONNS_CLOSE_ERROR2);
-                        /* clean locks and/or queued locks */
-                        if (FLOM_RC_OK != (ret_cod =
-                                           locker->resource.clean(
-                                               &locker->resource, locker->uid,
-                                               flom_conns_get_conn(
-                                                   &conns, i))))
-                            THROW(RESOURCE_CLEAN_ERROR2);
-                        /* conns is no more consistent, break the loop and poll
-                           again */
+                        if (FLOM_RC_OK != (ret_cod = flom_locker_close_conn(
+                                               locker, &conns, i)))
+                            flom_locker_worker_discard(
+                                worker, &conns, locker, ret_cod);
                         refresh_conns = TRUE;
                     }
+                    flom_locker_set_wakeup(locker);
                     if (refresh_conns)
-                        /* conns is no more consistent, break the loop and poll
-                           again */
+                        /* conns is no more consistent, break the loop and
+                           poll again */
                         break;
                 }
-                if (fds[i].revents & POLLHUP) {
-                    if (0 != i) {
-                        /* client termination */
-                        FLOM_TRACE(("flom_locker_loop: client %u "
-                                    "disconnected\n", i));
-                        if (FLOM_RC_OK != (ret_cod = flom_conns_close_fd(
-                                               &conns, i)))
-                            THROW(CONNS_CLOSE_ERROR3);
-                        /* clean locks and/or queued locks */
-                        if (FLOM_RC_OK != (ret_cod =
-                                           locker->resource.clean(
-                                               &locker->resource,
-                                               locker->uid,
-                                               flom_conns_get_conn(
-                                                   &conns, i))))
-                            THROW(RESOURCE_CLEAN_ERROR3);
-                    } else {
-                        /* locker termination asked by parent thread */
-                        FLOM_TRACE(("flom_locker_loop: termination of this "
-                                    "locker was asked by parent thread...\n"));
-                        if (FLOM_RC_OK != (ret_cod = flom_conns_close_fd(
-                                               &conns, i)))
-                            THROW(CONNS_CLOSE_ERROR4);
-                        locker->read_pipe = FLOM_NULL_FD;
-                    }
+                if (revents & POLLHUP) {
+                    /* client termination */
+                    FLOM_TRACE(("flom_locker_worker_loop: client %u "
+                                "disconnected\n", i));
+                    if (FLOM_RC_OK != (ret_cod = flom_locker_close_conn(
+                                           locker, &conns, i)))
+                        flom_locker_worker_discard(
+                            worker, &conns, locker, ret_cod);
                     /* conns is no more consistent, break the loop and poll
                        again */
                     break;
-                } /* if (fds[i].revents & POLLHUP) */
-            } /* for (i... */
+                } /* if (revents & POLLHUP) */
+            } /* for (j... */
+            /* lockers not involved by the events can reach their wake-up
+               time too */
+            if (FLOM_RC_OK != (ret_cod = flom_locker_worker_timeout(
+                                   worker, &conns)))
+                THROW(WORKER_TIMEOUT_ERROR2);
         } /* while (loop) */
         THROW(NONE);
     } CATCH {
@@ -341,20 +540,10 @@ gpointer flom_locker_loop(gpointer data)
                 break;
             case CONN_INIT_ERROR:
             case CONNS_CLEAN_ERROR:
-                break;
-            case CONNS_GET_FDS_ERROR:
-                ret_cod = FLOM_RC_NULL_OBJECT;
-                break;
-            case CONNS_SET_EVENTS_ERROR:
-            case POLL_ERROR:
-            case RESOURCE_TIMEOUT_ERROR:
-            case CONNS_CLOSE_ERROR1:
-            case RESOURCE_CLEAN_ERROR1:
-            case CONNS_CLOSE_ERROR2:
-            case RESOURCE_CLEAN_ERROR2:
-            case CONNS_CLOSE_ERROR3:
-            case RESOURCE_CLEAN_ERROR3:
-            case CONNS_CLOSE_ERROR4:
+            case CONNS_POLL_ERROR:
+            case WORKER_TIMEOUT_ERROR1:
+            case WORKER_DRAIN_ERROR:
+            case WORKER_TIMEOUT_ERROR2:
                 break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
@@ -368,81 +557,714 @@ gpointer flom_locker_loop(gpointer data)
         flom_conn_delete(conn);
     /* clean-up connections object */
     flom_conns_free(&conns);
-    FLOM_TRACE(("flom_locker_loop/excp=%d/"
+    flom_conn_batch_free(&worker->batch);
+    if (wakeup_fd_added)
+        worker->wakeup_read_fd = FLOM_NULL_FD;
+    /* the lockers hosted by this worker can not be served anymore: the
+       acceptor threads must stop routing the requests to them */
+    if (NONE != excp) {
+        syslog(LOG_ERR, FLOM_SYSLOG_FLM032E, worker->id, ret_cod,
+               flom_strerror(ret_cod));
+        flom_locker_worker_fail(worker);
+    }
+    FLOM_TRACE(("flom_locker_worker_loop/excp=%d/"
                 "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
-    FLOM_TRACE(("flom_locker_loop: this thread completed service (last "
-                "message)\n"));
+    FLOM_TRACE(("flom_locker_worker_loop: this thread completed service "
+                "(last message)\n"));
     return data;
 }
 
 
 
+int flom_locker_worker_push(struct flom_locker_worker_s *worker,
+                            const struct flom_locker_token_s *token,
+                            flom_conn_t *conn)
+{
+    enum Exception { RING_FULL
+                     , WORKER_WAKEUP_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_locker_worker_push\n"));
+    TRY {
+        struct flom_locker_ring_s *ring = &worker->ring;
+        struct flom_locker_ring_slot_s *slot = NULL;
+        guint pos = (guint)g_atomic_int_get(&ring->head);
+        
+        /* a failed worker thread does not consume the ring anymore */
+        if (g_atomic_int_get(&worker->failed)) {
+            FLOM_TRACE(("flom_locker_worker_push: worker %u failed\n",
+                        worker->id));
+            THROW(RING_FULL);
+        }
+        /* reserving a slot */
+        while (NULL == slot) {
+            gint diff;
+            slot = &ring->slots[pos & (FLOM_LOCKER_RING_SIZE - 1)];
+            diff = (gint)((guint)g_atomic_int_get(&slot->sequence) - pos);
+            if (0 == diff) {
+                /* the slot is free, but another producer can reserve it
+                   first */
+                if (g_atomic_int_compare_and_exchange(
+                        &ring->head, (gint)pos, (gint)(pos + 1)))
+                    break;
+            } else if (0 > diff) {
+                /* the ring is full: the callers hold the registry mutex
+                   and must not wait for the worker thread */
+                FLOM_TRACE(("flom_locker_worker_push: the ring of worker "
+                            "%u is full\n", worker->id));
+                THROW(RING_FULL);
+            }
+            /* retry with the current head */
+            slot = NULL;
+            pos = (guint)g_atomic_int_get(&ring->head);
+        } /* while (NULL == slot) */
+        slot->token = *token;
+        slot->conn = conn;
+        /* publishing the command for the worker thread */
+        g_atomic_int_set(&slot->sequence, (gint)(pos + 1));
+        FLOM_TRACE(("flom_locker_worker_push: command=%d queued to worker "
+                    "%u (position=%u)\n", token->command, worker->id, pos));
+        /* only the first command of a burst wakes up the worker thread */
+        if (g_atomic_int_compare_and_exchange(
+                &worker->wakeup_pending, FALSE, TRUE)) {
+            if (FLOM_RC_OK != (ret_cod = flom_locker_worker_wakeup(worker)))
+                THROW(WORKER_WAKEUP_ERROR);
+        }
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case RING_FULL:
+                ret_cod = FLOM_RC_RING_FULL;
+                break;
+            case WORKER_WAKEUP_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_locker_worker_push/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_locker_worker_pop(struct flom_locker_worker_s *worker,
+                           struct flom_locker_token_s *token,
+                           flom_conn_t **conn)
+{
+    struct flom_locker_ring_s *ring = &worker->ring;
+    guint pos = (guint)ring->tail;
+    struct flom_locker_ring_slot_s *slot =
+        &ring->slots[pos & (FLOM_LOCKER_RING_SIZE - 1)];
+
+    /* the slot is empty or a producer has not yet published it */
+    if (0 > (gint)((guint)g_atomic_int_get(&slot->sequence) - (pos + 1)))
+        return FALSE;
+    *token = slot->token;
+    *conn = slot->conn;
+    /* the slot can be reserved again in the next lap */
+    g_atomic_int_set(&slot->sequence, (gint)(pos + FLOM_LOCKER_RING_SIZE));
+    ring->tail = (gint)(pos + 1);
+    return TRUE;
+}
+
+
+
+int flom_locker_worker_wakeup(struct flom_locker_worker_s *worker)
+{
+    enum Exception { WRITE_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_locker_worker_wakeup\n"));
+    TRY {
+#ifdef FLOM_LOCKER_EVENTFD
+        guint64 value = 1;
+#else
+        char value = 1;
+#endif
+        FLOM_TRACE(("flom_locker_worker_wakeup: worker=%u, "
+                    "wakeup_write_fd=%d\n", worker->id,
+                    worker->wakeup_write_fd));
+        if (sizeof(value) != write(worker->wakeup_write_fd, &value,
+                                   sizeof(value)))
+            THROW(WRITE_ERROR);
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case WRITE_ERROR:
+                ret_cod = FLOM_RC_WRITE_ERROR;
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_locker_worker_wakeup/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_locker_worker_drain(struct flom_locker_worker_s *worker,
+                             flom_conns_t *conns, int *refresh_conns,
+                             int *stop)
+{
+    enum Exception { READ_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_locker_worker_drain\n"));
+    TRY {
+        struct flom_locker_token_s flt;
+        flom_conn_t *new_conn = NULL;
+        guint counter = 0;
+#ifdef FLOM_LOCKER_EVENTFD
+        guint64 value;
+#else
+        char value[64];
+#endif
+        
+        *refresh_conns = *stop = FALSE;
+        /* consume the wake-up: eventfd resets its counter, a pipe could
+           contain some other bytes, but they will cause only a spurious
+           wake-up */
+        if (0 >= read(worker->wakeup_read_fd, &value, sizeof(value)))
+            THROW(READ_ERROR);
+        /* the flag must be reset before draining the ring: a command
+           pushed from now on will signal a new wake-up */
+        g_atomic_int_set(&worker->wakeup_pending, FALSE);
+        while (!*stop && flom_locker_worker_pop(worker, &flt, &new_conn)) {
+            counter++;
+            if (FLOM_LOCKER_CMD_STOP == flt.command)
+                *stop = TRUE;
+            else {
+                int refresh = FALSE;
+                if (FLOM_RC_OK != (ret_cod = flom_locker_worker_command(
+                                       worker, conns, &flt, new_conn,
+                                       &refresh))) {
+                    /* the failure involves only the locker of the command,
+                       the other lockers are still served */
+                    if (NULL != flt.locker)
+                        flom_locker_worker_discard(
+                            worker, conns, flt.locker, ret_cod);
+                    else if (NULL != new_conn) {
+                        flom_conn_terminate(new_conn);
+                        flom_conn_delete(new_conn);
+                    }
+                    refresh = TRUE;
+                }
+                if (refresh)
+                    *refresh_conns = TRUE;
+            }
+        } /* while (!*stop && ... */
+        /* the commands queued behind the stop command will not be served:
+           the transferred connections must be released */
+        while (*stop && flom_locker_worker_pop(worker, &flt, &new_conn)) {
+            counter++;
+            if (FLOM_LOCKER_CMD_NEW_CONN == flt.command &&
+                NULL != flt.locker)
+                flt.locker->read_sequence = flt.sequence;
+            if (NULL != new_conn) {
+                FLOM_TRACE(("flom_locker_worker_drain: releasing "
+                            "connection %p queued after stop command\n",
+                            new_conn));
+                flom_conn_terminate(new_conn);
+                flom_conn_delete(new_conn);
+            }
+        } /* while (*stop && ... */
+        FLOM_TRACE(("flom_locker_worker_drain: worker=%u, commands=%u, "
+                    "stop=%d\n", worker->id, counter, *stop));
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case READ_ERROR:
+                ret_cod = FLOM_RC_READ_ERROR;
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_locker_worker_drain/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_locker_worker_command(struct flom_locker_worker_s *worker,
+                               flom_conns_t *conns,
+                               const struct flom_locker_token_s *flt,
+                               flom_conn_t *new_conn,
+                               int *refresh_conns)
+{
+    enum Exception { NULL_OBJECT
+                     , LOCKER_CLOSE_CONN_ERROR
+                     , INVALID_OPTION
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_locker_worker_command\n"));
+    TRY {
+        struct flom_locker_s *locker;
+        guint i;
+
+        *refresh_conns = FALSE;
+        if (NULL == (locker = flt->locker))
+            THROW(NULL_OBJECT);
+        FLOM_TRACE(("flom_locker_worker_command: command=%d, locker=%p "
+                    "(uid=" FLOM_UID_T_FORMAT ", resource_name='%s')\n",
+                    flt->command, locker, locker->uid,
+                    flom_resource_get_name(&locker->resource)));
+        switch (flt->command) {
+            case FLOM_LOCKER_CMD_NEW_CONN:
+                if (NULL == new_conn)
+                    THROW(NULL_OBJECT);
+                if (locker->discarded) {
+                    /* the connection was queued before the locker failed:
+                       it can only be refused */
+                    FLOM_TRACE(("flom_locker_worker_command: locker %p "
+                                "was discarded, closing connection %p\n",
+                                locker, new_conn));
+                    locker->read_sequence = flt->sequence;
+                    flom_conn_terminate(new_conn);
+                    flom_conn_delete(new_conn);
+                    break;
+                }
+                /* the first connection attaches the locker to this worker */
+                if (0 == locker->read_sequence) {
+                    FLOM_TRACE(("flom_locker_worker_command: hosting locker "
+                                "%p inside worker %u\n", locker,
+                                worker->id));
+                    worker->locker_number++;
+                }
+                flom_conns_set_domain(conns, flt->domain);
+                FLOM_TRACE(("flom_locker_worker_command: receiving "
+                            "connection %p (domain=%d, client_fd=%d, "
+                            "sequence=%d)\n", new_conn,
+                            flt->domain, flt->client_fd, flt->sequence));
+                /* the worker thread must not wait for a partial message of
+                   a single client; a send waits the socket at most
+                   FLOM_NETWORK_SEND_TIMEOUT milliseconds */
+                if (FLOM_RC_OK != (ret_cod = flom_tcp_set_nonblocking(
+                                       flom_conn_get_tcp(new_conn), TRUE))) {
+                    FLOM_TRACE(("flom_locker_worker_command: unable to "
+                                "set connection %p non blocking, closing "
+                                "it\n", new_conn));
+                    locker->read_sequence = flt->sequence;
+                    flom_conn_terminate(new_conn);
+                    flom_conn_delete(new_conn);
+                    break;
+                }
+                /* import the connection passed by parent thread */
+                flom_conn_set_locker(new_conn, locker);
+                flom_conn_set_batch(new_conn, &worker->batch);
+                flom_conns_import(conns, flt->client_fd, new_conn);
+                locker->conn_number++;
+                locker->idle_periods = 0;
+                /* set the locker sequence */
+                locker->read_sequence = flt->sequence;
+                /* process the message sent by the client and the messages
+                   it pipelined after the first one */
+                ret_cod = flom_locker_loop_inmsg(
+                    locker, new_conn, flom_conn_get_msg(new_conn));
+                if (FLOM_RC_OK == ret_cod &&
+                    0 < flom_conn_get_pending_msgs(new_conn))
+                    ret_cod = flom_locker_loop_pollin(
+                        locker, conns, flom_conn_get_conns_pos(new_conn),
+                        refresh_conns);
+                if (FLOM_RC_OK != ret_cod) {
+                    FLOM_TRACE(("flom_locker_worker_command: connection "
+                                "raised an exception, closing it...\n"));
+                    if (FLOM_RC_OK != (ret_cod = flom_locker_close_conn(
+                                           locker, conns,
+                                           flom_conn_get_conns_pos(
+                                               new_conn))))
+                        THROW(LOCKER_CLOSE_CONN_ERROR);
+                    *refresh_conns = TRUE;
+                }
+                flom_locker_set_wakeup(locker);
+                break;
+            case FLOM_LOCKER_CMD_TERMINATE:
+                FLOM_TRACE(("flom_locker_worker_command: termination of "
+                            "locker %p was asked by parent thread...\n",
+                            locker));
+                /* no connection should be attached to a terminating
+                   locker, but it's better to check it */
+                for (i=1; i<flom_conns_get_used(conns) &&
+                         0 < locker->conn_number; ++i) {
+                    flom_conn_t *c = flom_conns_get_conn(conns, i);
+                    if (locker == flom_conn_get_locker(c) &&
+                        FLOM_CONN_STATE_REMOVE != flom_conn_get_state(c)) {
+                        FLOM_TRACE(("flom_locker_worker_command: closing "
+                                    "connection %u still attached to the "
+                                    "locker\n", i));
+                        /* the locker is leaving anyway: an error can't
+                           stop its termination */
+                        if (FLOM_RC_OK != (ret_cod = flom_locker_close_conn(
+                                               locker, conns, i)))
+                            FLOM_TRACE(("flom_locker_worker_command/"
+                                        "flom_locker_close_conn: "
+                                        "ret_cod=%d\n", ret_cod));
+                        *refresh_conns = TRUE;
+                    }
+                } /* for (i=1; ... */
+                /* the locker must not be woken up anymore */
+                flom_timer_wheel_del(&worker->wheel, &locker->wakeup);
+                worker->locker_number--;
+                /* from now on, main thread can destroy the locker */
+                g_atomic_int_set(&locker->terminated, TRUE);
+                break;
+            default:
+                THROW(INVALID_OPTION);
+        } /* switch (flt->command) */
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case NULL_OBJECT:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
+            case LOCKER_CLOSE_CONN_ERROR:
+                break;
+            case INVALID_OPTION:
+                ret_cod = FLOM_RC_INVALID_OPTION;
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_locker_worker_command/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_locker_worker_get_timeout(const struct flom_locker_worker_s *worker)
+{
+    int timeout = flom_timer_wheel_get_timeout(
+        &worker->wheel, flom_timer_get_ticks());
+    
+    FLOM_TRACE(("flom_locker_worker_get_timeout: worker=%u, lockers=%u, "
+                "timers=%u, timeout=%d\n", worker->id, worker->locker_number,
+                flom_timer_wheel_count(&worker->wheel), timeout));
+    return timeout;
+}
+
+
+
+int flom_locker_worker_timeout(struct flom_locker_worker_s *worker,
+                               flom_conns_t *conns)
+{
+    enum Exception { NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_locker_worker_timeout\n"));
+    TRY {
+        flom_timer_t *timer;
+
+        flom_timer_wheel_advance(&worker->wheel, flom_timer_get_ticks());
+        /* only the lockers whose timer expired are involved */
+        while (NULL != (timer = flom_timer_wheel_pop_expired(
+                            &worker->wheel))) {
+            struct flom_locker_s *locker = flom_timer_get_data(timer);
+            FLOM_TRACE(("flom_locker_worker_timeout: wake-up time reached "
+                        "for locker %p (resource_name='%s')\n", locker,
+                        flom_resource_get_name(&locker->resource)));
+            /* calling timeout resource callback: a failure involves only
+               this locker */
+            if (FLOM_RC_OK != (ret_cod = locker->resource.timeout(
+                                   &locker->resource, locker->uid,
+                                   &locker->next_deadline))) {
+                flom_locker_worker_discard(worker, conns, locker, ret_cod);
+                continue;
+            }
+            if (0 == locker->conn_number) {
+                locker->idle_periods++;
+                FLOM_TRACE(("flom_locker_worker_timeout: no client is "
+                            "connected, idle_periods=%d, waiting exit "
+                            "command from parent thread...\n",
+                            locker->idle_periods));
+            }
+            flom_locker_set_wakeup(locker);
+        } /* while (NULL != (timer = ... */
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_locker_worker_timeout/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+void flom_locker_worker_flush(struct flom_locker_worker_s *worker,
+                              flom_conns_t *conns)
+{
+    GPtrArray *failed = worker->batch.failed;
+    
+    flom_conn_batch_flush(&worker->batch);
+    /* a client that can't receive its messages would wait forever or
+       would read a broken stream: it's disconnected */
+    while (0 < failed->len) {
+        int ret_cod;
+        flom_conn_t *c = g_ptr_array_remove_index_fast(
+            failed, failed->len - 1);
+        struct flom_locker_s *locker = flom_conn_get_locker(c);
+        if (NULL == locker ||
+            FLOM_CONN_STATE_REMOVE == flom_conn_get_state(c))
+            continue;
+        FLOM_TRACE(("flom_locker_worker_flush: closing connection %p "
+                    "after a send error\n", c));
+        if (FLOM_RC_OK != (ret_cod = flom_locker_close_conn(
+                               locker, conns, flom_conn_get_conns_pos(c))))
+            flom_locker_worker_discard(worker, conns, locker, ret_cod);
+    } /* while (0 < failed->len) */
+}
+
+
+
+void flom_locker_worker_discard(struct flom_locker_worker_s *worker,
+                                flom_conns_t *conns,
+                                struct flom_locker_s *locker,
+                                int error)
+{
+    guint i;
+    
+    FLOM_TRACE(("flom_locker_worker_discard: worker=%u, locker=%p, "
+                "error=%d\n", worker->id, locker, error));
+    if (locker->discarded)
+        return;
+    syslog(LOG_WARNING, FLOM_SYSLOG_FLM033W,
+           flom_resource_get_name(&locker->resource), error,
+           flom_strerror(error));
+    locker->discarded = TRUE;
+    /* new requests for the same resource must start a new locker */
+    flom_locker_array_lock(worker->lockers);
+    flom_locker_array_unindex(worker->lockers, locker);
+    flom_locker_array_unlock(worker->lockers);
+    /* the resource can not be trusted anymore: the connections are closed
+       without cleaning it */
+    for (i=1; i<flom_conns_get_used(conns) && 0 < locker->conn_number; ++i) {
+        flom_conn_t *c = flom_conns_get_conn(conns, i);
+        if (locker == flom_conn_get_locker(c) &&
+            FLOM_CONN_STATE_REMOVE != flom_conn_get_state(c)) {
+            int ret_cod;
+            FLOM_TRACE(("flom_locker_worker_discard: closing connection "
+                        "%u\n", i));
+            if (FLOM_RC_OK != (ret_cod = flom_conns_close_fd(conns, i)))
+                FLOM_TRACE(("flom_locker_worker_discard/"
+                            "flom_conns_close_fd: ret_cod=%d\n", ret_cod));
+            locker->conn_number--;
+        }
+    } /* for (i=1; ... */
+    /* the locker stays idle: the periodic check of the acceptor threads
+       will send the termination command */
+    flom_timer_wheel_del(&worker->wheel, &locker->wakeup);
+    locker->idle_periods = FLOM_LOCKER_MAX_IDLE_PERIODS + 1;
+}
+
+
+
+void flom_locker_worker_fail(struct flom_locker_worker_s *worker)
+{
+    flom_locker_array_t *lockers = worker->lockers;
+    struct flom_locker_token_s flt;
+    flom_conn_t *new_conn = NULL;
+    guint i;
+    
+    FLOM_TRACE(("flom_locker_worker_fail: worker=%u\n", worker->id));
+    /* the acceptor threads push the commands holding the mutex: no command
+       can be queued after the flag has been set */
+    flom_locker_array_lock(lockers);
+    g_atomic_int_set(&worker->failed, TRUE);
+    while (flom_locker_worker_pop(worker, &flt, &new_conn)) {
+        if (NULL != new_conn) {
+            flom_conn_terminate(new_conn);
+            flom_conn_delete(new_conn);
+        }
+        new_conn = NULL;
+    } /* while (flom_locker_worker_pop(... */
+    /* the lockers are not referenced by this thread anymore: the acceptor
+       threads can destroy them */
+    for (i=0; i<flom_locker_array_count(lockers); ++i) {
+        struct flom_locker_s *locker = flom_locker_array_get(lockers, i);
+        if (worker != locker->worker)
+            continue;
+        FLOM_TRACE(("flom_locker_worker_fail: detaching locker %p\n",
+                    locker));
+        flom_locker_array_unindex(lockers, locker);
+        locker->terminating = TRUE;
+        g_atomic_int_set(&locker->terminated, TRUE);
+    } /* for (i=0; ... */
+    flom_locker_array_unlock(lockers);
+}
+
+
+
+void flom_locker_set_wakeup(struct flom_locker_s *locker)
+{
+    int timeout;
+    
+    /* compute time-out from next deadline as asked by the resource
+       (in case the resource asked for a deadline...) */
+    if (locker->discarded) {
+        /* the resource must not be called anymore */
+        timeout = -1;
+    } else if (0 <= (timeout = flom_locker_loop_get_timeout(
+                  &locker->next_deadline))) {
+        FLOM_TRACE(("flom_locker_set_wakeup: timeout was requested by the "
+                    "resource: %d milliseconds\n", timeout));
+    } else if (locker->idle_periods > FLOM_LOCKER_MAX_IDLE_PERIODS) {
+        /* the only possible event comes from main thread, a wake-up
+           would be useless */
+        timeout = -1;
+        FLOM_TRACE(("flom_locker_set_wakeup: locker termination already "
+                    "started, no wake-up is necessary...\n"));
+    } else if (locker->idle_periods > 0) {
+        /* there's a chance this locker would start termination
+           because there are no connected clients */
+        timeout = FLOM_LOCKER_POLL_TIMEOUT;
+        FLOM_TRACE(("flom_locker_set_wakeup: possible locker termination "
+                    "in the next few milliseconds, using a short "
+                    "timeout...\n"));
+    } else if (locker->idle_periods == 0 &&
+               locker->idle_lifespan > 0) {
+        /* time-out must be fixed to resource lifespan as requested
+           by the client */
+        timeout = locker->idle_lifespan;
+        FLOM_TRACE(("flom_locker_set_wakeup: resource timeout asked by "
+                    "caller (%d milliseconds)\n", timeout));
+    } else {
+        timeout = FLOM_LOCKER_POLL_TIMEOUT;
+        FLOM_TRACE(("flom_locker_set_wakeup: setting default timeout: "
+                    "%d milliseconds\n", timeout));
+    }
+    if (0 > timeout)
+        flom_timer_wheel_del(&locker->worker->wheel, &locker->wakeup);
+    else
+        flom_timer_wheel_add(&locker->worker->wheel, &locker->wakeup,
+                             flom_timer_get_ticks() + timeout);
+}
+
+
+
+int flom_locker_close_conn(struct flom_locker_s *locker,
+                           flom_conns_t *conns, guint id)
+{
+    enum Exception { CONNS_CLOSE_ERROR
+                     , RESOURCE_CLEAN_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_locker_close_conn\n"));
+    TRY {
+        /* a connection can be closed only once */
+        if (FLOM_CONN_STATE_REMOVE == flom_conn_get_state(
+                flom_conns_get_conn(conns, id))) {
+            FLOM_TRACE(("flom_locker_close_conn: connection %u already "
+                        "closed\n", id));
+        } else {
+            if (FLOM_RC_OK != (ret_cod = flom_conns_close_fd(conns, id)))
+                THROW(CONNS_CLOSE_ERROR);
+            locker->conn_number--;
+            /* clean locks and/or queued locks */
+            if (FLOM_RC_OK != (ret_cod = locker->resource.clean(
+                                   &locker->resource, locker->uid,
+                                   flom_conns_get_conn(conns, id))))
+                THROW(RESOURCE_CLEAN_ERROR);
+            flom_locker_set_wakeup(locker);
+        }
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case CONNS_CLOSE_ERROR:
+            case RESOURCE_CLEAN_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_locker_close_conn/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
 int flom_locker_loop_pollin(struct flom_locker_s *locker,
                             flom_conns_t *conns, guint id,
-                            int *refresh_conns, struct timeval *next_deadline)
+                            int *refresh_conns)
 {
     enum Exception { CONNS_GET_CD_ERROR
-                     , READ_ERROR1
-                     , READ_ERROR2
                      , MSG_RETRIEVE_ERROR
-                     , CONNS_CLOSE_ERROR1
-                     , RESOURCE_CLEAN_ERROR
+                     , LOCKER_CLOSE_CONN_ERROR1
                      , CONNS_GET_MSG_ERROR
-                     , CONNS_GET_GMPC_ERROR
+                     , CONNS_GET_PARSER_ERROR
                      , MSG_DESERIALIZE_ERROR
-                     , CONNS_CLOSE_ERROR2
-                     , RESOURCE_INMSG_ERROR
-                     , MSG_SERIALIZE_ERROR
-                     , MSG_SEND_ERROR
-                     , MSG_FREE_ERROR
-                     , PROTOCOL_ERROR
+                     , LOCKER_CLOSE_CONN_ERROR2
+                     , LOCKER_LOOP_INMSG_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     
-    flom_conn_t *new_conn = NULL;
-    
     FLOM_TRACE(("flom_locker_loop_pollin\n"));
     TRY {
-        *refresh_conns = FALSE;
         struct flom_msg_s *msg = NULL;
         flom_conn_t *curr_conn;
+        char buffer[FLOM_MSG_BUFFER_SIZE];
+        size_t read_bytes;
+        flom_msg_parser_t *parser;
         
+        *refresh_conns = FALSE;
         if (NULL == (curr_conn = flom_conns_get_conn(conns, id)))
             THROW(CONNS_GET_CD_ERROR);
         FLOM_TRACE(("flom_locker_loop_pollin: id=%d, fd=%d\n",
                     id, flom_tcp_get_sockfd(flom_conn_get_tcp(curr_conn))));
         locker->idle_periods = 0;
-        if (0 == id) {
-            struct flom_locker_token_s flt;
-            /* it's a connection passed by parent thread */
-            /* pick-up token from parent thread */
-            if (sizeof(flt) != read(
-                    locker->read_pipe, &flt, sizeof(flt)))
-                THROW(READ_ERROR1);
-            flom_conns_set_domain(conns, flt.domain);
-            FLOM_TRACE(("flom_locker_loop_pollin: receiving connection "
-                    "(domain=%d, client_fd=%d, sequence=%d) using pipe %d\n",
-                        flt.domain, flt.client_fd, flt.sequence,
-                        locker->read_pipe));
-            /* pick-up connection data pointer parent thread */
-            if (sizeof(new_conn) != read(
-                    locker->read_pipe, &new_conn, sizeof(new_conn)))
-                THROW(READ_ERROR2);
-            /* import the connection passed by parent thread */
-            flom_conns_import(conns, flt.client_fd, new_conn);
-            /* set the locker sequence */
-            locker->read_sequence = flt.sequence;
-            /* retrieve the message sent by the client */
-            msg = flom_conn_get_msg(new_conn);
-        } else {
-            char buffer[FLOM_MSG_BUFFER_SIZE];
-            size_t read_bytes;
-            GMarkupParseContext *gmpc;
-            /* it's data from an existing connection */
-            if (FLOM_RC_OK != (ret_cod = flom_conn_recv(
-                                   curr_conn, buffer, sizeof(buffer),
-                                   &read_bytes, FLOM_NETWORK_WAIT_TIMEOUT,
-                                   NULL, NULL)))
+        /* all the messages already inside the receive buffer are processed
+           now: poll/epoll would not report them */
+        do {
+            /* it's data from an existing connection: the socket is non
+               blocking and the worker thread does not wait for a message
+               that's arriving in many chunks */
+            ret_cod = flom_conn_recv(curr_conn, buffer, sizeof(buffer),
+                                     &read_bytes, 0, NULL, NULL);
+            if (FLOM_RC_WOULD_BLOCK == ret_cod) {
+                FLOM_TRACE(("flom_locker_loop_pollin: id=%d, no complete "
+                            "message is available, the partial message "
+                            "stays buffered\n", id));
+                break;
+            } else if (FLOM_RC_OK != ret_cod)
                 THROW(MSG_RETRIEVE_ERROR);
 
             if (0 == read_bytes) {
@@ -451,79 +1273,38 @@ int flom_locker_loop_pollin(struct flom_locker_s *locker,
                             "returned 0 bytes: disconnecting...\n",
                             id, flom_tcp_get_sockfd(
                                 flom_conn_get_tcp(curr_conn))));
-                if (FLOM_RC_OK != (ret_cod = flom_conns_close_fd(
-                                       conns, id)))
-                    THROW(CONNS_CLOSE_ERROR1);
-                *refresh_conns = TRUE;
                 /* clean lock state if any lock was acquired... */
-                if (FLOM_RC_OK != (ret_cod = 
-                                   locker->resource.clean(
-                                       &locker->resource, locker->uid,
-                                       curr_conn)))
-                    THROW(RESOURCE_CLEAN_ERROR);
+                if (FLOM_RC_OK != (ret_cod = flom_locker_close_conn(
+                                       locker, conns, id)))
+                    THROW(LOCKER_CLOSE_CONN_ERROR1);
+                *refresh_conns = TRUE;
             } else {
                 /* data arrived */
                 if (NULL == (msg = flom_conns_get_msg(conns, id)))
                     THROW(CONNS_GET_MSG_ERROR);
 
-                if (NULL == (gmpc = flom_conns_get_parser(conns, id)))
-                    THROW(CONNS_GET_GMPC_ERROR);
+                if (NULL == (parser = flom_conns_get_parser(conns, id)))
+                    THROW(CONNS_GET_PARSER_ERROR);
             
                 if (FLOM_RC_OK != (ret_cod = flom_msg_deserialize(
-                                       buffer, read_bytes, msg, gmpc)))
+                                       buffer, read_bytes, msg, parser)))
                     THROW(MSG_DESERIALIZE_ERROR);
                 flom_conn_set_last_step(curr_conn, msg->header.pvs.step);
                 /* if the message is not valid the client must be terminated */
                 if (FLOM_MSG_STATE_INVALID == msg->state) {
                     FLOM_TRACE(("flom_locker_loop_pollin: message from client "
                                 "%i is invalid, disconneting...\n", id));
-                    if (FLOM_RC_OK != (ret_cod = flom_conns_close_fd(
-                                           conns, id)))
-                        THROW(CONNS_CLOSE_ERROR2);
-                }
+                    if (FLOM_RC_OK != (ret_cod = flom_locker_close_conn(
+                                           locker, conns, id)))
+                        THROW(LOCKER_CLOSE_CONN_ERROR2);
+                    *refresh_conns = TRUE;
+                } else if (FLOM_RC_OK != (ret_cod = flom_locker_loop_inmsg(
+                                              locker, curr_conn, msg)))
+                    THROW(LOCKER_LOOP_INMSG_ERROR);
             } /* if (0 == read_bytes) */
-        } /* if (0 == id) */
-        
-        if (NULL != msg) {
-            if (NULL != new_conn)
-                curr_conn = new_conn;
-            if (FLOM_MSG_VERB_LOCK == msg->header.pvs.verb ||
-                FLOM_MSG_VERB_UNLOCK == msg->header.pvs.verb) {
-                /* process input message */
-                if (FLOM_RC_OK != (ret_cod = 
-                                   locker->resource.inmsg(
-                                       &locker->resource, locker->uid,
-                                       curr_conn, msg, next_deadline)))
-                    THROW(RESOURCE_INMSG_ERROR);
-                /* reply with output message */
-                if (FLOM_MSG_STATE_READY == msg->state) {
-                    char buffer[FLOM_MSG_BUFFER_SIZE];
-                    size_t msg_len = 0;
-                    if (FLOM_RC_OK != (ret_cod = flom_msg_serialize(
-                                           msg, buffer, sizeof(buffer),
-                                           &msg_len)))
-                        THROW(MSG_SERIALIZE_ERROR);
-                    ret_cod = flom_conn_send(curr_conn, buffer, msg_len);
-                    if (FLOM_RC_SEND_ERROR == ret_cod) {
-                        FLOM_TRACE(("flom_locker_loop_pollin: error while "
-                                    "sending message to client (the "
-                                    "connection) will be closed during next "
-                                    "poll loop...\n"));
-                    } else if (FLOM_RC_OK != ret_cod)
-                        THROW(MSG_SEND_ERROR);
-                    flom_conn_set_last_step(curr_conn, msg->header.pvs.step);
-                } /* if (FLOM_MSG_STATE_READY == msg->state) */
-            } else {
-                /* Implement ping message here... */
-                FLOM_TRACE(("flom_locker_loop_pollin: unexpected message with "
-                            "verb=%d was arrived!\n", msg->header.pvs.verb));
-                THROW(PROTOCOL_ERROR);
-            } /* if (FLOM_MSG_VERB_LOCK == msg->header.pvs.verb ... */
-            /* free message content and reset it */
-            if (FLOM_RC_OK != (ret_cod = flom_msg_free(msg)))
-                THROW(MSG_FREE_ERROR);
-            flom_msg_init(msg);
-        } /* if (NULL != msg) */
+        } while (!*refresh_conns &&
+                 FLOM_CONN_STATE_REMOVE != flom_conn_get_state(curr_conn) &&
+                 0 < flom_conn_get_pending_msgs(curr_conn));
         
         THROW(NONE);
     } CATCH {
@@ -531,27 +1312,108 @@ int flom_locker_loop_pollin(struct flom_locker_s *locker,
             case CONNS_GET_CD_ERROR:
                 ret_cod = FLOM_RC_NULL_OBJECT;
                 break;
-            case READ_ERROR1:
-            case READ_ERROR2:
-                ret_cod = FLOM_RC_READ_ERROR;
-                break;
             case MSG_RETRIEVE_ERROR:
-            case CONNS_CLOSE_ERROR1:
-            case RESOURCE_CLEAN_ERROR:
+            case LOCKER_CLOSE_CONN_ERROR1:
                 break;
             case CONNS_GET_MSG_ERROR:
-            case CONNS_GET_GMPC_ERROR:
+            case CONNS_GET_PARSER_ERROR:
                 ret_cod = FLOM_RC_NULL_OBJECT;
                 break;
             case MSG_DESERIALIZE_ERROR:
-            case CONNS_CLOSE_ERROR2:
+            case LOCKER_CLOSE_CONN_ERROR2:
+            case LOCKER_LOOP_INMSG_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_locker_loop_pollin/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_locker_loop_inmsg(struct flom_locker_s *locker,
+                           flom_conn_t *conn, struct flom_msg_s *msg)
+{
+    enum Exception { NULL_OBJECT
+                     , RESOURCE_INMSG_ERROR
+                     , MSG_SERIALIZE_ERROR
+                     , MSG_SEND_ERROR
+                     , PROTOCOL_ERROR
+                     , MSG_FREE_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_locker_loop_inmsg\n"));
+    TRY {
+        if (NULL == msg)
+            THROW(NULL_OBJECT);
+        if (FLOM_MSG_VERB_LOCK == msg->header.pvs.verb ||
+            FLOM_MSG_VERB_UNLOCK == msg->header.pvs.verb) {
+            /* process input message */
+            if (FLOM_RC_OK != (ret_cod = 
+                               locker->resource.inmsg(
+                                   &locker->resource, locker->uid,
+                                   conn, msg, &locker->next_deadline)))
+                THROW(RESOURCE_INMSG_ERROR);
+            /* reply with output message */
+            if (FLOM_MSG_STATE_READY == msg->state) {
+                char buffer[FLOM_MSG_BUFFER_SIZE];
+                size_t msg_len = 0;
+                const flom_msg_cached_answer_t *cached;
+                /* answer with the protocol level chosen by the client */
+                msg->header.level = flom_conn_get_level(conn);
+                /* common answers are not serialized again */
+                if (NULL != (cached = flom_msg_get_cached_reply(msg)))
+                    ret_cod = flom_conn_send(
+                        conn, cached->buffer, cached->len);
+                else {
+                    if (FLOM_RC_OK != (ret_cod = flom_msg_serialize(
+                                           msg, buffer, sizeof(buffer),
+                                           &msg_len)))
+                        THROW(MSG_SERIALIZE_ERROR);
+                    ret_cod = flom_conn_send(conn, buffer, msg_len);
+                }
+                if (FLOM_RC_SEND_ERROR == ret_cod) {
+                    FLOM_TRACE(("flom_locker_loop_inmsg: error while "
+                                "sending message to client (the "
+                                "connection) will be closed during next "
+                                "poll loop...\n"));
+                } else if (FLOM_RC_OK != ret_cod)
+                    THROW(MSG_SEND_ERROR);
+                flom_conn_set_last_step(conn, msg->header.pvs.step);
+            } /* if (FLOM_MSG_STATE_READY == msg->state) */
+        } else {
+            /* Implement ping message here... */
+            FLOM_TRACE(("flom_locker_loop_inmsg: unexpected message with "
+                        "verb=%d was arrived!\n", msg->header.pvs.verb));
+            THROW(PROTOCOL_ERROR);
+        } /* if (FLOM_MSG_VERB_LOCK == msg->header.pvs.verb ... */
+        /* free message content and reset it */
+        if (FLOM_RC_OK != (ret_cod = flom_msg_free(msg)))
+            THROW(MSG_FREE_ERROR);
+        flom_msg_init(msg);
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case NULL_OBJECT:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
             case RESOURCE_INMSG_ERROR:
+            case MSG_SERIALIZE_ERROR:
             case MSG_SEND_ERROR:
-            case MSG_FREE_ERROR:
                 break;
             case PROTOCOL_ERROR:
                 ret_cod = FLOM_RC_PROTOCOL_ERROR;
                 break;
+            case MSG_FREE_ERROR:
+                break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
                 break;
@@ -559,7 +1421,7 @@ int flom_locker_loop_pollin(struct flom_locker_s *locker,
                 ret_cod = FLOM_RC_INTERNAL_ERROR;
         } /* switch (excp) */
     } /* TRY-CATCH */
-    FLOM_TRACE(("flom_locker_loop_pollin/excp=%d/"
+    FLOM_TRACE(("flom_locker_loop_inmsg/excp=%d/"
                 "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
     return ret_cod;
 }
@@ -28,11 +28,15 @@
 #ifdef HAVE_GLIB_H
 # include <glib.h>
 #endif
+#ifdef HAVE_SYS_TIME_H
+# include <sys/time.h>
+#endif
 
 
 
 #include "flom_conns.h"
 #include "flom_rsrc.h"
+#include "flom_timer.h"
 
 
 
@@ -56,25 +60,208 @@
 
 
 /**
- * Data structure used for a locker thread
+ * Commands sent by main thread (listener) to a locker worker thread
  */
-struct flom_locker_s {
+typedef enum flom_locker_command_e {
+    /**
+     * A new client connection must be attached to a locker
+     */
+    FLOM_LOCKER_CMD_NEW_CONN,
+    /**
+     * A locker must be detached from the worker thread because main thread
+     * started its termination
+     */
+    FLOM_LOCKER_CMD_TERMINATE,
+    /**
+     * The worker thread must stop: it's sent by main thread when the pool
+     * of worker threads is stopped
+     */
+    FLOM_LOCKER_CMD_STOP
+} flom_locker_command_t;
+
+
+
+/**
+ * It's the struct passed from parent thread (listener) to child thread
+ * (locker worker) when a new client arrive or when a locker must be
+ * terminated
+ */
+struct flom_locker_token_s {
+    /**
+     * Command for the worker thread
+     */
+    flom_locker_command_t command;
+    /**
+     * Locker the command is related to
+     */
+    struct flom_locker_s *locker;
+    /**
+     * Socket domain associated to client connection
+     */
+    int domain;
+    /**
+     * Client connection (accepted) file descriptor
+     */
+    int client_fd;
+    /**
+     * Sequence number associated to the token
+     */
+    int sequence;
+};
+
+
+
+/**
+ * Number of slots of the ring used to pass the commands to a worker thread;
+ * it must be a power of 2
+ */
+#define FLOM_LOCKER_RING_SIZE      1024
+
+
+
+/**
+ * Maximum number of terminated lockers kept by @ref flom_locker_array_t to
+ * be reused by new resources
+ */
+#define FLOM_LOCKER_CACHE_SIZE     64
+
+
+
+#if defined(HAVE_SYS_EVENTFD_H) && defined(HAVE_EVENTFD)
+/**
+ * eventfd is available: it's used to wake up the worker threads instead of
+ * a pipe
+ */
+# define FLOM_LOCKER_EVENTFD
+#endif
+
+
+
+/**
+ * A slot of the command ring of a worker thread
+ */
+struct flom_locker_ring_slot_s {
+    /**
+     * Sequence number of the slot: the slot can be written by a producer
+     * when it's equal to the position, it can be read by the consumer when
+     * it's equal to the position + 1; it must be accessed with g_atomic_int
+     * functions
+     */
+    gint                        sequence;
+    /**
+     * Command for the worker thread
+     */
+    struct flom_locker_token_s  token;
+    /**
+     * Client connection transferred to the worker thread (only for
+     * @ref FLOM_LOCKER_CMD_NEW_CONN)
+     */
+    flom_conn_t                *conn;
+};
+
+
+
+/**
+ * Bounded multiple producers / single consumer ring used to pass the
+ * commands to a worker thread without locks and without a system call for
+ * every command
+ */
+struct flom_locker_ring_s {
+    /**
+     * Next position that will be reserved by a producer; it must be
+     * accessed with g_atomic_int functions
+     */
+    gint                            head;
+    /**
+     * Next position that will be read by the consumer (worker thread)
+     */
+    gint                            tail;
+    /**
+     * Slots of the ring
+     */
+    struct flom_locker_ring_slot_s  slots[FLOM_LOCKER_RING_SIZE];
+};
+
+
+
+/**
+ * Data structure used for a locker worker thread: every worker thread hosts
+ * many lockers and the connections of their clients
+ */
+struct flom_locker_worker_s {
     /**
-     * Identifier of the thread running the locker
+     * Identifier of the thread running the worker
      */
     GThread                 *thread;
     /**
-     * Unique identifier associated to the locker object
+     * Position of the worker inside the pool
      */
-    flom_uid_t               uid;
+    guint                    id;
     /**
-     * Pipe file descriptor: used by main thread (listener) to send commands
+     * Registry of the lockers: the worker thread locks it to unregister
+     * the lockers it can not serve anymore
      */
-    int                      write_pipe;
+    struct flom_locker_array_s *lockers;
     /**
-     * Pipe file descriptor: used by locker thread to receive commands
+     * Boolean value: the worker thread left its loop because of an error
+     * and it does not accept commands anymore; it must be accessed with
+     * g_atomic_int functions
      */
-    int                      read_pipe;
+    gint                     failed;
+    /**
+     * Ring used by main thread (listener) to send commands
+     */
+    struct flom_locker_ring_s ring;
+    /**
+     * Boolean value: a wake-up has already been signaled and the worker
+     * thread has not yet consumed it; it's used to signal only once a
+     * burst of commands and it must be accessed with g_atomic_int functions
+     */
+    gint                     wakeup_pending;
+    /**
+     * File descriptor used by main thread (listener) to wake up the worker
+     * thread: it's the same of @ref wakeup_read_fd if eventfd is used, the
+     * write side of a pipe otherwise
+     */
+    int                      wakeup_write_fd;
+    /**
+     * File descriptor polled by the worker thread to know there are new
+     * commands inside the ring
+     */
+    int                      wakeup_read_fd;
+    /**
+     * Number of lockers hosted by the worker; it's used only by the worker
+     * thread, the lockers are owned by @ref flom_locker_array_t
+     */
+    guint                    locker_number;
+    /**
+     * Wake-up timers of the hosted lockers; it's used only by the worker
+     * thread
+     */
+    flom_timer_wheel_t       wheel;
+    /**
+     * Output messages of the client connections: answers and grant
+     * notifications produced by a loop iteration are flushed together
+     * before the next poll; it's used only by the worker thread
+     */
+    flom_conn_batch_t        batch;
+};
+
+
+
+/**
+ * Data structure used for a locker: it manages a resource inside a locker
+ * worker thread
+ */
+struct flom_locker_s {
+    /**
+     * Worker thread hosting the locker
+     */
+    struct flom_locker_worker_s *worker;
+    /**
+     * Unique identifier associated to the locker object
+     */
+    flom_uid_t               uid;
     /**
      * Last sequence number sent by parent (listener) to locker thread:
      * parent point of view
@@ -95,6 +282,43 @@ struct flom_locker_s {
      * after last usage
      */
     int                      idle_lifespan;
+    /**
+     * Number of client connections attached to the locker (locker thread
+     * point of view)
+     */
+    int                      conn_number;
+    /**
+     * Next deadline asked by the resource (the resource is waiting a
+     * time-out)
+     */
+    struct timeval           next_deadline;
+    /**
+     * Timer used by the worker thread to call the timeout callback of the
+     * resource; it's not armed if no wake-up is necessary
+     */
+    flom_timer_t             wakeup;
+    /**
+     * Boolean value: main thread sent the termination command to the worker
+     * thread (main thread point of view)
+     */
+    int                      terminating;
+    /**
+     * Boolean value: the worker thread detached the locker and it can be
+     * destroyed by main thread; it must be accessed with g_atomic_int
+     * functions
+     */
+    gint                     terminated;
+    /**
+     * Boolean value: the locker raised an error, its connections have been
+     * closed and it waits the termination command (worker thread point of
+     * view)
+     */
+    int                      discarded;
+    /**
+     * Key used to index the locker inside @ref flom_locker_array_t (see
+     * @ref flom_rsrc_get_key)
+     */
+    gchar                   *key;
     /**
      * Resource managed by the locker
      */
@@ -110,29 +334,58 @@ typedef struct flom_locker_array_s {
     /**
      * Array of lockers
      */
-    GPtrArray *locker_array;
-} flom_locker_array_t;
-
-
-
-/**
- * It's the struct passed from parent thread (listener) to child thread
- * (locker) when a new client arrive
- */
-struct flom_locker_token_s {
+    GPtrArray  *locker_array;
     /**
-     * Socket domain associated to client connection
+     * Index of the active lockers: the key is the normalized resource name
+     * (see @ref flom_rsrc_get_key), the value is the locker; terminating
+     * lockers are removed from the index but they are kept inside the
+     * array until their worker thread has detached them
      */
-    int domain;
+    GHashTable *locker_index;
     /**
-     * Client connection (accepted) file descriptor
+     * Number of locker worker threads
      */
-    int client_fd;
+    guint       worker_number;
     /**
-     * Sequence number associated to the token
+     * Locker worker threads: every resource is pinned to one of them by
+     * the hash of its key, see @ref flom_locker_array_get_worker
      */
-    int sequence;
-};
+    struct flom_locker_worker_s *workers;
+    /**
+     * Terminated lockers parked for reuse: they are not attached to any
+     * resource and to any worker thread (see @ref FLOM_LOCKER_CACHE_SIZE)
+     */
+    GPtrArray  *locker_cache;
+    /**
+     * Number of lockers retrieved from the cache
+     */
+    guint64     cache_hits;
+    /**
+     * Number of lockers allocated because the cache was empty
+     */
+    guint64     cache_misses;
+    /**
+     * Number of messages sent by the stopped worker threads
+     */
+    guint64     batch_messages;
+    /**
+     * Number of writes used by the stopped worker threads to send
+     * @ref batch_messages messages
+     */
+    guint64     batch_writes;
+    /**
+     * Mutex protecting the registry (array, index and cache): when the
+     * daemon uses more than one acceptor thread, all of them create and
+     * look up lockers; see @ref flom_locker_array_lock
+     */
+    GMutex      mutex;
+    /**
+     * Number of lockers added to the registry (atomically updated): a
+     * change tells the acceptor threads that some connections waiting
+     * inside their incubator could be transferred
+     */
+    gint        generation;
+} flom_locker_array_t;
 
 
 
@@ -148,11 +401,16 @@ extern "C" {
      * @return a reason code
      */
     static inline void flom_locker_init(struct flom_locker_s *locker) {
-        locker->thread = NULL;
+        locker->worker = NULL;
         locker->uid = 0;
-        locker->write_pipe = locker->read_pipe = FLOM_NULL_FD;
         locker->write_sequence = locker->read_sequence =
-            locker->idle_periods = 0;
+            locker->idle_periods = locker->conn_number = 0;
+        /* a deadline in the past: no time-out requested by the resource */
+        locker->next_deadline.tv_sec = locker->next_deadline.tv_usec = 0;
+        flom_timer_init(&locker->wakeup, locker);
+        locker->terminating = locker->terminated = FALSE;
+        locker->discarded = FALSE;
+        locker->key = NULL;
         memset(&locker->resource, 0, sizeof(flom_resource_t));
     }
 
@@ -176,12 +434,162 @@ extern "C" {
     
 
     /**
-     * Remove all objects pointed by locker array and the array itself
+     * Remove all objects pointed by locker array and the array itself; the
+     * worker threads are stopped if they are still active
      * @param lockers IN/OUT pointer to object to release
      */
     void flom_locker_array_free(flom_locker_array_t *lockers);
 
 
+
+    /**
+     * Start the pool of worker threads that will host the lockers
+     * @param lockers IN/OUT array of lockers
+     * @param worker_number IN number of worker threads (it must be > 0)
+     * @return a reason code
+     */
+    int flom_locker_array_start_workers(flom_locker_array_t *lockers,
+                                        guint worker_number);
+
+
+
+    /**
+     * Stop the pool of worker threads: a stop command is sent to every
+     * worker and the threads are joined
+     * @param lockers IN/OUT array of lockers
+     */
+    void flom_locker_array_stop_workers(flom_locker_array_t *lockers);
+
+
+
+    /**
+     * Retrieve the worker thread that must host the locker of a resource:
+     * the same key is always associated to the same worker, this preserves
+     * the ordering of the requests related to a resource; a failed worker
+     * is replaced by the next one of the pool
+     * @param lockers IN array of lockers
+     * @param key IN normalized resource name (see @ref flom_rsrc_get_key)
+     * @return the worker
+     */
+    static inline struct flom_locker_worker_s *flom_locker_array_get_worker(
+        flom_locker_array_t *lockers, const gchar *key) {
+        guint i = g_str_hash(key) % lockers->worker_number;
+        guint n;
+        for (n=1; n<lockers->worker_number &&
+                 g_atomic_int_get(&lockers->workers[i].failed); ++n)
+            i = (i + 1) % lockers->worker_number;
+        return &lockers->workers[i];
+    }
+
+
+    
+    /**
+     * Retrieve an initialized locker object: a parked locker is reused if
+     * available, a new one is allocated otherwise
+     * @param lockers IN/OUT array of lockers
+     * @return the locker object
+     */
+    struct flom_locker_s *flom_locker_array_new_locker(
+        flom_locker_array_t *lockers);
+
+
+
+    /**
+     * Release the resource of a locker and park the locker for reuse; the
+     * locker is destroyed if the cache is full
+     * @param lockers IN/OUT array of lockers
+     * @param locker IN/OUT locker object that must not be referenced
+     *        anymore by the caller
+     */
+    void flom_locker_array_park(flom_locker_array_t *lockers,
+                                struct flom_locker_s *locker);
+
+
+
+    /**
+     * Number of lockers retrieved from the cache
+     * @param lockers IN array of lockers
+     * @return the number of hits
+     */
+    static inline guint64 flom_locker_array_get_cache_hits(
+        const flom_locker_array_t *lockers) {
+        return lockers->cache_hits;
+    }
+
+
+    
+    /**
+     * Number of lockers allocated because the cache was empty
+     * @param lockers IN array of lockers
+     * @return the number of misses
+     */
+    static inline guint64 flom_locker_array_get_cache_misses(
+        const flom_locker_array_t *lockers) {
+        return lockers->cache_misses;
+    }
+
+
+
+    /**
+     * Number of messages sent by the worker threads (available after
+     * their termination)
+     * @param lockers IN array of lockers
+     * @return the number of messages
+     */
+    static inline guint64 flom_locker_array_get_batch_messages(
+        const flom_locker_array_t *lockers) {
+        return lockers->batch_messages;
+    }
+
+
+    
+    /**
+     * Number of writes used by the worker threads to send their messages
+     * (available after their termination)
+     * @param lockers IN array of lockers
+     * @return the number of writes
+     */
+    static inline guint64 flom_locker_array_get_batch_writes(
+        const flom_locker_array_t *lockers) {
+        return lockers->batch_writes;
+    }
+
+
+
+    /**
+     * Lock the registry of the lockers; it must be called before any
+     * lookup, creation or destruction of a locker
+     * @param lockers IN/OUT array of lockers
+     */
+    static inline void flom_locker_array_lock(flom_locker_array_t *lockers) {
+        g_mutex_lock(&lockers->mutex);
+    }
+
+
+
+    /**
+     * Unlock the registry of the lockers
+     * @param lockers IN/OUT array of lockers
+     */
+    static inline void flom_locker_array_unlock(
+        flom_locker_array_t *lockers) {
+        g_mutex_unlock(&lockers->mutex);
+    }
+
+
+
+    /**
+     * Return the number of lockers added to the registry since its
+     * initialization; it can be called without locking the registry
+     * @param lockers IN array of lockers
+     * @return the generation of the registry
+     */
+    static inline gint flom_locker_array_get_generation(
+        flom_locker_array_t *lockers) {
+        return g_atomic_int_get(&lockers->generation);
+    }
+
+
     
     /**
      * Add a new locker to locker array
@@ -194,13 +602,43 @@ extern "C" {
 
 
     /**
-     * Remove a locker from locker array
+     * Remove a locker from locker array; the locker is parked for reuse
+     * (see @ref flom_locker_array_park)
      * @param lockers IN/OUT array of lockers
      * @param locker IN pointer to the element must be deleted
      */
     void flom_locker_array_del(flom_locker_array_t *lockers,
                                struct flom_locker_s *locker);
 
+
+
+    
+    /**
+     * Remove a locker from the index of the active lockers: the locker is
+     * still inside the array, but it can not be retrieved anymore by
+     * @ref flom_locker_array_lookup; it must be used when locker termination
+     * starts
+     * @param lockers IN/OUT array of lockers
+     * @param locker IN pointer to the element must be removed from index
+     */
+    void flom_locker_array_unindex(flom_locker_array_t *lockers,
+                                   struct flom_locker_s *locker);
+
+
+
+    /**
+     * Retrieve the active locker that manages a resource
+     * @param lockers IN array of lockers
+     * @param key IN normalized resource name (see @ref flom_rsrc_get_key)
+     * @return the locker or NULL if there is no active locker for the
+     *         resource
+     */
+    static inline struct flom_locker_s *flom_locker_array_lookup(
+        flom_locker_array_t *lockers, const gchar *key) {
+        return (struct flom_locker_s *)g_hash_table_lookup(
+            lockers->locker_index, key);
+    }
+
     
                                    
     /**
@@ -235,29 +673,203 @@ extern "C" {
 
     
     /**
-     * Main loop function for locker thread
-     * @param data IN pointer to locker context, it must be a pointer to
-     * @ref flom_locker_s
+     * Main loop function for locker worker thread
+     * @param data IN pointer to worker context, it must be a pointer to
+     * @ref flom_locker_worker_s
      */
-    gpointer flom_locker_loop(gpointer data);
+    gpointer flom_locker_worker_loop(gpointer data);
+
+
+
+    /**
+     * Send a command to a worker thread: the command is put inside the
+     * ring of the worker and the worker is woken up only if a previous
+     * wake-up has not been consumed yet (a burst of commands costs a single
+     * system call); if the ring is full or the worker thread failed, the
+     * function returns @ref FLOM_RC_RING_FULL without waiting because the
+     * callers hold the mutex of the lockers registry
+     * @param worker IN/OUT worker context object
+     * @param token IN command for the worker thread
+     * @param conn IN client connection transferred to the worker thread
+     *        (only for @ref FLOM_LOCKER_CMD_NEW_CONN, NULL otherwise)
+     * @return a reason code
+     */
+    int flom_locker_worker_push(struct flom_locker_worker_s *worker,
+                                const struct flom_locker_token_s *token,
+                                flom_conn_t *conn);
+
+
+
+    /**
+     * Retrieve the next command from the ring of a worker thread; this
+     * function must be called only by the worker thread
+     * @param worker IN/OUT worker context object
+     * @param token OUT command for the worker thread
+     * @param conn OUT client connection transferred to the worker thread
+     * @return TRUE if a command was retrieved, FALSE if the ring is empty
+     */
+    int flom_locker_worker_pop(struct flom_locker_worker_s *worker,
+                               struct flom_locker_token_s *token,
+                               flom_conn_t **conn);
+
+
+
+    /**
+     * Wake up a worker thread writing to its wake-up file descriptor
+     * @param worker IN worker context object
+     * @return a reason code
+     */
+    int flom_locker_worker_wakeup(struct flom_locker_worker_s *worker);
+
+
+    
+    /**
+     * Consume the wake-up signaled by main thread (listener) and manage all
+     * the commands queued inside the ring of the worker thread
+     * @param worker IN/OUT worker context object
+     * @param conns IN/OUT connections object of the worker thread
+     * @param refresh_conns OUT the conns object must be refreshed due to
+     *        some deletion inside it
+     * @param stop OUT the worker thread must stop
+     * @return a reason code
+     */
+    int flom_locker_worker_drain(struct flom_locker_worker_s *worker,
+                                 flom_conns_t *conns, int *refresh_conns,
+                                 int *stop);
 
 
     
     /**
-     * Manager POLLIN event received from locker thread
+     * Manage a command sent by main thread (listener) to the worker thread
+     * @param worker IN/OUT worker context object
+     * @param conns IN/OUT connections object of the worker thread
+     * @param flt IN command retrieved from the ring
+     * @param new_conn IN client connection retrieved from the ring
+     * @param refresh_conns OUT the conns object must be refreshed due to
+     *        some deletion inside it
+     * @return a reason code
+     */
+    int flom_locker_worker_command(struct flom_locker_worker_s *worker,
+                                   flom_conns_t *conns,
+                                   const struct flom_locker_token_s *flt,
+                                   flom_conn_t *new_conn,
+                                   int *refresh_conns);
+
+
+
+    /**
+     * Compute the timeout for the poll loop of a worker thread: it's
+     * retrieved from the timer wheel of the wake-up times of the hosted
+     * lockers
+     * @param worker IN worker context object
+     * @return a timeout value (milliseconds) or -1 if no locker needs a
+     *         wake-up
+     */
+    int flom_locker_worker_get_timeout(
+        const struct flom_locker_worker_s *worker);
+
+
+
+    /**
+     * Advance the timer wheel of the worker and call the timeout callback
+     * of the resources whose wake-up time has been reached; a locker whose
+     * callback fails is discarded (see @ref flom_locker_worker_discard)
+     * @param worker IN/OUT worker context object
+     * @param conns IN/OUT connections object of the worker
+     * @return a reason code
+     */
+    int flom_locker_worker_timeout(struct flom_locker_worker_s *worker,
+                                   flom_conns_t *conns);
+
+
+
+    /**
+     * Send the messages queued by the connections of a worker thread and
+     * close the connections that raised a send error
+     * @param worker IN/OUT worker context object
+     * @param conns IN/OUT connections object of the worker
+     */
+    void flom_locker_worker_flush(struct flom_locker_worker_s *worker,
+                                  flom_conns_t *conns);
+
+
+
+    /**
+     * Discard a locker that raised an error without stopping the other
+     * lockers hosted by the same worker thread: the locker is removed from
+     * the index of the registry, its connections are closed and it's left
+     * idle until the termination command arrives
+     * @param worker IN/OUT worker context object
+     * @param conns IN/OUT connections object of the worker
+     * @param locker IN/OUT locker to discard
+     * @param error IN reason code raised by the locker
+     */
+    void flom_locker_worker_discard(struct flom_locker_worker_s *worker,
+                                    flom_conns_t *conns,
+                                    struct flom_locker_s *locker,
+                                    int error);
+
+
+
+    /**
+     * Detach all the lockers hosted by a worker thread that is leaving its
+     * loop because of an error: the lockers are removed from the index of
+     * the registry and they are marked as terminated, the connections still
+     * queued inside the ring are closed
+     * @param worker IN/OUT worker context object
+     */
+    void flom_locker_worker_fail(struct flom_locker_worker_s *worker);
+
+
+
+    /**
+     * Compute the next wake-up time of a locker, using the same rules
+     * applied when every locker was running in a dedicated thread, and
+     * (re)arm its timer inside the wheel of the worker thread
+     * @param locker IN/OUT locker context object
+     */
+    void flom_locker_set_wakeup(struct flom_locker_s *locker);
+
+
+
+    /**
+     * Close a client connection attached to a locker and clean the locks
+     * and/or the queued lock requests of the client
+     * @param locker IN/OUT locker context object
+     * @param conns IN/OUT connections object of the worker thread
+     * @param id IN connection id
+     * @return a reason code
+     */
+    int flom_locker_close_conn(struct flom_locker_s *locker,
+                               flom_conns_t *conns, guint id);
+
+
+    
+    /**
+     * Manager POLLIN event received by a client connection attached to a
+     * locker
      * @param locker IN/OUT locker context object
      * @param conns IN/OUT connections object
      * @param id IN connection id
      * @param refresh_conns OUT the conns object must be refreshed due to
      *        some deletion inside it
-     * @param next_deadline OUT next deadline asked by the resource (the
-     *        resource is waiting a time-out)
      * @return a reason code
      */
     int flom_locker_loop_pollin(struct flom_locker_s *locker,
                                 flom_conns_t *conns, guint id,
-                                int *refresh_conns,
-                                struct timeval *next_deadline);
+                                int *refresh_conns);
+
+
+
+    /**
+     * Process a message sent by a client and reply to it if necessary
+     * @param locker IN/OUT locker context object
+     * @param conn IN/OUT client connection
+     * @param msg IN/OUT message sent by the client
+     * @return a reason code
+     */
+    int flom_locker_loop_inmsg(struct flom_locker_s *locker,
+                               flom_conn_t *conn, struct flom_msg_s *msg);
 
 
 
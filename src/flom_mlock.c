@@ -0,0 +1,1262 @@
+/*
+ * Copyright (c) 2013-2024, Christian Ferrari <tiian@users.sourceforge.net>
+ * All rights reserved.
+ *
+ * This file is part of FLoM, Free Lock Manager
+ *
+ * FLoM is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2.0 as
+ * published by the Free Software Foundation.
+ *
+ * FLoM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FLoM.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <config.h>
+
+
+
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_SYS_SOCKET_H
+# include <sys/socket.h>
+#endif
+#ifdef HAVE_SYS_UN_H
+# include <sys/un.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+
+
+#include "flom_daemon.h"
+#include "flom_errors.h"
+#include "flom_mlock.h"
+#include "flom_trace.h"
+
+
+
+/* set module trace flag */
+#ifdef FLOM_TRACE_MODULE
+# undef FLOM_TRACE_MODULE
+#endif /* FLOM_TRACE_MODULE */
+#define FLOM_TRACE_MODULE   FLOM_TRACE_MOD_MLOCK
+
+
+
+void flom_mlock_delete(flom_mlock_t *mlock)
+{
+    guint i;
+
+    FLOM_TRACE(("flom_mlock_delete: mlock=%p\n", mlock));
+    if (NULL == mlock)
+        return;
+    if (NULL != mlock->client) {
+        GHashTable *pipeline = flom_conn_get_pipeline(mlock->client);
+        if (mlock == flom_conn_get_mlock(mlock->client))
+            flom_conn_set_mlock(mlock->client, NULL);
+        else if (NULL != pipeline && mlock == g_hash_table_lookup(
+                     pipeline, GINT_TO_POINTER(mlock->rid)))
+            g_hash_table_remove(pipeline, GINT_TO_POINTER(mlock->rid));
+    }
+    if (NULL != mlock->members) {
+        for (i=0; i<mlock->member_number; ++i) {
+            struct flom_mlock_member_s *member = &mlock->members[i];
+            if (NULL != member->conn)
+                flom_conn_set_mlock(member->conn, NULL);
+            g_free(member->resource.name);
+            g_free(member->key);
+        } /* for (i=0; i<mlock->member_number; ++i) */
+        g_free(mlock->members);
+    }
+    g_free(mlock->element);
+    g_free(mlock);
+}
+
+
+
+int flom_mlock_member_compare(const void *a, const void *b)
+{
+    return strcmp(((const struct flom_mlock_member_s *)a)->key,
+                  ((const struct flom_mlock_member_s *)b)->key);
+}
+
+
+
+int flom_mlock_start(flom_conns_t *conns, guint id,
+                     flom_locker_array_t *lockers)
+{
+    enum Exception { CONNS_GET_CD_ERROR
+                     , CONNS_GET_MSG_ERROR
+                     , INVALID_VERB_STEP
+                     , G_TRY_MALLOC_ERROR1
+                     , G_TRY_MALLOC_ERROR2
+                     , NULL_OBJECT
+                     , MSG_FREE_ERROR
+                     , MLOCK_REPLY_ERROR
+                     , MLOCK_NEXT_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    flom_mlock_t *mlock = NULL;
+
+    FLOM_TRACE(("flom_mlock_start\n"));
+    TRY {
+        flom_conn_t *conn;
+        struct flom_msg_s *msg;
+        flom_mlock_t *started;
+        guint i;
+        int rc = FLOM_RC_OK;
+
+        if (NULL == (conn = flom_conns_get_conn(conns, id)))
+            THROW(CONNS_GET_CD_ERROR);
+        if (NULL == (msg = flom_conns_get_msg(conns, id)))
+            THROW(CONNS_GET_MSG_ERROR);
+        /* a pipelined client can send lock requests too */
+        if (FLOM_MSG_STEP_INCR != msg->header.pvs.step ||
+            (FLOM_MSG_VERB_MLOCK != msg->header.pvs.verb &&
+             (FLOM_MSG_VERB_LOCK != msg->header.pvs.verb ||
+              0 == msg->header.rid)))
+            THROW(INVALID_VERB_STEP);
+        if (NULL == (mlock = g_try_malloc0(sizeof(flom_mlock_t))))
+            THROW(G_TRY_MALLOC_ERROR1);
+        mlock->client = conn;
+        mlock->verb = msg->header.pvs.verb;
+        mlock->rid = msg->header.rid;
+        if (FLOM_MSG_VERB_LOCK == mlock->verb)
+            mlock->member_number = 1;
+        else if (0 == msg->body.mlock_8.resource_number)
+            rc = FLOM_RC_OUT_OF_RANGE;
+        else
+            mlock->member_number = msg->body.mlock_8.resource_number;
+        if (0 < mlock->member_number &&
+            NULL == (mlock->members = g_try_malloc0(
+                         mlock->member_number *
+                         sizeof(struct flom_mlock_member_s))))
+            THROW(G_TRY_MALLOC_ERROR2);
+        /* the resources are moved from the message to the members */
+        for (i=0; i<mlock->member_number; ++i) {
+            struct flom_mlock_member_s *member = &mlock->members[i];
+            struct flom_msg_body_lock_8_resource_s *resource =
+                FLOM_MSG_VERB_LOCK == mlock->verb ?
+                &msg->body.lock_8.resource : &msg->body.mlock_8.resources[i];
+            member->resource = *resource;
+            resource->name = NULL;
+            member->type = flom_rsrc_get_type(member->resource.name);
+            FLOM_TRACE(("flom_mlock_start: resource[%u]='%s', type=%d, "
+                        "mode=%d\n", i, member->resource.name, member->type,
+                        member->resource.mode));
+            /* only the resources that can be granted without returning an
+               element can be part of a multiple lock; a pipelined lock can
+               use any valid resource */
+            if (FLOM_RSRC_TYPE_NULL == member->type ||
+                (FLOM_MSG_VERB_MLOCK == mlock->verb &&
+                 FLOM_RSRC_TYPE_SIMPLE != member->type &&
+                 FLOM_RSRC_TYPE_NUMERIC != member->type &&
+                 FLOM_RSRC_TYPE_HIER != member->type))
+                rc = FLOM_RC_INVALID_RESOURCE_NAME;
+            else if (NULL == (member->key = flom_rsrc_get_key(
+                                  member->type, member->resource.name)))
+                THROW(NULL_OBJECT);
+        } /* for (i=0; i<mlock->member_number; ++i) */
+        /* the message has been consumed */
+        if (FLOM_RC_OK != (ret_cod = flom_msg_free(msg)))
+            THROW(MSG_FREE_ERROR);
+        flom_msg_init(msg);
+        if (FLOM_RC_OK == rc) {
+            /* all the clients acquire the resources following the same
+               order: they can not deadlock each other */
+            qsort(mlock->members, mlock->member_number,
+                  sizeof(struct flom_mlock_member_s),
+                  flom_mlock_member_compare);
+            /* a locker can't serve two members of the same request */
+            for (i=1; i<mlock->member_number; ++i)
+                if (0 == strcmp(mlock->members[i-1].key,
+                                mlock->members[i].key)) {
+                    rc = FLOM_RC_DUPLICATED_RESOURCE;
+                    break;
+                }
+        }
+        if (FLOM_RC_OK != rc) {
+            FLOM_TRACE(("flom_mlock_start: refusing the request with "
+                        "rc=%d\n", rc));
+            if (FLOM_RC_OK != (ret_cod = flom_mlock_reply(mlock, rc)))
+                THROW(MLOCK_REPLY_ERROR);
+            THROW(NONE);
+        }
+        /* from now on, the object is owned by the client connection */
+        if (0 == mlock->rid)
+            flom_conn_set_mlock(conn, mlock);
+        else
+            g_hash_table_insert(flom_conn_get_pipeline(conn),
+                                GINT_TO_POINTER(mlock->rid), mlock);
+        started = mlock;
+        mlock = NULL;
+        if (FLOM_RC_OK != (ret_cod = flom_mlock_next(
+                               conns, started, lockers)))
+            THROW(MLOCK_NEXT_ERROR);
+
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case CONNS_GET_CD_ERROR:
+            case CONNS_GET_MSG_ERROR:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
+            case INVALID_VERB_STEP:
+                ret_cod = FLOM_RC_PROTOCOL_ERROR;
+                break;
+            case G_TRY_MALLOC_ERROR1:
+            case G_TRY_MALLOC_ERROR2:
+                ret_cod = FLOM_RC_G_TRY_MALLOC_ERROR;
+                break;
+            case NULL_OBJECT:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
+            case MSG_FREE_ERROR:
+            case MLOCK_REPLY_ERROR:
+            case MLOCK_NEXT_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    /* a refused request is not attached to the client */
+    if (NULL != mlock)
+        flom_mlock_delete(mlock);
+    FLOM_TRACE(("flom_mlock_start/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_mlock_next(flom_conns_t *conns, flom_mlock_t *mlock,
+                    flom_locker_array_t *lockers)
+{
+    enum Exception { MLOCK_REPLY_ERROR
+                     , MLOCK_MEMBER_LOCK_ERROR
+                     , MLOCK_FAIL_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+
+    FLOM_TRACE(("flom_mlock_next\n"));
+    TRY {
+        int rc = FLOM_RC_OK;
+
+        if (flom_mlock_is_held(mlock)) {
+            FLOM_TRACE(("flom_mlock_next: all the %u resources have been "
+                        "acquired\n", mlock->member_number));
+            if (FLOM_RC_OK != (ret_cod = flom_mlock_reply(
+                                   mlock, FLOM_RC_OK)))
+                THROW(MLOCK_REPLY_ERROR);
+            THROW(NONE);
+        }
+        FLOM_TRACE(("flom_mlock_next: requesting resource %u of %u "
+                    "('%s')\n", mlock->current, mlock->member_number,
+                    mlock->members[mlock->current].resource.name));
+        if (FLOM_RC_OK != (ret_cod = flom_mlock_member_lock(
+                               conns, mlock, &mlock->members[mlock->current],
+                               lockers, &rc)))
+            THROW(MLOCK_MEMBER_LOCK_ERROR);
+        if (FLOM_RC_OK != rc &&
+            FLOM_RC_OK != (ret_cod = flom_mlock_fail(conns, mlock, rc)))
+            THROW(MLOCK_FAIL_ERROR);
+
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case MLOCK_REPLY_ERROR:
+            case MLOCK_MEMBER_LOCK_ERROR:
+            case MLOCK_FAIL_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_mlock_next/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_mlock_member_lock(flom_conns_t *conns, flom_mlock_t *mlock,
+                           struct flom_mlock_member_s *member,
+                           flom_locker_array_t *lockers, int *rc)
+{
+    enum Exception { SOCKETPAIR_ERROR
+                     , NEW_OBJ1
+                     , CONN_INIT_ERROR1
+                     , NEW_OBJ2
+                     , CONN_INIT_ERROR2
+                     , G_STRDUP_ERROR
+                     , CANT_CREATE
+                     , INVALID_RESOURCE
+                     , ACCEPT_LOOP_START_LOCKER_ERROR
+                     , RING_FULL
+                     , LOCKER_WORKER_PUSH_ERROR
+                     , ACCEPT_LOOP_INCUBATOR_TRANSFER_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    int fds[2] = { FLOM_NULL_FD, FLOM_NULL_FD };
+    flom_conn_t *daemon_conn = NULL;
+    flom_conn_t *locker_conn = NULL;
+    int locked = FALSE;
+
+    FLOM_TRACE(("flom_mlock_member_lock: resource='%s', key='%s'\n",
+                member->resource.name, member->key));
+    TRY {
+        struct sockaddr_un sa;
+        struct flom_msg_s *msg;
+        struct flom_locker_s *locker = NULL;
+        struct flom_locker_token_s flt;
+        int locker_is_new = FALSE;
+        int type = SOCK_STREAM;
+
+        *rc = FLOM_RC_OK;
+        memset(&sa, 0, sizeof(sa));
+        sa.sun_family = AF_UNIX;
+#ifdef SOCK_CLOEXEC
+        /* the descriptors must not leak into the commands executed by
+           the daemon */
+        type |= SOCK_CLOEXEC;
+#endif
+        if (-1 == socketpair(AF_UNIX, type, 0, fds))
+            THROW(SOCKETPAIR_ERROR);
+        /* the first end is monitored by this acceptor thread */
+        if (NULL == (daemon_conn = flom_conn_new(NULL)))
+            THROW(NEW_OBJ1);
+        if (FLOM_RC_OK != (ret_cod = flom_conn_init(
+                               daemon_conn, flom_conns_get_new_uid(conns),
+                               AF_UNIX, fds[0], SOCK_STREAM, sizeof(sa),
+                               (struct sockaddr *)&sa, TRUE)))
+            THROW(CONN_INIT_ERROR1);
+        fds[0] = FLOM_NULL_FD;
+        /* the second end is passed to the locker like a client connection
+           carrying a lock request */
+        if (NULL == (locker_conn = flom_conn_new(NULL)))
+            THROW(NEW_OBJ2);
+        if (FLOM_RC_OK != (ret_cod = flom_conn_init(
+                               locker_conn, flom_conns_get_new_uid(conns),
+                               AF_UNIX, fds[1], SOCK_STREAM, sizeof(sa),
+                               (struct sockaddr *)&sa, FALSE)))
+            THROW(CONN_INIT_ERROR2);
+        fds[1] = FLOM_NULL_FD;
+        msg = flom_conn_get_msg(locker_conn);
+        msg->header.level = FLOM_MSG_LEVEL;
+        msg->header.pvs.verb = FLOM_MSG_VERB_LOCK;
+        msg->header.pvs.step = FLOM_MSG_STEP_INCR;
+        msg->body.lock_8.resource = member->resource;
+        if (NULL == (msg->body.lock_8.resource.name = g_strdup(
+                         member->resource.name)))
+            THROW(G_STRDUP_ERROR);
+        msg->state = FLOM_MSG_STATE_READY;
+        flom_conn_set_last_step(locker_conn, FLOM_MSG_STEP_INCR);
+
+        /* lookup, creation and feeding of the locker must be atomic */
+        flom_locker_array_lock(lockers);
+        locked = TRUE;
+        if (NULL == (locker = flom_locker_array_lookup(lockers, member->key))) {
+            /* a multiple lock can't be parked inside the incubator: it
+               would keep the resources acquired until now */
+            if (!member->resource.create)
+                THROW(CANT_CREATE);
+            ret_cod = flom_accept_loop_start_locker(
+                lockers, msg, member->type, flom_conns_get_new_uid(conns),
+                &locker);
+            if (FLOM_RC_RESOURCE_INIT_ERROR == ret_cod) {
+                THROW(INVALID_RESOURCE);
+            } else if (FLOM_RC_OK != ret_cod)
+                THROW(ACCEPT_LOOP_START_LOCKER_ERROR);
+            locker_is_new = TRUE;
+        }
+        FLOM_TRACE(("flom_mlock_member_lock: resource '%s' will be served "
+                    "by locker " FLOM_UID_T_FORMAT "\n",
+                    member->resource.name, locker->uid));
+        /* prepare the token for locker thread */
+        flt.command = FLOM_LOCKER_CMD_NEW_CONN;
+        flt.locker = locker;
+        flt.domain = flom_conns_get_domain(conns);
+        flt.client_fd = flom_tcp_get_sockfd(flom_conn_get_tcp(locker_conn));
+        flt.sequence = locker->write_sequence + 1;
+        ret_cod = flom_locker_worker_push(locker->worker, &flt, locker_conn);
+        if (FLOM_RC_RING_FULL == ret_cod) {
+            THROW(RING_FULL);
+        } else if (FLOM_RC_OK != ret_cod)
+            THROW(LOCKER_WORKER_PUSH_ERROR);
+        locker->write_sequence = flt.sequence;
+        locker_conn = NULL;
+        /* the answer of the locker will be read by this thread */
+        flom_conn_set_mlock(daemon_conn, mlock);
+        flom_conns_add_conn(conns, daemon_conn);
+        member->conn = daemon_conn;
+        daemon_conn = NULL;
+        /* the clients waiting for this resource can be served by the new
+           locker */
+        if (locker_is_new &&
+            FLOM_RC_OK != (ret_cod = flom_accept_loop_incubator_transfer(
+                               conns, member->key, locker)))
+            THROW(ACCEPT_LOOP_INCUBATOR_TRANSFER_ERROR);
+
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case SOCKETPAIR_ERROR:
+                ret_cod = FLOM_RC_SOCKETPAIR_ERROR;
+                break;
+            case NEW_OBJ1:
+            case NEW_OBJ2:
+                ret_cod = FLOM_RC_NEW_OBJ;
+                break;
+            case CONN_INIT_ERROR1:
+            case CONN_INIT_ERROR2:
+                break;
+            case G_STRDUP_ERROR:
+                ret_cod = FLOM_RC_G_STRDUP_ERROR;
+                break;
+            case CANT_CREATE:
+                *rc = FLOM_RC_LOCK_CANT_WAIT;
+                ret_cod = FLOM_RC_OK;
+                break;
+            case INVALID_RESOURCE:
+                *rc = FLOM_RC_INVALID_RESOURCE_NAME;
+                ret_cod = FLOM_RC_OK;
+                break;
+            case RING_FULL:
+                *rc = FLOM_RC_RING_FULL;
+                ret_cod = FLOM_RC_OK;
+                break;
+            case ACCEPT_LOOP_START_LOCKER_ERROR:
+            case LOCKER_WORKER_PUSH_ERROR:
+            case ACCEPT_LOOP_INCUBATOR_TRANSFER_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    if (locked)
+        flom_locker_array_unlock(lockers);
+    /* release the objects that have not been passed to the threads */
+    if (NULL != locker_conn) {
+        flom_conn_terminate(locker_conn);
+        flom_conn_delete(locker_conn);
+    }
+    if (NULL != daemon_conn) {
+        flom_conn_terminate(daemon_conn);
+        flom_conn_delete(daemon_conn);
+    }
+    if (FLOM_NULL_FD != fds[0])
+        close(fds[0]);
+    if (FLOM_NULL_FD != fds[1])
+        close(fds[1]);
+    FLOM_TRACE(("flom_mlock_member_lock/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_mlock_member_pollin(flom_conns_t *conns, guint id,
+                             flom_locker_array_t *lockers)
+{
+    enum Exception { CONNS_GET_CD_ERROR
+                     , CONN_RECV_ERROR
+                     , EMPTY_MESSAGE
+                     , MSG_DESERIALIZE_ERROR
+                     , INVALID_MESSAGE
+                     , MLOCK_MEMBER_ANSWER_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+
+    FLOM_TRACE(("flom_mlock_member_pollin\n"));
+    TRY {
+        flom_conn_t *conn;
+
+        if (NULL == (conn = flom_conns_get_conn(conns, id)))
+            THROW(CONNS_GET_CD_ERROR);
+        /* the locker can send the answers of two steps together */
+        do {
+            char buffer[FLOM_MSG_BUFFER_SIZE];
+            size_t read_bytes;
+            struct flom_msg_s *msg = flom_conn_get_msg(conn);
+
+            if (FLOM_RC_OK != (ret_cod = flom_conn_recv(
+                                   conn, buffer, sizeof(buffer),
+                                   &read_bytes, FLOM_NETWORK_WAIT_TIMEOUT,
+                                   NULL, NULL)))
+                THROW(CONN_RECV_ERROR);
+            if (0 == read_bytes)
+                THROW(EMPTY_MESSAGE);
+            if (FLOM_RC_OK != (ret_cod = flom_msg_deserialize(
+                                   buffer, read_bytes, msg,
+                                   flom_conn_get_parser(conn))))
+                THROW(MSG_DESERIALIZE_ERROR);
+            flom_conn_set_last_step(conn, msg->header.pvs.step);
+            flom_msg_trace(msg);
+            if (FLOM_MSG_STATE_INVALID == msg->state)
+                THROW(INVALID_MESSAGE);
+            if (FLOM_MSG_STATE_READY == msg->state &&
+                FLOM_RC_OK != (ret_cod = flom_mlock_member_answer(
+                                   conns, conn, lockers)))
+                THROW(MLOCK_MEMBER_ANSWER_ERROR);
+        } while (flom_mlock_is_member(conn) &&
+                 0 < flom_conn_get_pending_msgs(conn));
+
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case CONNS_GET_CD_ERROR:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
+            case CONN_RECV_ERROR:
+            case EMPTY_MESSAGE:
+            case INVALID_MESSAGE:
+                /* the caller closes the connection */
+                ret_cod = FLOM_RC_CONNECTION_CLOSED;
+                break;
+            case MSG_DESERIALIZE_ERROR:
+            case MLOCK_MEMBER_ANSWER_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_mlock_member_pollin/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_mlock_member_answer(flom_conns_t *conns, flom_conn_t *conn,
+                             flom_locker_array_t *lockers)
+{
+    enum Exception { NULL_OBJECT
+                     , MSG_FREE_ERROR
+                     , MLOCK_CLOSE_CONN_ERROR
+                     , CONNS_CLOSE_FD_ERROR
+                     , MLOCK_REPLY_ERROR
+                     , MLOCK_NEXT_ERROR
+                     , MLOCK_FAIL_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+
+    FLOM_TRACE(("flom_mlock_member_answer\n"));
+    TRY {
+        flom_mlock_t *mlock = flom_conn_get_mlock(conn);
+        struct flom_msg_s *msg = flom_conn_get_msg(conn);
+        gchar **element = NULL;
+        int rc;
+
+        if (NULL == mlock)
+            THROW(NULL_OBJECT);
+        if (FLOM_MSG_VERB_LOCK != msg->header.pvs.verb)
+            rc = FLOM_RC_PROTOCOL_ERROR;
+        else if (2*FLOM_MSG_STEP_INCR == msg->header.pvs.step) {
+            rc = msg->body.lock_16.answer.rc;
+            element = &msg->body.lock_16.answer.element;
+        } else if (3*FLOM_MSG_STEP_INCR == msg->header.pvs.step) {
+            rc = msg->body.lock_24.answer.rc;
+            element = &msg->body.lock_24.answer.element;
+        } else
+            rc = FLOM_RC_PROTOCOL_ERROR;
+        /* the element is returned by the answer to a pipelined lock */
+        if (NULL != element && NULL != *element) {
+            g_free(mlock->element);
+            mlock->element = *element;
+            *element = NULL;
+        }
+        /* the message has been consumed */
+        if (FLOM_RC_OK != (ret_cod = flom_msg_free(msg)))
+            THROW(MSG_FREE_ERROR);
+        flom_msg_init(msg);
+        FLOM_TRACE(("flom_mlock_member_answer: resource %u of %u, "
+                    "rc=%d\n", mlock->current, mlock->member_number, rc));
+
+        if (flom_mlock_is_held(mlock) ||
+            conn != mlock->members[mlock->current].conn) {
+            /* only the member that's waiting for its lock can receive an
+               answer */
+            FLOM_TRACE(("flom_mlock_member_answer: unexpected answer, "
+                        "terminating the request...\n"));
+            if (FLOM_RC_OK != (ret_cod = flom_mlock_close_conn(conns, conn)))
+                THROW(MLOCK_CLOSE_CONN_ERROR);
+            if (FLOM_RC_OK != (ret_cod = flom_conns_close_fd(
+                                   conns, flom_conn_get_conns_pos(conn))))
+                THROW(CONNS_CLOSE_FD_ERROR);
+        } else if (FLOM_RC_LOCK_ENQUEUED == rc) {
+            /* the client is notified only the first time */
+            if (!mlock->enqueued) {
+                if (FLOM_RC_OK != (ret_cod = flom_mlock_reply(mlock, rc)))
+                    THROW(MLOCK_REPLY_ERROR);
+                mlock->enqueued = TRUE;
+            }
+        } else if (FLOM_RC_OK == rc) {
+            mlock->current++;
+            if (FLOM_RC_OK != (ret_cod = flom_mlock_next(
+                                   conns, mlock, lockers)))
+                THROW(MLOCK_NEXT_ERROR);
+        } else if (FLOM_RC_OK != (ret_cod = flom_mlock_fail(
+                                      conns, mlock, rc)))
+            THROW(MLOCK_FAIL_ERROR);
+
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case NULL_OBJECT:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
+            case MSG_FREE_ERROR:
+            case MLOCK_CLOSE_CONN_ERROR:
+            case CONNS_CLOSE_FD_ERROR:
+            case MLOCK_REPLY_ERROR:
+            case MLOCK_NEXT_ERROR:
+            case MLOCK_FAIL_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_mlock_member_answer/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_mlock_client_msg(flom_conns_t *conns, guint id)
+{
+    enum Exception { CONNS_GET_CD_ERROR
+                     , CONNS_GET_MSG_ERROR
+                     , MLOCK_RELEASE_ERROR
+                     , MLOCK_CLOSE_CONN_ERROR
+                     , CONNS_CLOSE_FD_ERROR
+                     , MSG_FREE_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+
+    FLOM_TRACE(("flom_mlock_client_msg\n"));
+    TRY {
+        flom_conn_t *conn;
+        struct flom_msg_s *msg;
+        flom_mlock_t *mlock;
+
+        if (NULL == (conn = flom_conns_get_conn(conns, id)))
+            THROW(CONNS_GET_CD_ERROR);
+        if (NULL == (msg = flom_conns_get_msg(conns, id)))
+            THROW(CONNS_GET_MSG_ERROR);
+        mlock = flom_conn_get_mlock(conn);
+        if (FLOM_MSG_VERB_UNLOCK == msg->header.pvs.verb &&
+            FLOM_MSG_STEP_INCR == msg->header.pvs.step) {
+            /* all the resources are released (or the pending request is
+               cancelled) */
+            FLOM_TRACE(("flom_mlock_client_msg: unlock message, releasing "
+                        "%u resources\n", mlock->member_number));
+            if (FLOM_RC_OK != (ret_cod = flom_mlock_release(conns, mlock)))
+                THROW(MLOCK_RELEASE_ERROR);
+            flom_mlock_delete(mlock);
+        } else {
+            FLOM_TRACE(("flom_mlock_client_msg: unexpected message "
+                        "(verb=%d, step=%d), terminating the client...\n",
+                        msg->header.pvs.verb, msg->header.pvs.step));
+            if (FLOM_RC_OK != (ret_cod = flom_mlock_close_conn(conns, conn)))
+                THROW(MLOCK_CLOSE_CONN_ERROR);
+            if (FLOM_RC_OK != (ret_cod = flom_conns_close_fd(conns, id)))
+                THROW(CONNS_CLOSE_FD_ERROR);
+        }
+        /* the message has been consumed */
+        if (FLOM_RC_OK != (ret_cod = flom_msg_free(msg)))
+            THROW(MSG_FREE_ERROR);
+        flom_msg_init(msg);
+
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case CONNS_GET_CD_ERROR:
+            case CONNS_GET_MSG_ERROR:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
+            case MLOCK_RELEASE_ERROR:
+            case MLOCK_CLOSE_CONN_ERROR:
+            case CONNS_CLOSE_FD_ERROR:
+            case MSG_FREE_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_mlock_client_msg/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_mlock_pipeline_msg(flom_conns_t *conns, guint id,
+                            flom_locker_array_t *lockers)
+{
+    enum Exception { CONNS_GET_CD_ERROR
+                     , CONNS_GET_MSG_ERROR
+                     , PROTOCOL_VIOLATION1
+                     , PROTOCOL_VIOLATION2
+                     , MLOCK_START_ERROR
+                     , MLOCK_PIPELINE_UNLOCK_ERROR
+                     , MSG_SERIALIZE_ERROR
+                     , PROTOCOL_VIOLATION3
+                     , MSG_FREE_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+
+    FLOM_TRACE(("flom_mlock_pipeline_msg\n"));
+    TRY {
+        flom_conn_t *conn;
+        struct flom_msg_s *msg;
+        GHashTable *pipeline;
+        flom_mlock_t *request;
+
+        if (NULL == (conn = flom_conns_get_conn(conns, id)))
+            THROW(CONNS_GET_CD_ERROR);
+        if (NULL == (msg = flom_conns_get_msg(conns, id)))
+            THROW(CONNS_GET_MSG_ERROR);
+        if (NULL == (pipeline = flom_conn_get_pipeline(conn))) {
+            FLOM_TRACE(("flom_mlock_pipeline_msg: client %u starts using "
+                        "pipelined requests\n", id));
+            pipeline = g_hash_table_new(g_direct_hash, g_direct_equal);
+            flom_conn_set_pipeline(conn, pipeline);
+        }
+        /* all the requests of a pipelined client must be tagged */
+        if (0 >= msg->header.rid ||
+            FLOM_MSG_STEP_INCR != msg->header.pvs.step)
+            THROW(PROTOCOL_VIOLATION1);
+        request = g_hash_table_lookup(
+            pipeline, GINT_TO_POINTER(msg->header.rid));
+        FLOM_TRACE(("flom_mlock_pipeline_msg: rid=%d, verb=%d, "
+                    "request=%p\n", msg->header.rid, msg->header.pvs.verb,
+                    request));
+        switch (msg->header.pvs.verb) {
+            case FLOM_MSG_VERB_LOCK:
+            case FLOM_MSG_VERB_MLOCK:
+                /* the id of a request can be reused after its release */
+                if (NULL != request)
+                    THROW(PROTOCOL_VIOLATION2);
+                if (FLOM_RC_OK != (ret_cod = flom_mlock_start(
+                                       conns, id, lockers)))
+                    THROW(MLOCK_START_ERROR);
+                break;
+            case FLOM_MSG_VERB_UNLOCK:
+                /* a request that has been refused does not exist anymore */
+                if (NULL == request) {
+                    FLOM_TRACE(("flom_mlock_pipeline_msg: there's no "
+                                "request with id %d, ignoring unlock...\n",
+                                msg->header.rid));
+                } else if (FLOM_RC_OK != (
+                               ret_cod = flom_mlock_pipeline_unlock(
+                                   conns, request,
+                                   msg->body.unlock_8.resource.rollback)))
+                    THROW(MLOCK_PIPELINE_UNLOCK_ERROR);
+                break;
+            case FLOM_MSG_VERB_PING: {
+                struct flom_msg_s pong;
+                char buffer[FLOM_MSG_BUFFER_SIZE];
+                size_t to_send;
+
+                flom_msg_init(&pong);
+                pong.header.level = flom_conn_get_level(conn);
+                pong.header.pvs.verb = FLOM_MSG_VERB_PING;
+                pong.header.pvs.step = 2*FLOM_MSG_STEP_INCR;
+                pong.header.rid = msg->header.rid;
+                pong.state = FLOM_MSG_STATE_READY;
+                if (FLOM_RC_OK != (ret_cod = flom_msg_serialize(
+                                       &pong, buffer, sizeof(buffer),
+                                       &to_send)))
+                    THROW(MSG_SERIALIZE_ERROR);
+                /* a client that can't be reached will be closed by the
+                   next poll */
+                if (FLOM_RC_OK != (ret_cod = flom_conn_send(
+                                       conn, buffer, to_send)))
+                    FLOM_TRACE(("flom_mlock_pipeline_msg: unable to answer "
+                                "the ping (ret_cod=%d), skipping...\n",
+                                ret_cod));
+                break;
+            }
+            default:
+                THROW(PROTOCOL_VIOLATION3);
+        } /* switch (msg->header.pvs.verb) */
+        /* the message has been consumed */
+        if (FLOM_RC_OK != (ret_cod = flom_msg_free(msg)))
+            THROW(MSG_FREE_ERROR);
+        flom_msg_init(msg);
+
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case CONNS_GET_CD_ERROR:
+            case CONNS_GET_MSG_ERROR:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
+            case PROTOCOL_VIOLATION1:
+            case PROTOCOL_VIOLATION2:
+            case PROTOCOL_VIOLATION3:
+                /* the caller closes the connection */
+                ret_cod = FLOM_RC_CONNECTION_CLOSED;
+                break;
+            case MLOCK_START_ERROR:
+            case MLOCK_PIPELINE_UNLOCK_ERROR:
+            case MSG_SERIALIZE_ERROR:
+            case MSG_FREE_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_mlock_pipeline_msg/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_mlock_pipeline_pollin(flom_conns_t *conns, guint id,
+                               flom_locker_array_t *lockers)
+{
+    enum Exception { CONNS_GET_CD_ERROR
+                     , CONN_RECV_ERROR
+                     , EMPTY_MESSAGE
+                     , MSG_DESERIALIZE_ERROR
+                     , INVALID_MESSAGE
+                     , PROTOCOL_ERROR
+                     , MLOCK_PIPELINE_MSG_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+
+    FLOM_TRACE(("flom_mlock_pipeline_pollin\n"));
+    TRY {
+        flom_conn_t *conn;
+
+        if (NULL == (conn = flom_conns_get_conn(conns, id)))
+            THROW(CONNS_GET_CD_ERROR);
+        /* the client does not wait for the answers: many requests can be
+           already inside the receive buffer */
+        do {
+            char buffer[FLOM_MSG_MAX_SIZE];
+            size_t read_bytes;
+            struct flom_msg_s *msg = flom_conn_get_msg(conn);
+
+            if (FLOM_RC_OK != (ret_cod = flom_conn_recv(
+                                   conn, buffer, sizeof(buffer),
+                                   &read_bytes, FLOM_NETWORK_WAIT_TIMEOUT,
+                                   NULL, NULL)))
+                THROW(CONN_RECV_ERROR);
+            if (0 == read_bytes)
+                THROW(EMPTY_MESSAGE);
+            if (FLOM_RC_OK != (ret_cod = flom_msg_deserialize(
+                                   buffer, read_bytes, msg,
+                                   flom_conn_get_parser(conn))))
+                THROW(MSG_DESERIALIZE_ERROR);
+            flom_conn_set_last_step(conn, msg->header.pvs.step);
+            flom_msg_trace(msg);
+            if (FLOM_MSG_STATE_INVALID == msg->state)
+                THROW(INVALID_MESSAGE);
+            if (FLOM_MSG_STATE_READY != msg->state)
+                continue;
+            if (!flom_msg_check_protocol(msg, TRUE))
+                THROW(PROTOCOL_ERROR);
+            if (FLOM_RC_OK != (ret_cod = flom_mlock_pipeline_msg(
+                                   conns, id, lockers)))
+                THROW(MLOCK_PIPELINE_MSG_ERROR);
+        } while (0 < flom_conn_get_pending_msgs(conn));
+
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case CONNS_GET_CD_ERROR:
+                ret_cod = FLOM_RC_NULL_OBJECT;
+                break;
+            case CONN_RECV_ERROR:
+            case EMPTY_MESSAGE:
+            case INVALID_MESSAGE:
+            case PROTOCOL_ERROR:
+                /* the caller closes the connection */
+                ret_cod = FLOM_RC_CONNECTION_CLOSED;
+                break;
+            case MSG_DESERIALIZE_ERROR:
+            case MLOCK_PIPELINE_MSG_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_mlock_pipeline_pollin/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_mlock_pipeline_unlock(flom_conns_t *conns, flom_mlock_t *mlock,
+                               int rollback)
+{
+    enum Exception { MSG_SERIALIZE_ERROR
+                     , MLOCK_RELEASE_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+
+    FLOM_TRACE(("flom_mlock_pipeline_unlock: rid=%d, rollback=%d\n",
+                mlock->rid, rollback));
+    TRY {
+        flom_conn_t *member_conn = mlock->members[0].conn;
+        
+        /* the locker of a granted resource receives the unlock message:
+           a transactional resource needs the rollback option */
+        if (FLOM_MSG_VERB_LOCK == mlock->verb && flom_mlock_is_held(mlock) &&
+            NULL != member_conn) {
+            struct flom_msg_s msg;
+            char buffer[FLOM_MSG_BUFFER_SIZE];
+            size_t to_send;
+
+            flom_msg_init(&msg);
+            msg.header.level = FLOM_MSG_LEVEL;
+            msg.header.pvs.verb = FLOM_MSG_VERB_UNLOCK;
+            msg.header.pvs.step = FLOM_MSG_STEP_INCR;
+            /* the name is borrowed from the member: the message is not
+               released */
+            msg.body.unlock_8.resource.name = mlock->members[0].resource.name;
+            msg.body.unlock_8.resource.rollback = rollback;
+            msg.state = FLOM_MSG_STATE_READY;
+            if (FLOM_RC_OK != (ret_cod = flom_msg_serialize(
+                                   &msg, buffer, sizeof(buffer), &to_send)))
+                THROW(MSG_SERIALIZE_ERROR);
+            /* closing the connection releases the resource anyway */
+            if (FLOM_RC_OK != (ret_cod = flom_conn_send(
+                                   member_conn, buffer, to_send)))
+                FLOM_TRACE(("flom_mlock_pipeline_unlock: unable to send the "
+                            "unlock message to the locker (ret_cod=%d), "
+                            "skipping...\n", ret_cod));
+        }
+        if (FLOM_RC_OK != (ret_cod = flom_mlock_release(conns, mlock)))
+            THROW(MLOCK_RELEASE_ERROR);
+
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case MSG_SERIALIZE_ERROR:
+            case MLOCK_RELEASE_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    flom_mlock_delete(mlock);
+    FLOM_TRACE(("flom_mlock_pipeline_unlock/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_mlock_pipeline_close(flom_conns_t *conns, flom_conn_t *conn)
+{
+    enum Exception { MLOCK_RELEASE_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    GHashTable *pipeline = flom_conn_get_pipeline(conn);
+    
+    FLOM_TRACE(("flom_mlock_pipeline_close\n"));
+    TRY {
+        GHashTableIter iter;
+        gpointer value;
+
+        if (NULL == pipeline)
+            THROW(NONE);
+        /* the requests must not be removed from the table while it's
+           scanned */
+        flom_conn_set_pipeline(conn, NULL);
+        g_hash_table_iter_init(&iter, pipeline);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            flom_mlock_t *mlock = (flom_mlock_t *)value;
+            g_hash_table_iter_steal(&iter);
+            ret_cod = flom_mlock_release(conns, mlock);
+            flom_mlock_delete(mlock);
+            if (FLOM_RC_OK != ret_cod)
+                THROW(MLOCK_RELEASE_ERROR);
+        } /* while (g_hash_table_iter_next(&iter, NULL, &value)) */
+
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case MLOCK_RELEASE_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    /* the requests that have not been released are deleted by
+       flom_mlock_free_all */
+    if (NULL != pipeline) {
+        if (0 == g_hash_table_size(pipeline))
+            g_hash_table_destroy(pipeline);
+        else
+            flom_conn_set_pipeline(conn, pipeline);
+    }
+    FLOM_TRACE(("flom_mlock_pipeline_close/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_mlock_reply(flom_mlock_t *mlock, int rc)
+{
+    int step = mlock->enqueued ?
+        3*FLOM_MSG_STEP_INCR : 2*FLOM_MSG_STEP_INCR;
+    int ret_cod;
+
+    FLOM_TRACE(("flom_mlock_reply: rid=%d, step=%d, rc=%d\n",
+                mlock->rid, step, rc));
+    if (0 == mlock->rid)
+        ret_cod = flom_conn_send_answer(
+            mlock->client, FLOM_MSG_VERB_MLOCK, step, rc);
+    else
+        /* the answer of a pipelined request carries its id */
+        ret_cod = flom_conn_send_tagged_answer(
+            mlock->client, mlock->verb, step, rc, mlock->rid,
+            FLOM_RC_OK == rc ? mlock->element : NULL);
+    if (FLOM_RC_OK != ret_cod) {
+        /* the client has probably disconnected: its connection will be
+           closed by the next poll */
+        FLOM_TRACE(("flom_mlock_reply: unable to send the answer to the "
+                    "client (ret_cod=%d), skipping...\n", ret_cod));
+    } else
+        flom_conn_set_last_step(mlock->client, step);
+    return FLOM_RC_OK;
+}
+
+
+
+int flom_mlock_release(flom_conns_t *conns, flom_mlock_t *mlock)
+{
+    enum Exception { CONNS_CLOSE_FD_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+
+    FLOM_TRACE(("flom_mlock_release\n"));
+    TRY {
+        guint i;
+
+        for (i=0; i<mlock->member_number; ++i) {
+            flom_conn_t *conn = mlock->members[i].conn;
+            if (NULL == conn)
+                continue;
+            /* closing its connection, the locker releases the resource */
+            mlock->members[i].conn = NULL;
+            flom_conn_set_mlock(conn, NULL);
+            if (FLOM_RC_OK != (ret_cod = flom_conns_close_fd(
+                                   conns, flom_conn_get_conns_pos(conn))))
+                THROW(CONNS_CLOSE_FD_ERROR);
+        } /* for (i=0; i<mlock->member_number; ++i) */
+        mlock->current = 0;
+
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case CONNS_CLOSE_FD_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_mlock_release/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_mlock_fail(flom_conns_t *conns, flom_mlock_t *mlock, int rc)
+{
+    enum Exception { MLOCK_RELEASE_ERROR
+                     , MLOCK_REPLY_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+
+    FLOM_TRACE(("flom_mlock_fail: rc=%d\n", rc));
+    TRY {
+        /* all or nothing: the resources acquired until now are released
+           before the answer is sent */
+        if (FLOM_RC_OK != (ret_cod = flom_mlock_release(conns, mlock)))
+            THROW(MLOCK_RELEASE_ERROR);
+        if (FLOM_RC_OK != (ret_cod = flom_mlock_reply(mlock, rc)))
+            THROW(MLOCK_REPLY_ERROR);
+
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case MLOCK_RELEASE_ERROR:
+            case MLOCK_REPLY_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    flom_mlock_delete(mlock);
+    FLOM_TRACE(("flom_mlock_fail/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_mlock_close_conn(flom_conns_t *conns, flom_conn_t *conn)
+{
+    enum Exception { MLOCK_PIPELINE_CLOSE_ERROR1
+                     , MLOCK_RELEASE_ERROR1
+                     , MLOCK_RELEASE_ERROR2
+                     , MLOCK_PIPELINE_CLOSE_ERROR2
+                     , CONNS_CLOSE_FD_ERROR
+                     , MLOCK_FAIL_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+
+    FLOM_TRACE(("flom_mlock_close_conn\n"));
+    TRY {
+        flom_mlock_t *mlock = flom_conn_get_mlock(conn);
+        guint i;
+
+        if (flom_mlock_is_pipelined(conn)) {
+            FLOM_TRACE(("flom_mlock_close_conn: the pipelined client is "
+                        "leaving, releasing its requests...\n"));
+            if (FLOM_RC_OK != (ret_cod = flom_mlock_pipeline_close(
+                                   conns, conn)))
+                THROW(MLOCK_PIPELINE_CLOSE_ERROR1);
+            THROW(NONE);
+        }
+        if (NULL == mlock)
+            THROW(NONE);
+        if (conn == mlock->client) {
+            FLOM_TRACE(("flom_mlock_close_conn: the client is leaving, "
+                        "releasing its resources...\n"));
+            if (FLOM_RC_OK != (ret_cod = flom_mlock_release(conns, mlock)))
+                THROW(MLOCK_RELEASE_ERROR1);
+            flom_mlock_delete(mlock);
+            THROW(NONE);
+        }
+        /* a member connection is closed by the locker or by a network
+           error */
+        flom_conn_set_mlock(conn, NULL);
+        for (i=0; i<mlock->member_number; ++i)
+            if (conn == mlock->members[i].conn)
+                mlock->members[i].conn = NULL;
+        if (flom_mlock_is_held(mlock)) {
+            flom_conn_t *client = mlock->client;
+            /* the client is not the owner of all the resources anymore */
+            FLOM_TRACE(("flom_mlock_close_conn: a granted resource has been "
+                        "lost, terminating the client...\n"));
+            if (FLOM_RC_OK != (ret_cod = flom_mlock_release(conns, mlock)))
+                THROW(MLOCK_RELEASE_ERROR2);
+            flom_mlock_delete(mlock);
+            /* the other requests of a pipelined client are released too */
+            if (FLOM_RC_OK != (ret_cod = flom_mlock_pipeline_close(
+                                   conns, client)))
+                THROW(MLOCK_PIPELINE_CLOSE_ERROR2);
+            if (FLOM_RC_OK != (ret_cod = flom_conns_close_fd(
+                                   conns, flom_conn_get_conns_pos(client))))
+                THROW(CONNS_CLOSE_FD_ERROR);
+        } else if (FLOM_RC_OK != (ret_cod = flom_mlock_fail(
+                                      conns, mlock, FLOM_RC_LOCK_CANT_LOCK)))
+            THROW(MLOCK_FAIL_ERROR);
+
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case MLOCK_PIPELINE_CLOSE_ERROR1:
+            case MLOCK_RELEASE_ERROR1:
+            case MLOCK_RELEASE_ERROR2:
+            case MLOCK_PIPELINE_CLOSE_ERROR2:
+            case CONNS_CLOSE_FD_ERROR:
+            case MLOCK_FAIL_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_mlock_close_conn/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+void flom_mlock_free_all(flom_conns_t *conns)
+{
+    guint i;
+
+    FLOM_TRACE(("flom_mlock_free_all\n"));
+    for (i=0; i<flom_conns_get_used(conns); ++i) {
+        flom_conn_t *conn = flom_conns_get_conn(conns, i);
+        flom_mlock_t *mlock;
+        GHashTable *pipeline;
+        /* every request is deleted by its client */
+        if (NULL == conn)
+            continue;
+        if (NULL != (mlock = flom_conn_get_mlock(conn)) &&
+            conn == mlock->client)
+            flom_mlock_delete(mlock);
+        if (NULL != (pipeline = flom_conn_get_pipeline(conn))) {
+            GHashTableIter iter;
+            gpointer value;
+            flom_conn_set_pipeline(conn, NULL);
+            g_hash_table_iter_init(&iter, pipeline);
+            while (g_hash_table_iter_next(&iter, NULL, &value))
+                flom_mlock_delete((flom_mlock_t *)value);
+            g_hash_table_destroy(pipeline);
+        }
+    } /* for (i=0; i<flom_conns_get_used(conns); ++i) */
+}
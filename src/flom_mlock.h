@@ -0,0 +1,409 @@
+/*
+ * Copyright (c) 2013-2024, Christian Ferrari <tiian@users.sourceforge.net>
+ * All rights reserved.
+ *
+ * This file is part of FLoM, Free Lock Manager
+ *
+ * FLoM is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2.0 as
+ * published by the Free Software Foundation.
+ *
+ * FLoM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FLoM.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FLOM_MLOCK_H
+# define FLOM_MLOCK_H
+
+
+
+#include <config.h>
+
+
+
+#ifdef HAVE_GLIB_H
+# include <glib.h>
+#endif
+
+
+
+#include "flom_conn.h"
+#include "flom_conns.h"
+#include "flom_locker.h"
+#include "flom_msg.h"
+#include "flom_rsrc.h"
+
+
+
+/* save old FLOM_TRACE_MODULE and set a new value */
+#ifdef FLOM_TRACE_MODULE
+# define FLOM_TRACE_MODULE_SAVE FLOM_TRACE_MODULE
+# undef FLOM_TRACE_MODULE
+#else
+# undef FLOM_TRACE_MODULE_SAVE
+#endif /* FLOM_TRACE_MODULE */
+#define FLOM_TRACE_MODULE      FLOM_TRACE_MOD_MLOCK
+
+
+
+/**
+ * A resource of a multiple lock request
+ */
+struct flom_mlock_member_s {
+    /**
+     * Resource requested by the client (the name is owned by the member)
+     */
+    struct flom_msg_body_lock_8_resource_s   resource;
+    /**
+     * Type of the resource
+     */
+    flom_rsrc_type_t                         type;
+    /**
+     * Key of the locker managing the resource (see
+     * @ref flom_rsrc_get_key): the members are acquired following the
+     * order of the keys
+     */
+    gchar                                   *key;
+    /**
+     * Daemon side of the socket pair used to acquire the resource from
+     * its locker; NULL if the resource has not been requested yet or if
+     * it has been released
+     */
+    flom_conn_t                             *conn;
+};
+
+
+
+/**
+ * A multiple lock request: the resources are acquired one at a time
+ * from their lockers, following the order of the keys, through internal
+ * connections created by the acceptor thread. All the clients that ask
+ * resources of the same lockers use the same global order and they can
+ * not deadlock each other. The client receives a single answer: all the
+ * resources have been acquired or none of them is kept.
+ * The same object is used for the lock requests of a pipelined client
+ * connection: every request has its own id and it's served by its own
+ * internal connection, the answers are returned as soon as they arrive
+ */
+typedef struct flom_mlock_s {
+    /**
+     * Connection of the client that sent the request
+     */
+    flom_conn_t                   *client;
+    /**
+     * Verb of the client request: @ref FLOM_MSG_VERB_MLOCK or
+     * @ref FLOM_MSG_VERB_LOCK (pipelined requests only)
+     */
+    int                            verb;
+    /**
+     * Request id of a pipelined request; 0 if the request is the only one
+     * of its client connection
+     */
+    int                            rid;
+    /**
+     * Number of resources in @ref members
+     */
+    guint                          member_number;
+    /**
+     * Index of the member that's waiting for its lock;
+     * @ref member_number if all the resources have been acquired
+     */
+    guint                          current;
+    /**
+     * The client has been notified with @ref FLOM_RC_LOCK_ENQUEUED and
+     * the outcome must be sent with the next step
+     */
+    int                            enqueued;
+    /**
+     * Resources requested by the client, sorted by key
+     */
+    struct flom_mlock_member_s    *members;
+    /**
+     * Element returned by the locker (resource sets and similar); it's
+     * passed to the client only by pipelined lock requests
+     */
+    gchar                         *element;
+} flom_mlock_t;
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+
+
+    /**
+     * Check if a connection is used by the acceptor thread to acquire a
+     * resource of a multiple lock request
+     * @param conn IN connection object
+     * @return a boolean value
+     */
+    static inline int flom_mlock_is_member(const flom_conn_t *conn) {
+        return NULL != conn->mlock && conn != conn->mlock->client;
+    }
+
+
+
+    /**
+     * Check if a connection belongs to a client that uses pipelined
+     * requests
+     * @param conn IN connection object
+     * @return a boolean value
+     */
+    static inline int flom_mlock_is_pipelined(const flom_conn_t *conn) {
+        return NULL != conn->pipeline;
+    }
+
+
+
+    /**
+     * Check if all the resources of a multiple lock request have been
+     * acquired
+     * @param mlock IN multiple lock object
+     * @return a boolean value
+     */
+    static inline int flom_mlock_is_held(const flom_mlock_t *mlock) {
+        return mlock->current == mlock->member_number;
+    }
+
+
+
+    /**
+     * Release a multiple lock object: the client and the connections of
+     * the members are detached, but they are not closed
+     * @param mlock IN/OUT multiple lock object
+     */
+    void flom_mlock_delete(flom_mlock_t *mlock);
+
+
+
+    /**
+     * Compare two members using their keys; it's used to sort the
+     * members of a multiple lock request
+     * @param a IN first member
+     * @param b IN second member
+     * @return <0, 0, >0 like strcmp
+     */
+    int flom_mlock_member_compare(const void *a, const void *b);
+
+
+
+    /**
+     * Start a multiple lock request: the resources are taken from the
+     * message of the client connection and the first one is requested to
+     * its locker. Invalid requests are refused with an answer to the
+     * client. A lock message of a pipelined client is started as a
+     * request with a single resource
+     * @param conns IN/OUT connections object
+     * @param id IN id of the client connection
+     * @param lockers IN/OUT array of lockers
+     * @return a reason code
+     */
+    int flom_mlock_start(flom_conns_t *conns, guint id,
+                         flom_locker_array_t *lockers);
+
+
+
+    /**
+     * Request the next resource of a multiple lock request; if all the
+     * resources have been acquired, the client is notified
+     * @param conns IN/OUT connections object
+     * @param mlock IN/OUT multiple lock object; it's deleted if the
+     *        request fails
+     * @param lockers IN/OUT array of lockers
+     * @return a reason code
+     */
+    int flom_mlock_next(flom_conns_t *conns, flom_mlock_t *mlock,
+                        flom_locker_array_t *lockers);
+
+
+
+    /**
+     * Pass the request of a member to the locker managing its resource:
+     * the locker is created if necessary
+     * @param conns IN/OUT connections object
+     * @param mlock IN/OUT multiple lock object
+     * @param member IN/OUT member to request
+     * @param lockers IN/OUT array of lockers
+     * @param rc OUT @ref FLOM_RC_OK if the request has been passed to the
+     *        locker, the answer that must be returned to the client
+     *        otherwise
+     * @return a reason code
+     */
+    int flom_mlock_member_lock(flom_conns_t *conns, flom_mlock_t *mlock,
+                               struct flom_mlock_member_s *member,
+                               flom_locker_array_t *lockers, int *rc);
+
+
+
+    /**
+     * Receive and process the answers sent by a locker to a member
+     * connection
+     * @param conns IN/OUT connections object
+     * @param id IN id of the member connection
+     * @param lockers IN/OUT array of lockers
+     * @return a reason code
+     */
+    int flom_mlock_member_pollin(flom_conns_t *conns, guint id,
+                                 flom_locker_array_t *lockers);
+
+
+
+    /**
+     * Process an answer sent by a locker to a member connection
+     * @param conns IN/OUT connections object
+     * @param conn IN/OUT member connection
+     * @param lockers IN/OUT array of lockers
+     * @return a reason code
+     */
+    int flom_mlock_member_answer(flom_conns_t *conns, flom_conn_t *conn,
+                                 flom_locker_array_t *lockers);
+
+
+
+    /**
+     * Process a message sent by a client that's the owner of a multiple
+     * lock request: an unlock message releases all the resources, any
+     * other message terminates the client connection
+     * @param conns IN/OUT connections object
+     * @param id IN id of the client connection
+     * @return a reason code
+     */
+    int flom_mlock_client_msg(flom_conns_t *conns, guint id);
+
+
+
+    /**
+     * Process the message of a client that uses pipelined requests: lock
+     * and multiple lock requests are started, unlock requests release the
+     * resources of the request with the same id and ping requests are
+     * answered immediately. Any other message terminates the client
+     * connection
+     * @param conns IN/OUT connections object
+     * @param id IN id of the client connection
+     * @param lockers IN/OUT array of lockers
+     * @return a reason code, @ref FLOM_RC_CONNECTION_CLOSED if the caller
+     *         must close the client connection
+     */
+    int flom_mlock_pipeline_msg(flom_conns_t *conns, guint id,
+                                flom_locker_array_t *lockers);
+
+
+
+    /**
+     * Receive and process all the messages available for a client that
+     * uses pipelined requests
+     * @param conns IN/OUT connections object
+     * @param id IN id of the client connection
+     * @param lockers IN/OUT array of lockers
+     * @return a reason code, @ref FLOM_RC_CONNECTION_CLOSED if the caller
+     *         must close the client connection
+     */
+    int flom_mlock_pipeline_pollin(flom_conns_t *conns, guint id,
+                                   flom_locker_array_t *lockers);
+
+
+
+    /**
+     * Release the resources of a pipelined lock request: the unlock
+     * message is passed to the locker (rollback option) before the
+     * internal connection is closed
+     * @param conns IN/OUT connections object
+     * @param mlock IN/OUT pipelined request; it's deleted
+     * @param rollback IN the state of the transactional resource must be
+     *        backed out
+     * @return a reason code
+     */
+    int flom_mlock_pipeline_unlock(flom_conns_t *conns, flom_mlock_t *mlock,
+                                   int rollback);
+
+
+
+    /**
+     * Release all the requests of a pipelined client connection
+     * @param conns IN/OUT connections object
+     * @param conn IN/OUT client connection
+     * @return a reason code
+     */
+    int flom_mlock_pipeline_close(flom_conns_t *conns, flom_conn_t *conn);
+
+
+
+    /**
+     * Send the answer of a multiple lock request to the client; a client
+     * that can't be reached is not an error: its connection will be
+     * closed by the next poll
+     * @param mlock IN/OUT multiple lock object
+     * @param rc IN answer return code
+     * @return a reason code
+     */
+    int flom_mlock_reply(flom_mlock_t *mlock, int rc);
+
+
+
+    /**
+     * Close all the member connections of a multiple lock request: the
+     * lockers release the resources (or remove the waiting requests)
+     * @param conns IN/OUT connections object
+     * @param mlock IN/OUT multiple lock object
+     * @return a reason code
+     */
+    int flom_mlock_release(flom_conns_t *conns, flom_mlock_t *mlock);
+
+
+
+    /**
+     * Terminate a multiple lock request that can not be completed: the
+     * acquired resources are released, the client receives the answer
+     * and the object is deleted
+     * @param conns IN/OUT connections object
+     * @param mlock IN/OUT multiple lock object
+     * @param rc IN answer return code for the client
+     * @return a reason code
+     */
+    int flom_mlock_fail(flom_conns_t *conns, flom_mlock_t *mlock, int rc);
+
+
+
+    /**
+     * Manage the multiple lock request a connection belongs to before
+     * the connection is closed: the request is terminated and, if a
+     * member of a granted request is lost, the client is disconnected too
+     * @param conns IN/OUT connections object
+     * @param conn IN/OUT connection that's going to be closed
+     * @return a reason code
+     */
+    int flom_mlock_close_conn(flom_conns_t *conns, flom_conn_t *conn);
+
+
+
+    /**
+     * Delete all the multiple lock and pipelined requests of a connections
+     * object; it must be called before the connections are released
+     * @param conns IN/OUT connections object
+     */
+    void flom_mlock_free_all(flom_conns_t *conns);
+
+
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+
+/* restore old value of FLOM_TRACE_MODULE */
+#ifdef FLOM_TRACE_MODULE_SAVE
+# undef FLOM_TRACE_MODULE
+# define FLOM_TRACE_MODULE FLOM_TRACE_MODULE_SAVE
+# undef FLOM_TRACE_MODULE_SAVE
+#endif /* FLOM_TRACE_MODULE_SAVE */
+
+
+
+#endif /* FLOM_MLOCK_H */
@@ -63,12 +63,14 @@ const gchar *FLOM_MSG_PROP_PEERID         = (gchar *)"peerid";
 const gchar *FLOM_MSG_PROP_PORT           = (gchar *)"port";
 const gchar *FLOM_MSG_PROP_QUANTITY       = (gchar *)"quantity";
 const gchar *FLOM_MSG_PROP_RC             = (gchar *)"rc";
+const gchar *FLOM_MSG_PROP_RID            = (gchar *)"rid";
 const gchar *FLOM_MSG_PROP_ROLLBACK       = (gchar *)"rollback";
 const gchar *FLOM_MSG_PROP_STEP           = (gchar *)"step";
 const gchar *FLOM_MSG_PROP_VERB           = (gchar *)"verb"; 
 const gchar *FLOM_MSG_PROP_WAIT           = (gchar *)"wait";
 const gchar *FLOM_MSG_TAG_ANSWER          = (gchar *)"answer";
 const gchar *FLOM_MSG_TAG_MSG             = (gchar *)"msg";
+const gchar *FLOM_MSG_CLOSING_TAG         = (gchar *)"</msg>";
 const gchar *FLOM_MSG_TAG_NETWORK         = (gchar *)"network";
 const gchar *FLOM_MSG_TAG_RESOURCE        = (gchar *)"resource";
 const gchar *FLOM_MSG_TAG_SESSION         = (gchar *)"session";
@@ -76,6 +78,46 @@ const gchar *FLOM_MSG_TAG_SHUTDOWN        = (gchar *)"shutdown";
 
 
 
+/* static fragments of the XML messages: they are appended with
+   FLOM_MSG_PUT_FRAGMENT and their length is computed at compile time */
+const gchar FLOM_MSG_FRAGMENT_MSG_OPEN[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" ?><msg level=\"";
+const gchar FLOM_MSG_FRAGMENT_VERB[] = "\" verb=\"";
+const gchar FLOM_MSG_FRAGMENT_STEP[] = "\" step=\"";
+const gchar FLOM_MSG_FRAGMENT_RID[] = "\" rid=\"";
+const gchar FLOM_MSG_FRAGMENT_TAG_END[] = "\">";
+const gchar FLOM_MSG_FRAGMENT_MSG_CLOSE[] = "</msg>";
+const gchar FLOM_MSG_FRAGMENT_EMPTY_TAG_END[] = "\"/>";
+const gchar FLOM_MSG_FRAGMENT_SPACED_EMPTY_TAG_END[] = "\" />";
+const gchar FLOM_MSG_FRAGMENT_SESSION[] = "<session peerid=\"";
+const gchar FLOM_MSG_FRAGMENT_ANSWER[] = "<answer rc=\"";
+const gchar FLOM_MSG_FRAGMENT_ELEMENT[] = "\" element=\"";
+const gchar FLOM_MSG_FRAGMENT_RESOURCE[] = "<resource name=\"";
+const gchar FLOM_MSG_FRAGMENT_MODE[] = "\" mode=\"";
+const gchar FLOM_MSG_FRAGMENT_WAIT[] = "\" wait=\"";
+const gchar FLOM_MSG_FRAGMENT_QUANTITY[] = "\" quantity=\"";
+const gchar FLOM_MSG_FRAGMENT_CREATE[] = "\" create=\"";
+const gchar FLOM_MSG_FRAGMENT_LIFESPAN[] = "\" lifespan=\"";
+const gchar FLOM_MSG_FRAGMENT_ROLLBACK[] = "\" rollback=\"";
+const gchar FLOM_MSG_FRAGMENT_NETWORK[] = "<network address=\"";
+const gchar FLOM_MSG_FRAGMENT_PORT[] = "\" port=\"";
+const gchar FLOM_MSG_FRAGMENT_SHUTDOWN[] = "<shutdown immediate=\"";
+/**
+ * Append a static fragment to a serialization buffer
+ */
+#define FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars, fragment) \
+    flom_msg_put_chars(buffer, offset, free_chars, fragment, \
+                       sizeof(fragment) - 1)
+
+
+
+flom_msg_cached_answer_t flom_msg_answer_cache[
+    FLOM_MSG_ANSWER_CACHE_LEVELS][FLOM_MSG_ANSWER_CACHE_STEPS][
+    FLOM_MSG_ANSWER_CACHE_RCS];
+gsize flom_msg_answer_cache_ready = 0;
+
+
+
 const char *FLOM_LOCK_MODE_NL_SHORT_STRING = "NL";
 const char *FLOM_LOCK_MODE_NL_LONG_STRING = "NullLock";
 const char *FLOM_LOCK_MODE_CR_SHORT_STRING = "CR";
@@ -91,12 +133,6 @@ const char *FLOM_LOCK_MODE_EX_LONG_STRING = "Exclusive";
 
 
 
-GMarkupParser flom_msg_parser = {
-    flom_msg_deserialize_start_element,
-    flom_msg_deserialize_end_element,
-    flom_msg_deserialize_text,
-    NULL, NULL };
-
 
 
 flom_lock_mode_t flom_lock_mode_retrieve(const gchar *text)
@@ -215,6 +251,7 @@ int flom_msg_free(struct flom_msg_s *msg)
                      , INVALID_STEP_PING
                      , INVALID_STEP_DISCOVER
                      , INVALID_STEP_MNGMNT
+                     , INVALID_STEP_MLOCK
                      , INVALID_VERB
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
@@ -312,6 +349,43 @@ int flom_msg_free(struct flom_msg_s *msg)
                         THROW(INVALID_STEP_MNGMNT);
                 }
                 break;
+            case FLOM_MSG_VERB_MLOCK:
+                switch (msg->header.pvs.step) {
+                    case FLOM_MSG_STEP_INCR:
+                        if (NULL != msg->body.mlock_8.session.peerid) {
+                            g_free(msg->body.mlock_8.session.peerid);
+                            msg->body.mlock_8.session.peerid = NULL;
+                        }
+                        if (NULL != msg->body.mlock_8.resources) {
+                            guint i;
+                            for (i=0; i<msg->body.mlock_8.resource_number;
+                                 ++i)
+                                g_free(msg->body.mlock_8.resources[i].name);
+                            g_free(msg->body.mlock_8.resources);
+                            msg->body.mlock_8.resources = NULL;
+                        }
+                        msg->body.mlock_8.resource_number = 0;
+                        break;
+                    case 2*FLOM_MSG_STEP_INCR:
+                        if (NULL != msg->body.lock_16.session.peerid) {
+                            g_free(msg->body.lock_16.session.peerid);
+                            msg->body.lock_16.session.peerid = NULL;
+                        }
+                        if (NULL != msg->body.lock_16.answer.element) {
+                            g_free(msg->body.lock_16.answer.element);
+                            msg->body.lock_16.answer.element = NULL;
+                        }
+                        break;
+                    case 3*FLOM_MSG_STEP_INCR:
+                        if (NULL != msg->body.lock_24.answer.element) {
+                            g_free(msg->body.lock_24.answer.element);
+                            msg->body.lock_24.answer.element = NULL;
+                        }
+                        break;
+                    default:
+                        THROW(INVALID_STEP_MLOCK);
+                }
+                break;
             default:
                 THROW(INVALID_VERB);
         } /* switch (msg->header.pvs.verb) */
@@ -324,6 +398,7 @@ int flom_msg_free(struct flom_msg_s *msg)
             case INVALID_STEP_PING:
             case INVALID_STEP_DISCOVER:
             case INVALID_STEP_MNGMNT:
+            case INVALID_STEP_MLOCK:
             case INVALID_VERB:
                 FLOM_TRACE(("flom_msg_free: verb=%d, step=%d\n",
                             msg->header.pvs.verb, msg->header.pvs.step));
@@ -372,12 +447,13 @@ int flom_msg_check_protocol(const struct flom_msg_s *msg, int client)
             } /* switch (msg->header.pvs.step) */                
             break;
         case FLOM_MSG_VERB_PING:
+            /* a pipelined client can ping the daemon too */
             switch (msg->header.pvs.step) {
                 case FLOM_MSG_STEP_INCR:
-                    ret_cod = client ? FALSE : TRUE;
+                    ret_cod = client ? 0 != msg->header.rid : TRUE;
                     break;
                 case 2*FLOM_MSG_STEP_INCR:
-                    ret_cod = client ? TRUE : FALSE;
+                    ret_cod = client ? TRUE : 0 != msg->header.rid;
                     break;
                 default:
                     break;
@@ -404,6 +480,19 @@ int flom_msg_check_protocol(const struct flom_msg_s *msg, int client)
                     break;
             } /* switch(msg->header.pvs.step) */
             break;
+        case FLOM_MSG_VERB_MLOCK:
+            switch (msg->header.pvs.step) {
+                case FLOM_MSG_STEP_INCR:
+                    ret_cod = client ? TRUE : FALSE;
+                    break;
+                case 2*FLOM_MSG_STEP_INCR:
+                case 3*FLOM_MSG_STEP_INCR:
+                    ret_cod = client ? FALSE : TRUE;
+                    break;
+                default:
+                    break;
+            } /* switch (msg->header.pvs.step) */
+            break;
         default:
             break;
     } /* switch (msg->header.pvs.verb) */
@@ -417,8 +506,8 @@ int flom_msg_serialize(const struct flom_msg_s *msg,
                        char *buffer, size_t buffer_len,
                        size_t *msg_len)
 {
-    enum Exception { BUFFER_TOO_SHORT1
-                     , BUFFER_TOO_SHORT2
+    enum Exception { SERIALIZE_BINARY_ERROR
+                     , BUFFER_TOO_SHORT1
                      , SERIALIZE_LOCK_8_ERROR
                      , SERIALIZE_LOCK_16_ERROR
                      , SERIALIZE_LOCK_24_ERROR
@@ -434,38 +523,45 @@ int flom_msg_serialize(const struct flom_msg_s *msg,
                      , INVALID_DISCOVER_STEP
                      , SERIALIZE_MNGMNT_8_ERROR
                      , INVALID_MNGMNT_STEP
+                     , SERIALIZE_MLOCK_8_ERROR
+                     , SERIALIZE_MLOCK_16_ERROR
+                     , SERIALIZE_MLOCK_24_ERROR
+                     , INVALID_MLOCK_STEP
                      , INVALID_VERB
                      , BUFFER_TOO_SHORT3
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
 
-    int used_chars = 0;
     size_t free_chars = buffer_len, offset = 0;
     
     FLOM_TRACE(("flom_msg_serialize\n"));
     TRY {
-        /* <xml ... > */
-        used_chars = snprintf(buffer, free_chars,
-                              "%s version=\"1.0\" encoding=\"UTF-8\" ?>",
-                              FLOM_MSG_HEADER);
-        if (used_chars >= free_chars)
+        /* compact binary encoding */
+        if (FLOM_MSG_LEVEL_BINARY == msg->header.level) {
+            if (FLOM_RC_OK != (ret_cod = flom_msg_serialize_binary(
+                                   msg, buffer, buffer_len, msg_len)))
+                THROW(SERIALIZE_BINARY_ERROR);
+            THROW(NONE);
+        }
+        /* <xml ... ><msg ... > */
+        FLOM_MSG_PUT_FRAGMENT(buffer, &offset, &free_chars,
+                              FLOM_MSG_FRAGMENT_MSG_OPEN);
+        flom_msg_put_int(buffer, &offset, &free_chars, msg->header.level);
+        FLOM_MSG_PUT_FRAGMENT(buffer, &offset, &free_chars,
+                              FLOM_MSG_FRAGMENT_VERB);
+        flom_msg_put_int(buffer, &offset, &free_chars, msg->header.pvs.verb);
+        FLOM_MSG_PUT_FRAGMENT(buffer, &offset, &free_chars,
+                              FLOM_MSG_FRAGMENT_STEP);
+        flom_msg_put_int(buffer, &offset, &free_chars, msg->header.pvs.step);
+        if (0 != msg->header.rid) {
+            FLOM_MSG_PUT_FRAGMENT(buffer, &offset, &free_chars,
+                                  FLOM_MSG_FRAGMENT_RID);
+            flom_msg_put_int(buffer, &offset, &free_chars, msg->header.rid);
+        }
+        FLOM_MSG_PUT_FRAGMENT(buffer, &offset, &free_chars,
+                              FLOM_MSG_FRAGMENT_TAG_END);
+        if (0 == free_chars)
             THROW(BUFFER_TOO_SHORT1);
-        /* <msg ... > */
-        free_chars -= used_chars;
-        offset += used_chars;
-        used_chars = snprintf(buffer + offset, free_chars,
-                              "<%s %s=\"%d\" %s=\"%d\" %s=\"%d\">",
-                              FLOM_MSG_TAG_MSG,
-                              FLOM_MSG_PROP_LEVEL,
-                              msg->header.level,
-                              FLOM_MSG_PROP_VERB,
-                              msg->header.pvs.verb,
-                              FLOM_MSG_PROP_STEP,
-                              msg->header.pvs.step);
-        if (used_chars >= free_chars)
-            THROW(BUFFER_TOO_SHORT2);
-        free_chars -= used_chars;
-        offset += used_chars;
 
         switch (msg->header.pvs.verb) {
             case FLOM_MSG_VERB_LOCK:
@@ -558,16 +654,39 @@ int flom_msg_serialize(const struct flom_msg_s *msg,
                         THROW(INVALID_MNGMNT_STEP);
                 }
                 break;
+            case FLOM_MSG_VERB_MLOCK:
+                switch (msg->header.pvs.step) {
+                    case FLOM_MSG_STEP_INCR:
+                        if (FLOM_RC_OK != (
+                                ret_cod = flom_msg_serialize_mlock_8(
+                                    msg, buffer, &offset, &free_chars)))
+                            THROW(SERIALIZE_MLOCK_8_ERROR);
+                        break;
+                    /* the answers share the body of the lock verb */
+                    case 2*FLOM_MSG_STEP_INCR:
+                        if (FLOM_RC_OK != (
+                                ret_cod = flom_msg_serialize_lock_16(
+                                    msg, buffer, &offset, &free_chars)))
+                            THROW(SERIALIZE_MLOCK_16_ERROR);
+                        break;
+                    case 3*FLOM_MSG_STEP_INCR:
+                        if (FLOM_RC_OK != (
+                                ret_cod = flom_msg_serialize_lock_24(
+                                    msg, buffer, &offset, &free_chars)))
+                            THROW(SERIALIZE_MLOCK_24_ERROR);
+                        break;
+                    default:
+                        THROW(INVALID_MLOCK_STEP);
+                }
+                break;
             default:
                 THROW(INVALID_VERB);
         }
         /* </msg> */
-        used_chars = snprintf(buffer + offset, free_chars,
-                              "</%s>", FLOM_MSG_TAG_MSG);
-        if (used_chars >= free_chars)
+        FLOM_MSG_PUT_FRAGMENT(buffer, &offset, &free_chars,
+                              FLOM_MSG_FRAGMENT_MSG_CLOSE);
+        if (0 == free_chars)
             THROW(BUFFER_TOO_SHORT3);
-        free_chars -= used_chars;
-        offset += used_chars;
 
         *msg_len = offset;
         
@@ -577,8 +696,9 @@ int flom_msg_serialize(const struct flom_msg_s *msg,
         THROW(NONE);
     } CATCH {
         switch (excp) {
+            case SERIALIZE_BINARY_ERROR:
+                break;
             case BUFFER_TOO_SHORT1:
-            case BUFFER_TOO_SHORT2:
                 ret_cod = FLOM_RC_CONTAINER_FULL;
                 break;
             case SERIALIZE_LOCK_8_ERROR:
@@ -591,12 +711,16 @@ int flom_msg_serialize(const struct flom_msg_s *msg,
             case SERIALIZE_DISCOVER_8_ERROR:
             case SERIALIZE_DISCOVER_16_ERROR:
             case SERIALIZE_MNGMNT_8_ERROR:
+            case SERIALIZE_MLOCK_8_ERROR:
+            case SERIALIZE_MLOCK_16_ERROR:
+            case SERIALIZE_MLOCK_24_ERROR:
                 break;
             case INVALID_LOCK_STEP:
             case INVALID_UNLOCK_STEP:
             case INVALID_PING_STEP:
             case INVALID_DISCOVER_STEP:
             case INVALID_MNGMNT_STEP:
+            case INVALID_MLOCK_STEP:
             case INVALID_VERB:
                 ret_cod = FLOM_RC_INTERNAL_ERROR;
                 break;
@@ -617,142 +741,314 @@ int flom_msg_serialize(const struct flom_msg_s *msg,
 
 
 
+int flom_msg_serialize_binary(const struct flom_msg_s *msg,
+                              char *buffer, size_t buffer_len,
+                              size_t *msg_len)
+{
+    enum Exception { INVALID_LOCK_STEP
+                     , INVALID_UNLOCK_STEP
+                     , INVALID_PING_STEP
+                     , INVALID_DISCOVER_STEP
+                     , INVALID_MNGMNT_STEP
+                     , INVALID_MLOCK_STEP
+                     , INVALID_VERB
+                     , BUFFER_TOO_SHORT1
+                     , BUFFER_TOO_SHORT2
+                     , BUFFER_TOO_SHORT3
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_msg_serialize_binary\n"));
+    TRY {
+        const gchar *strings[FLOM_MSG_BINARY_MAX_FIELDS];
+        gint32 ints[FLOM_MSG_BINARY_MAX_FIELDS];
+        guint n_strings = 0, n_ints = 0, i;
+        size_t offset = FLOM_MSG_BINARY_HEADER_SIZE + 2;
+
+        /* collect the fields of the body */
+        switch (msg->header.pvs.verb) {
+            case FLOM_MSG_VERB_LOCK:
+                switch (msg->header.pvs.step) {
+                    case FLOM_MSG_STEP_INCR:
+                        strings[n_strings++] = msg->body.lock_8.session.peerid;
+                        strings[n_strings++] = msg->body.lock_8.resource.name;
+                        ints[n_ints++] = msg->body.lock_8.resource.mode;
+                        ints[n_ints++] = msg->body.lock_8.resource.wait;
+                        ints[n_ints++] = msg->body.lock_8.resource.quantity;
+                        ints[n_ints++] = msg->body.lock_8.resource.create;
+                        ints[n_ints++] = msg->body.lock_8.resource.lifespan;
+                        break;
+                    case 2*FLOM_MSG_STEP_INCR:
+                        strings[n_strings++] =
+                            msg->body.lock_16.session.peerid;
+                        strings[n_strings++] =
+                            msg->body.lock_16.answer.element;
+                        ints[n_ints++] = msg->body.lock_16.answer.rc;
+                        break;
+                    case 3*FLOM_MSG_STEP_INCR:
+                        strings[n_strings++] =
+                            msg->body.lock_24.answer.element;
+                        ints[n_ints++] = msg->body.lock_24.answer.rc;
+                        break;
+                    case 4*FLOM_MSG_STEP_INCR:
+                        strings[n_strings++] =
+                            msg->body.lock_32.answer.element;
+                        ints[n_ints++] = msg->body.lock_32.answer.rc;
+                        break;
+                    default:
+                        THROW(INVALID_LOCK_STEP);
+                }
+                break;
+            case FLOM_MSG_VERB_UNLOCK:
+                switch (msg->header.pvs.step) {
+                    case FLOM_MSG_STEP_INCR:
+                        strings[n_strings++] =
+                            msg->body.unlock_8.resource.name;
+                        ints[n_ints++] = msg->body.unlock_8.resource.rollback;
+                        break;
+                    default:
+                        THROW(INVALID_UNLOCK_STEP);
+                }
+                break;
+            case FLOM_MSG_VERB_PING:
+                switch (msg->header.pvs.step) {
+                    case FLOM_MSG_STEP_INCR:
+                    case 2*FLOM_MSG_STEP_INCR:
+                        break;
+                    default:
+                        THROW(INVALID_PING_STEP);
+                }
+                break;
+            case FLOM_MSG_VERB_DISCOVER:
+                switch (msg->header.pvs.step) {
+                    case FLOM_MSG_STEP_INCR:
+                        break;
+                    case 2*FLOM_MSG_STEP_INCR:
+                        strings[n_strings++] =
+                            msg->body.discover_16.network.address;
+                        ints[n_ints++] = msg->body.discover_16.network.port;
+                        break;
+                    default:
+                        THROW(INVALID_DISCOVER_STEP);
+                }
+                break;
+            case FLOM_MSG_VERB_MNGMNT:
+                switch (msg->header.pvs.step) {
+                    case FLOM_MSG_STEP_INCR:
+                        strings[n_strings++] =
+                            msg->body.mngmnt_8.session.peerid;
+                        ints[n_ints++] = msg->body.mngmnt_8.action;
+                        ints[n_ints++] = msg->body.mngmnt_8.action_data.
+                            shutdown.immediate;
+                        break;
+                    default:
+                        THROW(INVALID_MNGMNT_STEP);
+                }
+                break;
+            case FLOM_MSG_VERB_MLOCK:
+                /* the list of resources of the request does not fit the
+                   fields of a binary message: only the answers can be
+                   encoded */
+                switch (msg->header.pvs.step) {
+                    case 2*FLOM_MSG_STEP_INCR:
+                        strings[n_strings++] =
+                            msg->body.lock_16.session.peerid;
+                        strings[n_strings++] =
+                            msg->body.lock_16.answer.element;
+                        ints[n_ints++] = msg->body.lock_16.answer.rc;
+                        break;
+                    case 3*FLOM_MSG_STEP_INCR:
+                        strings[n_strings++] =
+                            msg->body.lock_24.answer.element;
+                        ints[n_ints++] = msg->body.lock_24.answer.rc;
+                        break;
+                    default:
+                        THROW(INVALID_MLOCK_STEP);
+                }
+                break;
+            default:
+                THROW(INVALID_VERB);
+        } /* switch (msg->header.pvs.verb) */
+        
+        if (offset > buffer_len)
+            THROW(BUFFER_TOO_SHORT1);
+        buffer[FLOM_MSG_BINARY_HEADER_SIZE] = (char)n_strings;
+        buffer[FLOM_MSG_BINARY_HEADER_SIZE + 1] = (char)n_ints;
+        /* string fields: length and chars */
+        for (i=0; i<n_strings; ++i) {
+            size_t str_len = NULL == strings[i] ? 0 : strlen(strings[i]);
+            if (FLOM_MSG_BINARY_NULL_STRING <= str_len ||
+                offset + 2 + str_len > buffer_len)
+                THROW(BUFFER_TOO_SHORT2);
+            flom_msg_binary_put_uint16(
+                buffer + offset, NULL == strings[i] ?
+                FLOM_MSG_BINARY_NULL_STRING : (guint16)str_len);
+            offset += 2;
+            if (0 < str_len)
+                memcpy(buffer + offset, strings[i], str_len);
+            offset += str_len;
+        } /* for (i=0; i<n_strings; ++i) */
+        /* integer fields; the request id follows them, but it's not
+           counted by the header of the body */
+        if (0 != msg->header.rid)
+            ints[n_ints++] = msg->header.rid;
+        if (offset + 4*n_ints > buffer_len ||
+            offset + 4*n_ints - FLOM_MSG_BINARY_HEADER_SIZE > G_MAXUINT16)
+            THROW(BUFFER_TOO_SHORT3);
+        for (i=0; i<n_ints; ++i) {
+            flom_msg_binary_put_uint32(buffer + offset, (guint32)ints[i]);
+            offset += 4;
+        }
+        /* header */
+        buffer[0] = (char)FLOM_MSG_BINARY_MAGIC;
+        buffer[1] = (char)msg->header.level;
+        flom_msg_binary_put_uint16(
+            buffer + 2, (guint16)(offset - FLOM_MSG_BINARY_HEADER_SIZE));
+        flom_msg_binary_put_uint16(buffer + 4, (guint16)msg->header.pvs.verb);
+        flom_msg_binary_put_uint16(buffer + 6, (guint16)msg->header.pvs.step);
+        *msg_len = offset;
+        
+        FLOM_TRACE_HEX_DATA("flom_msg_serialize_binary: serialized message ",
+                            (void *)buffer, *msg_len);
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case INVALID_LOCK_STEP:
+            case INVALID_UNLOCK_STEP:
+            case INVALID_PING_STEP:
+            case INVALID_DISCOVER_STEP:
+            case INVALID_MNGMNT_STEP:
+            case INVALID_MLOCK_STEP:
+            case INVALID_VERB:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+                break;
+            case BUFFER_TOO_SHORT1:
+            case BUFFER_TOO_SHORT2:
+            case BUFFER_TOO_SHORT3:
+                ret_cod = FLOM_RC_CONTAINER_FULL;
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_msg_serialize_binary/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
 int flom_msg_serialize_lock_8(const struct flom_msg_s *msg,
                               char *buffer,
                               size_t *offset, size_t *free_chars)
 {
-    enum Exception { G_BASE64_ENCODE_ERROR
-                     , BUFFER_TOO_SHORT1
-                     , INVALID_RESOURCE_TYPE
-                     , BUFFER_TOO_SHORT2
+    enum Exception { SERIALIZE_LOCK_RESOURCE_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
-    gchar *base64_resource_name = NULL;
     
     FLOM_TRACE(("flom_msg_serialize_lock_8\n"));
     TRY {
-        int used_chars;
-        flom_rsrc_type_t frt;
-
-        /* encode resource name using base64 encoding */
-        if (NULL == (base64_resource_name =
-                     g_base64_encode((guchar *)msg->body.lock_8.resource.name,
-                                     strlen(msg->body.lock_8.resource.name))))
-            THROW(G_BASE64_ENCODE_ERROR);
         /* <session> */
-        used_chars = snprintf(buffer + *offset, *free_chars,
-                              "<%s %s=\"%s\"/>",
-                              FLOM_MSG_TAG_SESSION,
-                              FLOM_MSG_PROP_PEERID,
-                              NULL != msg->body.lock_8.session.peerid ?
-                              msg->body.lock_8.session.peerid :
-                              FLOM_EMPTY_STRING);
-        if (used_chars >= *free_chars)
-            THROW(BUFFER_TOO_SHORT1);
-        *free_chars -= used_chars;
-        *offset += used_chars;
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_SESSION);
+        flom_msg_put_string(buffer, offset, free_chars,
+                            msg->body.lock_8.session.peerid);
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_EMPTY_TAG_END);
         /* <resource> */
-        frt = flom_rsrc_get_type(msg->body.lock_8.resource.name);
+        if (FLOM_RC_OK != (ret_cod = flom_msg_serialize_lock_resource(
+                               &msg->body.lock_8.resource, buffer,
+                               offset, free_chars)))
+            THROW(SERIALIZE_LOCK_RESOURCE_ERROR);
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case SERIALIZE_LOCK_RESOURCE_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_msg_serialize_lock_8/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_msg_serialize_lock_resource(
+    const struct flom_msg_body_lock_8_resource_s *resource,
+    char *buffer, size_t *offset, size_t *free_chars)
+{
+    enum Exception { INVALID_RESOURCE_TYPE
+                     , BUFFER_TOO_SHORT
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_msg_serialize_lock_resource\n"));
+    TRY {
+        flom_rsrc_type_t frt = flom_rsrc_get_type(resource->name);
+        
+        /* <resource>: the name is base64 encoded directly inside the
+           buffer */
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_RESOURCE);
+        flom_msg_put_base64(buffer, offset, free_chars, resource->name);
         switch (frt) {
             case FLOM_RSRC_TYPE_SIMPLE:
-                used_chars = snprintf(buffer + *offset, *free_chars,
-                                      "<%s %s=\"%s\" %s=\"%d\" %s=\"%d\" "
-                                      "%s=\"%d\" %s=\"%d\"/>",
-                                      FLOM_MSG_TAG_RESOURCE,
-                                      FLOM_MSG_PROP_NAME,
-                                      base64_resource_name,
-                                      FLOM_MSG_PROP_MODE,
-                                      msg->body.lock_8.resource.mode,
-                                      FLOM_MSG_PROP_WAIT,
-                                      msg->body.lock_8.resource.wait,
-                                      FLOM_MSG_PROP_CREATE,
-                                      msg->body.lock_8.resource.create,
-                                      FLOM_MSG_PROP_LIFESPAN,
-                                      msg->body.lock_8.resource.lifespan);
+            case FLOM_RSRC_TYPE_HIER:
+                FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                                      FLOM_MSG_FRAGMENT_MODE);
+                flom_msg_put_int(buffer, offset, free_chars, resource->mode);
+                FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                                      FLOM_MSG_FRAGMENT_WAIT);
+                flom_msg_put_int(buffer, offset, free_chars, resource->wait);
                 break;
             case FLOM_RSRC_TYPE_NUMERIC:
-                used_chars = snprintf(buffer + *offset, *free_chars,
-                                      "<%s %s=\"%s\" %s=\"%d\" %s=\"%d\" "
-                                      "%s=\"%d\" %s=\"%d\"/>",
-                                      FLOM_MSG_TAG_RESOURCE,
-                                      FLOM_MSG_PROP_NAME,
-                                      base64_resource_name,
-                                      FLOM_MSG_PROP_WAIT,
-                                      msg->body.lock_8.resource.wait,
-                                      FLOM_MSG_PROP_QUANTITY,
-                                      msg->body.lock_8.resource.quantity,
-                                      FLOM_MSG_PROP_CREATE,
-                                      msg->body.lock_8.resource.create,
-                                      FLOM_MSG_PROP_LIFESPAN,
-                                      msg->body.lock_8.resource.lifespan);
+                FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                                      FLOM_MSG_FRAGMENT_WAIT);
+                flom_msg_put_int(buffer, offset, free_chars, resource->wait);
+                FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                                      FLOM_MSG_FRAGMENT_QUANTITY);
+                flom_msg_put_int(buffer, offset, free_chars,
+                                 resource->quantity);
                 break;
             case FLOM_RSRC_TYPE_SET:
-                used_chars = snprintf(buffer + *offset, *free_chars,
-                                      "<%s %s=\"%s\" %s=\"%d\" %s=\"%d\" "
-                                      "%s=\"%d\"/>",
-                                      FLOM_MSG_TAG_RESOURCE,
-                                      FLOM_MSG_PROP_NAME,
-                                      base64_resource_name,
-                                      FLOM_MSG_PROP_WAIT,
-                                      msg->body.lock_8.resource.wait,
-                                      FLOM_MSG_PROP_CREATE,
-                                      msg->body.lock_8.resource.create,
-                                      FLOM_MSG_PROP_LIFESPAN,
-                                      msg->body.lock_8.resource.lifespan);
-                break;
-            case FLOM_RSRC_TYPE_HIER:
-                used_chars = snprintf(buffer + *offset, *free_chars,
-                                      "<%s %s=\"%s\" %s=\"%d\" %s=\"%d\" "
-                                      "%s=\"%d\" %s=\"%d\"/>",
-                                      FLOM_MSG_TAG_RESOURCE,
-                                      FLOM_MSG_PROP_NAME,
-                                      base64_resource_name,
-                                      FLOM_MSG_PROP_MODE,
-                                      msg->body.lock_8.resource.mode,
-                                      FLOM_MSG_PROP_WAIT,
-                                      msg->body.lock_8.resource.wait,
-                                      FLOM_MSG_PROP_CREATE,
-                                      msg->body.lock_8.resource.create,
-                                      FLOM_MSG_PROP_LIFESPAN,
-                                      msg->body.lock_8.resource.lifespan);
-                break;
             case FLOM_RSRC_TYPE_SEQUENCE:
             case FLOM_RSRC_TYPE_TIMESTAMP:
-                used_chars = snprintf(buffer + *offset, *free_chars,
-                                      "<%s %s=\"%s\" %s=\"%d\" %s=\"%d\" "
-                                      "%s=\"%d\"/>",
-                                      FLOM_MSG_TAG_RESOURCE,
-                                      FLOM_MSG_PROP_NAME,
-                                      base64_resource_name,
-                                      FLOM_MSG_PROP_WAIT,
-                                      msg->body.lock_8.resource.wait,
-                                      FLOM_MSG_PROP_CREATE,
-                                      msg->body.lock_8.resource.create,
-                                      FLOM_MSG_PROP_LIFESPAN,
-                                      msg->body.lock_8.resource.lifespan);
+                FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                                      FLOM_MSG_FRAGMENT_WAIT);
+                flom_msg_put_int(buffer, offset, free_chars, resource->wait);
                 break;
             default:
                 THROW(INVALID_RESOURCE_TYPE);
         } /* switch (frt) */
-        
-        if (used_chars >= *free_chars)
-            THROW(BUFFER_TOO_SHORT2);
-        *free_chars -= used_chars;
-        *offset += used_chars;
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_CREATE);
+        flom_msg_put_int(buffer, offset, free_chars, resource->create);
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_LIFESPAN);
+        flom_msg_put_int(buffer, offset, free_chars, resource->lifespan);
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_EMPTY_TAG_END);
+        if (0 == *free_chars)
+            THROW(BUFFER_TOO_SHORT);
         
         THROW(NONE);
     } CATCH {
         switch (excp) {
-            case G_BASE64_ENCODE_ERROR:
-                ret_cod = FLOM_RC_G_BASE64_ENCODE_ERROR;
-                break;
-            case BUFFER_TOO_SHORT1:
-                ret_cod = FLOM_RC_CONTAINER_FULL;
-                break;
             case INVALID_RESOURCE_TYPE:
                 ret_cod = FLOM_RC_INVALID_RESOURCE_NAME;
                 break;
-            case BUFFER_TOO_SHORT2:
+            case BUFFER_TOO_SHORT:
                 ret_cod = FLOM_RC_CONTAINER_FULL;
                 break;
             case NONE:
@@ -762,12 +1058,59 @@ int flom_msg_serialize_lock_8(const struct flom_msg_s *msg,
                 ret_cod = FLOM_RC_INTERNAL_ERROR;
         } /* switch (excp) */
     } /* TRY-CATCH */
-    /* release memory */
-    if (NULL != base64_resource_name) {
-        g_free(base64_resource_name);
-        base64_resource_name = NULL;
-    }
-    FLOM_TRACE(("flom_msg_serialize_lock_8/excp=%d/"
+    FLOM_TRACE(("flom_msg_serialize_lock_resource/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_msg_serialize_mlock_8(const struct flom_msg_s *msg,
+                               char *buffer,
+                               size_t *offset, size_t *free_chars)
+{
+    enum Exception { INVALID_RESOURCE_NUMBER
+                     , SERIALIZE_LOCK_RESOURCE_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_msg_serialize_mlock_8\n"));
+    TRY {
+        guint i;
+        
+        if (0 == msg->body.mlock_8.resource_number ||
+            FLOM_MSG_MLOCK_MAX_RESOURCES < msg->body.mlock_8.resource_number)
+            THROW(INVALID_RESOURCE_NUMBER);
+        /* <session> */
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_SESSION);
+        flom_msg_put_string(buffer, offset, free_chars,
+                            msg->body.mlock_8.session.peerid);
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_EMPTY_TAG_END);
+        /* a <resource> tag for every resource */
+        for (i=0; i<msg->body.mlock_8.resource_number; ++i)
+            if (FLOM_RC_OK != (ret_cod = flom_msg_serialize_lock_resource(
+                                   msg->body.mlock_8.resources + i, buffer,
+                                   offset, free_chars)))
+                THROW(SERIALIZE_LOCK_RESOURCE_ERROR);
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case INVALID_RESOURCE_NUMBER:
+                ret_cod = FLOM_RC_OUT_OF_RANGE;
+                break;
+            case SERIALIZE_LOCK_RESOURCE_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_msg_serialize_mlock_8/excp=%d/"
                 "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
     return ret_cod;
 }
@@ -778,53 +1121,29 @@ int flom_msg_serialize_lock_16(const struct flom_msg_s *msg,
                                char *buffer,
                                size_t *offset, size_t *free_chars)
 {
-    enum Exception { BUFFER_TOO_SHORT1
-                     , BUFFER_TOO_SHORT2
+    enum Exception { BUFFER_TOO_SHORT
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     
     FLOM_TRACE(("flom_msg_serialize_lock_16\n"));
     TRY {
-        int used_chars;
-        
         /* <session> */
-        used_chars = snprintf(buffer + *offset, *free_chars,
-                              "<%s %s=\"%s\"/>",
-                              FLOM_MSG_TAG_SESSION,
-                              FLOM_MSG_PROP_PEERID,
-                              NULL != msg->body.lock_16.session.peerid ?
-                              msg->body.lock_16.session.peerid :
-                              FLOM_EMPTY_STRING);
-        if (used_chars >= *free_chars)
-            THROW(BUFFER_TOO_SHORT1);
-        *free_chars -= used_chars;
-        *offset += used_chars;
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_SESSION);
+        flom_msg_put_string(buffer, offset, free_chars,
+                            msg->body.lock_16.session.peerid);
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_EMPTY_TAG_END);
         /* <answer> */
-        if (NULL == msg->body.lock_16.answer.element) {
-            used_chars = snprintf(buffer + *offset, *free_chars,
-                                  "<%s %s=\"%d\"/>",
-                                  FLOM_MSG_TAG_ANSWER,
-                                  FLOM_MSG_PROP_RC,
-                                  msg->body.lock_16.answer.rc);
-        } else {
-            used_chars = snprintf(buffer + *offset, *free_chars,
-                                  "<%s %s=\"%d\" %s=\"%s\"/>",
-                                  FLOM_MSG_TAG_ANSWER,
-                                  FLOM_MSG_PROP_RC,
-                                  msg->body.lock_16.answer.rc,
-                                  FLOM_MSG_PROP_ELEMENT,
-                                  msg->body.lock_16.answer.element);
-        } /* if (NULL == msg->body.lock_16.answer.element) */
-        if (used_chars >= *free_chars)
-            THROW(BUFFER_TOO_SHORT2);
-        *free_chars -= used_chars;
-        *offset += used_chars;
+        flom_msg_put_answer(buffer, offset, free_chars,
+                            &msg->body.lock_16.answer);
+        if (0 == *free_chars)
+            THROW(BUFFER_TOO_SHORT);
         
         THROW(NONE);
     } CATCH {
         switch (excp) {
-            case BUFFER_TOO_SHORT1:
-            case BUFFER_TOO_SHORT2:
+            case BUFFER_TOO_SHORT:
                 ret_cod = FLOM_RC_CONTAINER_FULL;
                 break;
             case NONE:
@@ -851,28 +1170,11 @@ int flom_msg_serialize_lock_24(const struct flom_msg_s *msg,
     
     FLOM_TRACE(("flom_msg_serialize_lock_24\n"));
     TRY {
-        int used_chars;
-        
         /* <answer> */
-        if (NULL == msg->body.lock_24.answer.element) {
-            used_chars = snprintf(buffer + *offset, *free_chars,
-                                  "<%s %s=\"%d\"/>",
-                                  FLOM_MSG_TAG_ANSWER,
-                                  FLOM_MSG_PROP_RC,
-                                  msg->body.lock_24.answer.rc);
-        } else {
-            used_chars = snprintf(buffer + *offset, *free_chars,
-                                  "<%s %s=\"%d\" %s=\"%s\"/>",
-                                  FLOM_MSG_TAG_ANSWER,
-                                  FLOM_MSG_PROP_RC,
-                                  msg->body.lock_24.answer.rc,
-                                  FLOM_MSG_PROP_ELEMENT,
-                                  msg->body.lock_24.answer.element);
-        } /* if (NULL == msg->body.lock_16.answer.element) */
-        if (used_chars >= *free_chars)
+        flom_msg_put_answer(buffer, offset, free_chars,
+                            &msg->body.lock_24.answer);
+        if (0 == *free_chars)
             THROW(BUFFER_TOO_SHORT);
-        *free_chars -= used_chars;
-        *offset += used_chars;
         
         THROW(NONE);
     } CATCH {
@@ -904,28 +1206,11 @@ int flom_msg_serialize_lock_32(const struct flom_msg_s *msg,
     
     FLOM_TRACE(("flom_msg_serialize_lock_32\n"));
     TRY {
-        int used_chars;
-        
         /* <answer> */
-        if (NULL == msg->body.lock_32.answer.element) {
-            used_chars = snprintf(buffer + *offset, *free_chars,
-                                  "<%s %s=\"%d\"/>",
-                                  FLOM_MSG_TAG_ANSWER,
-                                  FLOM_MSG_PROP_RC,
-                                  msg->body.lock_32.answer.rc);
-        } else {
-            used_chars = snprintf(buffer + *offset, *free_chars,
-                                  "<%s %s=\"%d\" %s=\"%s\"/>",
-                                  FLOM_MSG_TAG_ANSWER,
-                                  FLOM_MSG_PROP_RC,
-                                  msg->body.lock_32.answer.rc,
-                                  FLOM_MSG_PROP_ELEMENT,
-                                  msg->body.lock_32.answer.element);
-        } /* if (NULL == msg->body.lock_16.answer.element) */
-        if (used_chars >= *free_chars)
+        flom_msg_put_answer(buffer, offset, free_chars,
+                            &msg->body.lock_32.answer);
+        if (0 == *free_chars)
             THROW(BUFFER_TOO_SHORT);
-        *free_chars -= used_chars;
-        *offset += used_chars;
         
         THROW(NONE);
     } CATCH {
@@ -951,41 +1236,29 @@ int flom_msg_serialize_unlock_8(const struct flom_msg_s *msg,
                                 char *buffer,
                                 size_t *offset, size_t *free_chars)
 {
-    enum Exception { G_BASE64_ENCODE_ERROR
-                     , BUFFER_TOO_SHORT
+    enum Exception { BUFFER_TOO_SHORT
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
-    gchar *base64_resource_name = NULL;
     
     FLOM_TRACE(("flom_msg_serialize_unlock_8\n"));
     TRY {
-        int used_chars;
-        
-        /* encode resource name using base64 encoding */
-        if (NULL == (base64_resource_name =
-                     g_base64_encode(
-                         (guchar *)msg->body.unlock_8.resource.name,
-                         strlen(msg->body.unlock_8.resource.name))))
-            THROW(G_BASE64_ENCODE_ERROR);
         /* <resource> */
-        used_chars = snprintf(buffer + *offset, *free_chars,
-                              "<%s %s=\"%s\" %s=\"%d\" />",
-                              FLOM_MSG_TAG_RESOURCE,
-                              FLOM_MSG_PROP_NAME,
-                              base64_resource_name,
-                              FLOM_MSG_PROP_ROLLBACK,
-                              msg->body.unlock_8.resource.rollback);
-        if (used_chars >= *free_chars)
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_RESOURCE);
+        flom_msg_put_base64(buffer, offset, free_chars,
+                            msg->body.unlock_8.resource.name);
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_ROLLBACK);
+        flom_msg_put_int(buffer, offset, free_chars,
+                         msg->body.unlock_8.resource.rollback);
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_SPACED_EMPTY_TAG_END);
+        if (0 == *free_chars)
             THROW(BUFFER_TOO_SHORT);
-        *free_chars -= used_chars;
-        *offset += used_chars;
         
         THROW(NONE);
     } CATCH {
         switch (excp) {
-            case G_BASE64_ENCODE_ERROR:
-                ret_cod = FLOM_RC_G_BASE64_ENCODE_ERROR;
-                break;
             case BUFFER_TOO_SHORT:
                 ret_cod = FLOM_RC_CONTAINER_FULL;
                 break;
@@ -996,11 +1269,6 @@ int flom_msg_serialize_unlock_8(const struct flom_msg_s *msg,
                 ret_cod = FLOM_RC_INTERNAL_ERROR;
         } /* switch (excp) */
     } /* TRY-CATCH */
-    /* release memory */
-    if (NULL != base64_resource_name) {
-        g_free(base64_resource_name);
-        base64_resource_name = NULL;
-    }
     FLOM_TRACE(("flom_msg_serialize_unlock_8/excp=%d/"
                 "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
     return ret_cod;
@@ -1099,22 +1367,19 @@ int flom_msg_serialize_discover_16(const struct flom_msg_s *msg,
     
     FLOM_TRACE(("flom_msg_serialize_discover_16\n"));
     TRY {
-        int used_chars;
-        
         /* <network> */
-        used_chars = snprintf(buffer + *offset, *free_chars,
-                              "<%s %s=\"%s\" %s=\"%hu\"/>",
-                              FLOM_MSG_TAG_NETWORK,
-                              FLOM_MSG_PROP_ADDRESS,
-                              NULL != msg->body.discover_16.network.address ?
-                              msg->body.discover_16.network.address :
-                              FLOM_EMPTY_STRING,
-                              FLOM_MSG_PROP_PORT,
-                              msg->body.discover_16.network.port);
-        if (used_chars >= *free_chars)
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_NETWORK);
+        flom_msg_put_string(buffer, offset, free_chars,
+                            msg->body.discover_16.network.address);
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_PORT);
+        flom_msg_put_int(buffer, offset, free_chars,
+                         (int)msg->body.discover_16.network.port);
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_EMPTY_TAG_END);
+        if (0 == *free_chars)
             THROW(BUFFER_TOO_SHORT);
-        *free_chars -= used_chars;
-        *offset += used_chars;
         
         THROW(NONE);
     } CATCH {
@@ -1140,42 +1405,36 @@ int flom_msg_serialize_mngmnt_8(const struct flom_msg_s *msg,
                                 char *buffer,
                                 size_t *offset, size_t *free_chars)
 {
-    enum Exception { BUFFER_TOO_SHORT1
-                     , BUFFER_TOO_SHORT2
+    enum Exception { BUFFER_TOO_SHORT
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     
     FLOM_TRACE(("flom_msg_serialize_mngmnt_8\n"));
     TRY {
-        int used_chars = 0;
-        
         /* <session> */
-        used_chars = snprintf(buffer + *offset, *free_chars,
-                              "<%s %s=\"%s\"/>",
-                              FLOM_MSG_TAG_SESSION,
-                              FLOM_MSG_PROP_PEERID,
-                              STROREMPTY(msg->body.mngmnt_8.session.peerid));
-        if (used_chars >= *free_chars)
-            THROW(BUFFER_TOO_SHORT1);
-        *free_chars -= used_chars;
-        *offset += used_chars;
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_SESSION);
+        flom_msg_put_string(buffer, offset, free_chars,
+                            msg->body.mngmnt_8.session.peerid);
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_EMPTY_TAG_END);
         /* shutdown action */
         if (FLOM_MSG_MNGMNT_ACTION_SHUTDOWN == msg->body.mngmnt_8.action) {
-            used_chars = snprintf(
-                buffer + *offset, *free_chars, "<%s %s=\"%d\"/>",
-                FLOM_MSG_TAG_SHUTDOWN, FLOM_MSG_PROP_IMMEDIATE,
+            FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                                  FLOM_MSG_FRAGMENT_SHUTDOWN);
+            flom_msg_put_int(
+                buffer, offset, free_chars,
                 msg->body.mngmnt_8.action_data.shutdown.immediate);
+            FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                                  FLOM_MSG_FRAGMENT_EMPTY_TAG_END);
         }
-        if (used_chars >= *free_chars)
-            THROW(BUFFER_TOO_SHORT2);
-        *free_chars -= used_chars;
-        *offset += used_chars;
+        if (0 == *free_chars)
+            THROW(BUFFER_TOO_SHORT);
         
         THROW(NONE);
     } CATCH {
         switch (excp) {
-            case BUFFER_TOO_SHORT1:
-            case BUFFER_TOO_SHORT2:
+            case BUFFER_TOO_SHORT:
                 ret_cod = FLOM_RC_CONTAINER_FULL;
                 break;
             case NONE:
@@ -1185,13 +1444,75 @@ int flom_msg_serialize_mngmnt_8(const struct flom_msg_s *msg,
                 ret_cod = FLOM_RC_INTERNAL_ERROR;
         } /* switch (excp) */
     } /* TRY-CATCH */
-    FLOM_TRACE(("flom_msg_serialize_discover_16/excp=%d/"
+    FLOM_TRACE(("flom_msg_serialize_mngmnt_8/excp=%d/"
                 "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
     return ret_cod;
 }
 
 
 
+void flom_msg_put_int(char *buffer, size_t *offset, size_t *free_chars,
+                      int value)
+{
+    char digits[FLOM_MSG_INT_DIGITS];
+    size_t i = sizeof(digits);
+    /* unsigned arithmetic avoids the overflow of -G_MININT */
+    guint u = 0 > value ? 0U - (guint)value : (guint)value;
+
+    do {
+        digits[--i] = (char)('0' + u % 10);
+        u /= 10;
+    } while (0 < u);
+    if (0 > value)
+        digits[--i] = '-';
+    flom_msg_put_chars(buffer, offset, free_chars,
+                       digits + i, sizeof(digits) - i);
+}
+
+
+
+void flom_msg_put_base64(char *buffer, size_t *offset, size_t *free_chars,
+                         const gchar *data)
+{
+    /* g_base64_encode_step needs (len / 3 + 1) * 4 + 4 output bytes */
+    gchar encoded[(FLOM_MSG_BASE64_CHUNK / 3 + 1) * 4 + 4];
+    size_t data_len = NULL == data ? 0 : strlen(data);
+    size_t done = 0, encoded_len;
+    gint state = 0, save = 0;
+
+    while (done < data_len && 0 < *free_chars) {
+        size_t chunk = data_len - done < FLOM_MSG_BASE64_CHUNK ?
+            data_len - done : FLOM_MSG_BASE64_CHUNK;
+        encoded_len = g_base64_encode_step(
+            (const guchar *)data + done, chunk, FALSE,
+            encoded, &state, &save);
+        flom_msg_put_chars(buffer, offset, free_chars,
+                           encoded, encoded_len);
+        done += chunk;
+    }
+    encoded_len = g_base64_encode_close(FALSE, encoded, &state, &save);
+    flom_msg_put_chars(buffer, offset, free_chars, encoded, encoded_len);
+}
+
+
+
+void flom_msg_put_answer(char *buffer, size_t *offset, size_t *free_chars,
+                         const struct flom_msg_body_answer_s *answer)
+{
+    FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                          FLOM_MSG_FRAGMENT_ANSWER);
+    flom_msg_put_int(buffer, offset, free_chars, answer->rc);
+    if (NULL != answer->element) {
+        FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                              FLOM_MSG_FRAGMENT_ELEMENT);
+        flom_msg_put_string(buffer, offset, free_chars, answer->element);
+    }
+    FLOM_MSG_PUT_FRAGMENT(buffer, offset, free_chars,
+                          FLOM_MSG_FRAGMENT_EMPTY_TAG_END);
+}
+
+
+
 int flom_msg_trace(const struct flom_msg_s *msg)
 {
     enum Exception { TRACE_LOCK_ERROR
@@ -1199,6 +1520,7 @@ int flom_msg_trace(const struct flom_msg_s *msg)
                      , TRACE_PING_ERROR
                      , TRACE_DISCOVER_ERROR
                      , TRACE_MNGMNT_ERROR
+                     , TRACE_MLOCK_ERROR
                      , INVALID_VERB
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
@@ -1206,9 +1528,9 @@ int flom_msg_trace(const struct flom_msg_s *msg)
     FLOM_TRACE(("flom_msg_trace: object=%p\n", msg));
     TRY {
         FLOM_TRACE(("flom_msg_trace: state=%d,header[level=%d,pvs.verb=%d,"
-                    "pvs.step=%d]\n", msg->state,
+                    "pvs.step=%d,rid=%d]\n", msg->state,
                     msg->header.level, msg->header.pvs.verb,
-                    msg->header.pvs.step));
+                    msg->header.pvs.step, msg->header.rid));
         switch (msg->header.pvs.verb) {
             case FLOM_MSG_VERB_NULL: /* null verb, skipping... */
                 break;
@@ -1232,6 +1554,10 @@ int flom_msg_trace(const struct flom_msg_s *msg)
                 if (FLOM_RC_OK != (ret_cod = flom_msg_trace_mngmnt(msg)))
                     THROW(TRACE_MNGMNT_ERROR);
                 break;
+            case FLOM_MSG_VERB_MLOCK: /* mlock */
+                if (FLOM_RC_OK != (ret_cod = flom_msg_trace_mlock(msg)))
+                    THROW(TRACE_MLOCK_ERROR);
+                break;
             default:
                 THROW(INVALID_VERB);
         }
@@ -1244,6 +1570,7 @@ int flom_msg_trace(const struct flom_msg_s *msg)
             case TRACE_PING_ERROR:
             case TRACE_DISCOVER_ERROR:
             case TRACE_MNGMNT_ERROR:
+            case TRACE_MLOCK_ERROR:
                 break;
             case INVALID_VERB:
                 ret_cod = FLOM_RC_INVALID_PROPERTY_VALUE;
@@ -1529,37 +1856,316 @@ int flom_msg_trace_mngmnt(const struct flom_msg_s *msg)
 
 
     
+int flom_msg_trace_mlock(const struct flom_msg_s *msg)
+{
+    enum Exception { INVALID_STEP
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_msg_trace_mlock\n"));
+    TRY {
+        guint i;
+        
+        switch (msg->header.pvs.step) {
+            case FLOM_MSG_STEP_INCR:
+                FLOM_TRACE(("flom_msg_trace_mlock: body["
+                            "%s[%s='%s'], resource_number=%u]\n",
+                            FLOM_MSG_TAG_SESSION,
+                            FLOM_MSG_PROP_PEERID,
+                            STROREMPTY(msg->body.mlock_8.session.peerid),
+                            msg->body.mlock_8.resource_number));
+                for (i=0; i<msg->body.mlock_8.resource_number; ++i) {
+                    const struct flom_msg_body_lock_8_resource_s *resource =
+                        msg->body.mlock_8.resources + i;
+                    FLOM_TRACE(("flom_msg_trace_mlock: body[%u]["
+                                "%s[%s='%s',%s=%d,%s=%d,%s=%d,%s=%d,%s=%d]"
+                                "]\n", i,
+                                FLOM_MSG_TAG_RESOURCE,
+                                FLOM_MSG_PROP_NAME,
+                                STROREMPTY(resource->name),
+                                FLOM_MSG_PROP_MODE, resource->mode,
+                                FLOM_MSG_PROP_WAIT, resource->wait,
+                                FLOM_MSG_PROP_QUANTITY, resource->quantity,
+                                FLOM_MSG_PROP_CREATE, resource->create,
+                                FLOM_MSG_PROP_LIFESPAN,
+                                resource->lifespan));
+                }
+                break;
+            case 2*FLOM_MSG_STEP_INCR:
+                FLOM_TRACE(("flom_msg_trace_mlock: body["
+                            "%s[%s='%s'], "
+                            "%s[%s=%d,%s='%s']]\n",
+                            FLOM_MSG_TAG_SESSION,
+                            FLOM_MSG_PROP_PEERID,
+                            STROREMPTY(msg->body.lock_16.session.peerid),
+                            FLOM_MSG_TAG_ANSWER,
+                            FLOM_MSG_PROP_RC,
+                            msg->body.lock_16.answer.rc,
+                            FLOM_MSG_PROP_ELEMENT,
+                            STROREMPTY(msg->body.lock_16.answer.element)));
+                break;
+            case 3*FLOM_MSG_STEP_INCR:
+                FLOM_TRACE(("flom_msg_trace_mlock: body[%s["
+                            "%s=%d,%s='%s']]\n",
+                            FLOM_MSG_TAG_ANSWER,
+                            FLOM_MSG_PROP_RC,
+                            msg->body.lock_24.answer.rc,
+                            FLOM_MSG_PROP_ELEMENT,
+                            STROREMPTY(msg->body.lock_24.answer.element)));
+                break;
+            default:
+                THROW(INVALID_STEP);
+        }
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case INVALID_STEP:
+                ret_cod = FLOM_RC_INVALID_PROPERTY_VALUE;
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_msg_trace_mlock/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+    
 int flom_msg_deserialize(char *buffer, size_t buffer_len,
                          struct flom_msg_s *msg,
-                         GMarkupParseContext *gmpc)
+                         flom_msg_parser_t *parser)
 {
-    enum Exception { G_MARKUP_PARSE_CONTEXT_PARSE_ERROR
+    enum Exception { DESERIALIZE_BINARY_ERROR
+                     , MSG_PARSER_PARSE_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     
     FLOM_TRACE(("flom_msg_deserialize\n"));
     TRY {
-        GError *error = NULL;
+        /* compact binary encoding does not need the XML parser */
+        if (flom_msg_is_binary(buffer, buffer_len)) {
+            if (FLOM_RC_OK != (ret_cod = flom_msg_deserialize_binary(
+                                   buffer, buffer_len, msg)))
+                THROW(DESERIALIZE_BINARY_ERROR);
+            THROW(NONE);
+        }
         
         FLOM_TRACE(("flom_msg_deserialize: deserializing message |%*.*s|\n",
                     buffer_len, buffer_len, buffer));
         
-        if (FALSE == g_markup_parse_context_parse(
-                gmpc, buffer, buffer_len, &error)) {
-            if (NULL != error) {
-                FLOM_TRACE(("flom_msg_deserialize: code=%d, message='%s'\n",
-                            error->code, error->message));
-                g_error_free(error);
-                error = NULL;
+        /* every buffer contains a whole message */
+        flom_msg_parser_reset(parser);
+        ret_cod = flom_msg_parser_parse(parser, buffer, buffer_len, msg);
+        if (FLOM_RC_XML_SYNTAX_ERROR == ret_cod) {
+            /* like a message with unexpected content, a malformed message
+               is not an error of the receiver */
+            FLOM_TRACE(("flom_msg_deserialize: malformed message, marking "
+                        "it as invalid\n"));
+            msg->state = FLOM_MSG_STATE_INVALID;
+        } else if (FLOM_RC_OK != ret_cod)
+            THROW(MSG_PARSER_PARSE_ERROR);
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case DESERIALIZE_BINARY_ERROR:
+                break;
+            case MSG_PARSER_PARSE_ERROR:
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_msg_deserialize/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_msg_deserialize_binary(const char *buffer, size_t buffer_len,
+                                struct flom_msg_s *msg)
+{
+    enum Exception { INVALID_MSG_LENGTH1
+                     , PROTOCOL_LEVEL_MISMATCH
+                     , INVALID_MSG_LENGTH2
+                     , INVALID_MSG_LENGTH3
+                     , INVALID_MSG_LENGTH4
+                     , INVALID_MSG_LENGTH5
+                     , UNEXPECTED_FIELDS
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    gchar *strings[FLOM_MSG_BINARY_MAX_FIELDS];
+    guint n_strings = 0, i;
+    
+    FLOM_TRACE(("flom_msg_deserialize_binary\n"));
+    TRY {
+        gint32 ints[FLOM_MSG_BINARY_MAX_FIELDS];
+        guint expected_strings, n_ints;
+        size_t offset = FLOM_MSG_BINARY_HEADER_SIZE + 2;
+        
+        FLOM_TRACE_HEX_DATA("flom_msg_deserialize_binary: deserializing "
+                            "message ", (void *)buffer, buffer_len);
+        if (offset > buffer_len ||
+            flom_msg_binary_frame_len(buffer) != buffer_len)
+            THROW(INVALID_MSG_LENGTH1);
+        msg->state = FLOM_MSG_STATE_PARSING;
+        msg->header.level = (guchar)buffer[1];
+        msg->header.pvs.verb = flom_msg_binary_get_uint16(buffer + 4);
+        msg->header.pvs.step = flom_msg_binary_get_uint16(buffer + 6);
+        if (FLOM_MSG_LEVEL_BINARY != msg->header.level)
+            THROW(PROTOCOL_LEVEL_MISMATCH);
+        expected_strings = (guchar)buffer[FLOM_MSG_BINARY_HEADER_SIZE];
+        n_ints = (guchar)buffer[FLOM_MSG_BINARY_HEADER_SIZE + 1];
+        if (FLOM_MSG_BINARY_MAX_FIELDS < expected_strings ||
+            FLOM_MSG_BINARY_MAX_FIELDS < n_ints)
+            THROW(INVALID_MSG_LENGTH2);
+        /* string fields */
+        while (n_strings < expected_strings) {
+            guint16 str_len;
+            if (offset + 2 > buffer_len)
+                THROW(INVALID_MSG_LENGTH3);
+            str_len = flom_msg_binary_get_uint16(buffer + offset);
+            offset += 2;
+            if (FLOM_MSG_BINARY_NULL_STRING == str_len) {
+                strings[n_strings++] = NULL;
+                continue;
             }
-            THROW(G_MARKUP_PARSE_CONTEXT_PARSE_ERROR);
+            if (offset + str_len > buffer_len)
+                THROW(INVALID_MSG_LENGTH4);
+            strings[n_strings++] = g_strndup(buffer + offset, str_len);
+            offset += str_len;
+        } /* while (n_strings < expected_strings) */
+        /* integer fields, optionally followed by the request id */
+        if (offset + 4*n_ints + 4 == buffer_len)
+            msg->header.rid = (gint32)flom_msg_binary_get_uint32(
+                buffer + buffer_len - 4);
+        else if (offset + 4*n_ints != buffer_len)
+            THROW(INVALID_MSG_LENGTH5);
+        for (i=0; i<n_ints; ++i) {
+            ints[i] = (gint32)flom_msg_binary_get_uint32(buffer + offset);
+            offset += 4;
         }
+        /* move the fields inside the message; the strings moved to the
+           message are released by flom_msg_free */
+        switch (msg->header.pvs.verb) {
+            case FLOM_MSG_VERB_LOCK:
+                switch (msg->header.pvs.step) {
+                    case FLOM_MSG_STEP_INCR:
+                        if (2 != n_strings || 5 != n_ints)
+                            THROW(UNEXPECTED_FIELDS);
+                        msg->body.lock_8.session.peerid = strings[0];
+                        msg->body.lock_8.resource.name = strings[1];
+                        msg->body.lock_8.resource.mode = ints[0];
+                        msg->body.lock_8.resource.wait = ints[1];
+                        msg->body.lock_8.resource.quantity = ints[2];
+                        msg->body.lock_8.resource.create = ints[3];
+                        msg->body.lock_8.resource.lifespan = ints[4];
+                        break;
+                    case 2*FLOM_MSG_STEP_INCR:
+                        if (2 != n_strings || 1 != n_ints)
+                            THROW(UNEXPECTED_FIELDS);
+                        msg->body.lock_16.session.peerid = strings[0];
+                        msg->body.lock_16.answer.element = strings[1];
+                        msg->body.lock_16.answer.rc = ints[0];
+                        break;
+                    case 3*FLOM_MSG_STEP_INCR:
+                        if (1 != n_strings || 1 != n_ints)
+                            THROW(UNEXPECTED_FIELDS);
+                        msg->body.lock_24.answer.element = strings[0];
+                        msg->body.lock_24.answer.rc = ints[0];
+                        break;
+                    case 4*FLOM_MSG_STEP_INCR:
+                        if (1 != n_strings || 1 != n_ints)
+                            THROW(UNEXPECTED_FIELDS);
+                        msg->body.lock_32.answer.element = strings[0];
+                        msg->body.lock_32.answer.rc = ints[0];
+                        break;
+                    default:
+                        THROW(UNEXPECTED_FIELDS);
+                }
+                break;
+            case FLOM_MSG_VERB_UNLOCK:
+                if (FLOM_MSG_STEP_INCR != msg->header.pvs.step ||
+                    1 != n_strings || 1 != n_ints)
+                    THROW(UNEXPECTED_FIELDS);
+                msg->body.unlock_8.resource.name = strings[0];
+                msg->body.unlock_8.resource.rollback = ints[0];
+                break;
+            case FLOM_MSG_VERB_PING:
+                if ((FLOM_MSG_STEP_INCR != msg->header.pvs.step &&
+                     2*FLOM_MSG_STEP_INCR != msg->header.pvs.step) ||
+                    0 != n_strings || 0 != n_ints)
+                    THROW(UNEXPECTED_FIELDS);
+                break;
+            case FLOM_MSG_VERB_DISCOVER:
+                if (FLOM_MSG_STEP_INCR == msg->header.pvs.step &&
+                    0 == n_strings && 0 == n_ints)
+                    break;
+                if (2*FLOM_MSG_STEP_INCR != msg->header.pvs.step ||
+                    1 != n_strings || 1 != n_ints)
+                    THROW(UNEXPECTED_FIELDS);
+                msg->body.discover_16.network.address = strings[0];
+                msg->body.discover_16.network.port = (in_port_t)ints[0];
+                break;
+            case FLOM_MSG_VERB_MNGMNT:
+                if (FLOM_MSG_STEP_INCR != msg->header.pvs.step ||
+                    1 != n_strings || 2 != n_ints)
+                    THROW(UNEXPECTED_FIELDS);
+                msg->body.mngmnt_8.session.peerid = strings[0];
+                msg->body.mngmnt_8.action = ints[0];
+                msg->body.mngmnt_8.action_data.shutdown.immediate = ints[1];
+                break;
+            case FLOM_MSG_VERB_MLOCK:
+                switch (msg->header.pvs.step) {
+                    case 2*FLOM_MSG_STEP_INCR:
+                        if (2 != n_strings || 1 != n_ints)
+                            THROW(UNEXPECTED_FIELDS);
+                        msg->body.lock_16.session.peerid = strings[0];
+                        msg->body.lock_16.answer.element = strings[1];
+                        msg->body.lock_16.answer.rc = ints[0];
+                        break;
+                    case 3*FLOM_MSG_STEP_INCR:
+                        if (1 != n_strings || 1 != n_ints)
+                            THROW(UNEXPECTED_FIELDS);
+                        msg->body.lock_24.answer.element = strings[0];
+                        msg->body.lock_24.answer.rc = ints[0];
+                        break;
+                    default:
+                        THROW(UNEXPECTED_FIELDS);
+                }
+                break;
+            default:
+                THROW(UNEXPECTED_FIELDS);
+        } /* switch (msg->header.pvs.verb) */
+        n_strings = 0;
+        msg->state = FLOM_MSG_STATE_READY;
         
         THROW(NONE);
     } CATCH {
         switch (excp) {
-            case G_MARKUP_PARSE_CONTEXT_PARSE_ERROR:
-                ret_cod = FLOM_RC_G_MARKUP_PARSE_CONTEXT_PARSE_ERROR;
+            case INVALID_MSG_LENGTH1:
+            case INVALID_MSG_LENGTH2:
+            case INVALID_MSG_LENGTH3:
+            case INVALID_MSG_LENGTH4:
+            case INVALID_MSG_LENGTH5:
+                ret_cod = FLOM_RC_INVALID_MSG_LENGTH;
+                break;
+            case PROTOCOL_LEVEL_MISMATCH:
+            case UNEXPECTED_FIELDS:
+                /* the message is well formed, but it can not be used */
+                msg->state = FLOM_MSG_STATE_INVALID;
+                ret_cod = FLOM_RC_OK;
                 break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
@@ -1568,13 +2174,281 @@ int flom_msg_deserialize(char *buffer, size_t buffer_len,
                 ret_cod = FLOM_RC_INTERNAL_ERROR;
         } /* switch (excp) */
     } /* TRY-CATCH */
-    FLOM_TRACE(("flom_msg_deserialize/excp=%d/"
+    /* release the strings that have not been moved inside the message */
+    for (i=0; i<n_strings; ++i)
+        g_free(strings[i]);
+    FLOM_TRACE(("flom_msg_deserialize_binary/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_msg_parser_parse(flom_msg_parser_t *parser,
+                          const char *buffer, size_t buffer_len,
+                          struct flom_msg_s *msg)
+{
+    enum Exception { UNEXPECTED_TEXT
+                     , TRAILING_DATA
+                     , UNEXPECTED_PROLOGUE
+                     , UNTERMINATED_PROLOGUE
+                     , INVALID_END_TAG1
+                     , INVALID_END_TAG2
+                     , UNBALANCED_END_TAG
+                     , INVALID_TAG_NAME
+                     , INVALID_TAG_END1
+                     , INVALID_TAG_END2
+                     , TOO_MANY_ATTRIBUTES
+                     , INVALID_ATTRIBUTE_NAME
+                     , DUPLICATED_ATTRIBUTE
+                     , MISSING_EQUAL_SIGN
+                     , INVALID_ATTRIBUTE_VALUE
+                     , NESTED_ELEMENT
+                     , INVALID_MESSAGE
+                     , UNTERMINATED_MESSAGE
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_msg_parser_parse\n"));
+    TRY {
+        while (parser->offset < buffer_len) {
+            size_t scratch_pos = 0;
+            const gchar *name;
+            guint i, n = 0;
+            int empty = FALSE;
+            
+            if (flom_msg_parser_is_space(buffer[parser->offset])) {
+                parser->offset++;
+                continue;
+            }
+            /* FLoM messages do not contain text */
+            if ('<' != buffer[parser->offset])
+                THROW(UNEXPECTED_TEXT);
+            /* nothing can follow the end of the root element */
+            if (0 == parser->depth && 0 < parser->tags)
+                THROW(TRAILING_DATA);
+            parser->offset++;
+            if (parser->offset < buffer_len &&
+                '?' == buffer[parser->offset]) {
+                /* XML declaration: it's skipped, but it must precede the
+                   root element */
+                if (0 < parser->tags)
+                    THROW(UNEXPECTED_PROLOGUE);
+                while (parser->offset + 1 < buffer_len &&
+                       ('?' != buffer[parser->offset] ||
+                        '>' != buffer[parser->offset + 1]))
+                    parser->offset++;
+                if (parser->offset + 1 >= buffer_len)
+                    THROW(UNTERMINATED_PROLOGUE);
+                parser->offset += 2;
+                continue;
+            }
+            if (parser->offset < buffer_len &&
+                '/' == buffer[parser->offset]) {
+                /* end tag: only the root element can be closed by an end
+                   tag */
+                parser->offset++;
+                if (NULL == (name = flom_msg_parser_scan_name(
+                                 parser, buffer, buffer_len, &scratch_pos)))
+                    THROW(INVALID_END_TAG1);
+                while (parser->offset < buffer_len &&
+                       flom_msg_parser_is_space(buffer[parser->offset]))
+                    parser->offset++;
+                if (parser->offset >= buffer_len ||
+                    '>' != buffer[parser->offset])
+                    THROW(INVALID_END_TAG2);
+                parser->offset++;
+                if (1 != parser->depth || strcmp(name, FLOM_MSG_TAG_MSG))
+                    THROW(UNBALANCED_END_TAG);
+                parser->depth--;
+                flom_msg_deserialize_end_element(msg, name);
+                if (FLOM_MSG_STATE_INVALID == msg->state)
+                    THROW(INVALID_MESSAGE);
+                continue;
+            }
+            /* start tag or empty element tag */
+            if (NULL == (name = flom_msg_parser_scan_name(
+                             parser, buffer, buffer_len, &scratch_pos)))
+                THROW(INVALID_TAG_NAME);
+            while (TRUE) {
+                while (parser->offset < buffer_len &&
+                       flom_msg_parser_is_space(buffer[parser->offset]))
+                    parser->offset++;
+                if (parser->offset >= buffer_len)
+                    THROW(INVALID_TAG_END1);
+                if ('>' == buffer[parser->offset]) {
+                    parser->offset++;
+                    break;
+                }
+                if ('/' == buffer[parser->offset]) {
+                    if (parser->offset + 1 >= buffer_len ||
+                        '>' != buffer[parser->offset + 1])
+                        THROW(INVALID_TAG_END2);
+                    parser->offset += 2;
+                    empty = TRUE;
+                    break;
+                }
+                if (FLOM_MSG_PARSER_MAX_ATTRIBUTES == n)
+                    THROW(TOO_MANY_ATTRIBUTES);
+                if (NULL == (parser->names[n] = flom_msg_parser_scan_name(
+                                 parser, buffer, buffer_len, &scratch_pos)))
+                    THROW(INVALID_ATTRIBUTE_NAME);
+                /* an attribute can not be specified twice in the same tag */
+                for (i=0; i<n; ++i)
+                    if (!strcmp(parser->names[i], parser->names[n]))
+                        THROW(DUPLICATED_ATTRIBUTE);
+                while (parser->offset < buffer_len &&
+                       flom_msg_parser_is_space(buffer[parser->offset]))
+                    parser->offset++;
+                if (parser->offset >= buffer_len ||
+                    '=' != buffer[parser->offset])
+                    THROW(MISSING_EQUAL_SIGN);
+                parser->offset++;
+                while (parser->offset < buffer_len &&
+                       flom_msg_parser_is_space(buffer[parser->offset]))
+                    parser->offset++;
+                if (NULL == (parser->values[n] = flom_msg_parser_scan_value(
+                                 parser, buffer, buffer_len, &scratch_pos)))
+                    THROW(INVALID_ATTRIBUTE_VALUE);
+                n++;
+            } /* while (TRUE) */
+            parser->names[n] = parser->values[n] = NULL;
+            /* the children of the root element are always empty */
+            if (0 < parser->depth && !empty)
+                THROW(NESTED_ELEMENT);
+            parser->tags++;
+            flom_msg_deserialize_start_element(
+                msg, name, parser->names, parser->values);
+            if (empty)
+                flom_msg_deserialize_end_element(msg, name);
+            else
+                parser->depth++;
+            /* there's no reason to parse the rest of an invalid message */
+            if (FLOM_MSG_STATE_INVALID == msg->state)
+                THROW(INVALID_MESSAGE);
+        } /* while (parser->offset < buffer_len) */
+        if (0 < parser->depth || 0 == parser->tags)
+            THROW(UNTERMINATED_MESSAGE);
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case UNEXPECTED_TEXT:
+            case TRAILING_DATA:
+            case UNEXPECTED_PROLOGUE:
+            case UNTERMINATED_PROLOGUE:
+            case INVALID_END_TAG1:
+            case INVALID_END_TAG2:
+            case UNBALANCED_END_TAG:
+            case INVALID_TAG_NAME:
+            case INVALID_TAG_END1:
+            case INVALID_TAG_END2:
+            case TOO_MANY_ATTRIBUTES:
+            case INVALID_ATTRIBUTE_NAME:
+            case DUPLICATED_ATTRIBUTE:
+            case MISSING_EQUAL_SIGN:
+            case INVALID_ATTRIBUTE_VALUE:
+            case NESTED_ELEMENT:
+            case UNTERMINATED_MESSAGE:
+                FLOM_TRACE(("flom_msg_parser_parse: syntax error at offset "
+                            SIZE_T_FORMAT "\n", parser->offset));
+                ret_cod = FLOM_RC_XML_SYNTAX_ERROR;
+                break;
+            case INVALID_MESSAGE:
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_msg_parser_parse/excp=%d/"
                 "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
     return ret_cod;
 }
 
 
 
+const gchar *flom_msg_parser_scan_name(flom_msg_parser_t *parser,
+                                       const char *buffer,
+                                       size_t buffer_len,
+                                       size_t *scratch_pos)
+{
+    gchar *name = parser->scratch + *scratch_pos;
+    size_t len = 0;
+
+    while (parser->offset < buffer_len &&
+           flom_msg_parser_is_name_char(buffer[parser->offset])) {
+        /* room for the terminator too */
+        if (*scratch_pos + len + 1 >= FLOM_MSG_PARSER_SCRATCH_SIZE)
+            return NULL;
+        name[len++] = buffer[parser->offset++];
+    }
+    if (0 == len)
+        return NULL;
+    name[len] = '\0';
+    *scratch_pos += len + 1;
+    return name;
+}
+
+
+
+const gchar *flom_msg_parser_scan_value(flom_msg_parser_t *parser,
+                                        const char *buffer,
+                                        size_t buffer_len,
+                                        size_t *scratch_pos)
+{
+    gchar *value = parser->scratch + *scratch_pos;
+    size_t len = 0;
+    char quote;
+
+    if (parser->offset >= buffer_len)
+        return NULL;
+    quote = buffer[parser->offset];
+    if ('"' != quote && '\'' != quote)
+        return NULL;
+    parser->offset++;
+    while (parser->offset < buffer_len && quote != buffer[parser->offset]) {
+        char c = buffer[parser->offset++];
+        if ('<' == c)
+            return NULL;
+        if ('&' == c) {
+            const char *entity = buffer + parser->offset;
+            size_t left = buffer_len - parser->offset;
+            if (4 <= left && !memcmp(entity, "amp;", 4)) {
+                c = '&';
+                parser->offset += 4;
+            } else if (3 <= left && !memcmp(entity, "lt;", 3)) {
+                c = '<';
+                parser->offset += 3;
+            } else if (3 <= left && !memcmp(entity, "gt;", 3)) {
+                c = '>';
+                parser->offset += 3;
+            } else if (5 <= left && !memcmp(entity, "quot;", 5)) {
+                c = '"';
+                parser->offset += 5;
+            } else if (5 <= left && !memcmp(entity, "apos;", 5)) {
+                c = '\'';
+                parser->offset += 5;
+            } else
+                return NULL;
+        }
+        /* room for the terminator too */
+        if (*scratch_pos + len + 1 >= FLOM_MSG_PARSER_SCRATCH_SIZE)
+            return NULL;
+        value[len++] = c;
+    }
+    /* missing closing quote */
+    if (parser->offset >= buffer_len)
+        return NULL;
+    parser->offset++;
+    value[len] = '\0';
+    *scratch_pos += len + 1;
+    return value;
+}
+
+
+
 int flom_msg_deserialize_resource_name(const gchar *base64,
                                        gchar **resource_name)
 {
@@ -1629,12 +2503,10 @@ int flom_msg_deserialize_resource_name(const gchar *base64,
 
 
 void flom_msg_deserialize_start_element(
-    GMarkupParseContext *context,
+    struct flom_msg_s   *msg,
     const gchar         *element_name,
     const gchar        **attribute_names,
-    const gchar        **attribute_values,
-    gpointer             user_data,
-    GError             **error)
+    const gchar        **attribute_values)
 {
     enum Exception { ALREADY_INVALID
                      , PROTOCOL_LEVEL_MISMATCH
@@ -1652,14 +2524,17 @@ void flom_msg_deserialize_start_element(
                      , G_STRDUP_ERROR3
                      , INVALID_PROPERTY9
                      , TAG_TYPE_ERROR
+                     , TOO_MANY_RESOURCES
+                     , G_TRY_MALLOC_ERROR
                      , NONE } excp;
     
     enum {
         dummy_tag, msg_tag, resource_tag, answer_tag, network_tag,
         session_tag, shutdown_tag
     } tag_type = dummy_tag;
-    /* deserialized message */
-    struct flom_msg_s *msg = (struct flom_msg_s *)user_data;
+    /* resource of a "lock 8" or "multiple lock 8" message filled by the
+       current tag */
+    struct flom_msg_body_lock_8_resource_s *lock_resource = NULL;
     
     const gchar **name_cursor = attribute_names;
     const gchar **value_cursor = attribute_values;
@@ -1687,6 +2562,25 @@ void flom_msg_deserialize_start_element(
             tag_type = session_tag;
         else if (!strcmp(element_name, FLOM_MSG_TAG_SHUTDOWN))
             tag_type = shutdown_tag;
+        if (resource_tag == tag_type &&
+            FLOM_MSG_STEP_INCR == msg->header.pvs.step) {
+            if (FLOM_MSG_VERB_LOCK == msg->header.pvs.verb)
+                lock_resource = &msg->body.lock_8.resource;
+            else if (FLOM_MSG_VERB_MLOCK == msg->header.pvs.verb) {
+                /* every resource tag appends a resource to the list */
+                if (FLOM_MSG_MLOCK_MAX_RESOURCES <=
+                    msg->body.mlock_8.resource_number)
+                    THROW(TOO_MANY_RESOURCES);
+                if (NULL == msg->body.mlock_8.resources &&
+                    NULL == (msg->body.mlock_8.resources = g_try_malloc0(
+                                 FLOM_MSG_MLOCK_MAX_RESOURCES *
+                                 sizeof(struct
+                                        flom_msg_body_lock_8_resource_s))))
+                    THROW(G_TRY_MALLOC_ERROR);
+                lock_resource = msg->body.mlock_8.resources +
+                    msg->body.mlock_8.resource_number++;
+            }
+        }
         while (*name_cursor) {
             FLOM_TRACE(("flom_msg_deserialize_start_element: name_cursor='%s' "
                         "value_cursor='%s'\n", *name_cursor, *value_cursor));
@@ -1700,11 +2594,12 @@ void flom_msg_deserialize_start_element(
                         msg->header.pvs.verb = strtol(*value_cursor, NULL, 10);
                     else if (!strcmp(*name_cursor, FLOM_MSG_PROP_STEP))
                         msg->header.pvs.step = strtol(*value_cursor, NULL, 10);
+                    else if (!strcmp(*name_cursor, FLOM_MSG_PROP_RID))
+                        msg->header.rid = strtol(*value_cursor, NULL, 10);
                     break;
                 case resource_tag:
                     /* check if this tag is OK for the current message */
-                    if ((FLOM_MSG_VERB_LOCK == msg->header.pvs.verb &&
-                         FLOM_MSG_STEP_INCR == msg->header.pvs.step) ||
+                    if (NULL != lock_resource ||
                         (FLOM_MSG_VERB_UNLOCK == msg->header.pvs.verb &&
                          FLOM_MSG_STEP_INCR == msg->header.pvs.step)) {
                         if (!strcmp(*name_cursor, FLOM_MSG_PROP_NAME)) {
@@ -1713,13 +2608,14 @@ void flom_msg_deserialize_start_element(
                                 flom_msg_deserialize_resource_name(
                                     *value_cursor, &tmp))
                                 THROW(DESERIALIZE_RESOURCE_NAME_ERROR);
-                            if (FLOM_MSG_VERB_LOCK == msg->header.pvs.verb)
-                                msg->body.lock_8.resource.name = tmp;
-                            else
+                            if (NULL != lock_resource) {
+                                g_free(lock_resource->name);
+                                lock_resource->name = tmp;
+                            } else
                                 msg->body.unlock_8.resource.name = tmp;
                         } else if (!strcmp(*name_cursor, FLOM_MSG_PROP_MODE)) {
-                            if (FLOM_MSG_VERB_LOCK == msg->header.pvs.verb)
-                                msg->body.lock_8.resource.mode =
+                            if (NULL != lock_resource)
+                                lock_resource->mode =
                                     strtol(*value_cursor, NULL, 10);
                             else {
                                 FLOM_TRACE(("flom_msg_deserialize_start_"
@@ -1741,8 +2637,8 @@ void flom_msg_deserialize_start_element(
                                 THROW(INVALID_PROPERTY2);
                             }
                         } else if (!strcmp(*name_cursor, FLOM_MSG_PROP_WAIT)) {
-                            if (FLOM_MSG_VERB_LOCK == msg->header.pvs.verb)
-                                msg->body.lock_8.resource.wait =
+                            if (NULL != lock_resource)
+                                lock_resource->wait =
                                     strtol(*value_cursor, NULL, 10);
                             else {
                                 FLOM_TRACE(("flom_msg_deserialize_start_"
@@ -1753,8 +2649,8 @@ void flom_msg_deserialize_start_element(
                             }
                         } else if (!strcmp(*name_cursor,
                                            FLOM_MSG_PROP_QUANTITY)) {
-                            if (FLOM_MSG_VERB_LOCK == msg->header.pvs.verb)
-                                msg->body.lock_8.resource.quantity =
+                            if (NULL != lock_resource)
+                                lock_resource->quantity =
                                     strtol(*value_cursor, NULL, 10);
                             else {
                                 FLOM_TRACE(("flom_msg_deserialize_start_"
@@ -1765,8 +2661,8 @@ void flom_msg_deserialize_start_element(
                             }
                         } else if (!strcmp(*name_cursor,
                                            FLOM_MSG_PROP_CREATE)) {
-                            if (FLOM_MSG_VERB_LOCK == msg->header.pvs.verb)
-                                msg->body.lock_8.resource.create =
+                            if (NULL != lock_resource)
+                                lock_resource->create =
                                     strtol(*value_cursor, NULL, 10);
                             else {
                                 FLOM_TRACE(("flom_msg_deserialize_start_"
@@ -1777,8 +2673,8 @@ void flom_msg_deserialize_start_element(
                             }
                         } else if (!strcmp(*name_cursor,
                                            FLOM_MSG_PROP_LIFESPAN)) {
-                            if (FLOM_MSG_VERB_LOCK == msg->header.pvs.verb)
-                                msg->body.lock_8.resource.lifespan =
+                            if (NULL != lock_resource)
+                                lock_resource->lifespan =
                                     strtol(*value_cursor, NULL, 10);
                             else {
                                 FLOM_TRACE(("flom_msg_deserialize_start_"
@@ -1797,7 +2693,11 @@ void flom_msg_deserialize_start_element(
                         (FLOM_MSG_VERB_LOCK == msg->header.pvs.verb &&
                          3*FLOM_MSG_STEP_INCR == msg->header.pvs.step) ||
                         (FLOM_MSG_VERB_LOCK == msg->header.pvs.verb &&
-                         4*FLOM_MSG_STEP_INCR == msg->header.pvs.step)) {
+                         4*FLOM_MSG_STEP_INCR == msg->header.pvs.step) ||
+                        (FLOM_MSG_VERB_MLOCK == msg->header.pvs.verb &&
+                         2*FLOM_MSG_STEP_INCR == msg->header.pvs.step) ||
+                        (FLOM_MSG_VERB_MLOCK == msg->header.pvs.verb &&
+                         3*FLOM_MSG_STEP_INCR == msg->header.pvs.step)) {
                         if (!strcmp(*name_cursor, FLOM_MSG_PROP_RC)) {
                             if (2*FLOM_MSG_STEP_INCR == msg->header.pvs.step)
                                 msg->body.lock_16.answer.rc =
@@ -1862,7 +2762,8 @@ void flom_msg_deserialize_start_element(
                 case session_tag:
                     /* check if this tag is OK for the current message */
                     if (
-                        (FLOM_MSG_VERB_LOCK == msg->header.pvs.verb &&
+                        ((FLOM_MSG_VERB_LOCK == msg->header.pvs.verb ||
+                          FLOM_MSG_VERB_MLOCK == msg->header.pvs.verb) &&
                         ((FLOM_MSG_STEP_INCR == msg->header.pvs.step) ||
                          (2*FLOM_MSG_STEP_INCR == msg->header.pvs.step))) ||
                         (FLOM_MSG_VERB_MNGMNT == msg->header.pvs.verb &&
@@ -1882,6 +2783,13 @@ void flom_msg_deserialize_start_element(
                                     msg->body.lock_8.session.peerid = tmp;
                                 else
                                     msg->body.lock_16.session.peerid = tmp;
+                            } else if (FLOM_MSG_VERB_MLOCK ==
+                                       msg->header.pvs.verb) {
+                                /* multiple lock verb message */
+                                if (FLOM_MSG_STEP_INCR == msg->header.pvs.step)
+                                    msg->body.mlock_8.session.peerid = tmp;
+                                else
+                                    msg->body.lock_16.session.peerid = tmp;
                             } else {
                                 /* mngmnt verb message */
                                 msg->body.mngmnt_8.session.peerid = tmp;
@@ -1936,6 +2844,8 @@ void flom_msg_deserialize_start_element(
             case G_STRDUP_ERROR3:
             case INVALID_PROPERTY9:
             case TAG_TYPE_ERROR:
+            case TOO_MANY_RESOURCES:
+            case G_TRY_MALLOC_ERROR:
                 msg->state = FLOM_MSG_STATE_INVALID;
                 break;
             case NONE:
@@ -1950,30 +2860,14 @@ void flom_msg_deserialize_start_element(
 
 
 
-void flom_msg_deserialize_text(GMarkupParseContext *context,
-                               const gchar         *text,
-                               gsize                text_len,
-                               gpointer             user_data,
-                               GError             **error)
-{
-    FLOM_TRACE(("flom_msg_deserialize_text: text='%*s'\n",
-                text_len, text));
-}
-
-
-
-void flom_msg_deserialize_end_element(GMarkupParseContext *context,
-                                      const gchar         *element_name,
-                                      gpointer             user_data,
-                                      GError             **error)
+void flom_msg_deserialize_end_element(struct flom_msg_s   *msg,
+                                      const gchar         *element_name)
 {
     enum Exception { ALREADY_INVALID
                      , ALREADY_READY
                      , ONLY_INITIALIZED
                      , INTERNAL_ERROR
                      , NONE } excp;
-    /* deserialized message */
-    struct flom_msg_s *msg = (struct flom_msg_s *)user_data;
     
     FLOM_TRACE(("flom_msg_deserialize_end_element\n"));
     TRY {
@@ -2115,6 +3009,134 @@ int flom_msg_build_answer(struct flom_msg_s *msg,
 
 
 
+void flom_msg_answer_cache_fill(void)
+{
+    int levels[FLOM_MSG_ANSWER_CACHE_LEVELS] = {
+        FLOM_MSG_LEVEL, FLOM_MSG_LEVEL_BINARY };
+    int rcs[FLOM_MSG_ANSWER_CACHE_RCS] = {
+        FLOM_RC_OK, FLOM_RC_LOCK_ENQUEUED, FLOM_RC_LOCK_BUSY };
+    guint l, s, r;
+    
+    FLOM_TRACE(("flom_msg_answer_cache_fill\n"));
+    for (l=0; l<FLOM_MSG_ANSWER_CACHE_LEVELS; ++l)
+        for (s=0; s<FLOM_MSG_ANSWER_CACHE_STEPS; ++s)
+            for (r=0; r<FLOM_MSG_ANSWER_CACHE_RCS; ++r) {
+                flom_msg_cached_answer_t *cached =
+                    &flom_msg_answer_cache[l][s][r];
+                struct flom_msg_s msg;
+                int ret_cod;
+
+                /* an answer that can not be serialized is not cached and
+                   it will be built from scratch every time */
+                cached->len = 0;
+                flom_msg_init(&msg);
+                if (FLOM_RC_OK != (ret_cod = flom_msg_build_answer(
+                                       &msg, FLOM_MSG_VERB_LOCK,
+                                       (s+2)*FLOM_MSG_STEP_INCR, rcs[r],
+                                       NULL))) {
+                    FLOM_TRACE(("flom_msg_answer_cache_fill: "
+                                "flom_msg_build_answer returned %d\n",
+                                ret_cod));
+                } else {
+                    msg.header.level = levels[l];
+                    if (FLOM_RC_OK != (ret_cod = flom_msg_serialize(
+                                           &msg, cached->buffer,
+                                           sizeof(cached->buffer),
+                                           &cached->len))) {
+                        FLOM_TRACE(("flom_msg_answer_cache_fill: "
+                                    "flom_msg_serialize returned %d\n",
+                                    ret_cod));
+                        cached->len = 0;
+                    }
+                }
+                flom_msg_free(&msg);
+            } /* for (r=0; r<FLOM_MSG_ANSWER_CACHE_RCS; ++r) */
+}
+
+
+
+const flom_msg_cached_answer_t *flom_msg_get_cached_answer(
+    int level, int verb, int step, int rc)
+{
+    guint l, s, r;
+
+    if (FLOM_MSG_VERB_LOCK != verb)
+        return NULL;
+    switch (level) {
+        case FLOM_MSG_LEVEL:
+            l = 0;
+            break;
+        case FLOM_MSG_LEVEL_BINARY:
+            l = 1;
+            break;
+        default:
+            return NULL;
+    } /* switch (level) */
+    switch (step) {
+        case 2*FLOM_MSG_STEP_INCR:
+        case 3*FLOM_MSG_STEP_INCR:
+        case 4*FLOM_MSG_STEP_INCR:
+            s = step / FLOM_MSG_STEP_INCR - 2;
+            break;
+        default:
+            return NULL;
+    } /* switch (step) */
+    switch (rc) {
+        case FLOM_RC_OK:
+            r = 0;
+            break;
+        case FLOM_RC_LOCK_ENQUEUED:
+            r = 1;
+            break;
+        case FLOM_RC_LOCK_BUSY:
+            r = 2;
+            break;
+        default:
+            return NULL;
+    } /* switch (rc) */
+    /* the cache is filled only once, by the first thread that needs it */
+    if (g_once_init_enter(&flom_msg_answer_cache_ready)) {
+        flom_msg_answer_cache_fill();
+        g_once_init_leave(&flom_msg_answer_cache_ready, 1);
+    }
+    return 0 < flom_msg_answer_cache[l][s][r].len ?
+        &flom_msg_answer_cache[l][s][r] : NULL;
+}
+
+
+
+const flom_msg_cached_answer_t *flom_msg_get_cached_reply(
+    const struct flom_msg_s *msg)
+{
+    const struct flom_msg_body_answer_s *answer = NULL;
+    
+    /* the cached answers do not carry a request id */
+    if (FLOM_MSG_STATE_READY != msg->state ||
+        FLOM_MSG_VERB_LOCK != msg->header.pvs.verb || 0 != msg->header.rid)
+        return NULL;
+    switch (msg->header.pvs.step) {
+        case 2*FLOM_MSG_STEP_INCR:
+            answer = &msg->body.lock_16.answer;
+            break;
+        case 3*FLOM_MSG_STEP_INCR:
+            answer = &msg->body.lock_24.answer;
+            break;
+        case 4*FLOM_MSG_STEP_INCR:
+            answer = &msg->body.lock_32.answer;
+            break;
+        default:
+            return NULL;
+    } /* switch (msg->header.pvs.step) */
+    /* the element is specific of every answer */
+    if (NULL != answer->element)
+        return NULL;
+    return flom_msg_get_cached_answer(
+        msg->header.level, msg->header.pvs.verb, msg->header.pvs.step,
+        answer->rc);
+}
+
+
+
 gchar *flom_msg_get_peerid(const struct flom_msg_s *msg)
 {
     gchar *ret = NULL;
@@ -2133,6 +3155,12 @@ gchar *flom_msg_get_peerid(const struct flom_msg_s *msg)
                 if (FLOM_MSG_STEP_INCR == msg->header.pvs.step)
                     ret = msg->body.mngmnt_8.session.peerid;
                 break;
+            case FLOM_MSG_VERB_MLOCK:
+                if (FLOM_MSG_STEP_INCR == msg->header.pvs.step)
+                    ret = msg->body.mlock_8.session.peerid;
+                else if (2*FLOM_MSG_STEP_INCR == msg->header.pvs.step)
+                    ret = msg->body.lock_16.session.peerid;
+                break;
             default:
                 break;
         } /* switch (msg->header.pvs.verb) */
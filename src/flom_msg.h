@@ -43,6 +43,7 @@
 
 
 
+#include "flom_defines.h"
 #include "flom_types.h"
 
 
@@ -63,6 +64,11 @@
  * deserialization)
  **/
 #define FLOM_MSG_BUFFER_SIZE        512
+/**
+ * Max size of a message: a multiple lock request (see
+ * @ref FLOM_MSG_VERB_MLOCK) can be larger than @ref FLOM_MSG_BUFFER_SIZE
+ **/
+#define FLOM_MSG_MAX_SIZE           (3*FLOM_NETWORK_BUFFER_SIZE)
 
 
 
@@ -97,6 +103,129 @@ typedef enum flom_msg_state_e {
  * configuration at run-time
  */
 #define FLOM_MSG_LEVEL           3
+/**
+ * Protocol level of the compact binary encoding: a client can use it in
+ * place of @ref FLOM_MSG_LEVEL and the daemon answers using the level of the
+ * first message received from the client
+ */
+#define FLOM_MSG_LEVEL_BINARY    4
+
+
+
+/**
+ * First byte of a message encoded with @ref FLOM_MSG_LEVEL_BINARY; it can not
+ * be the first char of an XML message
+ */
+#define FLOM_MSG_BINARY_MAGIC         0xF7
+/**
+ * Size of the header of a binary message: magic (1 byte), level (1 byte),
+ * body length (2 bytes), verb (2 bytes), step (2 bytes); multi byte fields
+ * use network byte order. The request id of a pipelined message
+ * (@ref flom_msg_header_s) is appended to the body as 4 more bytes
+ */
+#define FLOM_MSG_BINARY_HEADER_SIZE   8
+/**
+ * Length used to encode a NULL string inside a binary message
+ */
+#define FLOM_MSG_BINARY_NULL_STRING   0xFFFF
+/**
+ * Max number of string (or integer) fields carried by a binary message
+ */
+#define FLOM_MSG_BINARY_MAX_FIELDS    8
+/**
+ * Number of chars needed to format a 32 bit signed integer
+ */
+#define FLOM_MSG_INT_DIGITS           11
+/**
+ * Number of bytes base64 encoded with a single call of
+ * g_base64_encode_step while serializing a resource name
+ */
+#define FLOM_MSG_BASE64_CHUNK         48
+
+
+
+/**
+ * Number of protocol levels kept by the answer cache: @ref FLOM_MSG_LEVEL
+ * and @ref FLOM_MSG_LEVEL_BINARY
+ */
+#define FLOM_MSG_ANSWER_CACHE_LEVELS  2
+/**
+ * Number of lock answer steps kept by the answer cache: 16, 24 and 32
+ */
+#define FLOM_MSG_ANSWER_CACHE_STEPS   3
+/**
+ * Number of reason codes kept by the answer cache: @ref FLOM_RC_OK,
+ * @ref FLOM_RC_LOCK_ENQUEUED and @ref FLOM_RC_LOCK_BUSY
+ */
+#define FLOM_MSG_ANSWER_CACHE_RCS     3
+
+
+
+/**
+ * Max number of attributes of a single tag accepted by the XML parser
+ */
+#define FLOM_MSG_PARSER_MAX_ATTRIBUTES   8
+/**
+ * Size of the scratch area used by the XML parser to store the name and
+ * the attributes of a single tag
+ */
+#define FLOM_MSG_PARSER_SCRATCH_SIZE     FLOM_MSG_BUFFER_SIZE
+
+
+
+/**
+ * Hand written parser for the subset of XML used by FLoM messages (see
+ * doc/protocol.txt): it does not allocate memory and it's reset before
+ * every message by @ref flom_msg_deserialize
+ */
+typedef struct flom_msg_parser_s {
+    /**
+     * Number of elements currently open
+     */
+    guint          depth;
+    /**
+     * Number of tags parsed since the last reset
+     */
+    guint          tags;
+    /**
+     * Offset of the first char not yet parsed; after a syntax error it
+     * points to the offending char
+     */
+    size_t         offset;
+    /**
+     * Names of the attributes of the current tag (NULL terminated array
+     * of pointers inside @ref scratch)
+     */
+    const gchar   *names[FLOM_MSG_PARSER_MAX_ATTRIBUTES+1];
+    /**
+     * Values of the attributes of the current tag (NULL terminated array
+     * of pointers inside @ref scratch)
+     */
+    const gchar   *values[FLOM_MSG_PARSER_MAX_ATTRIBUTES+1];
+    /**
+     * Null terminated copies of the name, the attribute names and the
+     * unescaped attribute values of the current tag
+     */
+    gchar          scratch[FLOM_MSG_PARSER_SCRATCH_SIZE];
+} flom_msg_parser_t;
+
+
+
+/**
+ * A lock answer without element: it is serialized only once and the same
+ * bytes are sent to all the clients
+ */
+typedef struct flom_msg_cached_answer_s {
+    /**
+     * Number of bytes of the serialized answer; 0 if the answer is not
+     * available
+     */
+    size_t    len;
+    /**
+     * Serialized answer
+     */
+    char      buffer[FLOM_MSG_BUFFER_SIZE];
+} flom_msg_cached_answer_t;
 
 
 
@@ -125,12 +254,22 @@ typedef enum flom_msg_state_e {
  * Id assigned to verb "management"
  */
 #define FLOM_MSG_VERB_MNGMNT    5
+/**
+ * Id assigned to verb "multiple lock": a list of resources locked all or
+ * nothing
+ */
+#define FLOM_MSG_VERB_MLOCK     6
 
 /**
  * Default increment for message step
  */
 #define FLOM_MSG_STEP_INCR      8
 
+/**
+ * Max number of resources carried by a multiple lock message
+ */
+#define FLOM_MSG_MLOCK_MAX_RESOURCES    32
+
 
 
 /**
@@ -185,6 +324,10 @@ extern const gchar *FLOM_MSG_PROP_QUANTITY;
  * Label used to specify "rc" property
  */
 extern const gchar *FLOM_MSG_PROP_RC;
+/**
+ * Label used to specify "rid" property
+ */
+extern const gchar *FLOM_MSG_PROP_RID;
 /**
  * Label used to specify "rollback" property
  */
@@ -209,6 +352,10 @@ extern const gchar *FLOM_MSG_TAG_ANSWER;
  * Label used to specify "msg" tag
  */
 extern const gchar *FLOM_MSG_TAG_MSG;
+/**
+ * Closing "msg" tag: it terminates an XML message
+ */
+extern const gchar *FLOM_MSG_CLOSING_TAG;
 /**
  * Label used to specify "network" tag
  */
@@ -280,9 +427,20 @@ extern const char *FLOM_LOCK_MODE_EX_LONG_STRING;
 
 
 /**
- * A static object used by g_markup functions
+ * Pre-serialized lock answers, indexed by protocol level, step and reason
+ * code; use @ref flom_msg_get_cached_answer to access them
+ */
+extern flom_msg_cached_answer_t flom_msg_answer_cache[
+    FLOM_MSG_ANSWER_CACHE_LEVELS][FLOM_MSG_ANSWER_CACHE_STEPS][
+    FLOM_MSG_ANSWER_CACHE_RCS];
+
+
+
+/**
+ * Guard used by g_once_init_enter to fill @ref flom_msg_answer_cache only
+ * once
  */
-extern GMarkupParser flom_msg_parser;
+extern gsize flom_msg_answer_cache_ready;
 
 
 
@@ -315,6 +473,12 @@ struct flom_msg_header_s {
      * Protocol verb and step of the message
      */
     struct flom_msg_verb_step_s pvs;
+    /**
+     * Request id of a pipelined request: the answers carry the id of the
+     * request they belong to and can be returned out of order; 0 for the
+     * messages that follow the strict request/answer sequence
+     */
+    int                         rid;
 };
 
  
@@ -402,6 +566,26 @@ struct flom_msg_body_lock_16_session_s {
 
     
 
+/**
+ * Message body for verb "multiple lock", step "8"; the answers of the
+ * following steps use @ref flom_msg_body_lock_16_s and
+ * @ref flom_msg_body_lock_24_s
+ */
+struct flom_msg_body_mlock_8_s {
+    struct flom_msg_body_lock_8_session_s    session;
+    /**
+     * number of elements of resources array
+     */
+    guint                                    resource_number;
+    /**
+     * resources to lock; the array is allocated by the parser and it's
+     * released by @ref flom_msg_free
+     */
+    struct flom_msg_body_lock_8_resource_s  *resources;
+};
+
+
+
 /**
  * Message body for verb "lock", step "16"
  */
@@ -607,6 +791,7 @@ struct flom_msg_s {
         struct flom_msg_body_discover_8_s     discover_8;
         struct flom_msg_body_discover_16_s    discover_16;
         struct flom_msg_body_mngmnt_8_s       mngmnt_8;
+        struct flom_msg_body_mlock_8_s        mlock_8;
     } body;
 };
 
@@ -652,6 +837,173 @@ extern "C" {
     static inline void flom_msg_init(struct flom_msg_s *msg) {
         memset(msg, 0, sizeof(struct flom_msg_s));
     }
+
+
+
+    /**
+     * Append some chars to an XML serialization buffer that is kept null
+     * terminated. If the chars do not fit, *free_chars is set to 0 and all
+     * the following appends are discarded: the caller can check the
+     * overflow only once, after the last append
+     * @param buffer IN/OUT serialization buffer
+     * @param offset IN/OUT first unused char of the buffer
+     * @param free_chars IN/OUT remaining free chars inside the buffer
+     * @param chars IN chars to append
+     * @param len IN number of chars to append
+     */
+    static inline void flom_msg_put_chars(char *buffer, size_t *offset,
+                                          size_t *free_chars,
+                                          const char *chars, size_t len) {
+        if (len >= *free_chars) {
+            *free_chars = 0;
+            return;
+        }
+        memcpy(buffer + *offset, chars, len);
+        *offset += len;
+        *free_chars -= len;
+        buffer[*offset] = '\0';
+    }
+
+
+
+    /**
+     * Append a null terminated string to an XML serialization buffer, see
+     * @ref flom_msg_put_chars
+     * @param buffer IN/OUT serialization buffer
+     * @param offset IN/OUT first unused char of the buffer
+     * @param free_chars IN/OUT remaining free chars inside the buffer
+     * @param str IN string to append (NULL is appended as an empty string)
+     */
+    static inline void flom_msg_put_string(char *buffer, size_t *offset,
+                                           size_t *free_chars,
+                                           const gchar *str) {
+        if (NULL != str)
+            flom_msg_put_chars(buffer, offset, free_chars, str, strlen(str));
+    }
+
+
+
+    /**
+     * Append the decimal representation of an integer to an XML
+     * serialization buffer without using the printf family functions, see
+     * @ref flom_msg_put_chars
+     * @param buffer IN/OUT serialization buffer
+     * @param offset IN/OUT first unused char of the buffer
+     * @param free_chars IN/OUT remaining free chars inside the buffer
+     * @param value IN integer to append
+     */
+    void flom_msg_put_int(char *buffer, size_t *offset, size_t *free_chars,
+                          int value);
+
+
+
+    /**
+     * Append the base64 encoding of a string to an XML serialization
+     * buffer: the string is encoded chunk by chunk and no memory is
+     * allocated, see @ref flom_msg_put_chars
+     * @param buffer IN/OUT serialization buffer
+     * @param offset IN/OUT first unused char of the buffer
+     * @param free_chars IN/OUT remaining free chars inside the buffer
+     * @param data IN string to encode (NULL is encoded as an empty string)
+     */
+    void flom_msg_put_base64(char *buffer, size_t *offset, size_t *free_chars,
+                             const gchar *data);
+
+
+
+    /**
+     * Append an answer tag to an XML serialization buffer, see
+     * @ref flom_msg_put_chars
+     * @param buffer IN/OUT serialization buffer
+     * @param offset IN/OUT first unused char of the buffer
+     * @param free_chars IN/OUT remaining free chars inside the buffer
+     * @param answer IN answer to serialize
+     */
+    void flom_msg_put_answer(char *buffer, size_t *offset, size_t *free_chars,
+                             const struct flom_msg_body_answer_s *answer);
+
+
+
+    /**
+     * Store a 16 bit unsigned integer in network byte order
+     * @param buffer OUT destination (2 bytes)
+     * @param value IN value to store
+     */
+    static inline void flom_msg_binary_put_uint16(char *buffer,
+                                                  guint16 value) {
+        buffer[0] = (char)(value >> 8);
+        buffer[1] = (char)value;
+    }
+
+
+
+    /**
+     * Store a 32 bit unsigned integer in network byte order
+     * @param buffer OUT destination (4 bytes)
+     * @param value IN value to store
+     */
+    static inline void flom_msg_binary_put_uint32(char *buffer,
+                                                  guint32 value) {
+        buffer[0] = (char)(value >> 24);
+        buffer[1] = (char)(value >> 16);
+        buffer[2] = (char)(value >> 8);
+        buffer[3] = (char)value;
+    }
+
+
+
+    /**
+     * Retrieve a 16 bit unsigned integer stored in network byte order
+     * @param buffer IN source (2 bytes)
+     * @return the value
+     */
+    static inline guint16 flom_msg_binary_get_uint16(const char *buffer) {
+        return (guint16)(((guint16)(guchar)buffer[0] << 8) |
+                         (guint16)(guchar)buffer[1]);
+    }
+
+
+
+    /**
+     * Retrieve a 32 bit unsigned integer stored in network byte order
+     * @param buffer IN source (4 bytes)
+     * @return the value
+     */
+    static inline guint32 flom_msg_binary_get_uint32(const char *buffer) {
+        return ((guint32)(guchar)buffer[0] << 24) |
+            ((guint32)(guchar)buffer[1] << 16) |
+            ((guint32)(guchar)buffer[2] << 8) |
+            (guint32)(guchar)buffer[3];
+    }
+
+
+
+    /**
+     * Check if a (partially) received buffer contains a message encoded
+     * with @ref FLOM_MSG_LEVEL_BINARY
+     * @param buffer IN received bytes
+     * @param buffer_len IN number of received bytes
+     * @return a boolean value
+     */
+    static inline int flom_msg_is_binary(const char *buffer,
+                                         size_t buffer_len) {
+        return 0 < buffer_len &&
+            FLOM_MSG_BINARY_MAGIC == (guchar)buffer[0];
+    }
+
+
+
+    /**
+     * Compute the whole length of a binary message from its header
+     * @param buffer IN buffer starting with (at least)
+     *                  @ref FLOM_MSG_BINARY_HEADER_SIZE bytes of a binary
+     *                  message
+     * @return the number of bytes of the message, header included
+     */
+    static inline size_t flom_msg_binary_frame_len(const char *buffer) {
+        return FLOM_MSG_BINARY_HEADER_SIZE +
+            (size_t)flom_msg_binary_get_uint16(buffer + 2);
+    }
     
 
 
@@ -694,6 +1046,25 @@ extern "C" {
                            size_t *msg_len);
 
 
+
+    /**
+     * Serialize a message using the compact binary encoding
+     * (@ref FLOM_MSG_LEVEL_BINARY): after the header, the body contains the
+     * number of string fields (1 byte), the number of integer fields
+     * (1 byte), the string fields (2 bytes of length followed by the chars,
+     * without terminator) and the integer fields (4 bytes each)
+     * @param msg IN the object must be serialized
+     * @param buffer OUT the buffer will contain the serialized object (it
+     *                   is not null terminated)
+     * @param buffer_len IN the space allocated for buffer
+     * @param msg_len OUT number of bytes used in buffer for serializing msg
+     * @return a reason code
+     */
+    int flom_msg_serialize_binary(const struct flom_msg_s *msg,
+                                  char *buffer, size_t buffer_len,
+                                  size_t *msg_len);
+
+
     
     /**
      * Serialize the "lock_8" specific body part of a message
@@ -713,6 +1084,41 @@ extern "C" {
 
 
     
+    /**
+     * Serialize the "resource" tag of a "lock_8" or "mlock_8" message: the
+     * properties depend on the type of the resource
+     * @param resource IN the resource must be serialized
+     * @param buffer OUT the buffer will contain the XML serialized object
+     *                   and will be null terminated
+     * @param offset IN/OUT offset must be used to start serialization inside
+     *                      the buffer
+     * @param free_chars IN/OUT remaing free chars inside the buffer
+     * @return a reason code
+     */
+    int flom_msg_serialize_lock_resource(
+        const struct flom_msg_body_lock_8_resource_s *resource,
+        char *buffer, size_t *offset, size_t *free_chars);
+
+
+    
+    /**
+     * Serialize the "mlock_8" specific body part of a message
+     * @param msg IN the object must be serialized
+     * @param buffer OUT the buffer will contain the XML serialized object
+     *                   (the size has fixed size of
+     *                   @ref FLOM_MSG_MAX_SIZE bytes) and will be
+     *                   null terminated
+     * @param offset IN/OUT offset must be used to start serialization inside
+     *                      the buffer
+     * @param free_chars IN/OUT remaing free chars inside the buffer
+     * @return a reason code
+     */
+    int flom_msg_serialize_mlock_8(const struct flom_msg_s *msg,
+                                   char *buffer,
+                                   size_t *offset, size_t *free_chars);
+
+
+    
     /**
      * Serialize the "lock_16" specific body part of a message
      * @param msg IN the object must be serialized
@@ -929,18 +1335,132 @@ extern "C" {
 
     
     
+    /**
+     * Display the content of a multiple lock message
+     * @param msg IN the message must be massaged
+     * @return a reason code
+     */
+    int flom_msg_trace_mlock(const struct flom_msg_s *msg);
+
+    
+    
     /**
      * Deserialize a serialized buffer to a message struct
      * @param buffer IN/OUT the buffer that's containing the serialized object
      *                  (it does not have to be null terminated)
      * @param buffer_len IN number of significative bytes of buffer
-     * @param msg OUT the object after deserialization
-     * @param gmpc IN/OUT GMarkup parser context
+     * @param msg OUT the object after deserialization; a message that does
+     *                 not comply with the XML subset is marked as
+     *                 @ref FLOM_MSG_STATE_INVALID
+     * @param parser IN/OUT XML parser (it's reset before parsing)
      * @return a reason code
      */
     int flom_msg_deserialize(char *buffer, size_t buffer_len,
                              struct flom_msg_s *msg,
-                             GMarkupParseContext *gmpc);
+                             flom_msg_parser_t *parser);
+
+
+
+    /**
+     * Reset an XML parser: it's ready to parse a new message
+     * @param parser IN/OUT XML parser
+     */
+    static inline void flom_msg_parser_reset(flom_msg_parser_t *parser) {
+        parser->depth = 0;
+        parser->tags = 0;
+        parser->offset = 0;
+        parser->names[0] = parser->values[0] = NULL;
+    }
+
+
+
+    /**
+     * Check if a char is a white space for the XML parser
+     * @param c IN char to check
+     * @return a boolean value
+     */
+    static inline int flom_msg_parser_is_space(char c) {
+        return ' ' == c || '\n' == c || '\t' == c || '\r' == c;
+    }
+
+
+
+    /**
+     * Check if a char can be used inside a tag or attribute name
+     * @param c IN char to check
+     * @return a boolean value
+     */
+    static inline int flom_msg_parser_is_name_char(char c) {
+        return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') ||
+            ('0' <= c && c <= '9') || '_' == c || '-' == c || '.' == c ||
+            ':' == c;
+    }
+
+
+
+    /**
+     * Parse a whole XML message and fill the message struct in place using
+     * @ref flom_msg_deserialize_start_element and
+     * @ref flom_msg_deserialize_end_element
+     * @param parser IN/OUT XML parser (it must be reset)
+     * @param buffer IN the buffer that's containing the XML message
+     * @param buffer_len IN number of significative bytes of buffer
+     * @param msg OUT the object after deserialization
+     * @return a reason code: @ref FLOM_RC_XML_SYNTAX_ERROR if the message
+     *         does not comply with the XML subset
+     */
+    int flom_msg_parser_parse(flom_msg_parser_t *parser,
+                              const char *buffer, size_t buffer_len,
+                              struct flom_msg_s *msg);
+
+
+
+    /**
+     * Parse a tag or an attribute name and copy it inside the scratch area
+     * of the parser
+     * @param parser IN/OUT XML parser
+     * @param buffer IN the buffer that's containing the XML message
+     * @param buffer_len IN number of significative bytes of buffer
+     * @param scratch_pos IN/OUT first free char of the scratch area
+     * @return the copied (null terminated) name or NULL if the name is
+     *         empty or it does not fit
+     */
+    const gchar *flom_msg_parser_scan_name(flom_msg_parser_t *parser,
+                                           const char *buffer,
+                                           size_t buffer_len,
+                                           size_t *scratch_pos);
+
+
+
+    /**
+     * Parse a quoted attribute value, resolve the five predefined entities
+     * (amp, lt, gt, quot, apos) and copy it inside the scratch area of the
+     * parser
+     * @param parser IN/OUT XML parser
+     * @param buffer IN the buffer that's containing the XML message
+     * @param buffer_len IN number of significative bytes of buffer
+     * @param scratch_pos IN/OUT first free char of the scratch area
+     * @return the copied (null terminated) value or NULL if the value is
+     *         not valid or it does not fit
+     */
+    const gchar *flom_msg_parser_scan_value(flom_msg_parser_t *parser,
+                                            const char *buffer,
+                                            size_t buffer_len,
+                                            size_t *scratch_pos);
+
+
+
+    /**
+     * Deserialize a message encoded with @ref FLOM_MSG_LEVEL_BINARY; like
+     * the XML parser, a message with an unexpected level or unexpected
+     * fields is marked as @ref FLOM_MSG_STATE_INVALID
+     * @param buffer IN the buffer that's containing the whole binary message
+     * @param buffer_len IN number of significative bytes of buffer
+     * @param msg OUT the object after deserialization
+     * @return a reason code
+     */
+    int flom_msg_deserialize_binary(const char *buffer, size_t buffer_len,
+                                    struct flom_msg_s *msg);
 
 
 
@@ -959,36 +1479,30 @@ extern "C" {
     
 
     /**
-     * GMarkupParser start_element callback function
+     * Fill the message with the attributes of a start (or empty) tag; a tag
+     * that's not expected by the message is ignored, an attribute that's
+     * not expected marks the message as @ref FLOM_MSG_STATE_INVALID
+     * @param msg IN/OUT message under deserialization
+     * @param element_name IN name of the tag
+     * @param attribute_names IN NULL terminated array of attribute names
+     * @param attribute_values IN NULL terminated array of attribute values
      */
     void flom_msg_deserialize_start_element(
-        GMarkupParseContext *context,
+        struct flom_msg_s   *msg,
         const gchar         *element_name,
         const gchar        **attribute_names,
-        const gchar        **attribute_values,
-        gpointer             user_data,
-        GError             **error);
-
-    
-
-    /**
-     * GMarkupParser end_element callback function
-     */
-    void flom_msg_deserialize_end_element(GMarkupParseContext *context,
-                                          const gchar         *element_name,
-                                          gpointer             user_data,
-                                          GError             **error);
+        const gchar        **attribute_values);
 
     
 
     /**
-     * GMarkupParser text callback function
+     * Process an end (or empty) tag: the end of the msg tag completes the
+     * message
+     * @param msg IN/OUT message under deserialization
+     * @param element_name IN name of the tag
      */
-    void flom_msg_deserialize_text(GMarkupParseContext *context,
-                                   const gchar         *text,
-                                   gsize                text_len,
-                                   gpointer             user_data,
-                                   GError             **error);
+    void flom_msg_deserialize_end_element(struct flom_msg_s   *msg,
+                                          const gchar         *element_name);
 
     
 
@@ -1008,6 +1522,40 @@ extern "C" {
 
 
 
+    /**
+     * Serialize all the answers kept by @ref flom_msg_answer_cache; it's
+     * called only once by @ref flom_msg_get_cached_answer
+     */
+    void flom_msg_answer_cache_fill(void);
+
+
+
+    /**
+     * Retrieve the pre-serialized form of a lock answer without element;
+     * the cache is filled, in a thread safe way, the first time it's used
+     * @param level IN protocol level of the answer
+     * @param verb IN answer verb
+     * @param step IN answer step
+     * @param rc IN answer rc
+     * @return the cached answer or NULL if the answer is not cached and
+     *         must be built with @ref flom_msg_build_answer
+     */
+    const flom_msg_cached_answer_t *flom_msg_get_cached_answer(
+        int level, int verb, int step, int rc);
+
+
+
+    /**
+     * Retrieve the pre-serialized form of an answer message built with
+     * @ref flom_msg_build_answer
+     * @param msg IN answer message (ready to be sent)
+     * @return the cached answer or NULL if the message must be serialized
+     */
+    const flom_msg_cached_answer_t *flom_msg_get_cached_reply(
+        const struct flom_msg_s *msg);
+
+
+
     /**
      * Retrieve, if available, the ID of the peer that sent the message
      * @param msg IN message struct
@@ -49,8 +49,8 @@
 
 
 
-int flom_resource_hier_can_lock(struct flom_rsrc_data_hier_element_s *node,
-                                flom_lock_mode_t lock, gchar **level_name)
+int flom_resource_hier_can_lock_counts(const guint *counts,
+                                       flom_lock_mode_t lock)
 {
     static const flom_lock_mode_t lock_table[
         FLOM_LOCK_MODE_N][FLOM_LOCK_MODE_N] =
@@ -61,48 +61,128 @@ int flom_resource_hier_can_lock(struct flom_rsrc_data_hier_element_s *node,
           { TRUE,  TRUE,  FALSE, FALSE, FALSE, FALSE } ,
           { TRUE,  FALSE, FALSE, FALSE, FALSE, FALSE } };
     
-    GSList *p;
     flom_lock_mode_t old_lock;
-    int can_lock = TRUE;
     
+    for (old_lock = FLOM_LOCK_MODE_NL; old_lock < FLOM_LOCK_MODE_N;
+         ++old_lock) {
+        if (0 == counts[old_lock])
+            continue;
+        FLOM_TRACE(("flom_resource_hier_can_lock_counts: current_lock=%d "
+                    "(%u holders), asked_lock=%d, lock_table[%d][%d]=%d\n",
+                    old_lock, counts[old_lock], lock, old_lock, lock,
+                    lock_table[old_lock][lock]));
+        if (!lock_table[old_lock][lock])
+            return FALSE;
+    } /* for (old_lock ... */
+    return TRUE;
+}
+
+
+
+int flom_resource_hier_can_lock(struct flom_rsrc_data_hier_element_s *node,
+                                flom_lock_mode_t lock, gchar **level_name)
+{
     FLOM_TRACE(("flom_resource_hier_can_lock: node->name='%s', "
                 "level_name='%s', checking lock=%d\n", node->name,
                 *level_name != NULL ? *level_name : FLOM_NULL_STRING, lock));
-    if (NULL != *level_name) {
-        if (g_strcmp0(*level_name, node->name)) {
-            FLOM_TRACE(("flom_resource_hier_can_lock: node->name is "
-                        "different than level_name, leaving...\n"));
-            return can_lock;
-        } /* if (g_strcmp0(*level_name, node->name)) */
-    } /* if (NULL != *level_name) */
-    /* check locks kept by all the holders of this level */
-    p = node->holders;
-    while (NULL != p) {
-        old_lock = ((struct flom_rsrc_conn_lock_s *)p->data)->info.lock_mode;
-        FLOM_TRACE(("flom_resource_hier_can_lock: current_lock=%d, "
-                    "asked_lock=%d, lock_table[%d][%d]=%d\n",
-                    old_lock, lock, old_lock, lock,
-                    lock_table[old_lock][lock]));
-        can_lock &= lock_table[old_lock][lock];
-        if (!can_lock)
-            break;
-        else
-            p = p->next;
-    } /* while (NULL != p) */
-    /* checking must go deeper? */
-    if (can_lock) {
-        guint i;
-        /* resource name levels are terminated, check the locks kept by
-           all leaves */
-        for (i=0; i<node->leaves->len; ++i) {
-            can_lock = flom_resource_hier_can_lock(
-                g_ptr_array_index(node->leaves, i), lock,
-                NULL == *level_name ? level_name : level_name+1);
-            if (!can_lock)
+    if (NULL == *level_name)
+        return flom_resource_hier_can_lock_counts(node->subtree_counts, lock);
+    if (g_strcmp0(*level_name, node->name)) {
+        FLOM_TRACE(("flom_resource_hier_can_lock: node->name is "
+                    "different than level_name, leaving...\n"));
+        return TRUE;
+    } /* if (g_strcmp0(*level_name, node->name)) */
+    while (TRUE) {
+        if (NULL == *(++level_name)) {
+            /* resource name levels are terminated, check the locks kept
+               by this level and by all the next ones */
+            return flom_resource_hier_can_lock_counts(
+                node->subtree_counts, lock);
+        }
+        /* check the locks kept at this level only */
+        if (!flom_resource_hier_can_lock_counts(node->holder_counts, lock))
+            return FALSE;
+        if (NULL == (node = g_hash_table_lookup(node->index, *level_name))) {
+            FLOM_TRACE(("flom_resource_hier_can_lock: level '%s' is not "
+                        "locked, leaving...\n", *level_name));
+            return TRUE;
+        }
+    } /* while (TRUE) */
+}
+
+
+
+int flom_resource_hier_element_new(
+    struct flom_rsrc_data_hier_element_s *father, const gchar *name,
+    struct flom_rsrc_data_hier_element_s **element)
+{
+    enum Exception { G_TRY_MALLOC_ERROR
+                     , G_STRDUP_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    struct flom_rsrc_data_hier_element_s *frdhe = NULL;
+    
+    FLOM_TRACE(("flom_resource_hier_element_new\n"));
+    TRY {
+        /* the holder counters are zeroed too */
+        if (NULL == (frdhe = (struct flom_rsrc_data_hier_element_s *)
+                     g_try_malloc0(
+                         sizeof(struct flom_rsrc_data_hier_element_s))))
+            THROW(G_TRY_MALLOC_ERROR);
+        if (NULL == (frdhe->name = g_strdup(name)))
+            THROW(G_STRDUP_ERROR);
+        frdhe->holders = NULL;
+        frdhe->index = g_hash_table_new(g_str_hash, g_str_equal);
+        frdhe->parent = father;
+        if (NULL != father) {
+            /* link father to this element */
+            g_hash_table_insert(father->index, frdhe->name, frdhe);
+        }
+        *element = frdhe;
+        frdhe = NULL;
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case G_TRY_MALLOC_ERROR:
+                ret_cod = FLOM_RC_G_TRY_MALLOC_ERROR;
+                break;
+            case G_STRDUP_ERROR:
+                ret_cod = FLOM_RC_G_STRDUP_ERROR;
                 break;
-        } /* for (i=0; i<node->leaves.len; ++i) */
-    } /* if (can_lock) */
-    return can_lock;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    if (NULL != frdhe)
+        g_free(frdhe);
+    FLOM_TRACE(("flom_resource_hier_element_new/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+void flom_resource_hier_count_holder(
+    struct flom_rsrc_data_hier_element_s *node, flom_lock_mode_t lock,
+    int added)
+{
+    FLOM_TRACE(("flom_resource_hier_count_holder: node->name='%s', "
+                "lock=%d, added=%d\n", node->name, lock, added));
+    if (added)
+        node->holder_counts[lock]++;
+    else
+        node->holder_counts[lock]--;
+    /* update the summaries from this level up to the root */
+    for (; NULL != node; node = node->parent) {
+        if (added)
+            node->subtree_counts[lock]++;
+        else
+            node->subtree_counts[lock]--;
+    } /* for (; NULL != node; node = node->parent) */
 }
 
 
@@ -111,96 +191,58 @@ int flom_resource_hier_add_locker(flom_resource_t *resource,
                                   struct flom_rsrc_conn_lock_s *cl,
                                   gchar **splitted_name)
 {
-    enum Exception { G_TRY_MALLOC_ERROR
-                     , G_STRDUP_ERROR
-                     , INTERNAL_ERROR
+    enum Exception { INTERNAL_ERROR
+                     , RESOURCE_HIER_ELEMENT_NEW_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     
     FLOM_TRACE(("flom_resource_hier_add_locker\n"));
     TRY {
         struct flom_rsrc_data_hier_element_s *node = resource->data.hier.root;
-        gchar **level_name;
-        int node_is_leaf = TRUE;
-        int continue_search = TRUE;
+        struct flom_rsrc_data_hier_element_s *leaf;
+        gchar **level_name = splitted_name;
 
         flom_resource_hier_trace(resource);
-        for (level_name=splitted_name; *level_name; ++level_name) {
-            node_is_leaf = TRUE;
-            FLOM_TRACE(("flom_resource_hier_add_locker: "
-                        "*level_name='%s', node->name='%s'\n",
-                        STRORNULL(*level_name), STRORNULL(node->name)));
-            if (continue_search && !g_strcmp0(*level_name, node->name)) {
-                /* go one level depth */
-                guint i;
-                continue_search = FALSE;
-                for (i=0; i<node->leaves->len; ++i) {
-                    struct flom_rsrc_data_hier_element_s *leaf =
-                        g_ptr_array_index(node->leaves, i);
-                    node_is_leaf = FALSE;
-                    FLOM_TRACE(("flom_resource_hier_add_locker: "
-                                "*(level_name+1)='%s', leaf->name='%s'\n",
-                                STRORNULL(*(level_name+1)),
-                                STRORNULL(leaf->name)));
-                    if (!g_strcmp0(*(level_name+1), leaf->name)) {
-                        node = leaf;
-                        continue_search = TRUE;
-                        break;
-                    } /* if (!g_strcmp0(*(level_name+1), leaf->name)) */
-                } /* for (i=0; i<node->leaves->len; ++i) */
-            } else {
-                break;
-            } /* if (!g_strcmp0(*level_name, node->name)) */
-        } /* for (level_name=splitted_name; *level_name; ++level_name) */
-
-        /* check if the tree must be expanded */
-        if (NULL != *level_name && TRUE == node_is_leaf) {
-            /* new resource is longer than previous ones, "node" points to
-               a leaf tree node and must be extended */
-            struct flom_rsrc_data_hier_element_s *frdhe;
-            for (; *level_name; ++level_name) {
-                FLOM_TRACE(("flom_resource_hier_add_locker: adding node "
-                            "*level_name='%s'\n", *level_name));
-                /* allocating a new leaf */
-                if (NULL == (frdhe = (struct flom_rsrc_data_hier_element_s *)
-                             g_try_malloc(
-                                 sizeof(struct flom_rsrc_data_hier_element_s))))
-                    THROW(G_TRY_MALLOC_ERROR);
-                if (NULL == (frdhe->name = g_strdup(*level_name)))
-                    THROW(G_STRDUP_ERROR);
-                frdhe->holders = NULL;
-                frdhe->leaves = g_ptr_array_new();
-                /* link father to this element */
-                g_ptr_array_add(node->leaves, frdhe);
-                node = frdhe;
-            } /* for (; *level_name; ++level_name) */
-        } else if (NULL != *level_name && FALSE == node_is_leaf) {
-            /* this is an internal error that should never happen */
-            THROW(INTERNAL_ERROR);
+        if (NULL != *level_name) {
+            if (g_strcmp0(*level_name, node->name)) {
+                /* this is an internal error that should never happen */
+                FLOM_TRACE(("flom_resource_hier_add_locker: "
+                            "*level_name='%s', node->name='%s'\n",
+                            *level_name, STRORNULL(node->name)));
+                THROW(INTERNAL_ERROR);
+            }
+            ++level_name;
         }
-        /* if (NULL == *level_name)
-           FALSE == node_is_leaf:
-           new resource is shorter than previous ones, "node" points to
-           a non leaf tree node
-           TRUE == node_is_leaf:
-           new resource is exactly matches a previous one, "node" points
-           to a leaf tree node */
+        /* go down the existing levels */
+        for (; *level_name; ++level_name) {
+            if (NULL == (leaf = g_hash_table_lookup(
+                             node->index, *level_name)))
+                break;
+            node = leaf;
+        } /* for (; *level_name; ++level_name) */
+        /* new resource is longer than previous ones, "node" points to
+           the deepest existing level and the tree must be extended */
+        for (; *level_name; ++level_name) {
+            FLOM_TRACE(("flom_resource_hier_add_locker: adding node "
+                        "*level_name='%s'\n", *level_name));
+            if (FLOM_RC_OK != (ret_cod = flom_resource_hier_element_new(
+                                   node, *level_name, &leaf)))
+                THROW(RESOURCE_HIER_ELEMENT_NEW_ERROR);
+            node = leaf;
+        } /* for (; *level_name; ++level_name) */
         node->holders = g_slist_prepend(node->holders, (gpointer)cl);
+        flom_resource_hier_count_holder(node, cl->info.lock_mode, TRUE);
 
         flom_resource_hier_trace(resource);
         
         THROW(NONE);
     } CATCH {
         switch (excp) {
-            case G_TRY_MALLOC_ERROR:
-                ret_cod = FLOM_RC_G_TRY_MALLOC_ERROR;
-                break;
-            case G_STRDUP_ERROR:
-                ret_cod = FLOM_RC_G_STRDUP_ERROR;
-                break;
             case INTERNAL_ERROR:
                 ret_cod = FLOM_RC_INTERNAL_ERROR;
                 break;
+            case RESOURCE_HIER_ELEMENT_NEW_ERROR:
+                break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
                 break;
@@ -219,10 +261,9 @@ int flom_resource_hier_init(flom_resource_t *resource,
                             const gchar *name)
 {
     enum Exception { INVALID_RESOURCE_NAME
-                     , G_STRDUP_ERROR1
+                     , G_STRDUP_ERROR
                      , G_STRSPLIT_ERROR
-                     , G_TRY_MALLOC_ERROR
-                     , G_STRDUP_ERROR2
+                     , RESOURCE_HIER_ELEMENT_NEW_ERROR
                      , G_QUEUE_NEW_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
@@ -243,7 +284,7 @@ int flom_resource_hier_init(flom_resource_t *resource,
         }
             
         if (NULL == (resource->name = g_strdup(name)))
-            THROW(G_STRDUP_ERROR1);
+            THROW(G_STRDUP_ERROR);
         FLOM_TRACE(("flom_resource_hier_init: initializing resource ('%s')\n",
                     resource->name));
         /* prepare splitted name */
@@ -256,24 +297,15 @@ int flom_resource_hier_init(flom_resource_t *resource,
             struct flom_rsrc_data_hier_element_s *frdhe;
             FLOM_TRACE(("flom_resource_hier_init: level %d is '%s'\n",
                         i, *level_name));
-            /* allocating a new leaf */
-            if (NULL == (frdhe = (struct flom_rsrc_data_hier_element_s *)
-                         g_try_malloc(
-                             sizeof(struct flom_rsrc_data_hier_element_s))))
-                THROW(G_TRY_MALLOC_ERROR);
-            if (NULL == (frdhe->name = g_strdup(*level_name)))
-                THROW(G_STRDUP_ERROR2);
-            frdhe->holders = NULL;
-            frdhe->leaves = g_ptr_array_new();
+            /* allocating a new leaf linked to its father */
+            if (FLOM_RC_OK != (ret_cod = flom_resource_hier_element_new(
+                                   father, *level_name, &frdhe)))
+                THROW(RESOURCE_HIER_ELEMENT_NEW_ERROR);
             if (!i) {
                 /* link root to this element */
                 resource->data.hier.root = frdhe;
-                father = frdhe;
-            } else {
-                /* link father to this element */
-                g_ptr_array_add(father->leaves, frdhe);
-                father = frdhe;
             }
+            father = frdhe;
             i++;
         } /* for (name = ... */
         if (NULL == (resource->data.hier.waitings = g_queue_new()))
@@ -285,17 +317,13 @@ int flom_resource_hier_init(flom_resource_t *resource,
             case INVALID_RESOURCE_NAME:
                 ret_cod = FLOM_RC_INVALID_RESOURCE_NAME;
                 break;
-            case G_STRDUP_ERROR1:
+            case G_STRDUP_ERROR:
                 ret_cod = FLOM_RC_G_STRDUP_ERROR;
                 break;
             case G_STRSPLIT_ERROR:
                 ret_cod = FLOM_RC_G_STRSPLIT_ERROR;
                 break;
-            case G_TRY_MALLOC_ERROR:
-                ret_cod = FLOM_RC_G_TRY_MALLOC_ERROR;
-                break;
-            case G_STRDUP_ERROR2:
-                ret_cod = FLOM_RC_G_STRDUP_ERROR;
+            case RESOURCE_HIER_ELEMENT_NEW_ERROR:
                 break;
             case G_QUEUE_NEW_ERROR:
                 ret_cod = FLOM_RC_G_QUEUE_NEW_ERROR;
@@ -550,37 +578,21 @@ int flom_resource_hier_inmsg(flom_resource_t *resource,
 void flom_resource_hier_gc(
     struct flom_rsrc_data_hier_element_s *element)
 {
-    guint i;
-
-    /* scan leaves before */
-    if (NULL != element->leaves) {
-        FLOM_TRACE(("flom_resource_hier_gc: element '%s' has %u children\n",
-                    element->name, element->leaves->len));
-        i = 0;
-        while (i<element->leaves->len) {
-            struct flom_rsrc_data_hier_element_s *child =
-                g_ptr_array_index(element->leaves, i);
-            flom_resource_hier_gc(child);
-            /* check if the leaf is really a leaf or an internal node */
-            if (NULL == child->leaves || 0 == child->leaves->len) {
-                FLOM_TRACE(("flom_resource_hier_gc: child '%s' is a terminal "
-                            "node (a leaf) with holders=%p\n",
-                            child->name, child->holders));
-                if (NULL == child->holders) {
-                    FLOM_TRACE(("flom_resource_hier_gc: releasing leaf '%s'\n",
-                                child->name));
-                    g_free(child->name);
-                    child->name = NULL;
-                    if (NULL != child->leaves)
-                        g_ptr_array_free(child->leaves, TRUE);
-                    g_ptr_array_remove_index(element->leaves, i);
-                    g_free(child);
-                    continue;
-                } /* if (NULL == node->holders) */
-            } /* if (NULL == node->leaves || 0 == node->leaves->len) */
-            i++;
-        } /* while (i<element->leaves.len) */
-    } /* if (NULL != element->leaves) */
+    /* the root element is never released */
+    while (NULL != element->parent) {
+        struct flom_rsrc_data_hier_element_s *father = element->parent;
+        /* check if the element is really a leaf without holders */
+        if (0 != g_hash_table_size(element->index) ||
+            NULL != element->holders)
+            break;
+        FLOM_TRACE(("flom_resource_hier_gc: releasing leaf '%s'\n",
+                    element->name));
+        g_hash_table_remove(father->index, element->name);
+        g_hash_table_destroy(element->index);
+        g_free(element->name);
+        g_free(element);
+        element = father;
+    } /* while (NULL != element->parent) */
 }
     
 
@@ -593,7 +605,6 @@ int flom_resource_hier_clean(flom_resource_t *resource,
                      , G_STRSPLIT_ERROR
                      , INVALID_RESOURCE_NAME
                      , HIER_WAITINGS_ERROR
-                     , INTERNAL_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     
@@ -618,38 +629,21 @@ int flom_resource_hier_clean(flom_resource_t *resource,
             THROW(G_STRSPLIT_ERROR);
         /* search leaf node for this resource name */
         node = resource->data.hier.root;
-        for (level_name = splitted_name; *level_name; ++level_name) {
-            FLOM_TRACE(("flom_resource_hier_clean: *level_name='%s', "
-                        "node->name='%s'\n", STRORNULL(*level_name),
-                        STRORNULL(node->name)));
-            if (!g_strcmp0(*level_name, node->name)) {
-                /* go one level depth */
-                guint i;
-                int found = FALSE;
-                for (i=0; i<node->leaves->len; ++i) {
-                    struct flom_rsrc_data_hier_element_s *leaf =
-                        g_ptr_array_index(node->leaves, i);
-                    FLOM_TRACE(("flom_resource_hier_clean: "
-                                "*(level_name+1)='%s', leaf->name='%s'\n",
-                                STRORNULL(*(level_name+1)),
-                                STRORNULL(leaf->name)));
-                    if (!g_strcmp0(*(level_name+1), leaf->name)) {
-                        node = leaf;
-                        found = TRUE;
-                        FLOM_TRACE(("flom_resource_hier_clean: "
-                                    "*(level_name+1)==leaf->name\n"));
-                        break;
-                    } /* if (!g_strcmp0(*(level_name+1), leaf->name)) */
-                } /* for (i=0; i<node->leaves->len; ++i) */
-                if (!found && NULL != *(level_name+1)) {
+        level_name = splitted_name;
+        if (NULL != *level_name && !g_strcmp0(*level_name, node->name)) {
+            for (++level_name; *level_name; ++level_name) {
+                struct flom_rsrc_data_hier_element_s *leaf =
+                    g_hash_table_lookup(node->index, *level_name);
+                if (NULL == leaf) {
                     FLOM_TRACE(("flom_resource_hier_clean: unable to locate "
                                 "node for resource level '%s', it was "
                                 "probably already cleaned-up\n",
-                                STRORNULL(*(level_name+1))));
+                                *level_name));
                     break;
                 }
-            } /* if (!g_strcmp0(*level_name, node->name)) */
-        } /* for (level_name = splitted_name; *level_name; ++level_name) */
+                node = leaf;
+            } /* for (++level_name; *level_name; ++level_name) */
+        }
         assert(NULL != node);
         /* check if the connection keeps a lock */
         p = node->holders;
@@ -667,6 +661,7 @@ int flom_resource_hier_clean(flom_resource_t *resource,
                         cl->info.lock_mode));
             FLOM_TRACE(("flom_resource_hier_clean: cl=%p\n", cl));
             node->holders = g_slist_remove(node->holders, cl);
+            flom_resource_hier_count_holder(node, cl->info.lock_mode, FALSE);
             /* free the now useless connection lock record */
             flom_rsrc_conn_lock_delete(cl);
             /* check if some other clients can get a lock now */
@@ -674,32 +669,20 @@ int flom_resource_hier_clean(flom_resource_t *resource,
                                    resource)))
                 THROW(HIER_WAITINGS_ERROR);
         } else {
-            guint i = 0;
+            GList *w;
             /* check if the connection was waiting a lock */
-            do {
+            if (NULL != (w = flom_rsrc_waitings_find(
+                             resource->data.hier.waitings, conn))) {
                 struct flom_rsrc_conn_lock_s *cl =
-                    (struct flom_rsrc_conn_lock_s *)
-                    g_queue_peek_nth(resource->data.hier.waitings, i);
-                if (NULL == cl)
-                    break;
-                if (cl->conn == conn) {
-                    /* remove from waitings */
-                    FLOM_TRACE(("flom_resource_hier_clean: the client is "
-                                "waiting for a lock mode %d, removing "
-                                "it...\n", cl->info.lock_mode));
-                    cl = g_queue_pop_nth(resource->data.hier.waitings, i);
-                    if (NULL == cl) {
-                        /* this should be impossibile because peek was ok
-                           some rows above */
-                        THROW(INTERNAL_ERROR);
-                    } else {
-                        /* free the now useless connection lock record */
-                        flom_rsrc_conn_lock_delete(cl);
-                    }
-                    break;
-                } else
-                    ++i;
-            } while (TRUE);
+                    (struct flom_rsrc_conn_lock_s *)w->data;
+                /* remove from waitings */
+                FLOM_TRACE(("flom_resource_hier_clean: the client is "
+                            "waiting for a lock mode %d, removing "
+                            "it...\n", cl->info.lock_mode));
+                g_queue_delete_link(resource->data.hier.waitings, w);
+                /* free the now useless connection lock record */
+                flom_rsrc_conn_lock_delete(cl);
+            }
         } /* if (NULL != p) */
         FLOM_TRACE(("flom_resource_hier_clean: node->holders=%p\n",
                     node->holders));
@@ -712,7 +695,7 @@ int flom_resource_hier_clean(flom_resource_t *resource,
                         "holder connection\n"));
         }                  
         /* calling garbage collector */
-        flom_resource_hier_gc(resource->data.hier.root);
+        flom_resource_hier_gc(node);
         flom_resource_hier_trace(resource);
                 
         THROW(NONE);
@@ -729,9 +712,6 @@ int flom_resource_hier_clean(flom_resource_t *resource,
                 break;
             case HIER_WAITINGS_ERROR:
                 break;
-            case INTERNAL_ERROR:
-                ret_cod = FLOM_RC_INTERNAL_ERROR;
-                break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
                 break;
@@ -778,18 +758,18 @@ void flom_resource_hier_free(flom_resource_t *resource)
 void flom_resource_hier_free_element(
     struct flom_rsrc_data_hier_element_s *element)
 {
-    guint i;
+    GHashTableIter iter;
+    gpointer leaf;
 
     FLOM_TRACE(("flom_resource_hier_free_element: diving the tree...\n"));
-    /* scan leaves and free them before */
-    if (NULL != element->leaves) {
-        for (i=0; i<element->leaves->len; ++i) {
-            flom_resource_hier_free_element(
-                g_ptr_array_index(element->leaves, i));
-            g_free(g_ptr_array_index(element->leaves, i));
-        } /* for (i=0; i<element->leaves.len; ++i) */
-    } /* if (NULL != element->leaves) */
-    g_ptr_array_free(element->leaves, TRUE);
+    /* scan leaves and free them before: the keys of the index are not
+       used after the names have been released */
+    g_hash_table_iter_init(&iter, element->index);
+    while (g_hash_table_iter_next(&iter, NULL, &leaf)) {
+        flom_resource_hier_free_element(leaf);
+        g_free(leaf);
+    } /* while (g_hash_table_iter_next(&iter, NULL, &leaf)) */
+    g_hash_table_destroy(element->index);
 
     FLOM_TRACE(("flom_resource_hier_free_element: cleaning element '%s'\n",
                 element->name));    
@@ -889,10 +869,7 @@ int flom_resource_hier_waitings(flom_resource_t *resource)
 {
     enum Exception { G_STRSPLIT_ERROR
                      , RESOURCE_HIER_ADD_LOCKER_ERROR
-                     , MSG_BUILD_ANSWER_ERROR
-                     , MSG_SERIALIZE_ERROR
-                     , MSG_SEND_ERROR
-                     , MSG_FREE_ERROR
+                     , CONN_SEND_ANSWER_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     struct flom_rsrc_conn_lock_s *cl = NULL;
@@ -900,21 +877,13 @@ int flom_resource_hier_waitings(flom_resource_t *resource)
     
     FLOM_TRACE(("flom_resource_hier_waitings\n"));
     TRY {
-        guint i = 0;
-        struct flom_msg_s msg;
-        char buffer[FLOM_NETWORK_BUFFER_SIZE];
-        size_t to_send;
+        GList *w = resource->data.hier.waitings->head;
         size_t sep_len = strlen(FLOM_HIER_RESOURCE_SEPARATOR);
         
         /* check if there is any connection waiting for a lock */
-        do {
-            cl = (struct flom_rsrc_conn_lock_s *)
-                g_queue_peek_nth(resource->data.hier.waitings, i);
-            if (NULL == cl) {
-                FLOM_TRACE(("flom_resource_hier_waitings: NULL cl for "
-                            "i=%u\n", i));
-                break;
-            }
+        while (NULL != w) {
+            GList *next = w->next;
+            cl = (struct flom_rsrc_conn_lock_s *)w->data;
             assert(NULL != cl->name);
             /* prepare splitted resource name */
             if (NULL == (splitted_name = g_strsplit(
@@ -926,30 +895,17 @@ int flom_resource_hier_waitings(flom_resource_t *resource)
                     resource->data.hier.root, cl->info.lock_mode,
                     splitted_name)) {
                 /* remove from waitings */
-                cl = g_queue_pop_nth(resource->data.hier.waitings, i);
-                /* this should be impossibile because peek was ok
-                   some rows above */
-                assert(NULL != cl);
+                g_queue_delete_link(resource->data.hier.waitings, w);
                 if (FLOM_RC_OK != (
                         ret_cod = flom_resource_hier_add_locker(
                             resource, cl, splitted_name)))
                     THROW(RESOURCE_HIER_ADD_LOCKER_ERROR);
                 /* send a message to the client that is waiting the lock */
-                flom_msg_init(&msg);
-                if (FLOM_RC_OK != (ret_cod = flom_msg_build_answer(
-                                       &msg, FLOM_MSG_VERB_LOCK,
-                                       3*FLOM_MSG_STEP_INCR,
-                                       FLOM_RC_OK, NULL)))
-                    THROW(MSG_BUILD_ANSWER_ERROR);
-                if (FLOM_RC_OK != (
-                        ret_cod = flom_msg_serialize(
-                            &msg, buffer, sizeof(buffer), &to_send)))
-                    THROW(MSG_SERIALIZE_ERROR);
-                flom_msg_trace(&msg);
-                if (FLOM_RC_OK != (ret_cod = flom_conn_send(
-                                       cl->conn, buffer, to_send)))
-                    THROW(MSG_SEND_ERROR);
-                flom_conn_set_last_step(cl->conn, msg.header.pvs.step);
+                if (FLOM_RC_OK != (ret_cod = flom_conn_send_answer(
+                                       cl->conn, FLOM_MSG_VERB_LOCK,
+                                       3*FLOM_MSG_STEP_INCR, FLOM_RC_OK)))
+                    THROW(CONN_SEND_ANSWER_ERROR);
+                flom_conn_set_last_step(cl->conn, 3*FLOM_MSG_STEP_INCR);
                 /* propagate the info to the VFS ram tree */
                 if (FLOM_RC_OK != (
                         ret_cod = flom_vfs_ram_tree_move_locker_conn(
@@ -960,13 +916,11 @@ int flom_resource_hier_waitings(flom_resource_t *resource)
                                 cl->conn->uid));
                 }
                 cl = NULL;
-                if (FLOM_RC_OK != (ret_cod = flom_msg_free(&msg)))
-                    THROW(MSG_FREE_ERROR);                
-            } else
-                ++i;
+            }
             g_strfreev(splitted_name);
             splitted_name = NULL;
-        } while (TRUE);
+            w = next;
+        } /* while (NULL != w) */
         
         THROW(NONE);
     } CATCH {
@@ -975,10 +929,7 @@ int flom_resource_hier_waitings(flom_resource_t *resource)
                 ret_cod = FLOM_RC_G_STRSPLIT_ERROR;
                 break;
             case RESOURCE_HIER_ADD_LOCKER_ERROR:
-            case MSG_BUILD_ANSWER_ERROR:
-            case MSG_SERIALIZE_ERROR:
-            case MSG_SEND_ERROR:
-            case MSG_FREE_ERROR:
+            case CONN_SEND_ANSWER_ERROR:
                 break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
@@ -1018,9 +969,11 @@ void flom_resource_hier_trace(const flom_resource_t *resource)
 void flom_resource_hier_trace_node(
     struct flom_rsrc_data_hier_element_s *node, int level)
 {
-    int leaf_id, holders;
+    int holders;
     char *tabs;
     GSList *p;
+    GHashTableIter iter;
+    gpointer leaf;
 
     switch (level) {
         case 0: tabs = ""; break;
@@ -1046,9 +999,7 @@ void flom_resource_hier_trace_node(
     FLOM_TRACE(("flom_resource_hier_trace_node: %s%s%s (holders=%d)\n",
                 tabs, FLOM_HIER_RESOURCE_SEPARATOR, node->name, holders));
     /* looping on all leafs */
-    for (leaf_id=0; leaf_id<node->leaves->len; ++leaf_id) {
-        struct flom_rsrc_data_hier_element_s *leaf =
-            g_ptr_array_index(node->leaves, leaf_id);
+    g_hash_table_iter_init(&iter, node->index);
+    while (g_hash_table_iter_next(&iter, NULL, &leaf))
         flom_resource_hier_trace_node(leaf, level+1);
-    } /* for (leaf_id=0; leaf_id<node->leaves->len; ++leaf_id) */
 }
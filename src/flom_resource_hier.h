@@ -45,7 +45,21 @@
 extern "C" {
 #endif /* __cplusplus */
     /**
-     * Check if a lock can be granted on a resource
+     * Check if a lock mode is compatible with the holders counted for
+     * every lock mode
+     * @param counts IN array of @ref FLOM_LOCK_MODE_N holder counters
+     * @param lock IN lock mode to check
+     * @return a boolean value
+     */
+    int flom_resource_hier_can_lock_counts(const guint *counts,
+                                           flom_lock_mode_t lock);
+
+
+
+    /**
+     * Check if a lock can be granted on a resource: the levels of the name
+     * are followed from the root and the last one is checked with the
+     * summary of its subtree
      * @param node IN reference to root node of a resource
      * @param lock IN lock mode to check
      * @param level_name IN a pointer to the current level part of the name
@@ -56,6 +70,33 @@ extern "C" {
 
 
 
+    /**
+     * Create a new element of the tree and link it to its father
+     * @param father IN/OUT previous level element, NULL for the root
+     * @param name IN name of the level
+     * @param element OUT the new element
+     * @return a reason code
+     */
+    int flom_resource_hier_element_new(
+        struct flom_rsrc_data_hier_element_s *father, const gchar *name,
+        struct flom_rsrc_data_hier_element_s **element);
+
+
+
+    /**
+     * Update the holder counters of an element and the subtree summaries
+     * of the element and of all its ancestors
+     * @param node IN/OUT element that got or lost a holder
+     * @param lock IN lock mode of the holder
+     * @param added IN TRUE if the holder has been added, FALSE if it has
+     *        been removed
+     */
+    void flom_resource_hier_count_holder(
+        struct flom_rsrc_data_hier_element_s *node, flom_lock_mode_t lock,
+        int added);
+
+
+
     /**
      * Add a new locker to a resource
      * @param resource IN/OUT resource reference
@@ -113,7 +154,9 @@ extern "C" {
 
 
     /**
-     * Garbage collector: it removes useless leaves from the tree
+     * Garbage collector: it removes the element if it's a leaf without
+     * holders, then it goes on with its ancestors; the root is never
+     * removed
      * @param element IN/OUT tree element to free
      */
     void flom_resource_hier_gc(
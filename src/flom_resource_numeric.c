@@ -315,7 +315,6 @@ int flom_resource_numeric_clean(flom_resource_t *resource,
 {
     enum Exception { NULL_OBJECT
                      , NUMERIC_WAITINGS_ERROR
-                     , INTERNAL_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     
@@ -354,32 +353,20 @@ int flom_resource_numeric_clean(flom_resource_t *resource,
                                    resource)))
                 THROW(NUMERIC_WAITINGS_ERROR);
         } else {
-            guint i = 0;
+            GList *w;
             /* check if the connection was waiting a lock */
-            do {
+            if (NULL != (w = flom_rsrc_waitings_find(
+                             resource->data.numeric.waitings, conn))) {
                 struct flom_rsrc_conn_lock_s *cl =
-                    (struct flom_rsrc_conn_lock_s *)
-                    g_queue_peek_nth(resource->data.numeric.waitings, i);
-                if (NULL == cl)
-                    break;
-                if (cl->conn == conn) {
-                    /* remove from waitings */
-                    FLOM_TRACE(("flom_resource_numeric_clean: the client is "
-                                "waiting for a lock with quantity %d, "
-                                "removing it...\n", cl->info.quantity));
-                    cl = g_queue_pop_nth(resource->data.numeric.waitings, i);
-                    if (NULL == cl) {
-                        /* this should be impossibile because peek was ok
-                           some rows above */
-                        THROW(INTERNAL_ERROR);
-                    } else {
-                        /* free the now useless connection lock record */
-                        flom_rsrc_conn_lock_delete(cl);
-                    }
-                    break;
-                } else
-                    ++i;
-            } while (TRUE);
+                    (struct flom_rsrc_conn_lock_s *)w->data;
+                /* remove from waitings */
+                FLOM_TRACE(("flom_resource_numeric_clean: the client is "
+                            "waiting for a lock with quantity %d, "
+                            "removing it...\n", cl->info.quantity));
+                g_queue_delete_link(resource->data.numeric.waitings, w);
+                /* free the now useless connection lock record */
+                flom_rsrc_conn_lock_delete(cl);
+            }
         } /* if (NULL != p) */
         /* propagate the info to the VFS ram tree */
         if (FLOM_RC_OK != (
@@ -398,9 +385,6 @@ int flom_resource_numeric_clean(flom_resource_t *resource,
                 break;
             case NUMERIC_WAITINGS_ERROR:
                 break;
-            case INTERNAL_ERROR:
-                ret_cod = FLOM_RC_INTERNAL_ERROR;
-                break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
                 break;
@@ -451,56 +435,32 @@ void flom_resource_numeric_free(flom_resource_t *resource)
 
 int flom_resource_numeric_waitings(flom_resource_t *resource)
 {
-    enum Exception { INTERNAL_ERROR
-                     , MSG_BUILD_ANSWER_ERROR
-                     , MSG_SERIALIZE_ERROR
-                     , MSG_SEND_ERROR
-                     , MSG_FREE_ERROR
+    enum Exception { CONN_SEND_ANSWER_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     struct flom_rsrc_conn_lock_s *cl = NULL;
     
     FLOM_TRACE(("flom_resource_numeric_waitings\n"));
     TRY {
-        guint i = 0;
-        struct flom_msg_s msg;
-        char buffer[FLOM_NETWORK_BUFFER_SIZE];
-        size_t to_send;
+        GList *w = resource->data.numeric.waitings->head;
         
         /* check if there is any connection waiting for a lock */
-        do {
-            cl = (struct flom_rsrc_conn_lock_s *)
-                g_queue_peek_nth(resource->data.numeric.waitings, i);
-            if (NULL == cl)
-                break;
+        while (NULL != w) {
+            GList *next = w->next;
+            cl = (struct flom_rsrc_conn_lock_s *)w->data;
             /* try to apply this lock... */
             if (flom_resource_numeric_can_lock(resource, cl->info.quantity)) {
                 /* remove from waitings */
-                cl = g_queue_pop_nth(resource->data.numeric.waitings, i);
-                if (NULL == cl)
-                    /* this should be impossibile because peek was ok
-                       some rows above */
-                    THROW(INTERNAL_ERROR);
+                g_queue_delete_link(resource->data.numeric.waitings, w);
                 FLOM_TRACE(("flom_resource_numeric_waitings: asked lock "
                             "quantity %d can be assigned to connection "
                             "%p\n", cl->info.quantity, cl->conn));
                 /* send a message to the client that's waiting the lock */
-                flom_msg_init(&msg);
-                if (FLOM_RC_OK != (ret_cod = flom_msg_build_answer(
-                                       &msg, FLOM_MSG_VERB_LOCK,
-                                       3*FLOM_MSG_STEP_INCR,
-                                       FLOM_RC_OK, NULL)))
-                    THROW(MSG_BUILD_ANSWER_ERROR);
-                if (FLOM_RC_OK != (
-                        ret_cod = flom_msg_serialize(
-                            &msg, buffer, sizeof(buffer), &to_send)))
-                    THROW(MSG_SERIALIZE_ERROR);
-                if (FLOM_RC_OK != (ret_cod = flom_conn_send(
-                                       cl->conn, buffer, to_send)))
-                    THROW(MSG_SEND_ERROR);
-                flom_conn_set_last_step(cl->conn, msg.header.pvs.step);
-                if (FLOM_RC_OK != (ret_cod = flom_msg_free(&msg)))
-                    THROW(MSG_FREE_ERROR);                
+                if (FLOM_RC_OK != (ret_cod = flom_conn_send_answer(
+                                       cl->conn, FLOM_MSG_VERB_LOCK,
+                                       3*FLOM_MSG_STEP_INCR, FLOM_RC_OK)))
+                    THROW(CONN_SEND_ANSWER_ERROR);
+                flom_conn_set_last_step(cl->conn, 3*FLOM_MSG_STEP_INCR);
                 /* insert into holders */
                 resource->data.numeric.holders = g_slist_prepend(
                     resource->data.numeric.holders,
@@ -516,20 +476,14 @@ int flom_resource_numeric_waitings(flom_resource_t *resource)
                                 cl->conn->uid));
                 }
                 cl = NULL;
-            } else
-                ++i;
-        } while (TRUE);
+            }
+            w = next;
+        } /* while (NULL != w) */
         
         THROW(NONE);
     } CATCH {
         switch (excp) {
-            case INTERNAL_ERROR:
-                ret_cod = FLOM_RC_INTERNAL_ERROR;
-                break;
-            case MSG_BUILD_ANSWER_ERROR:
-            case MSG_SERIALIZE_ERROR:
-            case MSG_SEND_ERROR:
-            case MSG_FREE_ERROR:
+            case CONN_SEND_ANSWER_ERROR:
                 break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
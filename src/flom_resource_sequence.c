@@ -355,7 +355,6 @@ int flom_resource_sequence_clean(flom_resource_t *resource,
 {
     enum Exception { NULL_OBJECT
                      , SEQUENCE_WAITINGS_ERROR
-                     , INTERNAL_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     
@@ -391,31 +390,19 @@ int flom_resource_sequence_clean(flom_resource_t *resource,
                                    resource, locker_uid)))
                 THROW(SEQUENCE_WAITINGS_ERROR);
         } else {
-            guint i = 0;
+            GList *w;
             /* check if the connection was waiting a lock */
-            do {
+            if (NULL != (w = flom_rsrc_waitings_find(
+                             resource->data.sequence.waitings, conn))) {
                 struct flom_rsrc_conn_lock_s *cl =
-                    (struct flom_rsrc_conn_lock_s *)
-                    g_queue_peek_nth(resource->data.sequence.waitings, i);
-                if (NULL == cl)
-                    break;
-                if (cl->conn == conn) {
-                    /* remove from waitings */
-                    FLOM_TRACE(("flom_resource_sequence_clean: the client is "
-                                "waiting for a lock, removing it...\n"));
-                    cl = g_queue_pop_nth(resource->data.sequence.waitings, i);
-                    if (NULL == cl) {
-                        /* this should be impossibile because peek was ok
-                           some rows above */
-                        THROW(INTERNAL_ERROR);
-                    } else {
-                        /* free the now useless connection lock record */
-                        flom_rsrc_conn_lock_delete(cl);
-                    }
-                    break;
-                } else
-                    ++i;
-            } while (TRUE);
+                    (struct flom_rsrc_conn_lock_s *)w->data;
+                /* remove from waitings */
+                FLOM_TRACE(("flom_resource_sequence_clean: the client is "
+                            "waiting for a lock, removing it...\n"));
+                g_queue_delete_link(resource->data.sequence.waitings, w);
+                /* free the now useless connection lock record */
+                flom_rsrc_conn_lock_delete(cl);
+            }
         } /* if (NULL != p) */
         /* propagate the info to the VFS ram tree */
         if (FLOM_RC_OK != (
@@ -434,9 +421,6 @@ int flom_resource_sequence_clean(flom_resource_t *resource,
                 break;
             case SEQUENCE_WAITINGS_ERROR:
                 break;
-            case INTERNAL_ERROR:
-                ret_cod = FLOM_RC_INTERNAL_ERROR;
-                break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
                 break;
@@ -495,8 +479,7 @@ void flom_resource_sequence_free(flom_resource_t *resource)
 int flom_resource_sequence_waitings(flom_resource_t *resource,
                                     flom_uid_t locker_uid)
 {
-    enum Exception { INTERNAL_ERROR
-                     , MSG_BUILD_ANSWER_ERROR
+    enum Exception { MSG_BUILD_ANSWER_ERROR
                      , MSG_SERIALIZE_ERROR
                      , MSG_SEND_ERROR
                      , MSG_FREE_ERROR
@@ -506,26 +489,20 @@ int flom_resource_sequence_waitings(flom_resource_t *resource,
     
     FLOM_TRACE(("flom_resource_sequence_waitings\n"));
     TRY {
-        guint i = 0;
+        GList *w = resource->data.sequence.waitings->head;
         struct flom_msg_s msg;
         char buffer[FLOM_NETWORK_BUFFER_SIZE];
         size_t to_send;
         gchar element[40]; /* it must contain a guint */
         
         /* check if there is any connection waiting for a lock */
-        do {
-            cl = (struct flom_rsrc_conn_lock_s *)
-                g_queue_peek_nth(resource->data.sequence.waitings, i);
-            if (NULL == cl)
-                break;
+        while (NULL != w) {
+            GList *next = w->next;
+            cl = (struct flom_rsrc_conn_lock_s *)w->data;
             /* try to apply this lock... */
             if (flom_resource_sequence_can_lock(resource)) {
                 /* remove from waitings */
-                cl = g_queue_pop_nth(resource->data.sequence.waitings, i);
-                if (NULL == cl)
-                    /* this should be impossibile because peek was ok
-                       some rows above */
-                    THROW(INTERNAL_ERROR);
+                g_queue_delete_link(resource->data.sequence.waitings, w);
                 FLOM_TRACE(("flom_resource_sequence_waitings: asked lock "
                             "can be assigned to connection %p\n",
                             cl->conn));
@@ -540,6 +517,7 @@ int flom_resource_sequence_waitings(flom_resource_t *resource,
                                        3*FLOM_MSG_STEP_INCR,
                                        FLOM_RC_OK, element)))
                     THROW(MSG_BUILD_ANSWER_ERROR);
+                msg.header.level = flom_conn_get_level(cl->conn);
                 if (FLOM_RC_OK != (
                         ret_cod = flom_msg_serialize(
                             &msg, buffer, sizeof(buffer), &to_send)))
@@ -577,16 +555,13 @@ int flom_resource_sequence_waitings(flom_resource_t *resource,
                                 cl->conn->uid));
                 }
                 cl = NULL;
-            } else
-                ++i;
-        } while (TRUE);
+            }
+            w = next;
+        } /* while (NULL != w) */
         
         THROW(NONE);
     } CATCH {
         switch (excp) {
-            case INTERNAL_ERROR:
-                ret_cod = FLOM_RC_INTERNAL_ERROR;
-                break;
             case MSG_BUILD_ANSWER_ERROR:
             case MSG_SERIALIZE_ERROR:
             case MSG_SEND_ERROR:
@@ -48,26 +48,66 @@
 
 int flom_resource_set_can_lock(flom_resource_t *resource, guint *element)
 {
-    guint i;
-    int found = FALSE;
+    gulong *free_map = resource->data.set.free_map;
+    guint words = (resource->data.set.elements->len +
+                   FLOM_RSRC_SET_MAP_BITS - 1) / FLOM_RSRC_SET_MAP_BITS;
+    guint first, i;
+    gint bit;
     
-    FLOM_TRACE(("flom_resource_set_can_lock\n"));
-    /* loop around elements starting from the index element */
-    for (i=0; i<resource->data.set.elements->len; ++i) {
-        /* i loops between 0 and len-1
-           j loops between index and index-1 traversing len-1 and 0 */
-        guint j = (i + resource->data.set.index) %
-            resource->data.set.elements->len;
-        struct flom_rsrc_data_set_element_s *rdse =
-            &g_array_index(resource->data.set.elements,
-                           struct flom_rsrc_data_set_element_s, j);
-        if (NULL == rdse->conn) {
-            *element = j;
-            found = TRUE;
-            break;
-        }
-    } /* for i */
-    return found;
+    FLOM_TRACE(("flom_resource_set_can_lock: free_number=%u\n",
+                resource->data.set.free_number));
+    if (0 == resource->data.set.free_number)
+        return FALSE;
+    /* look for an available element starting from the index element:
+       the word of the index is checked from the index bit before, then
+       the following words are checked wrapping around the end of the
+       map, at last the bits of the first word before the index */
+    first = resource->data.set.index / FLOM_RSRC_SET_MAP_BITS;
+    bit = g_bit_nth_lsf(free_map[first],
+                        (gint)(resource->data.set.index %
+                               FLOM_RSRC_SET_MAP_BITS) - 1);
+    for (i=1; -1 == bit && i<=words; ++i) {
+        first = (first + 1) % words;
+        bit = g_bit_nth_lsf(free_map[first], -1);
+    } /* for (i=1; -1 == bit && i<=words; ++i) */
+    if (-1 == bit)
+        return FALSE;
+    *element = first * FLOM_RSRC_SET_MAP_BITS + bit;
+    return TRUE;
+}
+
+
+
+void flom_resource_set_assign(flom_resource_t *resource, guint element,
+                              flom_conn_t *conn)
+{
+    struct flom_rsrc_data_set_element_s *rdse =
+        &g_array_index(resource->data.set.elements,
+                       struct flom_rsrc_data_set_element_s, element);
+    /* track locker connection */
+    rdse->conn = conn;
+    resource->data.set.free_map[element / FLOM_RSRC_SET_MAP_BITS] &=
+        ~(1UL << (element % FLOM_RSRC_SET_MAP_BITS));
+    resource->data.set.free_number--;
+    g_hash_table_insert(resource->data.set.holders, (gpointer)conn,
+                        GUINT_TO_POINTER(element));
+    /* move to next element for next locker (round robin) */
+    resource->data.set.index = (resource->data.set.index + 1) %
+        resource->data.set.elements->len;
+}
+
+
+
+void flom_resource_set_release(flom_resource_t *resource, guint element)
+{
+    struct flom_rsrc_data_set_element_s *rdse =
+        &g_array_index(resource->data.set.elements,
+                       struct flom_rsrc_data_set_element_s, element);
+    g_hash_table_remove(resource->data.set.holders, (gpointer)rdse->conn);
+    rdse->conn = NULL;
+    resource->data.set.free_map[element / FLOM_RSRC_SET_MAP_BITS] |=
+        1UL << (element % FLOM_RSRC_SET_MAP_BITS);
+    resource->data.set.free_number++;
 }
 
 
@@ -78,12 +118,15 @@ int flom_resource_set_init(flom_resource_t *resource,
     enum Exception { G_STRDUP_ERROR
                      , G_ARRAY_NEW_ERROR
                      , RSRC_GET_ELEMENTS_ERROR
+                     , G_TRY_MALLOC_ERROR
                      , G_QUEUE_NEW_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     
     FLOM_TRACE(("flom_resource_set_init\n"));
     TRY {
+        guint i, words;
+        
         if (NULL == (resource->name = g_strdup(name)))
             THROW(G_STRDUP_ERROR);
         FLOM_TRACE(("flom_resource_set_init: initialized resource ('%s')\n",
@@ -98,6 +141,18 @@ int flom_resource_set_init(flom_resource_t *resource,
                                name, resource->data.set.elements)))
             THROW(RSRC_GET_ELEMENTS_ERROR);
         resource->data.set.index = 0;
+        /* all the elements are available */
+        words = (resource->data.set.elements->len +
+                 FLOM_RSRC_SET_MAP_BITS - 1) / FLOM_RSRC_SET_MAP_BITS;
+        if (NULL == (resource->data.set.free_map = g_try_malloc0(
+                         (words > 0 ? words : 1) * sizeof(gulong))))
+            THROW(G_TRY_MALLOC_ERROR);
+        for (i=0; i<resource->data.set.elements->len; ++i)
+            resource->data.set.free_map[i / FLOM_RSRC_SET_MAP_BITS] |=
+                1UL << (i % FLOM_RSRC_SET_MAP_BITS);
+        resource->data.set.free_number = resource->data.set.elements->len;
+        resource->data.set.holders = g_hash_table_new(
+            g_direct_hash, g_direct_equal);
         if (NULL == (resource->data.set.waitings = g_queue_new()))
             THROW(G_QUEUE_NEW_ERROR);
 
@@ -112,6 +167,9 @@ int flom_resource_set_init(flom_resource_t *resource,
                 break;
             case RSRC_GET_ELEMENTS_ERROR:
                 break;
+            case G_TRY_MALLOC_ERROR:
+                ret_cod = FLOM_RC_G_TRY_MALLOC_ERROR;
+                break;
             case G_QUEUE_NEW_ERROR:
                 ret_cod = FLOM_RC_G_QUEUE_NEW_ERROR;
                 break;
@@ -173,10 +231,7 @@ int flom_resource_set_inmsg(flom_resource_t *resource,
                                 "can be assigned to connection %p\n",
                                 element, rdse->name, conn));
                     /* track locker connection */
-                    rdse->conn = conn;
-                    /* move to next element for next locker (round robin) */
-                    resource->data.set.index = (resource->data.set.index + 1) %
-                        resource->data.set.elements->len;
+                    flom_resource_set_assign(resource, element, conn);
                     /* retrieve the name of the peer (IP address) */
                     peer_name = flom_tcp_retrieve_peer_name(&conn->tcp);
                     /* propagate the info to the VFS ram tree */
@@ -314,65 +369,41 @@ int flom_resource_set_clean(flom_resource_t *resource,
 {
     enum Exception { NULL_OBJECT
                      , SET_WAITINGS_ERROR
-                     , INTERNAL_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     
     FLOM_TRACE(("flom_resource_set_clean\n"));
     TRY {
-        guint element;
-        int found = FALSE;
-        struct flom_rsrc_data_set_element_s *rdse = NULL;
+        gpointer element = NULL;
 
         if (NULL == resource)
             THROW(NULL_OBJECT);
         /* check if the connection keeps a lock */
-        for (element=0; element<resource->data.set.elements->len;
-             ++element) {
-            rdse = &g_array_index(resource->data.set.elements,
-                                  struct flom_rsrc_data_set_element_s,
-                                  element);
-            if (rdse->conn == conn) {
-                found = TRUE;
-                break;
-            }
-        } /* for (element=0; ... */
-        if (found) {
+        if (g_hash_table_lookup_extended(resource->data.set.holders,
+                                         (gpointer)conn, NULL, &element)) {
             FLOM_TRACE(("flom_resource_set_clean: the client is holding "
-                        "element %u ('%s'), removing connection %p from "
-                        "it...\n", element, rdse->name, conn));
-            rdse->conn = NULL;
+                        "element %u, removing connection %p from "
+                        "it...\n", GPOINTER_TO_UINT(element), conn));
+            flom_resource_set_release(resource, GPOINTER_TO_UINT(element));
             if (FLOM_RC_OK != (ret_cod = flom_resource_set_waitings(
                                    resource)))
                 THROW(SET_WAITINGS_ERROR);
         } else {
-            guint i = 0;
+            GList *w;
             /* check if the connection was waiting a lock */
-            do {
+            if (NULL != (w = flom_rsrc_waitings_find(
+                             resource->data.set.waitings, conn))) {
                 struct flom_rsrc_conn_lock_s *cl =
-                    (struct flom_rsrc_conn_lock_s *)
-                    g_queue_peek_nth(resource->data.set.waitings, i);
-                if (NULL == cl)
-                    break;
-                if (cl->conn == conn) {
-                    /* remove from waitings */
-                    FLOM_TRACE(("flom_resource_set_clean: the client is "
-                                "waiting to a lock an element, "
-                                "removing it...\n"));
-                    cl = g_queue_pop_nth(resource->data.set.waitings, i);
-                    if (NULL == cl) {
-                        /* this should be impossibile because peek was ok
-                           some rows above */
-                        THROW(INTERNAL_ERROR);
-                    } else {
-                        /* free the now useless connection lock record */
-                        flom_rsrc_conn_lock_delete(cl);
-                    }
-                    break;
-                } else
-                    ++i;
-            } while (TRUE);
-        } /* if (NULL != p) */
+                    (struct flom_rsrc_conn_lock_s *)w->data;
+                /* remove from waitings */
+                FLOM_TRACE(("flom_resource_set_clean: the client is "
+                            "waiting to a lock an element, "
+                            "removing it...\n"));
+                g_queue_delete_link(resource->data.set.waitings, w);
+                /* free the now useless connection lock record */
+                flom_rsrc_conn_lock_delete(cl);
+            }
+        } /* if (g_hash_table_lookup_extended(... */
         /* propagate the info to the VFS ram tree */
         if (FLOM_RC_OK != (
                 ret_cod = flom_vfs_ram_tree_del_conn(
@@ -390,9 +421,6 @@ int flom_resource_set_clean(flom_resource_t *resource,
                 break;
             case SET_WAITINGS_ERROR:
                 break;
-            case INTERNAL_ERROR:
-                ret_cod = FLOM_RC_INTERNAL_ERROR;
-                break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
                 break;
@@ -425,6 +453,12 @@ void flom_resource_set_free(flom_resource_t *resource)
     /* free array structure */
     g_array_free(resource->data.set.elements, TRUE);
     resource->data.set.elements = NULL;
+    g_free(resource->data.set.free_map);
+    resource->data.set.free_map = NULL;
+    resource->data.set.free_number = 0;
+    if (NULL != resource->data.set.holders)
+        g_hash_table_destroy(resource->data.set.holders);
+    resource->data.set.holders = NULL;
     /* clean-up waitings queue... */
     FLOM_TRACE(("flom_resource_set_free: cleaning-up waitings queue...\n"));
     while (!g_queue_is_empty(resource->data.set.waitings)) {
@@ -446,8 +480,7 @@ void flom_resource_set_free(flom_resource_t *resource)
 
 int flom_resource_set_waitings(flom_resource_t *resource)
 {
-    enum Exception { INTERNAL_ERROR
-                     , MSG_BUILD_ANSWER_ERROR
+    enum Exception { MSG_BUILD_ANSWER_ERROR
                      , MSG_SERIALIZE_ERROR
                      , MSG_SEND_ERROR
                      , MSG_FREE_ERROR
@@ -457,18 +490,16 @@ int flom_resource_set_waitings(flom_resource_t *resource)
     
     FLOM_TRACE(("flom_resource_set_waitings\n"));
     TRY {
-        guint i = 0;
+        GList *w = resource->data.set.waitings->head;
         struct flom_msg_s msg;
         char buffer[FLOM_NETWORK_BUFFER_SIZE];
         size_t to_send;
         
         /* check if there is any connection waiting for a lock */
-        do {
+        while (NULL != w) {
+            GList *next = w->next;
             guint element;
-            cl = (struct flom_rsrc_conn_lock_s *)
-                g_queue_peek_nth(resource->data.set.waitings, i);
-            if (NULL == cl)
-                break;
+            cl = (struct flom_rsrc_conn_lock_s *)w->data;
             /* try to apply this lock... */
             if (flom_resource_set_can_lock(resource, &element)) {
                 struct flom_rsrc_data_set_element_s *rdse =
@@ -476,11 +507,7 @@ int flom_resource_set_waitings(flom_resource_t *resource)
                                    struct flom_rsrc_data_set_element_s,
                                    element);
                 /* remove from waitings */
-                cl = g_queue_pop_nth(resource->data.set.waitings, i);
-                if (NULL == cl)
-                    /* this should be impossibile because peek was ok
-                       some rows above */
-                    THROW(INTERNAL_ERROR);
+                g_queue_delete_link(resource->data.set.waitings, w);
                 FLOM_TRACE(("flom_resource_set_waitings: element %u ('%s') "
                             "can be assigned to connection %p\n",
                             element, rdse->name, cl->conn));
@@ -491,6 +518,7 @@ int flom_resource_set_waitings(flom_resource_t *resource)
                                        3*FLOM_MSG_STEP_INCR,
                                        FLOM_RC_OK, rdse->name)))
                     THROW(MSG_BUILD_ANSWER_ERROR);
+                msg.header.level = flom_conn_get_level(cl->conn);
                 if (FLOM_RC_OK != (
                         ret_cod = flom_msg_serialize(
                             &msg, buffer, sizeof(buffer), &to_send)))
@@ -502,10 +530,7 @@ int flom_resource_set_waitings(flom_resource_t *resource)
                 if (FLOM_RC_OK != (ret_cod = flom_msg_free(&msg)))
                     THROW(MSG_FREE_ERROR);                
                 /* track locker connection */
-                rdse->conn = cl->conn;
-                /* move to next element for next locker (round robin) */
-                resource->data.set.index = (resource->data.set.index + 1) %
-                    resource->data.set.elements->len;
+                flom_resource_set_assign(resource, element, cl->conn);
                 /* propagate the info to the VFS ram tree */
                 if (FLOM_RC_OK != (
                         ret_cod = flom_vfs_ram_tree_move_locker_conn(
@@ -518,16 +543,13 @@ int flom_resource_set_waitings(flom_resource_t *resource)
                 /* free cl */
                 flom_rsrc_conn_lock_delete(cl);
                 cl = NULL;
-            } else
-                ++i;
-        } while (TRUE);
+            }
+            w = next;
+        } /* while (NULL != w) */
         
         THROW(NONE);
     } CATCH {
         switch (excp) {
-            case INTERNAL_ERROR:
-                ret_cod = FLOM_RC_INTERNAL_ERROR;
-                break;
             case MSG_BUILD_ANSWER_ERROR:
             case MSG_SERIALIZE_ERROR:
             case MSG_SEND_ERROR:
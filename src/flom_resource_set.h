@@ -48,7 +48,9 @@ extern "C" {
 
     
     /**
-     * Check if a lock can be granted on a resource
+     * Check if a lock can be granted on a resource: the first available
+     * element after the round robin index is searched in the bitmap of
+     * the available elements
      * @param resource IN reference to resource object
      * @param element OUT available for lock (if an element is available
      *        and the function return TRUE)
@@ -58,6 +60,27 @@ extern "C" {
                                    guint *element);
 
 
+
+    /**
+     * Assign an available element to a holder connection and move the
+     * round robin index to the next element
+     * @param resource IN/OUT reference to resource object
+     * @param element IN element that must be assigned
+     * @param conn IN connection of the holder
+     */
+    void flom_resource_set_assign(flom_resource_t *resource, guint element,
+                                  flom_conn_t *conn);
+
+
+
+    /**
+     * Make an element available again after its holder released it
+     * @param resource IN/OUT reference to resource object
+     * @param element IN element that must be released
+     */
+    void flom_resource_set_release(flom_resource_t *resource, guint element);
+
+
     
     /**
      * Initialize a new resource of type set
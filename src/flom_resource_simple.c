@@ -20,6 +20,9 @@
 
 
 
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
 #ifdef HAVE_GLIB_H
 # include <glib.h>
 #endif
@@ -58,29 +61,110 @@ int flom_resource_simple_can_lock(flom_resource_t *resource,
           { TRUE,  TRUE,  FALSE, FALSE, FALSE, FALSE } ,
           { TRUE,  FALSE, FALSE, FALSE, FALSE, FALSE } };
     
-    GSList *p = NULL;
     flom_lock_mode_t old_lock;
     int can_lock = TRUE;
     
     FLOM_TRACE(("flom_resource_simple_can_lock: checking lock=%d\n", lock));
-    p = resource->data.simple.holders;
-    while (NULL != p) {
-        old_lock = ((struct flom_rsrc_conn_lock_s *)p->data)->info.lock_mode;
-        FLOM_TRACE(("flom_resource_simple_can_lock: current_lock=%d, "
-                    "asked_lock=%d, lock_table[%d][%d]=%d\n",
-                    old_lock, lock, old_lock, lock,
-                    lock_table[old_lock][lock]));
+    /* a lock mode held by many connections is checked only once */
+    for (old_lock = FLOM_LOCK_MODE_NL; old_lock < FLOM_LOCK_MODE_N;
+         ++old_lock) {
+        if (0 == resource->data.simple.holder_counts[old_lock])
+            continue;
+        FLOM_TRACE(("flom_resource_simple_can_lock: current_lock=%d "
+                    "(%u holders), asked_lock=%d, lock_table[%d][%d]=%d\n",
+                    old_lock, resource->data.simple.holder_counts[old_lock],
+                    lock, old_lock, lock, lock_table[old_lock][lock]));
         can_lock &= lock_table[old_lock][lock];
         if (!can_lock)
             break;
-        else
-            p = p->next;
-    } /* while (NULL != p) */
+    } /* for (old_lock ... */
     return can_lock;
 }
 
 
 
+int flom_resource_simple_waitings_push(flom_resource_t *resource,
+                                       struct flom_rsrc_conn_lock_s *cl)
+{
+    enum Exception { G_TRY_MALLOC_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_resource_simple_waitings_push\n"));
+    TRY {
+        struct flom_rsrc_simple_run_s *run = NULL;
+        
+        if (NULL != resource->data.simple.waitings->tail)
+            run = (struct flom_rsrc_simple_run_s *)
+                resource->data.simple.waitings->tail->data;
+        if (NULL == run || run->lock_mode != cl->info.lock_mode) {
+            /* a different lock mode starts a new run */
+            if (NULL == (run = g_try_malloc0(
+                             sizeof(struct flom_rsrc_simple_run_s))))
+                THROW(G_TRY_MALLOC_ERROR);
+            run->lock_mode = cl->info.lock_mode;
+            g_queue_init(&run->members);
+            g_queue_push_tail(resource->data.simple.waitings, (gpointer)run);
+            FLOM_TRACE(("flom_resource_simple_waitings_push: new run %p "
+                        "for lock mode %d\n", run, run->lock_mode));
+        }
+        g_queue_push_tail(&run->members, (gpointer)cl);
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case G_TRY_MALLOC_ERROR:
+                ret_cod = FLOM_RC_G_TRY_MALLOC_ERROR;
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_resource_simple_waitings_push/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+GList *flom_resource_simple_run_delete(flom_resource_t *resource, GList *r)
+{
+    GQueue *waitings = resource->data.simple.waitings;
+    GList *prev = r->prev;
+    GList *next = r->next;
+    
+    FLOM_TRACE(("flom_resource_simple_run_delete: removing run %p\n",
+                r->data));
+    g_free(r->data);
+    g_queue_delete_link(waitings, r);
+    if (NULL != prev && NULL != next) {
+        struct flom_rsrc_simple_run_s *prev_run =
+            (struct flom_rsrc_simple_run_s *)prev->data;
+        struct flom_rsrc_simple_run_s *next_run =
+            (struct flom_rsrc_simple_run_s *)next->data;
+        if (prev_run->lock_mode == next_run->lock_mode) {
+            /* the runs became adjacent: the members of the second one are
+               spliced at the end of the first one */
+            GList *after = next->next;
+            FLOM_TRACE(("flom_resource_simple_run_delete: merging run %p "
+                        "into run %p\n", next_run, prev_run));
+            prev_run->members.tail->next = next_run->members.head;
+            next_run->members.head->prev = prev_run->members.tail;
+            prev_run->members.tail = next_run->members.tail;
+            prev_run->members.length += next_run->members.length;
+            g_free(next_run);
+            g_queue_delete_link(waitings, next);
+            return after;
+        }
+    }
+    return next;
+}
+
+
+
 int flom_resource_simple_init(flom_resource_t *resource,
                               const gchar *name)
 {
@@ -97,6 +181,8 @@ int flom_resource_simple_init(flom_resource_t *resource,
                     resource->name));
 
         resource->data.simple.holders = NULL;
+        memset(resource->data.simple.holder_counts, 0,
+               sizeof(resource->data.simple.holder_counts));
         if (NULL == (resource->data.simple.waitings = g_queue_new()))
             THROW(G_QUEUE_NEW_ERROR);
         
@@ -133,6 +219,7 @@ int flom_resource_simple_inmsg(flom_resource_t *resource,
                      , G_TRY_MALLOC_ERROR1
                      , MSG_BUILD_ANSWER_ERROR1
                      , G_TRY_MALLOC_ERROR2
+                     , WAITINGS_PUSH_ERROR
                      , MSG_BUILD_ANSWER_ERROR2
                      , MSG_BUILD_ANSWER_ERROR3
                      , INVALID_OPTION
@@ -173,6 +260,7 @@ int flom_resource_simple_inmsg(flom_resource_t *resource,
                     resource->data.simple.holders = g_slist_prepend(
                         resource->data.simple.holders,
                         (gpointer)cl);
+                    resource->data.simple.holder_counts[new_lock]++;
                     /* retrieve the name of the peer (IP address) */
                     peer_name = flom_tcp_retrieve_peer_name(&conn->tcp);
                     /* propagate the info to the VFS ram tree */
@@ -203,9 +291,12 @@ int flom_resource_simple_inmsg(flom_resource_t *resource,
                             THROW(G_TRY_MALLOC_ERROR2);
                         cl->info.lock_mode = new_lock;
                         cl->conn = conn;
-                        g_queue_push_tail(
-                            resource->data.simple.waitings,
-                            (gpointer)cl);
+                        if (FLOM_RC_OK != (
+                                ret_cod = flom_resource_simple_waitings_push(
+                                    resource, cl))) {
+                            flom_rsrc_conn_lock_delete(cl);
+                            THROW(WAITINGS_PUSH_ERROR);
+                        }
                         /* retrieve the name of the peer (IP address) */
                         peer_name = flom_tcp_retrieve_peer_name(&conn->tcp);
                         /* propagate the info to the VFS ram tree */
@@ -279,6 +370,7 @@ int flom_resource_simple_inmsg(flom_resource_t *resource,
             case G_TRY_MALLOC_ERROR2:
                 ret_cod = FLOM_RC_G_TRY_MALLOC_ERROR;
                 break;
+            case WAITINGS_PUSH_ERROR:
             case MSG_BUILD_ANSWER_ERROR2:
             case MSG_BUILD_ANSWER_ERROR3:
                 break;
@@ -314,7 +406,6 @@ int flom_resource_simple_clean(flom_resource_t *resource,
 {
     enum Exception { NULL_OBJECT
                      , SIMPLE_WAITINGS_ERROR
-                     , INTERNAL_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     
@@ -341,6 +432,7 @@ int flom_resource_simple_clean(flom_resource_t *resource,
             FLOM_TRACE(("flom_resource_simple_clean: cl=%p\n", cl));
             resource->data.simple.holders = g_slist_remove(
                 resource->data.simple.holders, cl);
+            resource->data.simple.holder_counts[cl->info.lock_mode]--;
             /* free the now useless connection lock record */
             flom_rsrc_conn_lock_delete(cl);
             /*
@@ -352,32 +444,29 @@ int flom_resource_simple_clean(flom_resource_t *resource,
                                    resource)))
                 THROW(SIMPLE_WAITINGS_ERROR);
         } else {
-            guint i = 0;
+            GList *r = resource->data.simple.waitings->head;
+            GList *w = NULL;
             /* check if the connection was waiting a lock */
-            do {
-                struct flom_rsrc_conn_lock_s *cl =
-                    (struct flom_rsrc_conn_lock_s *)
-                    g_queue_peek_nth(resource->data.simple.waitings, i);
-                if (NULL == cl)
-                    break;
-                if (cl->conn == conn) {
+            while (NULL != r) {
+                struct flom_rsrc_simple_run_s *run =
+                    (struct flom_rsrc_simple_run_s *)r->data;
+                if (NULL != (w = flom_rsrc_waitings_find(
+                                 &run->members, conn))) {
+                    struct flom_rsrc_conn_lock_s *cl =
+                        (struct flom_rsrc_conn_lock_s *)w->data;
                     /* remove from waitings */
                     FLOM_TRACE(("flom_resource_simple_clean: the client is "
                                 "waiting for a lock mode %d, removing "
                                 "it...\n", cl->info.lock_mode));
-                    cl = g_queue_pop_nth(resource->data.simple.waitings, i);
-                    if (NULL == cl) {
-                        /* this should be impossibile because peek was ok
-                           some rows above */
-                        THROW(INTERNAL_ERROR);
-                    } else {
-                        /* free the now useless connection lock record */
-                        flom_rsrc_conn_lock_delete(cl);
-                    }
+                    g_queue_delete_link(&run->members, w);
+                    if (g_queue_is_empty(&run->members))
+                        flom_resource_simple_run_delete(resource, r);
+                    /* free the now useless connection lock record */
+                    flom_rsrc_conn_lock_delete(cl);
                     break;
-                } else
-                    ++i;
-            } while (TRUE);
+                }
+                r = r->next;
+            } /* while (NULL != r) */
         } /* if (NULL != p) */
         /* propagate the info to the VFS ram tree */
         if (FLOM_RC_OK != (
@@ -396,9 +485,6 @@ int flom_resource_simple_clean(flom_resource_t *resource,
                 break;
             case SIMPLE_WAITINGS_ERROR:
                 break;
-            case INTERNAL_ERROR:
-                ret_cod = FLOM_RC_INTERNAL_ERROR;
-                break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
                 break;
@@ -425,13 +511,21 @@ void flom_resource_simple_free(flom_resource_t *resource)
         flom_rsrc_conn_lock_delete(cl);
     }
     resource->data.simple.holders = NULL;
+    memset(resource->data.simple.holder_counts, 0,
+           sizeof(resource->data.simple.holder_counts));
     /* clean-up waitings queue... */
     FLOM_TRACE(("flom_resource_simple_free: cleaning-up waitings queue...\n"));
     while (!g_queue_is_empty(resource->data.simple.waitings)) {
-        struct flom_rsrc_conn_lock_s *cl =
-            (struct flom_rsrc_conn_lock_s *)g_queue_pop_head(
+        struct flom_rsrc_simple_run_s *run =
+            (struct flom_rsrc_simple_run_s *)g_queue_pop_head(
                 resource->data.simple.waitings);
-        flom_rsrc_conn_lock_delete(cl);
+        while (!g_queue_is_empty(&run->members)) {
+            struct flom_rsrc_conn_lock_s *cl =
+                (struct flom_rsrc_conn_lock_s *)g_queue_pop_head(
+                    &run->members);
+            flom_rsrc_conn_lock_delete(cl);
+        }
+        g_free(run);
     }
     g_queue_free(resource->data.simple.waitings);
     resource->data.simple.waitings = NULL;
@@ -445,57 +539,50 @@ void flom_resource_simple_free(flom_resource_t *resource)
 
 int flom_resource_simple_waitings(flom_resource_t *resource)
 {
-    enum Exception { INTERNAL_ERROR
-                     , MSG_BUILD_ANSWER_ERROR
-                     , MSG_SERIALIZE_ERROR
-                     , MSG_SEND_ERROR
-                     , MSG_FREE_ERROR
+    enum Exception { CONN_SEND_ANSWER_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     struct flom_rsrc_conn_lock_s *cl = NULL;
     
     FLOM_TRACE(("flom_resource_simple_waitings\n"));
     TRY {
-        guint i = 0;
-        struct flom_msg_s msg;
-        char buffer[FLOM_NETWORK_BUFFER_SIZE];
-        size_t to_send;
+        GList *r = resource->data.simple.waitings->head;
         
-        /* check if there is any connection waiting for a lock */
-        do {
-            cl = (struct flom_rsrc_conn_lock_s *)
-                g_queue_peek_nth(resource->data.simple.waitings, i);
-            if (NULL == cl)
-                break;
-            /* try to apply this lock... */
-            if (flom_resource_simple_can_lock(resource, cl->info.lock_mode)) {
+        /* check if there is any run of connections waiting for a lock */
+        while (NULL != r) {
+            struct flom_rsrc_simple_run_s *run =
+                (struct flom_rsrc_simple_run_s *)r->data;
+            /* a run can be left empty by a previous failed sweep */
+            if (g_queue_is_empty(&run->members)) {
+                r = flom_resource_simple_run_delete(resource, r);
+                continue;
+            }
+            /* the members of a run ask the same lock: an incompatible run
+               is skipped without looking at its members */
+            if (!flom_resource_simple_can_lock(resource, run->lock_mode)) {
+                r = r->next;
+                continue;
+            }
+            FLOM_TRACE(("flom_resource_simple_waitings: granting run %p "
+                        "(lock mode %d, %u members)\n", run, run->lock_mode,
+                        g_queue_get_length(&run->members)));
+            /* grant the members until the lock conflicts with itself
+               (PW, EX) or the run is exhausted */
+            do {
                 /* remove from waitings */
-                cl = g_queue_pop_nth(resource->data.simple.waitings, i);
-                if (NULL == cl)
-                    /* this should be impossibile because peek was ok
-                       some rows above */
-                    THROW(INTERNAL_ERROR);
+                cl = (struct flom_rsrc_conn_lock_s *)g_queue_pop_head(
+                    &run->members);
                 /* send a message to the client that is waiting the lock */
-                flom_msg_init(&msg);
-                if (FLOM_RC_OK != (ret_cod = flom_msg_build_answer(
-                                       &msg, FLOM_MSG_VERB_LOCK,
-                                       3*FLOM_MSG_STEP_INCR,
-                                       FLOM_RC_OK, NULL)))
-                    THROW(MSG_BUILD_ANSWER_ERROR);
-                if (FLOM_RC_OK != (
-                        ret_cod = flom_msg_serialize(
-                            &msg, buffer, sizeof(buffer), &to_send)))
-                    THROW(MSG_SERIALIZE_ERROR);
-                if (FLOM_RC_OK != (ret_cod = flom_conn_send(
-                                       cl->conn, buffer, to_send)))
-                    THROW(MSG_SEND_ERROR);
-                flom_conn_set_last_step(cl->conn, msg.header.pvs.step);
-                if (FLOM_RC_OK != (ret_cod = flom_msg_free(&msg)))
-                    THROW(MSG_FREE_ERROR);                
+                if (FLOM_RC_OK != (ret_cod = flom_conn_send_answer(
+                                       cl->conn, FLOM_MSG_VERB_LOCK,
+                                       3*FLOM_MSG_STEP_INCR, FLOM_RC_OK)))
+                    THROW(CONN_SEND_ANSWER_ERROR);
+                flom_conn_set_last_step(cl->conn, 3*FLOM_MSG_STEP_INCR);
                 /* insert into holders */
                 resource->data.simple.holders = g_slist_prepend(
                     resource->data.simple.holders,
                     (gpointer)cl);
+                resource->data.simple.holder_counts[cl->info.lock_mode]++;
                 /* propagate the info to the VFS ram tree */
                 if (FLOM_RC_OK != (
                         ret_cod = flom_vfs_ram_tree_move_locker_conn(
@@ -506,20 +593,18 @@ int flom_resource_simple_waitings(flom_resource_t *resource)
                                 cl->conn->uid));
                 }                  
                 cl = NULL;
-            } else
-                ++i;
-        } while (TRUE);
+            } while (!g_queue_is_empty(&run->members) &&
+                     flom_resource_simple_can_lock(resource, run->lock_mode));
+            if (g_queue_is_empty(&run->members))
+                r = flom_resource_simple_run_delete(resource, r);
+            else
+                r = r->next;
+        } /* while (NULL != r) */
         
         THROW(NONE);
     } CATCH {
         switch (excp) {
-            case INTERNAL_ERROR:
-                ret_cod = FLOM_RC_INTERNAL_ERROR;
-                break;
-            case MSG_BUILD_ANSWER_ERROR:
-            case MSG_SERIALIZE_ERROR:
-            case MSG_SEND_ERROR:
-            case MSG_FREE_ERROR:
+            case CONN_SEND_ANSWER_ERROR:
                 break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
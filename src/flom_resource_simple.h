@@ -55,6 +55,31 @@ extern "C" {
 
 
     
+    /**
+     * Append a waiting connection to the queue of a simple resource: it
+     * joins the last run if it asked the same lock mode, a new run is
+     * created otherwise
+     * @param resource IN/OUT reference to resource object
+     * @param cl IN connection lock record of the waiting connection
+     * @return a reason code
+     */
+    int flom_resource_simple_waitings_push(flom_resource_t *resource,
+                                           struct flom_rsrc_conn_lock_s *cl);
+
+
+    
+    /**
+     * Remove an empty run from the waitings queue of a simple resource;
+     * the neighbouring runs are merged if they asked the same lock mode
+     * @param resource IN/OUT reference to resource object
+     * @param r IN link of the run that must be removed
+     * @return the link of the first run after the removed one
+     */
+    GList *flom_resource_simple_run_delete(flom_resource_t *resource,
+                                           GList *r);
+
+
+    
     /**
      * Initialize a new resource of type simple
      * @param resource IN reference to resource object
@@ -108,7 +133,9 @@ extern "C" {
 
 
     /**
-     * Check if any of the lock waitings can get a lock
+     * Check if any of the lock waitings can get a lock: every run is
+     * checked once, a compatible run is granted until a member conflicts
+     * with the holders, an incompatible run is skipped as a whole
      * @param resource IN/OUT reference to resource object
      * @return a reason code
      */
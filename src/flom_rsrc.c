@@ -208,6 +208,32 @@ const gchar *flom_rsrc_get_type_human_readable(flom_rsrc_type_t res_type)
 }
 
 
+
+gchar *flom_rsrc_get_key(flom_rsrc_type_t type, const gchar *resource_name)
+{
+    gchar *key = NULL;
+    
+    if (NULL == resource_name)
+        return NULL;
+    if (FLOM_RSRC_TYPE_HIER == type) {
+        size_t sep_len = strlen(FLOM_HIER_RESOURCE_SEPARATOR);
+        const gchar *root = resource_name, *end;
+        /* skip the leading separator, the key retains it to avoid any
+           clash with the other resource types */
+        if (0 == strncmp(root, FLOM_HIER_RESOURCE_SEPARATOR, sep_len))
+            root += sep_len;
+        if (NULL == (end = strstr(root, FLOM_HIER_RESOURCE_SEPARATOR)))
+            key = g_strdup(resource_name);
+        else
+            key = g_strndup(resource_name, end - resource_name);
+    } else
+        key = g_strdup(resource_name);
+    FLOM_TRACE(("flom_rsrc_get_key: resource_name='%s', key='%s'\n",
+                resource_name, STRORNULL(key)));
+    return key;
+}
+
+
 int flom_rsrc_get_transactional(const gchar *resource_name)
 {
     flom_rsrc_type_t type;
@@ -455,6 +481,24 @@ GSList *flom_rsrc_conn_find(GSList *holders, flom_conn_t *conn)
 
 
 
+GList *flom_rsrc_waitings_find(GQueue *waitings, flom_conn_t *conn)
+{
+    GList *p = waitings->head;
+    
+    FLOM_TRACE(("flom_rsrc_waitings_find\n"));
+
+    while (NULL != p) {
+        if (((struct flom_rsrc_conn_lock_s *)p->data)->conn == conn)
+            break;
+        else
+            p = p->next;
+    } /* while (NULL != p) */
+    FLOM_TRACE(("flom_rsrc_waitings_find: returning %p\n", p));
+    return p;
+}
+
+
+
 
 int flom_resource_init(flom_resource_t *resource,
                        flom_rsrc_type_t type, const gchar *name)
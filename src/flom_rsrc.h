@@ -138,6 +138,24 @@ struct flom_rsrc_conn_lock_s {
 
 
 
+/**
+ * A run of consecutive waiting connections that asked the same lock mode
+ * to a simple resource: the compatibility of the run is checked once and
+ * all its members can be granted with a single sweep
+ */
+struct flom_rsrc_simple_run_s {
+    /**
+     * Lock mode asked by all the members of the run
+     */
+    flom_lock_mode_t        lock_mode;
+    /**
+     * Waiting connections (@ref flom_rsrc_conn_lock_s) in arrival order
+     */
+    GQueue                  members;
+};
+
+
+
 /**
  * Resource data for type "simple" @ref FLOM_RSRC_TYPE_SIMPLE
  */
@@ -147,7 +165,14 @@ struct flom_rsrc_data_simple_s {
      */
     GSList                 *holders;
     /**
-     * List of connections waiting for a lock
+     * Number of holders for every lock mode: the compatibility of a new
+     * lock is checked without scanning the holders list
+     */
+    guint                   holder_counts[FLOM_LOCK_MODE_N];
+    /**
+     * Queue of the connections waiting for a lock, grouped in runs of
+     * consecutive requests with the same lock mode
+     * (@ref flom_rsrc_simple_run_s)
      */
     GQueue                 *waitings;
 };
@@ -178,6 +203,14 @@ struct flom_rsrc_data_numeric_s {
 
 
 
+/**
+ * Number of elements tracked by every word of the free elements bitmap of
+ * a set resource
+ */
+#define FLOM_RSRC_SET_MAP_BITS   (sizeof(gulong)*8)
+
+
+
 /**
  * Resource data for type "set" @ref FLOM_RSRC_TYPE_SET
  */
@@ -191,6 +224,19 @@ struct flom_rsrc_data_set_s {
      * of the lock holder
      */
     GArray                 *elements;
+    /**
+     * Bitmap of the available elements: the bit of an element is set if
+     * no connection holds it
+     */
+    gulong                 *free_map;
+    /**
+     * Number of available elements
+     */
+    guint                   free_number;
+    /**
+     * Element (GUINT_TO_POINTER) held by every holder connection
+     */
+    GHashTable             *holders;
     /**
      * List of connections waiting for an element to lock
      */
@@ -229,9 +275,24 @@ struct flom_rsrc_data_hier_element_s {
      */
     GSList                        *holders;
     /**
-     * Next level elements of the same type of this one
+     * Next level elements of the same type of this one, indexed by name
+     * (the keys are the names owned by the elements)
+     */
+    GHashTable                    *index;
+    /**
+     * Previous level element, NULL for the root element
+     */
+    struct flom_rsrc_data_hier_element_s *parent;
+    /**
+     * Number of holders at this level for every lock mode
      */
-    GPtrArray                     *leaves;
+    guint                          holder_counts[FLOM_LOCK_MODE_N];
+    /**
+     * Number of holders at this level and at all the next levels for every
+     * lock mode: a lock on this level is checked without visiting the
+     * subtree
+     */
+    guint                          subtree_counts[FLOM_LOCK_MODE_N];
 };
 
 
@@ -432,6 +493,22 @@ extern "C" {
      */
     const gchar *flom_rsrc_get_type_human_readable(flom_rsrc_type_t res_type);
 
+
+
+    
+    /**
+     * Retrieve the key used to index the locker that manages a resource:
+     * it's the resource name itself for all the resource types, but
+     * hierarchical resources that are indexed by the root level (the first
+     * level of the path) because a single locker manages the whole tree
+     * @param type IN resource type
+     * @param resource_name IN resource name
+     * @return a string that MUST be released with g_free or NULL in case of
+     *         error
+     */
+    gchar *flom_rsrc_get_key(flom_rsrc_type_t type,
+                             const gchar *resource_name);
+
     
     
     /**
@@ -502,6 +579,18 @@ extern "C" {
      */
     GSList *flom_rsrc_conn_find(GSList *holders, flom_conn_t *conn);
 
+
+
+    /**
+     * Find in waitings queue the link related to a connection
+     * @param waitings IN the queue with lock waiting elements
+     * @param conn IN the connection that must be found
+     * @return the link related to the searched connection or NULL; it can
+     *         be removed with g_queue_delete_link without scanning the
+     *         queue again
+     */
+    GList *flom_rsrc_waitings_find(GQueue *waitings, flom_conn_t *conn);
+
     
 
     /**
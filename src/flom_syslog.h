@@ -84,6 +84,24 @@ extern "C" {
 #define FLOM_SYSLOG_FLM023I "FLM023I unmounting FUSE file system with command '%s'"
 #define FLOM_SYSLOG_FLM024W "FLM024W command '%s' exited with status %d: try to unmount it manually with '" FUSERMOUNT " -u %s' or with 'sudo umount -l %s'"
 #define FLOM_SYSLOG_FLM025E "FLM025E unable to allocate " SIZE_T_FORMAT " bytes to unmount FUSE filesystem: '%s' must be unmounted manually"
+#define FLOM_SYSLOG_FLM026I "FLM026I locker cache statistics: " \
+    UINT64_T_FORMAT " hits, " UINT64_T_FORMAT " misses"
+#define FLOM_SYSLOG_FLM027I "FLM027I accepting TCP/IP connections with " \
+    "%u threads"
+#define FLOM_SYSLOG_FLM028E "FLM028E acceptor thread %u terminated with " \
+    "error %d ('%s')"
+#define FLOM_SYSLOG_FLM029I "FLM029I locker output statistics: " \
+    UINT64_T_FORMAT " messages sent with " UINT64_T_FORMAT " writes"
+#define FLOM_SYSLOG_FLM030I "FLM030I TLS handshake statistics: " \
+    UINT64_T_FORMAT " full handshakes in " UINT64_T_FORMAT " us, " \
+    UINT64_T_FORMAT " resumed sessions in " UINT64_T_FORMAT " us"
+#define FLOM_SYSLOG_FLM031I "FLM031I TLS kernel offload statistics: " \
+    UINT64_T_FORMAT " connections sending, " UINT64_T_FORMAT \
+    " connections receiving through the kernel"
+#define FLOM_SYSLOG_FLM032E "FLM032E locker worker thread %u terminated " \
+    "with error %d ('%s')"
+#define FLOM_SYSLOG_FLM033W "FLM033W locker of resource '%s' discarded " \
+    "after error %d ('%s')"
     
     
 
@@ -20,6 +20,9 @@
 
 
 
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
 #ifdef HAVE_NETDB_H
 # include <netdb.h>
 #endif
@@ -134,6 +137,21 @@ int flom_tcp_listen(flom_tcp_t *obj)
                     gai = gai->ai_next;
                     close(fd);
                     fd = FLOM_NULL_FD;
+#ifdef SO_REUSEPORT
+                } else if (1 < flom_config_get_acceptor_threads(
+                               obj->config) &&
+                           -1 == setsockopt(fd, SOL_SOCKET, SO_REUSEPORT,
+                                            (void *)&sock_opt,
+                                            sizeof(sock_opt))) {
+                    /* every acceptor thread binds its own socket to the
+                       same address */
+                    FLOM_TRACE(("flom_tcp_listen/setsockopt(SO_REUSEPORT) : "
+                                "errno=%d '%s', skipping...\n", errno,
+                                strerror(errno)));
+                    gai = gai->ai_next;
+                    close(fd);
+                    fd = FLOM_NULL_FD;
+#endif /* SO_REUSEPORT */
                 } else if (-1 == bind(fd, sa, gai->ai_addrlen)) {
                     FLOM_TRACE(("flom_tcp_listen/bind() : "
                                 "errno=%d '%s', skipping...\n", errno,
@@ -327,7 +345,7 @@ int flom_tcp_recv(const flom_tcp_t *obj, void *buf, size_t len,
 {
     enum Exception {
         INVALID_SOCKET_TYPE,
-        RECV_MSG_ERROR,
+        RECV_CHUNK_ERROR,
         RECVFROM_ERROR,
         NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
@@ -336,9 +354,9 @@ int flom_tcp_recv(const flom_tcp_t *obj, void *buf, size_t len,
     TRY {
         switch (obj->socket_type) {
             case SOCK_STREAM:
-                if (FLOM_RC_OK != (ret_cod = flom_tcp_recv_msg(
+                if (FLOM_RC_OK != (ret_cod = flom_tcp_recv_chunk(
                                        obj, buf, len, received)))
-                    THROW(RECV_MSG_ERROR);
+                    THROW(RECV_CHUNK_ERROR);
                 break;
             case SOCK_DGRAM:
                 if (0 > (*received = recvfrom(
@@ -362,7 +380,7 @@ int flom_tcp_recv(const flom_tcp_t *obj, void *buf, size_t len,
             case INVALID_SOCKET_TYPE:
                 ret_cod = FLOM_RC_INVALID_OPTION;
                 break;
-            case RECV_MSG_ERROR:
+            case RECV_CHUNK_ERROR:
                 break;
             case RECVFROM_ERROR:
                 ret_cod = FLOM_RC_RECVFROM_ERROR;
@@ -381,83 +399,83 @@ int flom_tcp_recv(const flom_tcp_t *obj, void *buf, size_t len,
 
 
 
-int flom_tcp_recv_msg(const flom_tcp_t *obj, char *buf, size_t len,
-                      size_t *received)
+int flom_tcp_recv_chunk(const flom_tcp_t *obj, char *buf, size_t len,
+                        size_t *received)
 {
     enum Exception {
-        OUT_OF_RANGE,
+        WOULD_BLOCK,
         RECV_ERROR,
-        BUFFER_OVERFLOW,
         NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     
-    FLOM_TRACE(("flom_tcp_recv_msg\n"));
+    FLOM_TRACE(("flom_tcp_recv_chunk\n"));
     TRY {
-        char closing_tag[FLOM_MSG_BUFFER_SIZE];
-        size_t retrieved = 0;
-        size_t closing_tag_len;
-        size_t to_be_read;
         ssize_t read_bytes;
-        char closing_tag_last;
-        int found = FALSE;
-        int i, j;
         
-        /* preparing the closing tag string */
-        snprintf(closing_tag, sizeof(closing_tag), "</%s>",
-                 FLOM_MSG_TAG_MSG);
-        closing_tag_len = strlen(closing_tag);
-        closing_tag_last = closing_tag[closing_tag_len-1];
-        FLOM_TRACE(("flom_tcp_recv_msg: closing_tag='%s', closing_tag_len="
-                    SIZE_T_FORMAT ", closing_tag_last='%c'\n",
-                    closing_tag, closing_tag_len, closing_tag_last));
-        if (len < closing_tag_len)
-            THROW(OUT_OF_RANGE);
-        /* loop until a complete message has been retrieved or an error
-           occurs */
-        to_be_read = closing_tag_len;
-        while (!found) {
-            read_bytes = recv(obj->sockfd, buf+retrieved, to_be_read, 0);
-            FLOM_TRACE(("flom_tcp_recv_msg: read_bytes=%d '%*.*s'\n",
-                        read_bytes, read_bytes, read_bytes, buf+retrieved));
-            if (0 >= read_bytes)
-                THROW(RECV_ERROR);
-            retrieved += read_bytes;
-            /* too few chars, go on */
-            if (retrieved < closing_tag_len)
-                continue;
-            /* looping on closing_tag */
-            j = 0;
-            for (i=0; i<closing_tag_len; ++i) {
-                if (buf[retrieved-j-1] == closing_tag[closing_tag_len-i-1])
-                    j++;
-                else
-                    j = 0;
-            } /* for (i=0; i<closing_tag_len; ++i) */
-            if (j == closing_tag_len)
-                found = TRUE;
-            else {
-                to_be_read = closing_tag_len - j;
-                if (retrieved + to_be_read >= len)
-                    THROW(BUFFER_OVERFLOW);
-            }
-        } /* while (TRUE) */
-        /* put string terminator */
-        buf[retrieved] = '\0';
-        *received = retrieved;
-        FLOM_TRACE(("flom_tcp_recv_msg: received message is '%s' "
-                    "of " SIZE_T_FORMAT " chars\n", buf, *received));
+        read_bytes = recv(obj->sockfd, buf, len, 0);
+        FLOM_TRACE(("flom_tcp_recv_chunk: fd=%d, len=" SIZE_T_FORMAT
+                    ", read_bytes=" SSIZE_T_FORMAT "\n",
+                    obj->sockfd, len, read_bytes));
+        /* a non blocking socket has nothing to be read */
+        if (0 > read_bytes && (EAGAIN == errno || EWOULDBLOCK == errno))
+            THROW(WOULD_BLOCK);
+        /* 0 means the peer closed the connection */
+        if (0 >= read_bytes)
+            THROW(RECV_ERROR);
+        *received = (size_t)read_bytes;
         
         THROW(NONE);
     } CATCH {
         switch (excp) {
-            case OUT_OF_RANGE:
-                ret_cod = FLOM_RC_OUT_OF_RANGE;
+            case WOULD_BLOCK:
+                ret_cod = FLOM_RC_WOULD_BLOCK;
                 break;
             case RECV_ERROR:
                 ret_cod = FLOM_RC_RECV_ERROR;
                 break;
-            case BUFFER_OVERFLOW:
-                ret_cod = FLOM_RC_BUFFER_OVERFLOW;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_tcp_recv_chunk/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+int flom_tcp_wait_fd(int fd, short events, int timeout)
+{
+    enum Exception { POLL_ERROR
+                     , NETWORK_TIMEOUT
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_tcp_wait_fd: fd=%d, events=%d, timeout=%d\n",
+                fd, events, timeout));
+    TRY {
+        struct pollfd fds[1];
+        int rc;
+        
+        fds[0].fd = fd;
+        fds[0].events = events;
+        fds[0].revents = 0;
+        if (0 > (rc = poll(fds, 1, timeout)))
+            THROW(POLL_ERROR);
+        if (0 == rc)
+            THROW(NETWORK_TIMEOUT);
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case POLL_ERROR:
+                ret_cod = FLOM_RC_POLL_ERROR;
+                break;
+            case NETWORK_TIMEOUT:
+                ret_cod = FLOM_RC_NETWORK_TIMEOUT;
                 break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
@@ -466,7 +484,7 @@ int flom_tcp_recv_msg(const flom_tcp_t *obj, char *buf, size_t len,
                 ret_cod = FLOM_RC_INTERNAL_ERROR;
         } /* switch (excp) */
     } /* TRY-CATCH */
-    FLOM_TRACE(("flom_tcp_recv_msg/excp=%d/"
+    FLOM_TRACE(("flom_tcp_wait_fd/excp=%d/"
                 "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
     return ret_cod;
 }
@@ -477,6 +495,7 @@ int flom_tcp_send(const flom_tcp_t *obj, const void *buf, size_t len)
 {
     enum Exception { GETSOCKOPT_ERROR
                      , CONNECTION_CLOSED
+                     , TCP_WAIT_FD_ERROR
                      , SEND_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
@@ -484,6 +503,7 @@ int flom_tcp_send(const flom_tcp_t *obj, const void *buf, size_t len)
     FLOM_TRACE(("flom_tcp_send: fd=%d\n", obj->sockfd));
     TRY {
         ssize_t wrote_bytes;
+        size_t sent = 0;
         int optval;
         socklen_t optlen = sizeof(optval);
 
@@ -502,13 +522,28 @@ int flom_tcp_send(const flom_tcp_t *obj, const void *buf, size_t len)
         FLOM_TRACE(("flom_tcp_send: sending " SIZE_T_FORMAT
                     " bytes (fd=%d) '%*.*s'...\n", len, obj->sockfd,
                     len, len, buf));
-        wrote_bytes = send(obj->sockfd, buf, len, MSG_NOSIGNAL);
-        if (len != wrote_bytes) {
-            FLOM_TRACE(("flom_tcp_send: sent " SSIZE_T_FORMAT
-                        " bytes instead of " SIZE_T_FORMAT "\n",
-                        wrote_bytes, len));
-            THROW(SEND_ERROR);
-        }
+        /* a non blocking socket can accept only a part of the buffer:
+           the rest is sent as soon as the socket is writable again, a
+           message is never truncated */
+        while (sent < len) {
+            wrote_bytes = send(obj->sockfd, (const char *)buf + sent,
+                               len - sent, MSG_NOSIGNAL);
+            if (0 > wrote_bytes &&
+                (EAGAIN == errno || EWOULDBLOCK == errno)) {
+                if (FLOM_RC_OK != (ret_cod = flom_tcp_wait_fd(
+                                       obj->sockfd, POLLOUT,
+                                       FLOM_NETWORK_SEND_TIMEOUT)))
+                    THROW(TCP_WAIT_FD_ERROR);
+                continue;
+            }
+            if (0 >= wrote_bytes) {
+                FLOM_TRACE(("flom_tcp_send: sent " SIZE_T_FORMAT
+                            " bytes instead of " SIZE_T_FORMAT "\n",
+                            sent, len));
+                THROW(SEND_ERROR);
+            }
+            sent += (size_t)wrote_bytes;
+        } /* while (sent < len) */
         
         THROW(NONE);
     } CATCH {
@@ -519,6 +554,8 @@ int flom_tcp_send(const flom_tcp_t *obj, const void *buf, size_t len)
             case CONNECTION_CLOSED:
                 ret_cod = FLOM_RC_CONNECTION_CLOSED;
                 break;
+            case TCP_WAIT_FD_ERROR:
+                break;
             case SEND_ERROR:
                 ret_cod = FLOM_RC_SEND_ERROR;
                 break;
@@ -572,6 +609,48 @@ int flom_tcp_close(flom_tcp_t *obj)
 
 
 
+int flom_tcp_set_nonblocking(const flom_tcp_t *obj, int value)
+{
+    enum Exception { FCNTL_ERROR1
+                     , FCNTL_ERROR2
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_tcp_set_nonblocking: sockfd=%d, value=%d\n",
+                obj->sockfd, value));
+    TRY {
+        int flags;
+        
+        if (-1 == (flags = fcntl(obj->sockfd, F_GETFL)))
+            THROW(FCNTL_ERROR1);
+        if (value)
+            flags |= O_NONBLOCK;
+        else
+            flags &= ~O_NONBLOCK;
+        if (-1 == fcntl(obj->sockfd, F_SETFL, flags))
+            THROW(FCNTL_ERROR2);
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case FCNTL_ERROR1:
+            case FCNTL_ERROR2:
+                ret_cod = FLOM_RC_FCNTL_ERROR;
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    FLOM_TRACE(("flom_tcp_set_nonblocking/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
 gchar *flom_tcp_retrieve_peer_name(const flom_tcp_t *obj)
 {
     struct sockaddr_storage sa;
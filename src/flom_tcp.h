@@ -296,11 +296,13 @@ extern "C" {
 
     
     /**
-     * Retrieve the first XML message from a socket (file descriptor)
+     * Receive data from a socket (file descriptor): a stream socket returns
+     * the available bytes (message framing is performed by
+     * @ref flom_conn_recv), a datagram socket returns a datagram
      * @param obj IN TCP communication object
-     * @param buf OUT buffer will be used to store the XML message
+     * @param buf OUT buffer will be used to store the received bytes
      * @param len IN size of buf
-     * @param received OUT number of bytes read, XML message length
+     * @param received OUT number of bytes read
      * @param src_addr OUT transparently passed to recvfrom if type is
      *                 SOCK_DGRAM (see recvfrom man page)
      * @param addrlen OUT transparently passed to recvfrom if type is
@@ -314,25 +316,37 @@ extern "C" {
 
 
     /**
-     * Return a single XML message from a TCP/IP socket; this helper functions
-     * avoid that more than one message are retrieved at the same time
+     * Receive the bytes available on a TCP/IP socket with a single system
+     * call; it waits only if no byte is available
      * @param obj IN TCP communication object
-     * @param buf OUT buffer will be used to store the XML message
+     * @param buf OUT buffer will be used to store the received bytes
      * @param len IN size of buf
-     * @param received OUT number of bytes read, XML message length
-     * @param src_addr OUT transparently passed to recvfrom if type is
-     *                 SOCK_DGRAM (see recvfrom man page)
-     * @param addrlen OUT transparently passed to recvfrom if type is
-     *                 SOCK_DGRAM (see recvfrom man page)
-     * @return a reason code
+     * @param received OUT number of bytes read (always greater than 0)
+     * @return a reason code; @ref FLOM_RC_RECV_ERROR is returned if the
+     *         peer closed the connection, @ref FLOM_RC_WOULD_BLOCK if the
+     *         socket is non blocking and no byte is available
      */     
-    int flom_tcp_recv_msg(const flom_tcp_t *obj, char *buf, size_t len,
-                          size_t *received);
+    int flom_tcp_recv_chunk(const flom_tcp_t *obj, char *buf, size_t len,
+                            size_t *received);
 
 
     
     /**
-     * Send a message to a TCP/IP socket (file descriptor)
+     * Wait until a file descriptor is ready for some events
+     * @param fd IN file descriptor
+     * @param events IN poll events (POLLIN, POLLOUT)
+     * @param timeout IN maximum wait time (milliseconds)
+     * @return a reason code; @ref FLOM_RC_NETWORK_TIMEOUT if the file
+     *         descriptor is not ready after timeout milliseconds
+     */
+    int flom_tcp_wait_fd(int fd, short events, int timeout);
+
+
+    
+    /**
+     * Send a message to a TCP/IP socket (file descriptor); the whole
+     * buffer is sent even if the socket is non blocking (see
+     * @ref FLOM_NETWORK_SEND_TIMEOUT)
      * @param obj IN TCP communication object
      * @param buf IN buffer will be used to store the XML message
      * @param len IN size of buf
@@ -351,6 +365,17 @@ extern "C" {
 
 
 
+    /**
+     * Switch the socket of a TCP/IP connection to non blocking mode and
+     * back
+     * @param obj IN TCP communication object
+     * @param value IN boolean value: TRUE non blocking, FALSE blocking
+     * @return a reason code
+     */
+    int flom_tcp_set_nonblocking(const flom_tcp_t *obj, int value);
+
+
+
     /**
      * Retrieve a string containing IP address and port of the connected
      * peer
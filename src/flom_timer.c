@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2013-2024, Christian Ferrari <tiian@users.sourceforge.net>
+ * All rights reserved.
+ *
+ * This file is part of FLoM, Free Lock Manager
+ *
+ * FLoM is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2.0 as
+ * published by the Free Software Foundation.
+ *
+ * FLoM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FLoM.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <config.h>
+
+
+
+#include "flom_defines.h"
+#include "flom_timer.h"
+#include "flom_trace.h"
+
+
+
+/* set module trace flag */
+#ifdef FLOM_TRACE_MODULE
+# undef FLOM_TRACE_MODULE
+#endif /* FLOM_TRACE_MODULE */
+#define FLOM_TRACE_MODULE   FLOM_TRACE_MOD_TIMER
+
+
+
+void flom_timer_wheel_init(flom_timer_wheel_t *wheel, guint64 now)
+{
+    guint i, j;
+
+    wheel->now = now;
+    wheel->count = 0;
+    for (i=0; i<FLOM_TIMER_WHEEL_LEVELS; ++i) {
+        wheel->level_count[i] = 0;
+        for (j=0; j<FLOM_TIMER_WHEEL_SLOTS; ++j)
+            wheel->slots[i][j].next = wheel->slots[i][j].prev =
+                &wheel->slots[i][j];
+    }
+    wheel->expired.next = wheel->expired.prev = &wheel->expired;
+}
+
+
+
+void flom_timer_wheel_add(flom_timer_wheel_t *wheel,
+                          flom_timer_t *timer, guint64 expire)
+{
+    flom_timer_wheel_del(wheel, timer);
+    /* the slot of the current tick has already been processed */
+    timer->expire = expire > wheel->now ? expire : wheel->now + 1;
+    flom_timer_wheel_insert(wheel, timer);
+}
+
+
+
+void flom_timer_wheel_insert(flom_timer_wheel_t *wheel,
+                             flom_timer_t *timer)
+{
+    flom_timer_t *head;
+    guint64 expire = timer->expire;
+    guint64 delta;
+    guint level = 0;
+
+    if (expire < wheel->now)
+        expire = wheel->now;
+    delta = expire - wheel->now;
+    while (level < FLOM_TIMER_WHEEL_LEVELS - 1 &&
+           delta >= ((guint64)1 << ((level + 1) * FLOM_TIMER_WHEEL_BITS)))
+        level++;
+    /* a timer beyond the horizon of the wheel is parked in the farthest
+       slot of the last level and it's re-inserted by the cascade */
+    if (delta >= ((guint64)1 << (FLOM_TIMER_WHEEL_LEVELS *
+                                 FLOM_TIMER_WHEEL_BITS)))
+        expire = wheel->now + ((guint64)1 << (FLOM_TIMER_WHEEL_LEVELS *
+                                              FLOM_TIMER_WHEEL_BITS)) - 1;
+    head = &wheel->slots[level][
+        (expire >> (level * FLOM_TIMER_WHEEL_BITS)) & FLOM_TIMER_WHEEL_MASK];
+    timer->level = level;
+    timer->next = head;
+    timer->prev = head->prev;
+    head->prev->next = timer;
+    head->prev = timer;
+    wheel->level_count[level]++;
+    wheel->count++;
+}
+
+
+
+void flom_timer_wheel_del(flom_timer_wheel_t *wheel, flom_timer_t *timer)
+{
+    if (!flom_timer_is_armed(timer))
+        return;
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = timer->prev = NULL;
+    if (FLOM_TIMER_WHEEL_LEVELS > timer->level) {
+        wheel->level_count[timer->level]--;
+        wheel->count--;
+    }
+}
+
+
+
+void flom_timer_wheel_advance(flom_timer_wheel_t *wheel, guint64 now)
+{
+    while (wheel->now < now) {
+        flom_timer_t *head;
+        guint level;
+
+        if (0 == wheel->count) {
+            wheel->now = now;
+            break;
+        }
+        /* the lower empty levels can be skipped up to the next cascade of
+           the first non empty level */
+        for (level=0; 0 == wheel->level_count[level]; ++level)
+            ;
+        if (0 < level) {
+            guint shift = level * FLOM_TIMER_WHEEL_BITS;
+            guint64 boundary = ((wheel->now >> shift) + 1) << shift;
+            if (boundary > now) {
+                wheel->now = now;
+                break;
+            }
+            wheel->now = boundary - 1;
+        }
+        wheel->now++;
+        /* upper levels cascade first: their timers can fall into the slot
+           of a lower level that is cascading now */
+        for (level=FLOM_TIMER_WHEEL_LEVELS-1; level>0; --level)
+            if (0 == (wheel->now & (((guint64)1 << (
+                                         level * FLOM_TIMER_WHEEL_BITS)) - 1)))
+                flom_timer_wheel_cascade(wheel, level);
+        /* all the timers of the current slot of the first level expire */
+        head = &wheel->slots[0][wheel->now & FLOM_TIMER_WHEEL_MASK];
+        while (head->next != head) {
+            flom_timer_t *timer = head->next;
+            flom_timer_wheel_del(wheel, timer);
+            timer->level = FLOM_TIMER_WHEEL_LEVELS;
+            timer->next = &wheel->expired;
+            timer->prev = wheel->expired.prev;
+            wheel->expired.prev->next = timer;
+            wheel->expired.prev = timer;
+        }
+    } /* while (wheel->now < now) */
+}
+
+
+
+void flom_timer_wheel_cascade(flom_timer_wheel_t *wheel, guint level)
+{
+    flom_timer_t *head = &wheel->slots[level][
+        (wheel->now >> (level * FLOM_TIMER_WHEEL_BITS)) &
+        FLOM_TIMER_WHEEL_MASK];
+    /* detach the list: the timers could be inserted again in the same
+       slot if they are beyond the horizon of the wheel */
+    flom_timer_t *timer = head->next;
+
+    if (timer == head)
+        return;
+    head->prev->next = NULL;
+    head->next = head->prev = head;
+    while (NULL != timer) {
+        flom_timer_t *next = timer->next;
+        wheel->level_count[level]--;
+        wheel->count--;
+        timer->next = timer->prev = NULL;
+        flom_timer_wheel_insert(wheel, timer);
+        timer = next;
+    }
+}
+
+
+
+flom_timer_t *flom_timer_wheel_pop_expired(flom_timer_wheel_t *wheel)
+{
+    flom_timer_t *timer = wheel->expired.next;
+
+    if (timer == &wheel->expired)
+        return NULL;
+    flom_timer_wheel_del(wheel, timer);
+    return timer;
+}
+
+
+
+int flom_timer_wheel_get_timeout(const flom_timer_wheel_t *wheel,
+                                 guint64 now)
+{
+    guint64 next = 0;
+    guint i;
+
+    if (wheel->expired.next != &wheel->expired)
+        return 0;
+    if (0 == wheel->count)
+        return -1;
+    if (0 < wheel->level_count[0])
+        for (i=1; i<=FLOM_TIMER_WHEEL_SLOTS; ++i) {
+            const flom_timer_t *head = &wheel->slots[0][
+                (wheel->now + i) & FLOM_TIMER_WHEEL_MASK];
+            if (head->next != head) {
+                next = wheel->now + i;
+                break;
+            }
+        } /* for (i=1; i<=FLOM_TIMER_WHEEL_SLOTS; ++i) */
+    /* the next cascade of the first non empty upper level */
+    for (i=1; i<FLOM_TIMER_WHEEL_LEVELS; ++i)
+        if (0 < wheel->level_count[i]) {
+            guint shift = i * FLOM_TIMER_WHEEL_BITS;
+            guint64 boundary = ((wheel->now >> shift) + 1) << shift;
+            if (0 == next || boundary < next)
+                next = boundary;
+            break;
+        }
+    FLOM_TRACE(("flom_timer_wheel_get_timeout: wheel->now=" UINT64_T_FORMAT
+                ", now=" UINT64_T_FORMAT ", next=" UINT64_T_FORMAT
+                ", count=%u\n", wheel->now, now, next, wheel->count));
+    if (next <= now)
+        return 0;
+    if (next - now > G_MAXINT)
+        return G_MAXINT;
+    return (int)(next - now);
+}
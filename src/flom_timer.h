@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2013-2024, Christian Ferrari <tiian@users.sourceforge.net>
+ * All rights reserved.
+ *
+ * This file is part of FLoM, Free Lock Manager
+ *
+ * FLoM is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2.0 as
+ * published by the Free Software Foundation.
+ *
+ * FLoM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FLoM.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FLOM_TIMER_H
+# define FLOM_TIMER_H
+
+
+
+#include <config.h>
+
+
+
+#ifdef HAVE_GLIB_H
+# include <glib.h>
+#endif
+
+
+
+/* save old FLOM_TRACE_MODULE and set a new value */
+#ifdef FLOM_TRACE_MODULE
+# define FLOM_TRACE_MODULE_SAVE FLOM_TRACE_MODULE
+# undef FLOM_TRACE_MODULE
+#else
+# undef FLOM_TRACE_MODULE_SAVE
+#endif /* FLOM_TRACE_MODULE */
+#define FLOM_TRACE_MODULE      FLOM_TRACE_MOD_TIMER
+
+
+
+/**
+ * Number of bits of the tick used to index the slots of a level of the
+ * wheel
+ */
+#define FLOM_TIMER_WHEEL_BITS      6
+/**
+ * Number of slots of every level of the wheel
+ */
+#define FLOM_TIMER_WHEEL_SLOTS     (1 << FLOM_TIMER_WHEEL_BITS)
+/**
+ * Mask used to compute the slot of a tick
+ */
+#define FLOM_TIMER_WHEEL_MASK      (FLOM_TIMER_WHEEL_SLOTS - 1)
+/**
+ * Number of levels of the wheel: a tick is a millisecond, the wheel
+ * covers 2^24 milliseconds (about 4.6 hours); farther timers are parked in
+ * the last level and re-inserted when the last level cascades
+ */
+#define FLOM_TIMER_WHEEL_LEVELS    4
+
+
+
+/**
+ * A timer that can be inserted into a @ref flom_timer_wheel_t; it's
+ * designed to be embedded inside the object it refers to
+ */
+typedef struct flom_timer_s {
+    /**
+     * Next timer in the same slot; NULL if the timer is not armed
+     */
+    struct flom_timer_s *next;
+    /**
+     * Previous timer in the same slot; NULL if the timer is not armed
+     */
+    struct flom_timer_s *prev;
+    /**
+     * Expiration tick (milliseconds, see @ref flom_timer_get_ticks)
+     */
+    guint64              expire;
+    /**
+     * Level of the wheel hosting the timer;
+     * @ref FLOM_TIMER_WHEEL_LEVELS means the timer is expired and it's
+     * waiting to be picked up by @ref flom_timer_wheel_pop_expired
+     */
+    guint                level;
+    /**
+     * Object the timer refers to
+     */
+    gpointer             data;
+} flom_timer_t;
+
+
+
+/**
+ * Hierarchical timer wheel: insertion and cancellation of a timer are
+ * O(1) operations, the cost of advancing the wheel does not depend on the
+ * number of armed timers. The object is not thread safe: it must be used
+ * by a single thread
+ */
+typedef struct flom_timer_wheel_s {
+    /**
+     * Last tick processed by @ref flom_timer_wheel_advance
+     */
+    guint64              now;
+    /**
+     * Number of armed timers (expired timers are not counted)
+     */
+    guint                count;
+    /**
+     * Number of armed timers for every level
+     */
+    guint                level_count[FLOM_TIMER_WHEEL_LEVELS];
+    /**
+     * Slots of the wheel: every slot is the sentinel of a circular list
+     */
+    flom_timer_t         slots[FLOM_TIMER_WHEEL_LEVELS]
+    [FLOM_TIMER_WHEEL_SLOTS];
+    /**
+     * Sentinel of the circular list of the expired timers
+     */
+    flom_timer_t         expired;
+} flom_timer_wheel_t;
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+
+
+    /**
+     * Current tick used by timer wheels: milliseconds from the monotonic
+     * clock
+     * @return the current tick
+     */
+    static inline guint64 flom_timer_get_ticks(void) {
+        return (guint64)(g_get_monotonic_time() / 1000);
+    }
+
+
+
+    /**
+     * Initialize a timer (it's not armed)
+     * @param timer IN/OUT timer to initialize
+     * @param data IN object the timer refers to
+     */
+    static inline void flom_timer_init(flom_timer_t *timer, gpointer data) {
+        timer->next = timer->prev = NULL;
+        timer->expire = 0;
+        timer->level = 0;
+        timer->data = data;
+    }
+
+
+
+    /**
+     * Check if a timer is inside a wheel (armed or expired)
+     * @param timer IN timer
+     * @return a boolean value
+     */
+    static inline int flom_timer_is_armed(const flom_timer_t *timer) {
+        return NULL != timer->next;
+    }
+
+
+
+    /**
+     * Retrieve the object the timer refers to
+     * @param timer IN timer
+     * @return the object
+     */
+    static inline gpointer flom_timer_get_data(const flom_timer_t *timer) {
+        return timer->data;
+    }
+
+
+
+    /**
+     * Initialize a timer wheel
+     * @param wheel IN/OUT wheel to initialize
+     * @param now IN current tick (see @ref flom_timer_get_ticks)
+     */
+    void flom_timer_wheel_init(flom_timer_wheel_t *wheel, guint64 now);
+
+
+
+    /**
+     * Number of armed timers
+     * @param wheel IN timer wheel
+     * @return the number of armed timers
+     */
+    static inline guint flom_timer_wheel_count(
+        const flom_timer_wheel_t *wheel) {
+        return wheel->count;
+    }
+
+
+
+    /**
+     * Arm a timer: if the timer is already armed, it's moved to the new
+     * expiration tick; an expiration tick in the past is moved to the next
+     * tick
+     * @param wheel IN/OUT timer wheel
+     * @param timer IN/OUT timer to arm
+     * @param expire IN expiration tick (see @ref flom_timer_get_ticks)
+     */
+    void flom_timer_wheel_add(flom_timer_wheel_t *wheel,
+                              flom_timer_t *timer, guint64 expire);
+
+
+
+    /**
+     * Put a timer into the slot associated to its expiration tick; it's
+     * used by @ref flom_timer_wheel_add and by the cascade of the levels
+     * @param wheel IN/OUT timer wheel
+     * @param timer IN/OUT timer (it must not be inside any list)
+     */
+    void flom_timer_wheel_insert(flom_timer_wheel_t *wheel,
+                                 flom_timer_t *timer);
+
+
+
+    /**
+     * Disarm a timer; nothing is done if the timer is not armed
+     * @param wheel IN/OUT timer wheel
+     * @param timer IN/OUT timer to disarm
+     */
+    void flom_timer_wheel_del(flom_timer_wheel_t *wheel,
+                              flom_timer_t *timer);
+
+
+
+    /**
+     * Advance the wheel up to the current tick: expired timers are moved
+     * to the expired list and they can be retrieved with
+     * @ref flom_timer_wheel_pop_expired
+     * @param wheel IN/OUT timer wheel
+     * @param now IN current tick (see @ref flom_timer_get_ticks)
+     */
+    void flom_timer_wheel_advance(flom_timer_wheel_t *wheel, guint64 now);
+
+
+
+    /**
+     * Move the timers of a slot of an upper level to the lower levels
+     * @param wheel IN/OUT timer wheel
+     * @param level IN level of the slot (it must be > 0)
+     */
+    void flom_timer_wheel_cascade(flom_timer_wheel_t *wheel, guint level);
+
+
+
+    /**
+     * Retrieve and disarm the first expired timer
+     * @param wheel IN/OUT timer wheel
+     * @return the expired timer or NULL if there are no expired timers
+     */
+    flom_timer_t *flom_timer_wheel_pop_expired(flom_timer_wheel_t *wheel);
+
+
+
+    /**
+     * Compute the number of milliseconds the caller can wait before the
+     * wheel must be advanced again; the value can be shorter than the
+     * next expiration because the cascade of an upper level is a wake-up
+     * point too
+     * @param wheel IN timer wheel
+     * @param now IN current tick (see @ref flom_timer_get_ticks)
+     * @return a timeout value (milliseconds) or -1 if there are no armed
+     *         timers
+     */
+    int flom_timer_wheel_get_timeout(const flom_timer_wheel_t *wheel,
+                                     guint64 now);
+
+
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+
+/* restore old value of FLOM_TRACE_MODULE */
+#ifdef FLOM_TRACE_MODULE_SAVE
+# undef FLOM_TRACE_MODULE
+# define FLOM_TRACE_MODULE FLOM_TRACE_MODULE_SAVE
+# undef FLOM_TRACE_MODULE_SAVE
+#endif /* FLOM_TRACE_MODULE_SAVE */
+
+
+
+#endif /* FLOM_TIMER_H */
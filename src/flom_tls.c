@@ -20,15 +20,28 @@
 
 
 
+#ifdef HAVE_STDIO_H
+# include <stdio.h>
+#endif
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
 #ifdef HAVE_STRING_H
 # include <string.h>
 #endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
 
 
 
 #include "flom_config.h"
 #include "flom_errors.h"
 #include "flom_syslog.h"
+#include "flom_tcp.h"
 #include "flom_tls.h"
 #include "flom_trace.h"
 
@@ -55,6 +68,39 @@ static GMutex flom_tls_mutex;
 
 
 
+/**
+ * Index of the custom callback data: it's allocated only once because
+ * every index enlarges the extra data of all the SSL structures created
+ * later. It's protected by @ref flom_tls_mutex
+ */
+static int flom_tls_callback_data_index = -1;
+
+
+
+/**
+ * This mutex is used to create the shared server context only once
+ */
+static GMutex flom_tls_server_mutex;
+
+
+
+/**
+ * TLS/SSL context shared by all the server connections of the process
+ * (see @ref flom_tls_server_context); it's protected by
+ * @ref flom_tls_server_mutex
+ */
+static SSL_CTX *flom_tls_server_ctx = NULL;
+
+
+
+/**
+ * Statistics of the handshakes completed by the process; they're
+ * protected by @ref flom_tls_mutex
+ */
+static flom_tls_stats_t flom_tls_stats;
+
+
+
 gchar *flom_tls_get_unique_id() {
     gchar *tmp = NULL;
     char *machine_id = dbus_get_local_machine_id();
@@ -205,8 +251,12 @@ int flom_tls_context(flom_tls_t *obj)
         }
         
         /* set callback data index */
-        obj->callback_data_index = SSL_get_ex_new_index(
-            0, "callback data index", NULL, NULL, NULL);
+        g_mutex_lock(&flom_tls_mutex);
+        if (-1 == flom_tls_callback_data_index)
+            flom_tls_callback_data_index = SSL_get_ex_new_index(
+                0, "callback data index", NULL, NULL, NULL);
+        obj->callback_data_index = flom_tls_callback_data_index;
+        g_mutex_unlock(&flom_tls_mutex);
         /* set callback function */
         mode = SSL_VERIFY_PEER;
         if (!obj->client)
@@ -216,6 +266,25 @@ int flom_tls_context(flom_tls_t *obj)
         SSL_CTX_set_verify(obj->ctx, mode, flom_tls_callback);
         /* set max depth for the certificate chain verification */
         SSL_CTX_set_verify_depth(obj->ctx, obj->depth+1);
+        /* the client sessions are not kept in memory: the process is
+           short lived and the sessions are persisted by the callback */
+        if (obj->client) {
+            SSL_CTX_set_session_cache_mode(
+                obj->ctx, SSL_SESS_CACHE_CLIENT |
+                SSL_SESS_CACHE_NO_INTERNAL_STORE);
+            SSL_CTX_sess_set_new_cb(obj->ctx, flom_tls_session_new_cb);
+        }
+        /* the kernel takes over the records after the handshake */
+        if (obj->kernel_offload) {
+#ifdef FLOM_TLS_KTLS
+            FLOM_TRACE(("flom_tls_context: enabling kernel TLS offload\n"));
+            SSL_CTX_set_options(obj->ctx, SSL_OP_ENABLE_KTLS);
+#else
+            FLOM_TRACE(("flom_tls_context: kernel TLS offload is not "
+                        "supported by the OpenSSL library, the records "
+                        "will be processed in user space\n"));
+#endif
+        }
         
         THROW(NONE);
     } CATCH {
@@ -240,6 +309,285 @@ int flom_tls_context(flom_tls_t *obj)
 
 
 
+int flom_tls_server_context(flom_tls_t *obj, const char *cert_file,
+                            const char *priv_key_file,
+                            const char *ca_cert_file)
+{
+    enum Exception { TLS_CONTEXT_ERROR
+                     , TLS_SET_CERT_ERROR
+                     , SSL_CTX_SET_SESSION_ID_CONTEXT_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+    
+    FLOM_TRACE(("flom_tls_server_context\n"));
+    /* the connections are accepted by many threads */
+    g_mutex_lock(&flom_tls_server_mutex);
+    TRY {
+        if (NULL == flom_tls_server_ctx) {
+            if (FLOM_RC_OK != (ret_cod = flom_tls_context(obj)))
+                THROW(TLS_CONTEXT_ERROR);
+            if (FLOM_RC_OK != (ret_cod = flom_tls_set_cert(
+                                   obj, cert_file, priv_key_file,
+                                   ca_cert_file)))
+                THROW(TLS_SET_CERT_ERROR);
+            /* the peer is verified: the sessions can be resumed only if
+               they are bound to a context */
+            if (1 != SSL_CTX_set_session_id_context(
+                    obj->ctx, (const unsigned char *)PACKAGE_NAME,
+                    sizeof(PACKAGE_NAME)-1)) {
+                unsigned long err = ERR_get_error();
+                FLOM_TRACE_SSLERR("flom_tls_server_context/"
+                                  "SSL_CTX_set_session_id_context:", err);
+                THROW(SSL_CTX_SET_SESSION_ID_CONTEXT_ERROR);
+            }
+            /* session cache and session tickets (enabled by default) */
+            SSL_CTX_set_session_cache_mode(obj->ctx, SSL_SESS_CACHE_SERVER);
+            SSL_CTX_sess_set_cache_size(obj->ctx,
+                                        FLOM_TLS_SESSION_CACHE_SIZE);
+            SSL_CTX_set_timeout(obj->ctx, FLOM_TLS_SESSION_TIMEOUT);
+            flom_tls_server_ctx = obj->ctx;
+            FLOM_TRACE(("flom_tls_server_context: created shared context "
+                        "%p\n", flom_tls_server_ctx));
+        } else {
+            if (NULL != obj->ctx)
+                SSL_CTX_free(obj->ctx);
+            obj->ctx = flom_tls_server_ctx;
+            obj->callback_data_index = flom_tls_callback_data_index;
+        }
+        /* the connection keeps its own reference to the shared context */
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+        CRYPTO_add(&obj->ctx->references, 1, CRYPTO_LOCK_SSL_CTX);
+#else
+        SSL_CTX_up_ref(obj->ctx);
+#endif
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case TLS_CONTEXT_ERROR:
+            case TLS_SET_CERT_ERROR:
+                break;
+            case SSL_CTX_SET_SESSION_ID_CONTEXT_ERROR:
+                ret_cod = FLOM_RC_SSL_CTX_SET_SESSION_ID_CONTEXT_ERROR;
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    g_mutex_unlock(&flom_tls_server_mutex);
+    FLOM_TRACE(("flom_tls_server_context/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    return ret_cod;
+}
+
+
+
+void flom_tls_server_context_free(void)
+{
+    g_mutex_lock(&flom_tls_server_mutex);
+    if (NULL != flom_tls_server_ctx) {
+        FLOM_TRACE(("flom_tls_server_context_free: releasing shared "
+                    "context %p\n", flom_tls_server_ctx));
+        SSL_CTX_free(flom_tls_server_ctx);
+        flom_tls_server_ctx = NULL;
+    }
+    g_mutex_unlock(&flom_tls_server_mutex);
+}
+
+
+
+void flom_tls_session_load(flom_tls_t *obj)
+{
+    gchar *contents = NULL;
+    gsize length = 0;
+    GError *error = NULL;
+    SSL_SESSION *session = NULL;
+    const unsigned char *p;
+
+    if (NULL == obj->callback_data.session_file)
+        return;
+    if (!g_file_get_contents(obj->callback_data.session_file, &contents,
+                             &length, &error)) {
+        FLOM_TRACE(("flom_tls_session_load: unable to read session file "
+                    "'%s' (%s), a full handshake will be performed\n",
+                    obj->callback_data.session_file, error->message));
+        g_error_free(error);
+        return;
+    }
+    p = (const unsigned char *)contents;
+    if (NULL == (session = d2i_SSL_SESSION(NULL, &p, (long)length))) {
+        unsigned long err = ERR_get_error();
+        FLOM_TRACE_SSLERR("flom_tls_session_load/d2i_SSL_SESSION:", err);
+    } else {
+        if (1 != SSL_set_session(obj->ssl, session)) {
+            unsigned long err = ERR_get_error();
+            FLOM_TRACE_SSLERR("flom_tls_session_load/SSL_set_session:", err);
+        } else {
+            FLOM_TRACE(("flom_tls_session_load: session loaded from file "
+                        "'%s'\n", obj->callback_data.session_file));
+        }
+        SSL_SESSION_free(session);
+    }
+    g_free(contents);
+}
+
+
+
+int flom_tls_session_new_cb(SSL *ssl, SSL_SESSION *session)
+{
+    enum Exception { NO_SESSION_FILE
+                     , I2D_SSL_SESSION_ERROR
+                     , G_TRY_MALLOC_ERROR
+                     , G_STRDUP_PRINTF_ERROR
+                     , MKSTEMP_ERROR
+                     , FCHMOD_ERROR
+                     , WRITE_ERROR
+                     , RENAME_ERROR
+                     , NONE } excp;
+    int ret_cod = FLOM_RC_INTERNAL_ERROR;
+
+    unsigned char *buffer = NULL;
+    gchar *tmp_file = NULL;
+    int fd = -1;
+    
+    FLOM_TRACE(("flom_tls_session_new_cb\n"));
+    TRY {
+        struct flom_tls_callback_data_s *data;
+        unsigned char *p;
+        int length;
+        
+        data = SSL_get_ex_data(ssl, flom_tls_callback_data_index);
+        if (NULL == data || NULL == data->session_file)
+            THROW(NO_SESSION_FILE);
+        if (0 >= (length = i2d_SSL_SESSION(session, NULL)))
+            THROW(I2D_SSL_SESSION_ERROR);
+        if (NULL == (buffer = g_try_malloc(length)))
+            THROW(G_TRY_MALLOC_ERROR);
+        p = buffer;
+        i2d_SSL_SESSION(session, &p);
+        /* the session contains the master secret: it must be readable
+           by the owner only and the clients that are reading the file
+           must never see a partial content; the temporary file is created
+           with an unpredictable name and it can not be a file (or a
+           symbolic link) prepared by another user */
+        if (NULL == (tmp_file = g_strdup_printf(
+                         "%s.XXXXXX", data->session_file)))
+            THROW(G_STRDUP_PRINTF_ERROR);
+        if (-1 == (fd = mkstemp(tmp_file)))
+            THROW(MKSTEMP_ERROR);
+        if (-1 == fchmod(fd, S_IRUSR|S_IWUSR))
+            THROW(FCHMOD_ERROR);
+        if (length != write(fd, buffer, length))
+            THROW(WRITE_ERROR);
+        close(fd);
+        fd = -1;
+        if (-1 == rename(tmp_file, data->session_file))
+            THROW(RENAME_ERROR);
+        FLOM_TRACE(("flom_tls_session_new_cb: session saved in file '%s' "
+                    "(%d bytes)\n", data->session_file, length));
+        
+        THROW(NONE);
+    } CATCH {
+        switch (excp) {
+            case NO_SESSION_FILE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            case I2D_SSL_SESSION_ERROR:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+                break;
+            case G_TRY_MALLOC_ERROR:
+                ret_cod = FLOM_RC_G_TRY_MALLOC_ERROR;
+                break;
+            case G_STRDUP_PRINTF_ERROR:
+                ret_cod = FLOM_RC_G_STRDUP_ERROR;
+                break;
+            case MKSTEMP_ERROR:
+                ret_cod = FLOM_RC_MKSTEMP_ERROR;
+                break;
+            case FCHMOD_ERROR:
+                ret_cod = FLOM_RC_FCHMOD_ERROR;
+                break;
+            case WRITE_ERROR:
+                ret_cod = FLOM_RC_WRITE_ERROR;
+                break;
+            case RENAME_ERROR:
+                ret_cod = FLOM_RC_RENAME_ERROR;
+                break;
+            case NONE:
+                ret_cod = FLOM_RC_OK;
+                break;
+            default:
+                ret_cod = FLOM_RC_INTERNAL_ERROR;
+        } /* switch (excp) */
+    } /* TRY-CATCH */
+    /* clean-up: a session that can't be saved is not an error, the next
+       client will perform a full handshake */
+    if (-1 != fd)
+        close(fd);
+    if (NULL != tmp_file) {
+        /* the temporary file exists only if mkstemp succeeded */
+        if (MKSTEMP_ERROR < excp && NONE > excp)
+            unlink(tmp_file);
+        g_free(tmp_file);
+    }
+    g_free(buffer);
+    FLOM_TRACE(("flom_tls_session_new_cb/excp=%d/"
+                "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
+    /* the reference to the session is not kept */
+    return 0;
+}
+
+
+
+void flom_tls_handshake_done(const flom_tls_t *obj)
+{
+    guint64 duration = (guint64)(g_get_monotonic_time() -
+                                 obj->handshake_start);
+    int reused = SSL_session_reused(obj->ssl);
+    int ktls_send = FALSE, ktls_recv = FALSE;
+
+#ifdef FLOM_TLS_KTLS
+    /* OpenSSL falls back silently if the kernel or the cipher can't be
+       used for the offload */
+    ktls_send = BIO_get_ktls_send(SSL_get_wbio(obj->ssl));
+    ktls_recv = BIO_get_ktls_recv(SSL_get_rbio(obj->ssl));
+    if (obj->kernel_offload)
+        FLOM_TRACE(("flom_tls_handshake_done: kernel TLS offload "
+                    "send=%d, recv=%d\n", ktls_send, ktls_recv));
+#endif
+
+    FLOM_TRACE(("flom_tls_handshake_done: %s handshake completed in "
+                UINT64_T_FORMAT " us\n", reused ? "abbreviated" : "full",
+                duration));
+    g_mutex_lock(&flom_tls_mutex);
+    if (reused) {
+        flom_tls_stats.resumed++;
+        flom_tls_stats.resumed_usec += duration;
+    } else {
+        flom_tls_stats.full++;
+        flom_tls_stats.full_usec += duration;
+    }
+    if (ktls_send)
+        flom_tls_stats.ktls_send++;
+    if (ktls_recv)
+        flom_tls_stats.ktls_recv++;
+    g_mutex_unlock(&flom_tls_mutex);
+}
+
+
+
+void flom_tls_get_stats(flom_tls_stats_t *stats)
+{
+    g_mutex_lock(&flom_tls_mutex);
+    *stats = flom_tls_stats;
+    g_mutex_unlock(&flom_tls_mutex);
+}
+
+
+
 int flom_tls_callback(int preverify_ok, X509_STORE_CTX *x509_ctx)
 {
     int ret_cod = TRUE;
@@ -415,9 +763,12 @@ int flom_tls_connect(flom_tls_t *obj, int sockfd)
     TRY {
         int rc;
         
+        obj->handshake_start = g_get_monotonic_time();
         /* SSL boilerplate... */
         if (FLOM_RC_OK != (ret_cod = flom_tls_prepare(obj, sockfd)))
             THROW(TSL_PREPARE_ERROR);
+        /* try to resume the session of a previous client */
+        flom_tls_session_load(obj);
         /* initiates the TLS/SSL handshake with the server */
         if (SSL_ERROR_NONE != (rc = SSL_get_error(
                                    obj->ssl, SSL_connect(obj->ssl)))) {
@@ -431,6 +782,7 @@ int flom_tls_connect(flom_tls_t *obj, int sockfd)
                         "encryption\n",
                         SSL_CIPHER_get_name(SSL_get_current_cipher(
                                                 obj->ssl))));
+            flom_tls_handshake_done(obj);
         }
         /* get peer certificate */
         obj->cert = flom_tls_cert_new();
@@ -465,21 +817,34 @@ int flom_tls_connect(flom_tls_t *obj, int sockfd)
 int flom_tls_accept(flom_tls_t *obj, int sockfd)
 {
     enum Exception { TSL_PREPARE_ERROR
+                     , HANDSHAKE_IN_PROGRESS
                      , SSL_ACCEPT_ERROR
                      , TLS_CERT_PARSE_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     
-    FLOM_TRACE(("flom_tls_accept\n"));
+    FLOM_TRACE(("flom_tls_accept: handshake=%d\n", obj->handshake));
     TRY {
         int rc;
         
-        /* SSL boilerplate... */
-        if (FLOM_RC_OK != (ret_cod = flom_tls_prepare(obj, sockfd)))
-            THROW(TSL_PREPARE_ERROR);
-        /* initiates the TLS/SSL handshake with the server */
-        if (SSL_ERROR_NONE != (rc = SSL_get_error(
-                                   obj->ssl, SSL_accept(obj->ssl)))) {
+        /* SSL boilerplate... only the first time: an handshake in progress
+           is resumed */
+        if (FLOM_TLS_HANDSHAKE_NONE == obj->handshake) {
+            obj->handshake_start = g_get_monotonic_time();
+            if (FLOM_RC_OK != (ret_cod = flom_tls_prepare(obj, sockfd)))
+                THROW(TSL_PREPARE_ERROR);
+        }
+        /* initiates (or resumes) the TLS/SSL handshake with the client */
+        rc = SSL_get_error(obj->ssl, SSL_accept(obj->ssl));
+        if (SSL_ERROR_WANT_READ == rc || SSL_ERROR_WANT_WRITE == rc) {
+            /* non blocking socket: the caller must wait the socket is
+               ready and call this function again */
+            obj->handshake = SSL_ERROR_WANT_READ == rc ?
+                FLOM_TLS_HANDSHAKE_WANT_READ : FLOM_TLS_HANDSHAKE_WANT_WRITE;
+            FLOM_TRACE(("flom_tls_accept/SSL_accept: handshake in progress "
+                        "(%s)\n", flom_tls_get_error_label(rc)));
+            THROW(HANDSHAKE_IN_PROGRESS);
+        } else if (SSL_ERROR_NONE != rc) {
             unsigned long err;
             FLOM_TRACE(("flom_tls_accept/SSL_accept: SSL error=%d (%s)\n",
                         rc, flom_tls_get_error_label(rc)));
@@ -487,10 +852,12 @@ int flom_tls_accept(flom_tls_t *obj, int sockfd)
             FLOM_TRACE_SSLERR("flom_tls_accept/SSL_accept:", err);
             THROW(SSL_ACCEPT_ERROR);
         } else {
+            obj->handshake = FLOM_TLS_HANDSHAKE_DONE;
             FLOM_TRACE(("flom_tls_accepted: connection accepted with %s "
                         "encryption\n",
                         SSL_CIPHER_get_name(SSL_get_current_cipher(
                                                 obj->ssl))));
+            flom_tls_handshake_done(obj);
         }
         /* get peer certificate */
         obj->cert = flom_tls_cert_new();
@@ -503,6 +870,9 @@ int flom_tls_accept(flom_tls_t *obj, int sockfd)
         switch (excp) {
             case TSL_PREPARE_ERROR:
                 break;
+            case HANDSHAKE_IN_PROGRESS:
+                ret_cod = FLOM_RC_TLS_HANDSHAKE_IN_PROGRESS;
+                break;
             case SSL_ACCEPT_ERROR:
                 ret_cod = FLOM_RC_SSL_ACCEPT_ERROR;
                 break;
@@ -524,7 +894,8 @@ int flom_tls_accept(flom_tls_t *obj, int sockfd)
 
 int flom_tls_send(flom_tls_t *obj, const void *buf, size_t len)
 {
-    enum Exception { SSL_WRITE_ERROR
+    enum Exception { TCP_WAIT_FD_ERROR
+                     , SSL_WRITE_ERROR
                      , SEND_ERROR
                      , NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
@@ -533,7 +904,21 @@ int flom_tls_send(flom_tls_t *obj, const void *buf, size_t len)
     TRY {
         int sent_bytes, ssl_rc;
 
-        sent_bytes = SSL_write(obj->ssl, buf, (int)len);
+        /* a non blocking socket can't accept the whole record now: the
+           write is retried with the same arguments when the socket is
+           ready again, a record is never truncated */
+        while (0 >= (sent_bytes = SSL_write(obj->ssl, buf, (int)len))) {
+            ssl_rc = SSL_get_error(obj->ssl, sent_bytes);
+            if (SSL_ERROR_WANT_WRITE != ssl_rc &&
+                SSL_ERROR_WANT_READ != ssl_rc)
+                break;
+            if (FLOM_RC_OK != (ret_cod = flom_tcp_wait_fd(
+                                   SSL_get_fd(obj->ssl),
+                                   SSL_ERROR_WANT_WRITE == ssl_rc ?
+                                   POLLOUT : POLLIN,
+                                   FLOM_NETWORK_SEND_TIMEOUT)))
+                THROW(TCP_WAIT_FD_ERROR);
+        } /* while (0 >= (sent_bytes = ... */
         if (0 >= sent_bytes) {
             unsigned long err;
             ssl_rc = SSL_get_error(obj->ssl, sent_bytes);
@@ -551,6 +936,8 @@ int flom_tls_send(flom_tls_t *obj, const void *buf, size_t len)
         THROW(NONE);
     } CATCH {
         switch (excp) {
+            case TCP_WAIT_FD_ERROR:
+                break;
             case SSL_WRITE_ERROR:
                 ret_cod = FLOM_RC_SSL_WRITE_ERROR;
                 break;
@@ -571,91 +958,58 @@ int flom_tls_send(flom_tls_t *obj, const void *buf, size_t len)
 
 
 
-int flom_tls_recv_msg(flom_tls_t *obj, char *buf, size_t len,
-                      size_t *received)
+int flom_tls_recv_chunk(flom_tls_t *obj, char *buf, size_t len,
+                        size_t *received)
 {
     enum Exception {
-        OUT_OF_RANGE,
+        WOULD_BLOCK,
         SSL_READ_ERROR,
-        BUFFER_OVERFLOW,
         NONE } excp;
     int ret_cod = FLOM_RC_INTERNAL_ERROR;
     
-    FLOM_TRACE(("flom_tls_recv_msg\n"));
+    FLOM_TRACE(("flom_tls_recv_chunk\n"));
     TRY {
-        char closing_tag[FLOM_MSG_BUFFER_SIZE];
         size_t retrieved = 0;
-        size_t closing_tag_len;
-        size_t to_be_read;
         int read_bytes;
-        char closing_tag_last;
-        int found = FALSE;
-        int i, j;
-        
-        /* preparing the closing tag string */
-        snprintf(closing_tag, sizeof(closing_tag), "</%s>",
-                 FLOM_MSG_TAG_MSG);
-        closing_tag_len = strlen(closing_tag);
-        closing_tag_last = closing_tag[closing_tag_len-1];
-        FLOM_TRACE(("flom_tls_recv_msg: closing_tag='%s', closing_tag_len="
-                    SIZE_T_FORMAT ", closing_tag_last='%c'\n",
-                    closing_tag, closing_tag_len, closing_tag_last));
-        if (len < closing_tag_len)
-            THROW(OUT_OF_RANGE);
-        /* loop until a complete message has been retrieved or an error
-           occurs */
-        to_be_read = closing_tag_len;
-        while (!found) {
-            read_bytes = SSL_read(obj->ssl, buf+retrieved, (int)to_be_read);
-            FLOM_TRACE(("flom_tls_recv_msg: read_bytes=%d '%*.*s'\n",
-                        read_bytes, read_bytes, read_bytes, buf+retrieved));
+
+        /* the records already decrypted by the library are drained too:
+           poll/epoll would not report them */
+        do {
+            read_bytes = SSL_read(obj->ssl, buf+retrieved,
+                                  (int)(len-retrieved));
+            FLOM_TRACE(("flom_tls_recv_chunk: read_bytes=%d\n",
+                        read_bytes));
             if (0 >= read_bytes) {
                 unsigned long err;
                 int ssl_rc = SSL_get_error(obj->ssl, read_bytes);
-                FLOM_TRACE(("flom_tls_recv_msg/SSL_read: SSL error=%d (%s)\n",
-                            ssl_rc, flom_tls_get_error_label(ssl_rc)));
+                FLOM_TRACE(("flom_tls_recv_chunk/SSL_read: SSL error=%d "
+                            "(%s)\n", ssl_rc,
+                            flom_tls_get_error_label(ssl_rc)));
+                /* a non blocking socket does not contain a complete
+                   record yet */
+                if (SSL_ERROR_WANT_READ == ssl_rc ||
+                    SSL_ERROR_WANT_WRITE == ssl_rc) {
+                    if (0 < retrieved)
+                        break;
+                    THROW(WOULD_BLOCK);
+                }
                 err = ERR_get_error();
-                FLOM_TRACE_SSLERR("flom_tls_recv_msg/SSL_read:", err);
+                FLOM_TRACE_SSLERR("flom_tls_recv_chunk/SSL_read:", err);
                 THROW(SSL_READ_ERROR);
             }
             retrieved += read_bytes;
-            /* too few chars, go on */
-            if (retrieved < closing_tag_len)
-                continue;
-            /* looping on closing_tag */
-            j = 0;
-            for (i=0; i<closing_tag_len; ++i) {
-                if (buf[retrieved-j-1] == closing_tag[closing_tag_len-i-1])
-                    j++;
-                else
-                    j = 0;
-            } /* for (i=0; i<closing_tag_len; ++i) */
-            if (j == closing_tag_len)
-                found = TRUE;
-            else {
-                to_be_read = closing_tag_len - j;
-                if (retrieved + to_be_read >= len)
-                    THROW(BUFFER_OVERFLOW);
-            }
-        } /* while (TRUE) */
-        /* put string terminator */
-        buf[retrieved] = '\0';
+        } while (retrieved < len && 0 < SSL_pending(obj->ssl));
         *received = retrieved;
-        FLOM_TRACE(("flom_tls_recv_msg: received message is '%s' "
-                    "of " SIZE_T_FORMAT " chars\n", buf, *received));
         
         THROW(NONE);
     } CATCH {
         switch (excp) {
-            case OUT_OF_RANGE:
-                ret_cod = FLOM_RC_OUT_OF_RANGE;
+            case WOULD_BLOCK:
+                ret_cod = FLOM_RC_WOULD_BLOCK;
                 break;
             case SSL_READ_ERROR:
                 ret_cod = FLOM_RC_SSL_READ_ERROR;
                 break;
-            case BUFFER_OVERFLOW:
-                ret_cod = FLOM_RC_BUFFER_OVERFLOW;
-                break;
             case NONE:
                 ret_cod = FLOM_RC_OK;
                 break;
@@ -663,7 +1017,7 @@ int flom_tls_recv_msg(flom_tls_t *obj, char *buf, size_t len,
                 ret_cod = FLOM_RC_INTERNAL_ERROR;
         } /* switch (excp) */
     } /* TRY-CATCH */
-    FLOM_TRACE(("flom_tls_recv_msg/excp=%d/"
+    FLOM_TRACE(("flom_tls_recv_chunk/excp=%d/"
                 "ret_cod=%d/errno=%d\n", excp, ret_cod, errno));
     return ret_cod;
 }
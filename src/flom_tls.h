@@ -28,6 +28,9 @@
 #ifdef HAVE_DBUS_DBUS_H
 # include <dbus/dbus.h>
 #endif
+#ifdef HAVE_POLL_H
+# include <poll.h>
+#endif
 #ifdef HAVE_OPENSSL_SSL_H
 # include <openssl/ssl.h>
 #endif
@@ -51,6 +54,16 @@
 
 
 
+/**
+ * Kernel TLS offload is supported by the OpenSSL library (OpenSSL 3.0 or
+ * newer built with KTLS support)
+ */
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+# define FLOM_TLS_KTLS
+#endif
+
+
+
 /**
  * Maximum depth for the certificate chain verification
  */
@@ -66,21 +79,75 @@
 
 
 /**
- * Custom data passed to verify callback OpenSSL function
+ * Maximum number of sessions kept by the server side session cache
+ */
+#define FLOM_TLS_SESSION_CACHE_SIZE         4096
+
+
+
+/**
+ * Lifetime (seconds) of the sessions issued by the daemon: a client
+ * that reconnects inside this interval performs an abbreviated handshake
+ */
+#define FLOM_TLS_SESSION_TIMEOUT            3600
+
+
+
+/**
+ * Custom data passed to callback OpenSSL functions
  */
 struct flom_tls_callback_data_s {
     /**
      * Certification chain verification depth
      */
-    int      depth;
+    int          depth;
     /**
      * Don't stop, do another step
      */
-    int      dont_stop;
+    int          dont_stop;
+    /**
+     * Name of the file used to persist the client side session; NULL if
+     * the sessions must not be resumed
+     */
+    const gchar *session_file;
 };
 
 
 
+/**
+ * Statistics of the handshakes completed by the process
+ */
+typedef struct {
+    /**
+     * Number of full handshakes
+     */
+    guint64 full;
+    /**
+     * Number of abbreviated handshakes (resumed sessions)
+     */
+    guint64 resumed;
+    /**
+     * Total duration of the full handshakes (microseconds)
+     */
+    guint64 full_usec;
+    /**
+     * Total duration of the abbreviated handshakes (microseconds)
+     */
+    guint64 resumed_usec;
+    /**
+     * Number of connections that send the records through the kernel
+     * (kTLS)
+     */
+    guint64 ktls_send;
+    /**
+     * Number of connections that receive the records through the kernel
+     * (kTLS)
+     */
+    guint64 ktls_recv;
+} flom_tls_stats_t;
+
+
+
 /**
  * Breakdown structure used to store all the strings related to a certificate
  */
@@ -128,6 +195,30 @@ typedef struct {
 
 
 
+/**
+ * Progress of the server side TLS handshake driven by @ref flom_tls_accept
+ */
+typedef enum flom_tls_handshake_e {
+    /**
+     * The handshake has not been started yet
+     */
+    FLOM_TLS_HANDSHAKE_NONE,
+    /**
+     * The handshake must be resumed when the socket is readable
+     */
+    FLOM_TLS_HANDSHAKE_WANT_READ,
+    /**
+     * The handshake must be resumed when the socket is writable
+     */
+    FLOM_TLS_HANDSHAKE_WANT_WRITE,
+    /**
+     * The handshake completed successfully
+     */
+    FLOM_TLS_HANDSHAKE_DONE
+} flom_tls_handshake_t;
+
+
+
 /**
  * Object used to manage a TLS connection: it contains all the necessary data
  * and avoid the usage of static data
@@ -162,6 +253,20 @@ typedef struct {
      * Index to custom callback data
      */
     int                                   callback_data_index;
+    /**
+     * Progress of the server side handshake
+     */
+    flom_tls_handshake_t                  handshake;
+    /**
+     * Monotonic time (microseconds) of the first handshake step
+     */
+    gint64                                handshake_start;
+    /**
+     * Boolean: after the handshake, the records must be encrypted and
+     * decrypted by the kernel (kTLS) if the kernel and the negotiated
+     * cipher support it
+     */
+    int                                   kernel_offload;
 } flom_tls_t;
 
 
@@ -246,6 +351,99 @@ extern "C" {
 
 
 
+    /**
+     * Attach the TLS/SSL context shared by all the server connections of
+     * the process; the context is created, and the certificates are set,
+     * only the first time. The shared context keeps the session cache and
+     * the session ticket keys: a client that reconnects can resume its
+     * session with an abbreviated handshake
+     * @param obj IN/OUT connection object reference
+     * @param cert_file IN local certificate filename
+     * @param priv_key_file IN private key filename
+     * @param ca_cert_file IN ca certificate filename
+     * @return a reason code
+     */
+    int flom_tls_server_context(flom_tls_t *obj, const char *cert_file,
+                                const char *priv_key_file,
+                                const char *ca_cert_file);
+
+
+
+    /**
+     * Release the TLS/SSL context shared by the server connections; the
+     * connections that are still using it keep their own reference
+     */
+    void flom_tls_server_context_free(void);
+
+
+
+    /**
+     * Set the file used to persist the client side session: the session
+     * is loaded by @ref flom_tls_connect and it's saved every time the
+     * server issues a new one
+     * @param obj IN/OUT TLS object
+     * @param session_file IN file name; the string is not copied and it
+     *        must live as long as the TLS object
+     */
+    static inline void flom_tls_set_session_file(flom_tls_t *obj,
+                                                 const gchar *session_file) {
+        obj->callback_data.session_file = session_file;
+    }
+
+
+
+    /**
+     * Ask the kernel TLS offload (kTLS) for the connection; it must be
+     * called before the context is created. The records are processed in
+     * user space if the library, the kernel or the negotiated cipher do
+     * not support it
+     * @param obj IN/OUT TLS object
+     * @param value IN boolean value
+     */
+    static inline void flom_tls_set_kernel_offload(flom_tls_t *obj,
+                                                   int value) {
+        obj->kernel_offload = value;
+    }
+
+
+
+    /**
+     * Load the session persisted by a previous client and pass it to the
+     * TLS/SSL structure: a missing or invalid file is not an error, a full
+     * handshake will be performed
+     * @param obj IN/OUT TLS object
+     */
+    void flom_tls_session_load(flom_tls_t *obj);
+
+
+
+    /**
+     * New session callback function: the session is saved in the session
+     * file of the client
+     * @param ssl IN SSL object that received the session
+     * @param session IN session issued by the server
+     * @return 0 because the session reference is not kept
+     */
+    int flom_tls_session_new_cb(SSL *ssl, SSL_SESSION *session);
+
+
+
+    /**
+     * Account a completed handshake in the statistics of the process
+     * @param obj IN TLS object
+     */
+    void flom_tls_handshake_done(const flom_tls_t *obj);
+
+
+
+    /**
+     * Retrieve the statistics of the handshakes completed by the process
+     * @param stats OUT a copy of the statistics
+     */
+    void flom_tls_get_stats(flom_tls_stats_t *stats);
+
+
+
     /**
      * Verify callback function
      * @param preverify_ok IN indicates, whether the verification of the
@@ -293,17 +491,53 @@ extern "C" {
 
     
     /**
-     * Switch a standard TCP server connection to a TLS server connection
+     * Switch a standard TCP server connection to a TLS server connection.
+     * If the socket is non blocking the handshake is a state machine: the
+     * function returns @ref FLOM_RC_TLS_HANDSHAKE_IN_PROGRESS when the
+     * socket is not ready and it must be called again, with the same
+     * arguments, when the socket becomes ready for the direction returned
+     * by @ref flom_tls_get_handshake_events
      * @param obj IN/OUT TLS object
      * @param sockfd IN file descriptor of the socket already connected
      * @return a reason code
      */
     int flom_tls_accept(flom_tls_t *obj, int sockfd);
+
+
+
+    /**
+     * Getter method for handshake property
+     * @param obj IN TLS object
+     * @return the progress of the server side handshake
+     */
+    static inline flom_tls_handshake_t flom_tls_get_handshake(
+        const flom_tls_t *obj) {
+        return obj->handshake;
+    }
+
+
+
+    /**
+     * Poll events needed to resume an handshake in progress
+     * @param obj IN TLS object
+     * @return POLLIN, POLLOUT or 0 if the handshake is not in progress
+     */
+    static inline short flom_tls_get_handshake_events(const flom_tls_t *obj) {
+        switch (obj->handshake) {
+            case FLOM_TLS_HANDSHAKE_WANT_READ:
+                return POLLIN;
+            case FLOM_TLS_HANDSHAKE_WANT_WRITE:
+                return POLLOUT;
+            default:
+                return 0;
+        }
+    }
     
 
 
     /**
-     * Send a buffer using TLS over TCP/IP
+     * Send a buffer using TLS over TCP/IP; the whole buffer is sent even
+     * if the socket is non blocking (see @ref FLOM_NETWORK_SEND_TIMEOUT)
      * @param obj IN/OUT TLS object
      * @param buf IN buffer to send
      * @param len IN buffer lenght
@@ -314,15 +548,18 @@ extern "C" {
     
 
     /**
-     * Receive an XML message using TLS over TCP/IP
+     * Receive the bytes available using TLS over TCP/IP; it waits only if
+     * no byte is available (message framing is performed by
+     * @ref flom_conn_recv)
      * @param obj IN/OUT TLS object
-     * @param buf OUT buffer to send
+     * @param buf OUT buffer for the received bytes
      * @param len IN buffer lenght
      * @param received OUT number of read bytes
-     * @return a reason code
+     * @return a reason code; @ref FLOM_RC_WOULD_BLOCK if the socket is non
+     *         blocking and no record is available
      */
-    int flom_tls_recv_msg(flom_tls_t *obj, char *buf, size_t len,
-                          size_t *received);
+    int flom_tls_recv_chunk(flom_tls_t *obj, char *buf, size_t len,
+                            size_t *received);
 
 
     
@@ -158,6 +158,16 @@
  */
 #define FLOM_TRACE_MOD_TCP                0x00400000
 
+/**
+ * trace module for timer functions
+ */
+#define FLOM_TRACE_MOD_TIMER              0x00800000
+
+/**
+ * trace module for multiple lock functions
+ */
+#define FLOM_TRACE_MOD_MLOCK              0x01000000
+
 
 
 /**
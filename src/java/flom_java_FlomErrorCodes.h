@@ -185,10 +185,6 @@ extern "C" {
 #define org_tiian_flom_FlomErrorCodes_FLOM_RC_G_KEY_FILE_LOAD_FROM_FILE_ERROR -203L
 #undef org_tiian_flom_FlomErrorCodes_FLOM_RC_G_KEY_FILE_NEW_ERROR
 #define org_tiian_flom_FlomErrorCodes_FLOM_RC_G_KEY_FILE_NEW_ERROR -204L
-#undef org_tiian_flom_FlomErrorCodes_FLOM_RC_G_MARKUP_PARSE_CONTEXT_NEW_ERROR
-#define org_tiian_flom_FlomErrorCodes_FLOM_RC_G_MARKUP_PARSE_CONTEXT_NEW_ERROR -205L
-#undef org_tiian_flom_FlomErrorCodes_FLOM_RC_G_MARKUP_PARSE_CONTEXT_PARSE_ERROR
-#define org_tiian_flom_FlomErrorCodes_FLOM_RC_G_MARKUP_PARSE_CONTEXT_PARSE_ERROR -206L
 #undef org_tiian_flom_FlomErrorCodes_FLOM_RC_G_PTR_ARRAY_REMOVE_INDEX_FAST_ERROR
 #define org_tiian_flom_FlomErrorCodes_FLOM_RC_G_PTR_ARRAY_REMOVE_INDEX_FAST_ERROR -207L
 #undef org_tiian_flom_FlomErrorCodes_FLOM_RC_G_QUEUE_NEW_ERROR
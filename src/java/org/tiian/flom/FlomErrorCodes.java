@@ -15,6 +15,10 @@ public class FlomErrorCodes {
 	public final static int FLOM_ES_GENERIC_ERROR = 99;
 	/** Constant for error code 0 */
 	public final static int FLOM_ES_OK = 0;
+	/** Constant for error code +15 */
+	public final static int FLOM_RC_WOULD_BLOCK = +15;
+	/** Constant for error code +14 */
+	public final static int FLOM_RC_TLS_HANDSHAKE_IN_PROGRESS = +14;
 	/** Constant for error code +13 */
 	public final static int FLOM_RC_INACTIVE_FEATURE = +13;
 	/** Constant for error code +12 */
@@ -99,6 +103,12 @@ public class FlomErrorCodes {
 	public final static int FLOM_RC_CONNECTION_CLOSED_BY_SERVER = -27;
 	/** Constant for error code -28 */
 	public final static int FLOM_RC_OBJ_NOT_FOUND_ERROR = -28;
+	/** Constant for error code -29 */
+	public final static int FLOM_RC_XML_SYNTAX_ERROR = -29;
+	/** Constant for error code -30 */
+	public final static int FLOM_RC_DUPLICATED_RESOURCE = -30;
+	/** Constant for error code -31 */
+	public final static int FLOM_RC_RING_FULL = -31;
 	/** Constant for error code -100 */
 	public final static int FLOM_RC_ACCEPT_ERROR = -100;
 	/** Constant for error code -101 */
@@ -187,6 +197,18 @@ public class FlomErrorCodes {
 	public final static int FLOM_RC_WAIT_ERROR = -142;
 	/** Constant for error code -143 */
 	public final static int FLOM_RC_WRITE_ERROR = -143;
+	/** Constant for error code -144 */
+	public final static int FLOM_RC_EPOLL_WAIT_ERROR = -144;
+	/** Constant for error code -145 */
+	public final static int FLOM_RC_EVENTFD_ERROR = -145;
+	/** Constant for error code -146 */
+	public final static int FLOM_RC_SOCKETPAIR_ERROR = -146;
+	/** Constant for error code -147 */
+	public final static int FLOM_RC_RENAME_ERROR = -147;
+	/** Constant for error code -148 */
+	public final static int FLOM_RC_MKSTEMP_ERROR = -148;
+	/** Constant for error code -149 */
+	public final static int FLOM_RC_FCHMOD_ERROR = -149;
 	/** Constant for error code -200 */
 	public final static int FLOM_RC_G_ARRAY_NEW_ERROR = -200;
 	/** Constant for error code -201 */
@@ -197,10 +219,6 @@ public class FlomErrorCodes {
 	public final static int FLOM_RC_G_KEY_FILE_LOAD_FROM_FILE_ERROR = -203;
 	/** Constant for error code -204 */
 	public final static int FLOM_RC_G_KEY_FILE_NEW_ERROR = -204;
-	/** Constant for error code -205 */
-	public final static int FLOM_RC_G_MARKUP_PARSE_CONTEXT_NEW_ERROR = -205;
-	/** Constant for error code -206 */
-	public final static int FLOM_RC_G_MARKUP_PARSE_CONTEXT_PARSE_ERROR = -206;
 	/** Constant for error code -207 */
 	public final static int FLOM_RC_G_NODE_APPEND_DATA_ERROR = -207;
 	/** Constant for error code -208 */
@@ -257,6 +275,8 @@ public class FlomErrorCodes {
 	public final static int FLOM_RC_SSL_WRITE_ERROR = -412;
 	/** Constant for error code -413 */
 	public final static int FLOM_RC_TLS_NO_VALID_METHOD = -413;
+	/** Constant for error code -414 */
+	public final static int FLOM_RC_SSL_CTX_SET_SESSION_ID_CONTEXT_ERROR = -414;
 	/**
 	 * Retrieve the text associated to a FLoM code
 	 * @param code is the code returned by the C native functions
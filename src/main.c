@@ -63,10 +63,14 @@ static gint unicast_port = _DEFAULT_DAEMON_PORT;
 static gchar *multicast_address = NULL;
 static gint multicast_port = _DEFAULT_DAEMON_PORT;
 static gchar *mount_point_vfs = NULL;
+static gint locker_threads = _DEFAULT_LOCKER_THREADS;
+static gint acceptor_threads = _DEFAULT_ACCEPTOR_THREADS;
 static gchar *network_interface = NULL;
 static gint discovery_attempts = _DEFAULT_DISCOVERY_ATTEMPTS;
 static gint discovery_timeout = _DEFAULT_DISCOVERY_TIMEOUT;
 static gint discovery_ttl = _DEFAULT_DISCOVERY_TTL;
+static gchar *discovery_cache_file = NULL;
+static gint discovery_cache_lifespan = _DEFAULT_DISCOVERY_CACHE_LIFESPAN;
 static gint tcp_keepalive_time = _DEFAULT_TCP_KEEPALIVE_TIME;
 static gint tcp_keepalive_intvl = _DEFAULT_TCP_KEEPALIVE_INTVL;
 static gint tcp_keepalive_probes = _DEFAULT_TCP_KEEPALIVE_PROBES;
@@ -74,6 +78,9 @@ static gchar *tls_certificate = NULL;
 static gchar *tls_private_key = NULL;
 static gchar *tls_ca_certificate = NULL;
 static gchar *tls_check_peer_id = NULL;
+static gchar *tls_session_file = NULL;
+static gchar *tls_kernel_offload = NULL;
+static gchar *binary_protocol = NULL;
 static gchar **ignore_signal_array = NULL;
 static gboolean signal_list = FALSE;
 static gint quiesce_exit = 0;
@@ -103,17 +110,24 @@ static GOptionEntry entries[] =
     { "multicast-address", 'A', 0, G_OPTION_ARG_STRING, &multicast_address, "Daemon UDP/IP (multicast) address", NULL },
     { "multicast-port", 'P', 0, G_OPTION_ARG_INT, &multicast_port, "Daemon UDP/IP (multicast) port", NULL },
     { "mount-point-vfs", 'm', 0, G_OPTION_ARG_STRING, &mount_point_vfs, "Mount point of daemon Virtual File System", NULL },
+    { "locker-threads", 0, 0, G_OPTION_ARG_INT, &locker_threads, "Number of threads used by the daemon to manage the resources (0 means one for every online processor)", NULL },
+    { "acceptor-threads", 0, 0, G_OPTION_ARG_INT, &acceptor_threads, "Number of threads used by a TCP/IP daemon to accept the connections", NULL },
     { "network-interface", 'n', 0, G_OPTION_ARG_STRING, &network_interface, "Network interface that must be used for IPv6 link local addresses", NULL },
     { "discovery-attempts", 'D', 0, G_OPTION_ARG_INT, &discovery_attempts, "UDP/IP (multicast) max number of requests", NULL },
     { "discovery-timeout", 'I', 0, G_OPTION_ARG_INT, &discovery_timeout, "UDP/IP (multicast) request timeout", NULL },
     { "discovery-ttl", 0, 0, G_OPTION_ARG_INT, &discovery_ttl, "UDP/IP (multicast) hop limit", NULL },
+    { "discovery-cache-file", 0, 0, G_OPTION_ARG_STRING, &discovery_cache_file, "File used to cache the address of the daemon located by UDP/IP (multicast) discovery", NULL },
+    { "discovery-cache-lifespan", 0, 0, G_OPTION_ARG_INT, &discovery_cache_lifespan, "Lifespan of the cached daemon address (seconds)", NULL },
     { "tcp-keepalive-time", 0, 0, G_OPTION_ARG_INT, &tcp_keepalive_time, "Local override for SO_KEEPALIVE feature", NULL },
     { "tcp-keepalive-intvl", 0, 0, G_OPTION_ARG_INT, &tcp_keepalive_intvl, "Local override for SO_KEEPALIVE feature", NULL },
     { "tcp-keepalive-probes", 0, 0, G_OPTION_ARG_INT, &tcp_keepalive_probes, "Local override for SO_KEEPALIVE feature", NULL },
+    { "binary-protocol", 0, 0, G_OPTION_ARG_STRING, &binary_protocol, "Use the compact binary protocol level instead of XML (accepted values are 'yes', 'no')", NULL },
     { "tls-certificate", 0, 0, G_OPTION_ARG_STRING, &tls_certificate, "Name of the file that contains the X.509 certificate of this peer", NULL },
     { "tls-private-key", 0, 0, G_OPTION_ARG_STRING, &tls_private_key, "Name of the file that contains the private key of this peer", NULL },
     { "tls-ca-certificate", 0, 0, G_OPTION_ARG_STRING, &tls_ca_certificate, "Name of the file that contains the X.509 certificate of the certification authority that signed the certificate of this peer", NULL },
     { "tls-check-peer-id", 0, 0, G_OPTION_ARG_STRING, &tls_check_peer_id, "Check the unique id of the peer (accepted values are 'yes', 'no')", NULL },
+    { "tls-session-file", 0, 0, G_OPTION_ARG_STRING, &tls_session_file, "Name of the file used to persist the TLS session and resume it with an abbreviated handshake", NULL },
+    { "tls-kernel-offload", 0, 0, G_OPTION_ARG_STRING, &tls_kernel_offload, "Let the kernel process the TLS records after the handshake (accepted values are 'yes', 'no')", NULL },
     { "ignore-signal", 0, 0, G_OPTION_ARG_STRING_ARRAY, &ignore_signal_array, "Ignore a specific signal, can be repeated to specify more than one", NULL },
     { "signal-list", 0, 0, G_OPTION_ARG_NONE, &signal_list, "Print the list of signals that can be ignored and exit" },
     { "daemon-trace-file", 't', 0, G_OPTION_ARG_STRING, &daemon_trace_file, "Specify daemon (background process) trace file name (absolute path required)", NULL },
@@ -266,6 +280,12 @@ int main (int argc, char *argv[])
             exit(FLOM_ES_GENERIC_ERROR);
         }
     }
+    if (_DEFAULT_LOCKER_THREADS != locker_threads) {
+        flom_config_set_locker_threads(NULL, locker_threads);
+    }
+    if (_DEFAULT_ACCEPTOR_THREADS != acceptor_threads) {
+        flom_config_set_acceptor_threads(NULL, acceptor_threads);
+    }
     if (NULL != network_interface) {
         flom_config_set_network_interface(NULL, network_interface);
     }
@@ -278,6 +298,11 @@ int main (int argc, char *argv[])
     if (_DEFAULT_DISCOVERY_TTL != discovery_ttl) {
         flom_config_set_discovery_ttl(NULL, discovery_ttl);
     }
+    if (NULL != discovery_cache_file)
+        flom_config_set_discovery_cache_file(NULL, discovery_cache_file);
+    if (_DEFAULT_DISCOVERY_CACHE_LIFESPAN != discovery_cache_lifespan)
+        flom_config_set_discovery_cache_lifespan(
+            NULL, discovery_cache_lifespan);
     if (_DEFAULT_TCP_KEEPALIVE_TIME != tcp_keepalive_time) {
         flom_config_set_tcp_keepalive_time(NULL, tcp_keepalive_time);
     }
@@ -292,6 +317,16 @@ int main (int argc, char *argv[])
         g_strfreev(ignore_signal_array);
         ignore_signal_array = NULL;
     }
+    if (NULL != binary_protocol) {
+        flom_bool_value_t fbv;
+        if (FLOM_BOOL_INVALID == (
+                fbv = flom_bool_value_retrieve(binary_protocol))) {
+            g_print("binary-protocol: '%s' is an invalid value\n",
+                    binary_protocol);
+            exit(FLOM_ES_GENERIC_ERROR);
+        }
+        flom_config_set_binary_protocol(NULL, fbv);
+    }
     if (NULL != tls_certificate) {
         if (FLOM_RC_OK != flom_config_set_tls_certificate(
                 NULL, tls_certificate)) {
@@ -326,6 +361,18 @@ int main (int argc, char *argv[])
         }
         flom_config_set_tls_check_peer_id(NULL, fbv);
     }
+    if (NULL != tls_session_file)
+        flom_config_set_tls_session_file(NULL, tls_session_file);
+    if (NULL != tls_kernel_offload) {
+        flom_bool_value_t fbv;
+        if (FLOM_BOOL_INVALID == (
+                fbv = flom_bool_value_retrieve(tls_kernel_offload))) {
+            g_print("tls-kernel-offload: '%s' is an invalid value\n",
+                    tls_kernel_offload);
+            exit(FLOM_ES_GENERIC_ERROR);
+        }
+        flom_config_set_tls_kernel_offload(NULL, fbv);
+    }
 
     if (NULL != append_trace_file) {
         flom_bool_value_t fbv;
@@ -219,10 +219,6 @@ abstract class flom {
 
 	const FLOM_RC_G_KEY_FILE_NEW_ERROR = FLOM_RC_G_KEY_FILE_NEW_ERROR;
 
-	const FLOM_RC_G_MARKUP_PARSE_CONTEXT_NEW_ERROR = FLOM_RC_G_MARKUP_PARSE_CONTEXT_NEW_ERROR;
-
-	const FLOM_RC_G_MARKUP_PARSE_CONTEXT_PARSE_ERROR = FLOM_RC_G_MARKUP_PARSE_CONTEXT_PARSE_ERROR;
-
 	const FLOM_RC_G_NODE_APPEND_DATA_ERROR = FLOM_RC_G_NODE_APPEND_DATA_ERROR;
 
 	const FLOM_RC_G_NODE_NEW_ERROR = FLOM_RC_G_NODE_NEW_ERROR;
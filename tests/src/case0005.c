@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2013-2024, Christian Ferrari <tiian@users.sourceforge.net>
+ * All rights reserved.
+ *
+ * This file is part of FLoM.
+ *
+ * FLoM is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ * FLoM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FLoM.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "flom.h"
+
+
+
+/*
+ * Resources locked together by the tests
+ */
+const char *resource_names[] = { "red", "green", "blue" };
+const flom_lock_mode_t lock_modes[] = {
+    FLOM_LOCK_MODE_EX, FLOM_LOCK_MODE_PR, FLOM_LOCK_MODE_EX };
+/*
+ * The same resource can't be locked twice by the same request
+ */
+const char *duplicated_names[] = { "red", "green", "red" };
+/*
+ * Resource sets can not be locked together with other resources
+ */
+const char *invalid_names[] = { "red", "a.b.c" };
+
+
+
+/*
+ * Lock many resources with a single request, check the resources can't be
+ * locked by another handle and release them
+ */
+void lock_many(void) {
+    int ret_cod;
+    flom_handle_t my_handle, other_handle;
+
+    /* initialize the handles */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_init(&my_handle)) ||
+        FLOM_RC_OK != (ret_cod = flom_handle_init(&other_handle))) {
+        fprintf(stderr, "flom_handle_init() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    /* lock acquisition: all the resources */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_lock_many(
+                           &my_handle, resource_names, lock_modes, 3))) {
+        fprintf(stderr, "flom_handle_lock_many() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    /* the second handle can't wait for the resources */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_set_resource_timeout(
+                           &other_handle, 0))) {
+        fprintf(stderr, "flom_handle_set_resource_timeout() returned %d, "
+                "'%s'\n", ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    if (FLOM_RC_LOCK_BUSY != (ret_cod = flom_handle_lock_many(
+                                  &other_handle, resource_names + 2,
+                                  NULL, 1))) {
+        fprintf(stderr, "flom_handle_lock_many() returned %d, '%s' "
+                "instead of FLOM_RC_LOCK_BUSY\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    /* lock release */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_unlock(&my_handle))) {
+        fprintf(stderr, "flom_handle_unlock() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    /* now the resource is available: the release is asynchronous and the
+       second handle must wait for it */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_set_resource_timeout(
+                           &other_handle, -1))) {
+        fprintf(stderr, "flom_handle_set_resource_timeout() returned %d, "
+                "'%s'\n", ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    if (FLOM_RC_OK != (ret_cod = flom_handle_lock_many(
+                           &other_handle, resource_names + 2, NULL, 1))) {
+        fprintf(stderr, "flom_handle_lock_many() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    if (FLOM_RC_OK != (ret_cod = flom_handle_unlock(&other_handle))) {
+        fprintf(stderr, "flom_handle_unlock() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    /* handle clean-up (memory release) */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_clean(&my_handle)) ||
+        FLOM_RC_OK != (ret_cod = flom_handle_clean(&other_handle))) {
+        fprintf(stderr, "flom_handle_clean() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+}
+
+
+
+/*
+ * Requests refused by the lock manager
+ */
+void lock_many_refused(void) {
+    int ret_cod;
+    flom_handle_t my_handle;
+
+    /* initialize a new handle */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_init(&my_handle))) {
+        fprintf(stderr, "flom_handle_init() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    if (FLOM_RC_DUPLICATED_RESOURCE != (ret_cod = flom_handle_lock_many(
+                                            &my_handle, duplicated_names,
+                                            NULL, 3))) {
+        fprintf(stderr, "flom_handle_lock_many() returned %d, '%s' "
+                "instead of FLOM_RC_DUPLICATED_RESOURCE\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    if (FLOM_RC_INVALID_RESOURCE_NAME != (ret_cod = flom_handle_lock_many(
+                                              &my_handle, invalid_names,
+                                              NULL, 2))) {
+        fprintf(stderr, "flom_handle_lock_many() returned %d, '%s' "
+                "instead of FLOM_RC_INVALID_RESOURCE_NAME\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    /* a refused request does not keep any resource */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_lock_many(
+                           &my_handle, resource_names, NULL, 3))) {
+        fprintf(stderr, "flom_handle_lock_many() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    if (FLOM_RC_OK != (ret_cod = flom_handle_unlock(&my_handle))) {
+        fprintf(stderr, "flom_handle_unlock() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    /* handle clean-up (memory release) */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_clean(&my_handle))) {
+        fprintf(stderr, "flom_handle_clean() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+}
+
+
+
+int main(int argc, char *argv[]) {
+    lock_many();
+    lock_many_refused();
+    /* exit */
+    return 0;
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2013-2024, Christian Ferrari <tiian@users.sourceforge.net>
+ * All rights reserved.
+ *
+ * This file is part of FLoM.
+ *
+ * FLoM is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ * FLoM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FLoM.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "flom.h"
+
+
+
+/*
+ * Collect the answers of the pipelined requests: every request must be
+ * answered once, in any order
+ */
+void wait_answers(flom_handle_t *handle, int number, int expected_rc) {
+    int ret_cod, request_id, rc, answered = 0;
+
+    while (number > 0) {
+        if (FLOM_RC_OK != (ret_cod = flom_handle_pipeline_wait(
+                               handle, &request_id, &rc))) {
+            fprintf(stderr, "flom_handle_pipeline_wait() returned %d, '%s'\n",
+                    ret_cod, flom_strerror(ret_cod));
+            exit(1);
+        }
+        if (request_id < 1 || request_id > 31 ||
+            answered & (1 << request_id)) {
+            fprintf(stderr, "flom_handle_pipeline_wait() returned an "
+                    "unexpected request id (%d)\n", request_id);
+            exit(1);
+        }
+        if (expected_rc != rc) {
+            fprintf(stderr, "request %d returned %d, '%s' instead of %d\n",
+                    request_id, rc, flom_strerror(rc), expected_rc);
+            exit(1);
+        }
+        answered |= 1 << request_id;
+        number--;
+    }
+}
+
+
+
+/*
+ * Send many requests without waiting for the answers, check the resources
+ * can't be locked by another handle and release them one at a time
+ */
+void pipeline(void) {
+    int ret_cod, request_id, rc;
+    flom_handle_t my_handle, other_handle;
+
+    /* initialize the handles */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_init(&my_handle)) ||
+        FLOM_RC_OK != (ret_cod = flom_handle_init(&other_handle))) {
+        fprintf(stderr, "flom_handle_init() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    /* pipelined requests: two locks and a ping */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_pipeline_lock(
+                           &my_handle, 1, "pipe1")) ||
+        FLOM_RC_OK != (ret_cod = flom_handle_pipeline_lock(
+                           &my_handle, 2, "pipe2")) ||
+        FLOM_RC_OK != (ret_cod = flom_handle_pipeline_ping(
+                           &my_handle, 3))) {
+        fprintf(stderr, "flom_handle_pipeline_*() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    wait_answers(&my_handle, 3, FLOM_RC_OK);
+    /* the second handle can't wait for the resource */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_set_resource_timeout(
+                           &other_handle, 0)) ||
+        FLOM_RC_OK != (ret_cod = flom_handle_set_resource_name(
+                           &other_handle, "pipe1"))) {
+        fprintf(stderr, "flom_handle_set_*() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    if (FLOM_RC_LOCK_BUSY != (ret_cod = flom_handle_lock(&other_handle))) {
+        fprintf(stderr, "flom_handle_lock() returned %d, '%s' "
+                "instead of FLOM_RC_LOCK_BUSY\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    /* release of the first resource: the release is asynchronous and the
+       second handle must wait for it */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_pipeline_unlock(
+                           &my_handle, 1))) {
+        fprintf(stderr, "flom_handle_pipeline_unlock() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    if (FLOM_RC_OK != (ret_cod = flom_handle_set_resource_timeout(
+                           &other_handle, -1))) {
+        fprintf(stderr, "flom_handle_set_resource_timeout() returned %d, "
+                "'%s'\n", ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    if (FLOM_RC_OK != (ret_cod = flom_handle_lock(&other_handle))) {
+        fprintf(stderr, "flom_handle_lock() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    if (FLOM_RC_OK != (ret_cod = flom_handle_unlock(&other_handle))) {
+        fprintf(stderr, "flom_handle_unlock() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    /* a request for a resource held by a previous request of the same
+       handle is queued until the previous request releases it */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_pipeline_lock(
+                           &my_handle, 4, "pipe2"))) {
+        fprintf(stderr, "flom_handle_pipeline_lock() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    wait_answers(&my_handle, 1, FLOM_RC_LOCK_ENQUEUED);
+    if (FLOM_RC_OK != (ret_cod = flom_handle_pipeline_unlock(
+                           &my_handle, 2))) {
+        fprintf(stderr, "flom_handle_pipeline_unlock() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    if (FLOM_RC_OK != (ret_cod = flom_handle_pipeline_wait(
+                           &my_handle, &request_id, &rc)) ||
+        4 != request_id || FLOM_RC_OK != rc) {
+        fprintf(stderr, "flom_handle_pipeline_wait() returned %d, '%s', "
+                "request_id=%d, rc=%d\n", ret_cod, flom_strerror(ret_cod),
+                request_id, rc);
+        exit(1);
+    }
+    /* release of all the resources */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_unlock(&my_handle))) {
+        fprintf(stderr, "flom_handle_unlock() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    /* handle clean-up (memory release) */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_clean(&my_handle)) ||
+        FLOM_RC_OK != (ret_cod = flom_handle_clean(&other_handle))) {
+        fprintf(stderr, "flom_handle_clean() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+}
+
+
+
+/*
+ * Requests refused by the handle
+ */
+void pipeline_refused(void) {
+    int ret_cod;
+    flom_handle_t my_handle;
+
+    /* initialize a new handle */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_init(&my_handle))) {
+        fprintf(stderr, "flom_handle_init() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    /* nothing to unlock */
+    if (FLOM_RC_API_INVALID_SEQUENCE != (
+            ret_cod = flom_handle_pipeline_unlock(&my_handle, 1))) {
+        fprintf(stderr, "flom_handle_pipeline_unlock() returned %d, '%s' "
+                "instead of FLOM_RC_API_INVALID_SEQUENCE\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    /* request ids must be positive */
+    if (FLOM_RC_OUT_OF_RANGE != (ret_cod = flom_handle_pipeline_lock(
+                                     &my_handle, 0, "pipe1"))) {
+        fprintf(stderr, "flom_handle_pipeline_lock() returned %d, '%s' "
+                "instead of FLOM_RC_OUT_OF_RANGE\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    /* handle clean-up (memory release) */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_clean(&my_handle))) {
+        fprintf(stderr, "flom_handle_clean() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+}
+
+
+
+int main(int argc, char *argv[]) {
+    pipeline();
+    pipeline_refused();
+    /* exit */
+    return 0;
+}
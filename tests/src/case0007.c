@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2013-2024, Christian Ferrari <tiian@users.sourceforge.net>
+ * All rights reserved.
+ *
+ * This file is part of FLoM.
+ *
+ * FLoM is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ * FLoM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FLoM.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "flom.h"
+
+
+
+/*
+ * Resource locked by the holder and waited by all the requests
+ */
+const char *resource_name = "waiters";
+
+
+
+/*
+ * Collect the answers of the pipelined requests: every answer must carry
+ * the expected return code
+ */
+void wait_answers(flom_handle_t *handle, int number, int expected_rc) {
+    int ret_cod, request_id, rc;
+
+    while (number > 0) {
+        if (FLOM_RC_OK != (ret_cod = flom_handle_pipeline_wait(
+                               handle, &request_id, &rc))) {
+            fprintf(stderr, "flom_handle_pipeline_wait() returned %d, '%s'\n",
+                    ret_cod, flom_strerror(ret_cod));
+            exit(1);
+        }
+        if (expected_rc != rc) {
+            fprintf(stderr, "request %d returned %d, '%s' instead of %d\n",
+                    request_id, rc, flom_strerror(rc), expected_rc);
+            exit(1);
+        }
+        number--;
+    }
+}
+
+
+
+/*
+ * Queue many shared lock requests behind an exclusive lock and measure the
+ * time necessary to grant all of them when the exclusive lock is released.
+ * The number of waiters can be passed as the first argument: the daemon
+ * needs two file descriptors for every waiter
+ */
+int main(int argc, char *argv[]) {
+    int ret_cod, i, waiters = 100;
+    flom_handle_t holder, waiting;
+    struct timeval start, stop;
+    long elapsed;
+
+    if (argc > 1)
+        waiters = strtol(argv[1], NULL, 10);
+    /* initialize the handles */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_init(&holder)) ||
+        FLOM_RC_OK != (ret_cod = flom_handle_init(&waiting))) {
+        fprintf(stderr, "flom_handle_init() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    /* the holder keeps an exclusive lock, the waiters ask a shared lock */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_set_resource_name(
+                           &holder, resource_name)) ||
+        FLOM_RC_OK != (ret_cod = flom_handle_set_lock_mode(
+                           &holder, FLOM_LOCK_MODE_EX)) ||
+        FLOM_RC_OK != (ret_cod = flom_handle_set_lock_mode(
+                           &waiting, FLOM_LOCK_MODE_PR))) {
+        fprintf(stderr, "flom_handle_set_*() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    if (FLOM_RC_OK != (ret_cod = flom_handle_lock(&holder))) {
+        fprintf(stderr, "flom_handle_lock() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    /* queue the waiters */
+    for (i = 1; i <= waiters; ++i) {
+        if (FLOM_RC_OK != (ret_cod = flom_handle_pipeline_lock(
+                               &waiting, i, resource_name))) {
+            fprintf(stderr, "flom_handle_pipeline_lock() returned %d, "
+                    "'%s'\n", ret_cod, flom_strerror(ret_cod));
+            exit(1);
+        }
+    }
+    wait_answers(&waiting, waiters, FLOM_RC_LOCK_ENQUEUED);
+    /* release the exclusive lock: all the waiters are granted */
+    gettimeofday(&start, NULL);
+    if (FLOM_RC_OK != (ret_cod = flom_handle_unlock(&holder))) {
+        fprintf(stderr, "flom_handle_unlock() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    wait_answers(&waiting, waiters, FLOM_RC_OK);
+    gettimeofday(&stop, NULL);
+    elapsed = (stop.tv_sec - start.tv_sec) * 1000000 +
+        stop.tv_usec - start.tv_usec;
+    printf("%d waiters granted in %ld microseconds\n", waiters, elapsed);
+    /* release of all the resources */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_unlock(&waiting))) {
+        fprintf(stderr, "flom_handle_unlock() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    /* handle clean-up (memory release) */
+    if (FLOM_RC_OK != (ret_cod = flom_handle_clean(&holder)) ||
+        FLOM_RC_OK != (ret_cod = flom_handle_clean(&waiting))) {
+        fprintf(stderr, "flom_handle_clean() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    /* exit */
+    return 0;
+}
@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2013-2024, Christian Ferrari <tiian@users.sourceforge.net>
+ * All rights reserved.
+ *
+ * This file is part of FLoM.
+ *
+ * FLoM is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ * FLoM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FLoM.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "flom_errors.h"
+#include "flom_msg.h"
+
+
+
+/*
+ * This case test uses the internal interface of libflom: it's not a
+ * programming example, but a regression test of the XML message parser
+ */
+
+
+
+/*
+ * Header of the messages used by the test
+ */
+#define MSG_OPEN(VERB, STEP) \
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>" \
+    "<msg level=\"3\" verb=\"" #VERB "\" step=\"" #STEP "\">"
+#define MSG_CLOSE "</msg>"
+
+
+
+/*
+ * The parser is reused by all the messages, like the daemon does
+ */
+flom_msg_parser_t parser;
+
+
+
+/*
+ * Parse a message and check the state of the message after parsing
+ */
+void parse(const char *label, const char *text, struct flom_msg_s *msg,
+           int expected_state) {
+    int ret_cod;
+    char *buffer = NULL;
+    size_t len = strlen(text);
+
+    /* the parser must not rely on the string terminator */
+    if (NULL == (buffer = malloc(len + 1))) {
+        fprintf(stderr, "%s: malloc() returned NULL\n", label);
+        exit(1);
+    }
+    memcpy(buffer, text, len);
+    flom_msg_init(msg);
+    if (FLOM_RC_OK != (ret_cod = flom_msg_deserialize(
+                           buffer, len, msg, &parser))) {
+        fprintf(stderr, "%s: flom_msg_deserialize() returned %d, '%s'\n",
+                label, ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    free(buffer);
+    if (expected_state != msg->state) {
+        fprintf(stderr, "%s: message state is %d instead of %d\n",
+                label, msg->state, expected_state);
+        exit(1);
+    }
+}
+
+
+
+/*
+ * Parse a well formed message and check its header
+ */
+void parse_ready(const char *label, const char *text, struct flom_msg_s *msg,
+                 int verb, int step) {
+    parse(label, text, msg, FLOM_MSG_STATE_READY);
+    if (verb != msg->header.pvs.verb || step != msg->header.pvs.step) {
+        fprintf(stderr, "%s: verb=%d, step=%d instead of verb=%d, "
+                "step=%d\n", label, msg->header.pvs.verb,
+                msg->header.pvs.step, verb, step);
+        exit(1);
+    }
+}
+
+
+
+/*
+ * Parse a message that must be rejected
+ */
+void parse_invalid(const char *label, const char *text) {
+    struct flom_msg_s msg;
+
+    parse(label, text, &msg, FLOM_MSG_STATE_INVALID);
+    flom_msg_free(&msg);
+}
+
+
+
+/*
+ * Check a string field of a message
+ */
+void check_string(const char *label, const char *field,
+                  const char *expected) {
+    if (NULL == field || strcmp(field, expected)) {
+        fprintf(stderr, "%s: field is '%s' instead of '%s'\n",
+                label, NULL == field ? "(null)" : field, expected);
+        exit(1);
+    }
+}
+
+
+
+/*
+ * Check an integer field of a message
+ */
+void check_int(const char *label, int field, int expected) {
+    if (field != expected) {
+        fprintf(stderr, "%s: field is %d instead of %d\n",
+                label, field, expected);
+        exit(1);
+    }
+}
+
+
+
+/*
+ * A well formed message of every verb and step
+ */
+void well_formed(void) {
+    struct flom_msg_s msg;
+
+    parse_ready("lock 8",
+                MSG_OPEN(1, 8) "<session peerid=\"peer1\"/>"
+                "<resource name=\"cmVzMQ==\" mode=\"5\" wait=\"1\" "
+                "quantity=\"2\" create=\"1\" lifespan=\"300\"/>" MSG_CLOSE,
+                &msg, FLOM_MSG_VERB_LOCK, FLOM_MSG_STEP_INCR);
+    check_string("lock 8", msg.body.lock_8.session.peerid, "peer1");
+    check_string("lock 8", msg.body.lock_8.resource.name, "res1");
+    check_int("lock 8", msg.body.lock_8.resource.mode, 5);
+    check_int("lock 8", msg.body.lock_8.resource.wait, 1);
+    check_int("lock 8", msg.body.lock_8.resource.quantity, 2);
+    check_int("lock 8", msg.body.lock_8.resource.create, 1);
+    check_int("lock 8", msg.body.lock_8.resource.lifespan, 300);
+    flom_msg_free(&msg);
+
+    parse_ready("lock 16",
+                MSG_OPEN(1, 16) "<session peerid=\"peer2\"/>"
+                "<answer rc=\"0\" element=\"\"/>" MSG_CLOSE,
+                &msg, FLOM_MSG_VERB_LOCK, 2*FLOM_MSG_STEP_INCR);
+    check_string("lock 16", msg.body.lock_16.session.peerid, "peer2");
+    check_int("lock 16", msg.body.lock_16.answer.rc, FLOM_RC_OK);
+    flom_msg_free(&msg);
+
+    parse_ready("lock 24",
+                MSG_OPEN(1, 24) "<answer rc=\"0\" element=\"3\"/>" MSG_CLOSE,
+                &msg, FLOM_MSG_VERB_LOCK, 3*FLOM_MSG_STEP_INCR);
+    check_string("lock 24", msg.body.lock_24.answer.element, "3");
+    flom_msg_free(&msg);
+
+    parse_ready("lock 32",
+                MSG_OPEN(1, 32) "<answer rc=\"4\"/>" MSG_CLOSE,
+                &msg, FLOM_MSG_VERB_LOCK, 4*FLOM_MSG_STEP_INCR);
+    check_int("lock 32", msg.body.lock_32.answer.rc, 4);
+    flom_msg_free(&msg);
+
+    parse_ready("unlock 8",
+                MSG_OPEN(2, 8) "<resource name=\"cmVzMg==\" rollback=\"1\"/>"
+                MSG_CLOSE, &msg, FLOM_MSG_VERB_UNLOCK, FLOM_MSG_STEP_INCR);
+    check_string("unlock 8", msg.body.unlock_8.resource.name, "res2");
+    check_int("unlock 8", msg.body.unlock_8.resource.rollback, 1);
+    flom_msg_free(&msg);
+
+    parse_ready("ping 8", MSG_OPEN(3, 8) MSG_CLOSE,
+                &msg, FLOM_MSG_VERB_PING, FLOM_MSG_STEP_INCR);
+    flom_msg_free(&msg);
+
+    parse_ready("ping 16", MSG_OPEN(3, 16) MSG_CLOSE,
+                &msg, FLOM_MSG_VERB_PING, 2*FLOM_MSG_STEP_INCR);
+    flom_msg_free(&msg);
+
+    parse_ready("discover 8", MSG_OPEN(4, 8) MSG_CLOSE,
+                &msg, FLOM_MSG_VERB_DISCOVER, FLOM_MSG_STEP_INCR);
+    flom_msg_free(&msg);
+
+    parse_ready("discover 16",
+                MSG_OPEN(4, 16) "<network address=\"10.0.0.1\" port=\"28015\"/>"
+                MSG_CLOSE, &msg, FLOM_MSG_VERB_DISCOVER, 2*FLOM_MSG_STEP_INCR);
+    check_string("discover 16", msg.body.discover_16.network.address,
+                 "10.0.0.1");
+    check_int("discover 16", msg.body.discover_16.network.port, 28015);
+    flom_msg_free(&msg);
+
+    parse_ready("mngmnt 8",
+                MSG_OPEN(5, 8) "<session peerid=\"peer3\"/>"
+                "<shutdown immediate=\"1\"/>" MSG_CLOSE,
+                &msg, FLOM_MSG_VERB_MNGMNT, FLOM_MSG_STEP_INCR);
+    check_string("mngmnt 8", msg.body.mngmnt_8.session.peerid, "peer3");
+    check_int("mngmnt 8", msg.body.mngmnt_8.action,
+              FLOM_MSG_MNGMNT_ACTION_SHUTDOWN);
+    check_int("mngmnt 8",
+              msg.body.mngmnt_8.action_data.shutdown.immediate, 1);
+    flom_msg_free(&msg);
+
+    parse_ready("mlock 8",
+                MSG_OPEN(6, 8) "<session peerid=\"peer4\"/>"
+                "<resource name=\"cmVzMQ==\" mode=\"5\" wait=\"1\" "
+                "quantity=\"0\" create=\"1\" lifespan=\"0\"/>"
+                "<resource name=\"cmVzMg==\" mode=\"2\" wait=\"0\" "
+                "quantity=\"0\" create=\"1\" lifespan=\"0\"/>" MSG_CLOSE,
+                &msg, FLOM_MSG_VERB_MLOCK, FLOM_MSG_STEP_INCR);
+    check_string("mlock 8", msg.body.mlock_8.session.peerid, "peer4");
+    check_int("mlock 8", msg.body.mlock_8.resource_number, 2);
+    check_string("mlock 8", msg.body.mlock_8.resources[0].name, "res1");
+    check_string("mlock 8", msg.body.mlock_8.resources[1].name, "res2");
+    check_int("mlock 8", msg.body.mlock_8.resources[1].mode, 2);
+    flom_msg_free(&msg);
+
+    parse_ready("mlock 16",
+                MSG_OPEN(6, 16) "<session peerid=\"peer5\"/>"
+                "<answer rc=\"0\" element=\"\"/>" MSG_CLOSE,
+                &msg, FLOM_MSG_VERB_MLOCK, 2*FLOM_MSG_STEP_INCR);
+    check_string("mlock 16", msg.body.lock_16.session.peerid, "peer5");
+    flom_msg_free(&msg);
+
+    parse_ready("mlock 24",
+                MSG_OPEN(6, 24) "<answer rc=\"0\" element=\"\"/>" MSG_CLOSE,
+                &msg, FLOM_MSG_VERB_MLOCK, 3*FLOM_MSG_STEP_INCR);
+    flom_msg_free(&msg);
+
+    /* a request id, single quotes, white spaces and an end tag without
+       the XML declaration */
+    parse_ready("layout",
+                "<msg level='3' verb='3' step='8' rid='17' > \n"
+                "</msg >\n", &msg, FLOM_MSG_VERB_PING, FLOM_MSG_STEP_INCR);
+    check_int("layout", msg.header.rid, 17);
+    flom_msg_free(&msg);
+}
+
+
+
+/*
+ * Every escaped entity is replaced by its char
+ */
+void entities(void) {
+    struct flom_msg_s msg;
+
+    parse_ready("entities",
+                MSG_OPEN(1, 24) "<answer rc=\"0\" "
+                "element=\"a&amp;b&lt;c&gt;d&quot;e&apos;f\"/>" MSG_CLOSE,
+                &msg, FLOM_MSG_VERB_LOCK, 3*FLOM_MSG_STEP_INCR);
+    check_string("entities", msg.body.lock_24.answer.element,
+                 "a&b<c>d\"e'f");
+    flom_msg_free(&msg);
+
+    parse_ready("entities only",
+                MSG_OPEN(4, 16) "<network address=\"&lt;&amp;&gt;\" "
+                "port=\"1\"/>" MSG_CLOSE,
+                &msg, FLOM_MSG_VERB_DISCOVER, 2*FLOM_MSG_STEP_INCR);
+    check_string("entities only", msg.body.discover_16.network.address,
+                 "<&>");
+    flom_msg_free(&msg);
+
+    parse_invalid("unknown entity",
+                  MSG_OPEN(1, 24) "<answer rc=\"0\" element=\"a&nbsp;b\"/>"
+                  MSG_CLOSE);
+    parse_invalid("numeric entity",
+                  MSG_OPEN(1, 24) "<answer rc=\"0\" element=\"a&#38;b\"/>"
+                  MSG_CLOSE);
+    parse_invalid("unterminated entity",
+                  MSG_OPEN(1, 24) "<answer rc=\"0\" element=\"a&amp\"/>"
+                  MSG_CLOSE);
+    parse_invalid("entity at the end",
+                  MSG_OPEN(1, 24) "<answer rc=\"0\" element=\"&");
+}
+
+
+
+/*
+ * Attributes that can not be accepted
+ */
+void attributes(void) {
+    char text[2*FLOM_MSG_PARSER_SCRATCH_SIZE];
+    size_t len;
+
+    /* an attribute value that does not fit the scratch area */
+    strcpy(text, MSG_OPEN(1, 24) "<answer rc=\"0\" element=\"");
+    len = strlen(text);
+    memset(text + len, 'x', FLOM_MSG_PARSER_SCRATCH_SIZE);
+    strcpy(text + len + FLOM_MSG_PARSER_SCRATCH_SIZE, "\"/>" MSG_CLOSE);
+    parse_invalid("too long value", text);
+
+    /* an attribute name that does not fit the scratch area */
+    strcpy(text, MSG_OPEN(1, 24) "<answer ");
+    len = strlen(text);
+    memset(text + len, 'x', FLOM_MSG_PARSER_SCRATCH_SIZE);
+    strcpy(text + len + FLOM_MSG_PARSER_SCRATCH_SIZE,
+           "=\"0\"/>" MSG_CLOSE);
+    parse_invalid("too long name", text);
+
+    parse_invalid("repeated attribute",
+                  MSG_OPEN(1, 16) "<session peerid=\"peer1\" "
+                  "peerid=\"peer2\"/><answer rc=\"0\" element=\"\"/>"
+                  MSG_CLOSE);
+    parse_invalid("repeated header attribute",
+                  "<msg level=\"3\" verb=\"3\" verb=\"4\" step=\"8\">"
+                  MSG_CLOSE);
+    parse_invalid("too many attributes",
+                  MSG_OPEN(1, 24) "<answer a=\"1\" b=\"2\" c=\"3\" d=\"4\" "
+                  "e=\"5\" f=\"6\" g=\"7\" h=\"8\" i=\"9\"/>" MSG_CLOSE);
+    parse_invalid("missing equal sign",
+                  MSG_OPEN(1, 24) "<answer rc \"0\"/>" MSG_CLOSE);
+    parse_invalid("missing quote",
+                  MSG_OPEN(1, 24) "<answer rc=0/>" MSG_CLOSE);
+    parse_invalid("less than inside value",
+                  MSG_OPEN(1, 24) "<answer rc=\"0\" element=\"a<b\"/>"
+                  MSG_CLOSE);
+}
+
+
+
+/*
+ * Messages cut in the middle
+ */
+void truncated(void) {
+    parse_invalid("empty", "");
+    parse_invalid("only spaces", "  \n");
+    parse_invalid("only declaration",
+                  "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>");
+    parse_invalid("inside declaration", "<?xml version=\"1.0\"");
+    parse_invalid("only less than", "<");
+    parse_invalid("inside tag name", "<ms");
+    parse_invalid("inside attribute name", "<msg lev");
+    parse_invalid("after equal sign", "<msg level=");
+    parse_invalid("inside attribute value", "<msg level=\"3");
+    parse_invalid("before tag end", MSG_OPEN(3, 8) "<answer rc=\"0\"");
+    parse_invalid("inside empty tag end", MSG_OPEN(3, 8) "<answer rc=\"0\"/");
+    parse_invalid("missing end tag", MSG_OPEN(3, 8));
+    parse_invalid("inside end tag", MSG_OPEN(3, 8) "</ms");
+    parse_invalid("before end tag end", MSG_OPEN(3, 8) "</msg");
+}
+
+
+
+/*
+ * Data that can not follow or surround the root element
+ */
+void garbage(void) {
+    parse_invalid("trailing text", MSG_OPEN(3, 8) MSG_CLOSE "x");
+    parse_invalid("trailing element",
+                  MSG_OPEN(3, 8) MSG_CLOSE "<msg/>");
+    parse_invalid("trailing declaration",
+                  MSG_OPEN(3, 8) MSG_CLOSE "<?xml version=\"1.0\"?>");
+    parse_invalid("trailing end tag", MSG_OPEN(3, 8) MSG_CLOSE MSG_CLOSE);
+    parse_invalid("leading text", "x" MSG_OPEN(3, 8) MSG_CLOSE);
+    parse_invalid("text inside", MSG_OPEN(3, 8) "x" MSG_CLOSE);
+    parse_invalid("nested element",
+                  MSG_OPEN(3, 8) "<answer rc=\"0\"></answer>" MSG_CLOSE);
+    parse_invalid("wrong end tag", MSG_OPEN(3, 8) "</answer>");
+    parse_invalid("wrong protocol level",
+                  "<msg level=\"2\" verb=\"3\" step=\"8\">" MSG_CLOSE);
+}
+
+
+
+int main(int argc, char *argv[]) {
+    well_formed();
+    entities();
+    attributes();
+    truncated();
+    garbage();
+    return 0;
+}
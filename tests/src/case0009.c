@@ -0,0 +1,358 @@
+/*
+ * Copyright (c) 2013-2024, Christian Ferrari <tiian@users.sourceforge.net>
+ * All rights reserved.
+ *
+ * This file is part of FLoM.
+ *
+ * FLoM is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ * FLoM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FLoM.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "flom.h"
+#include "flom_conn.h"
+#include "flom_msg.h"
+
+
+
+/*
+ * This case test uses the internal interface of libflom: it's not a
+ * programming example, but a regression test of the framing of the stream
+ * messages inside the receive buffer of a connection
+ */
+
+
+
+/*
+ * Tagged ping request: the daemon answers it immediately
+ */
+#define PING(RID) \
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>" \
+    "<msg level=\"3\" verb=\"3\" step=\"8\" rid=\"" #RID "\"></msg>"
+
+
+
+flom_msg_parser_t parser;
+
+
+
+/*
+ * Send some bytes and fail if they can not be sent
+ */
+void send_all(int fd, const char *buffer, size_t len) {
+    while (len > 0) {
+        ssize_t sent = send(fd, buffer, len, MSG_NOSIGNAL);
+        if (0 > sent) {
+            fprintf(stderr, "send() returned %zd, errno=%d\n", sent, errno);
+            exit(1);
+        }
+        buffer += sent;
+        len -= (size_t)sent;
+    }
+}
+
+
+
+/*
+ * Check a message is a ping with the expected step and request id (0 means
+ * any request id); it returns the request id of the message
+ */
+int check_msg(const char *label, char *buffer, size_t len, int step,
+              int rid) {
+    int ret_cod;
+    struct flom_msg_s msg;
+
+    flom_msg_init(&msg);
+    if (FLOM_RC_OK != (ret_cod = flom_msg_deserialize(
+                           buffer, len, &msg, &parser))) {
+        fprintf(stderr, "%s: flom_msg_deserialize() returned %d, '%s'\n",
+                label, ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    if (FLOM_MSG_STATE_READY != msg.state ||
+        FLOM_MSG_VERB_PING != msg.header.pvs.verb ||
+        step != msg.header.pvs.step || 0 >= msg.header.rid ||
+        (0 != rid && rid != msg.header.rid)) {
+        fprintf(stderr, "%s: unexpected message (state=%d, verb=%d, "
+                "step=%d, rid=%d) instead of (step=%d, rid=%d): '%*.*s'\n",
+                label, msg.state, msg.header.pvs.verb, msg.header.pvs.step,
+                msg.header.rid, step, rid, (int)len, (int)len, buffer);
+        exit(1);
+    }
+    flom_msg_free(&msg);
+    return msg.header.rid;
+}
+
+
+
+/*
+ * Receive a message from a connection and check it
+ */
+void recv_msg(const char *label, flom_conn_t *conn, int rid) {
+    int ret_cod;
+    char buffer[FLOM_MSG_BUFFER_SIZE];
+    size_t received;
+
+    if (FLOM_RC_OK != (ret_cod = flom_conn_recv_msg(
+                           conn, buffer, sizeof(buffer), &received))) {
+        fprintf(stderr, "%s: flom_conn_recv_msg() returned %d, '%s'\n",
+                label, ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    check_msg(label, buffer, received, FLOM_MSG_STEP_INCR, rid);
+}
+
+
+
+/*
+ * Check the number of whole messages inside the receive buffer
+ */
+void check_pending(const char *label, flom_conn_t *conn, guint expected) {
+    guint pending = flom_conn_get_pending_msgs(conn);
+    if (expected != pending) {
+        fprintf(stderr, "%s: %u pending messages instead of %u\n",
+                label, pending, expected);
+        exit(1);
+    }
+}
+
+
+
+/*
+ * Frame the messages written to one end of a socket pair
+ */
+void local_framing(void) {
+    int ret_cod;
+    int fds[2];
+    struct sockaddr_un sa;
+    flom_conn_t *conn = NULL;
+    char buffer[FLOM_MSG_BUFFER_SIZE];
+    char *big = NULL;
+    size_t received, half;
+    const char *two = PING(1) PING(2);
+    const char *split = PING(3);
+
+    if (-1 == socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+        fprintf(stderr, "socketpair() returned errno=%d\n", errno);
+        exit(1);
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    if (NULL == (conn = flom_conn_new(NULL))) {
+        fprintf(stderr, "flom_conn_new() returned NULL\n");
+        exit(1);
+    }
+    if (FLOM_RC_OK != (ret_cod = flom_conn_init(
+                           conn, 1, AF_UNIX, fds[0], SOCK_STREAM,
+                           sizeof(sa), (struct sockaddr *)&sa, TRUE))) {
+        fprintf(stderr, "flom_conn_init() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+
+    /* the frame detection does not need a whole message */
+    if (0 != flom_conn_frame_msg(split, strlen(split) - 1) ||
+        strlen(split) != flom_conn_frame_msg(split, strlen(split)) ||
+        strlen(split) != flom_conn_frame_msg(two, strlen(two))) {
+        fprintf(stderr, "flom_conn_frame_msg() returned a wrong length\n");
+        exit(1);
+    }
+
+    /* two messages sent back to back are read by one chunk, the second
+       one is returned from the receive buffer */
+    check_pending("back to back", conn, 0);
+    send_all(fds[1], two, strlen(two));
+    recv_msg("back to back 1", conn, 1);
+    check_pending("back to back 1", conn, 1);
+    recv_msg("back to back 2", conn, 2);
+    check_pending("back to back 2", conn, 0);
+
+    /* a message split in two chunks is kept until it's complete */
+    if (-1 == fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK)) {
+        fprintf(stderr, "fcntl() returned errno=%d\n", errno);
+        exit(1);
+    }
+    half = strlen(split) / 2;
+    send_all(fds[1], split, half);
+    if (FLOM_RC_WOULD_BLOCK != (ret_cod = flom_conn_recv_msg(
+                                    conn, buffer, sizeof(buffer),
+                                    &received))) {
+        fprintf(stderr, "split: flom_conn_recv_msg() returned %d, '%s' "
+                "instead of FLOM_RC_WOULD_BLOCK\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    check_pending("split 1", conn, 0);
+    send_all(fds[1], split + half, strlen(split) - half);
+    recv_msg("split 2", conn, 3);
+    check_pending("split 2", conn, 0);
+
+    /* a frame that does not fit the receive buffer is refused */
+    if (NULL == (big = malloc(FLOM_CONN_RBUF_SIZE + 1))) {
+        fprintf(stderr, "malloc() returned NULL\n");
+        exit(1);
+    }
+    memset(big, ' ', FLOM_CONN_RBUF_SIZE + 1);
+    memcpy(big, "<msg", 4);
+    send_all(fds[1], big, FLOM_CONN_RBUF_SIZE + 1);
+    free(big);
+    if (FLOM_RC_BUFFER_OVERFLOW != (ret_cod = flom_conn_recv_msg(
+                                        conn, buffer, sizeof(buffer),
+                                        &received))) {
+        fprintf(stderr, "too long: flom_conn_recv_msg() returned %d, '%s' "
+                "instead of FLOM_RC_BUFFER_OVERFLOW\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+
+    flom_conn_delete(conn);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+
+
+/*
+ * Read from the daemon until the buffer contains a whole message
+ */
+size_t daemon_recv(int fd, char *buffer, size_t size, size_t *len) {
+    size_t msg_len;
+
+    while (0 == (msg_len = flom_conn_frame_msg(buffer, *len))) {
+        ssize_t read_bytes = recv(fd, buffer + *len, size - *len, 0);
+        if (0 >= read_bytes) {
+            fprintf(stderr, "recv() returned %zd, errno=%d\n",
+                    read_bytes, errno);
+            exit(1);
+        }
+        *len += (size_t)read_bytes;
+    }
+    return msg_len;
+}
+
+
+
+/*
+ * Consume a message at the beginning of the buffer
+ */
+void daemon_consume(char *buffer, size_t *len, size_t msg_len) {
+    *len -= msg_len;
+    memmove(buffer, buffer + msg_len, *len);
+}
+
+
+
+/*
+ * Connect to the daemon with the default configuration
+ */
+int daemon_connect(void) {
+    int ret_cod, fd;
+    flom_handle_t handle;
+    struct sockaddr_un sa;
+
+    if (FLOM_RC_OK != (ret_cod = flom_handle_init(&handle))) {
+        fprintf(stderr, "flom_handle_init() returned %d, '%s'\n",
+                ret_cod, flom_strerror(ret_cod));
+        exit(1);
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strncpy(sa.sun_path, flom_handle_get_socket_name(&handle),
+            sizeof(sa.sun_path) - 1);
+    flom_handle_clean(&handle);
+    if (-1 == (fd = socket(AF_UNIX, SOCK_STREAM, 0)) ||
+        -1 == connect(fd, (struct sockaddr *)&sa, sizeof(sa))) {
+        fprintf(stderr, "unable to connect to '%s', errno=%d\n",
+                sa.sun_path, errno);
+        exit(1);
+    }
+    return fd;
+}
+
+
+
+/*
+ * Frame the requests received by a running daemon
+ */
+void daemon_framing(void) {
+    int fd;
+    char buffer[4*FLOM_MSG_BUFFER_SIZE];
+    char *big = NULL;
+    size_t len = 0, msg_len, half;
+    ssize_t read_bytes;
+    const char *two = PING(1) PING(2);
+    const char *split = PING(3);
+    int answered = 0, i;
+
+    fd = daemon_connect();
+
+    /* two requests sent back to back are both answered */
+    send_all(fd, two, strlen(two));
+    for (i=0; i<2; ++i) {
+        msg_len = daemon_recv(fd, buffer, sizeof(buffer), &len);
+        /* the answers can arrive in any order */
+        answered |= 1 << check_msg("daemon back to back", buffer, msg_len,
+                                   2*FLOM_MSG_STEP_INCR, 0);
+        daemon_consume(buffer, &len, msg_len);
+    }
+    if ((1 << 1 | 1 << 2) != answered) {
+        fprintf(stderr, "daemon back to back: unexpected answers (mask "
+                "%d)\n", answered);
+        exit(1);
+    }
+
+    /* a request split in two chunks is answered when it's complete */
+    half = strlen(split) / 2;
+    send_all(fd, split, half);
+    usleep(100000);
+    send_all(fd, split + half, strlen(split) - half);
+    msg_len = daemon_recv(fd, buffer, sizeof(buffer), &len);
+    check_msg("daemon split", buffer, msg_len, 2*FLOM_MSG_STEP_INCR, 3);
+    daemon_consume(buffer, &len, msg_len);
+    close(fd);
+
+    /* a frame that does not fit the receive buffer closes the
+       connection */
+    fd = daemon_connect();
+    if (NULL == (big = malloc(FLOM_CONN_RBUF_SIZE + 1))) {
+        fprintf(stderr, "malloc() returned NULL\n");
+        exit(1);
+    }
+    memset(big, ' ', FLOM_CONN_RBUF_SIZE + 1);
+    memcpy(big, "<msg", 4);
+    /* the daemon can close the connection before the last byte is sent */
+    send(fd, big, FLOM_CONN_RBUF_SIZE + 1, MSG_NOSIGNAL);
+    free(big);
+    read_bytes = recv(fd, buffer, sizeof(buffer), 0);
+    if (0 < read_bytes) {
+        fprintf(stderr, "daemon too long: the daemon sent %zd bytes "
+                "instead of closing the connection\n", read_bytes);
+        exit(1);
+    }
+    close(fd);
+}
+
+
+
+int main(int argc, char *argv[]) {
+    local_framing();
+    if (argc > 1 && !strcmp(argv[1], "daemon"))
+        daemon_framing();
+    return 0;
+}